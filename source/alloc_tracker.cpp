@@ -0,0 +1,339 @@
+﻿#include "alloc_tracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+// 所有状态都是常量初始化的，静态初始化期间调用 operator new 也是安全的
+struct TagCounter
+{
+    std::atomic<const char*> tag {nullptr};
+    std::atomic<uint64_t> allocations {0};
+    std::atomic<uint64_t> bytes {0};
+
+    // beginFrame() 时的快照，只在调用 beginFrame() 的线程中访问
+    uint64_t frameAllocations {0};
+    uint64_t frameBytes {0};
+};
+
+constexpr const char* kUntagged = "untagged";
+constexpr const char* kOverflow = "other";
+
+std::atomic<bool> g_enabled {false};
+std::atomic<uint64_t> g_frees {0};
+TagCounter g_counters[AllocTracker::kMaxTags];
+thread_local const char* t_tag = nullptr;
+
+// 标签数量很少，线性查找。最后一个位置留给放不下的标签
+TagCounter& findCounter(const char* tag)
+{
+    for (uint32_t i = 0; i + 1 < AllocTracker::kMaxTags; ++i)
+    {
+        TagCounter& counter = g_counters[i];
+        const char* current = counter.tag.load(std::memory_order_acquire);
+        if (!current)
+        {
+            if (counter.tag.compare_exchange_strong(current, tag, std::memory_order_acq_rel))
+            {
+                return counter;
+            }
+        }
+
+        // 不同编译单元中相同的字面量地址可能不同
+        if (current == tag || strcmp(current, tag) == 0)
+        {
+            return counter;
+        }
+    }
+
+    TagCounter& overflow = g_counters[AllocTracker::kMaxTags - 1];
+    overflow.tag.store(kOverflow, std::memory_order_release);
+    return overflow;
+}
+
+// bgfx 传入的是完整路径，只保留文件名
+const char* getFileName(const char* filePath)
+{
+    const char* name = filePath;
+    for (const char* c = filePath; *c; ++c)
+    {
+        if (*c == '/' || *c == '\\')
+        {
+            name = c + 1;
+        }
+    }
+    return name;
+}
+
+class BgfxAllocator : public bx::AllocatorI
+{
+public:
+    void* realloc(void* ptr, size_t size, size_t align, const char* filePath, uint32_t line) override
+    {
+        if (size == 0)
+        {
+            if (ptr)
+            {
+                AllocTracker::recordFree();
+            }
+        }
+        else
+        {
+            AllocTracker::recordAllocation(size, filePath ? getFileName(filePath) : "bgfx");
+        }
+        return m_allocator.realloc(ptr, size, align, filePath, line);
+    }
+
+private:
+    bx::DefaultAllocator m_allocator;
+};
+
+void* allocate(size_t size)
+{
+    AllocTracker::recordAllocation(size);
+    return malloc(size != 0 ? size : 1);
+}
+
+void* allocateAligned(size_t size, std::align_val_t alignment)
+{
+    AllocTracker::recordAllocation(size);
+    const size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+#ifdef _MSC_VER
+    return _aligned_malloc(size != 0 ? size : 1, align);
+#else
+    void* ptr = nullptr;
+    return posix_memalign(&ptr, align, size != 0 ? size : 1) == 0 ? ptr : nullptr;
+#endif
+}
+
+void deallocate(void* ptr)
+{
+    if (ptr)
+    {
+        AllocTracker::recordFree();
+        free(ptr);
+    }
+}
+
+void deallocateAligned(void* ptr)
+{
+    if (ptr)
+    {
+        AllocTracker::recordFree();
+#ifdef _MSC_VER
+        _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
+    }
+}
+} // namespace
+
+void AllocTracker::setEnabled(bool enabled)
+{
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool AllocTracker::isEnabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+bx::AllocatorI* AllocTracker::getBgfxAllocator()
+{
+    static BgfxAllocator allocator;
+    return &allocator;
+}
+
+void AllocTracker::beginFrame()
+{
+    for (TagCounter& counter : g_counters)
+    {
+        counter.frameAllocations = counter.allocations.load(std::memory_order_relaxed);
+        counter.frameBytes       = counter.bytes.load(std::memory_order_relaxed);
+    }
+}
+
+uint64_t AllocTracker::getFrameAllocations()
+{
+    uint64_t allocations = 0;
+    for (const TagCounter& counter : g_counters)
+    {
+        allocations += counter.allocations.load(std::memory_order_relaxed) - counter.frameAllocations;
+    }
+    return allocations;
+}
+
+uint32_t AllocTracker::getFrameCounters(Counter* counters, uint32_t maxCounters)
+{
+    uint32_t count = 0;
+    for (const TagCounter& counter : g_counters)
+    {
+        const uint64_t allocations = counter.allocations.load(std::memory_order_relaxed) - counter.frameAllocations;
+        if (allocations == 0 || count == maxCounters)
+        {
+            continue;
+        }
+
+        counters[count++] = {counter.tag.load(std::memory_order_acquire), allocations, counter.bytes.load(std::memory_order_relaxed) - counter.frameBytes};
+    }
+    return count;
+}
+
+uint64_t AllocTracker::getTotalAllocations()
+{
+    uint64_t allocations = 0;
+    for (const TagCounter& counter : g_counters)
+    {
+        allocations += counter.allocations.load(std::memory_order_relaxed);
+    }
+    return allocations;
+}
+
+uint64_t AllocTracker::getTotalFrees()
+{
+    return g_frees.load(std::memory_order_relaxed);
+}
+
+void AllocTracker::recordAllocation(size_t size, const char* tag)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+
+    TagCounter& counter = findCounter(tag ? tag : (t_tag ? t_tag : kUntagged));
+    counter.allocations.fetch_add(1, std::memory_order_relaxed);
+    counter.bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void AllocTracker::recordFree()
+{
+    if (isEnabled())
+    {
+        g_frees.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+AllocScope::AllocScope(const char* tag)
+    : m_previous(t_tag)
+{
+    t_tag = tag;
+}
+
+AllocScope::~AllocScope()
+{
+    t_tag = m_previous;
+}
+
+// 替换全局 operator new/delete，整个程序（包括标准库）的申请都会经过这里
+void* operator new(size_t size)
+{
+    if (void* ptr = allocate(size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    if (void* ptr = allocateAligned(size, alignment))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    deallocateAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    deallocateAligned(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    deallocateAligned(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    deallocateAligned(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    deallocateAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    deallocateAligned(ptr);
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "bx/allocator.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// 内存申请统计：替换全局 operator new/delete，bgfx 的申请通过 getBgfxAllocator()（设置给 bgfxInit.allocator）统计。
+// 申请按当前线程的标签（AllocScope）分别计数，bgfx 的申请用 bgfx 源文件名作为标签（Release 版 bgfx 为 "bgfx"）。
+// 用来确认渲染循环稳定之后每帧不再申请内存：每帧开始调用 beginFrame()，结束时读取 getFrameAllocations()。
+// 只统计次数和字节数，不记录调用栈，开启后每次申请多一次原子加法
+class AllocTracker
+{
+public:
+    struct Counter
+    {
+        const char* tag;
+        uint64_t allocations;
+        uint64_t bytes;
+    };
+
+    static constexpr uint32_t kMaxTags = 32;
+
+    // 默认关闭，关闭时 operator new/delete 只多一次判断
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    static bx::AllocatorI* getBgfxAllocator();
+
+    // 记录当前计数作为这一帧的起点
+    static void beginFrame();
+
+    // beginFrame() 之后所有标签的申请次数之和
+    static uint64_t getFrameAllocations();
+
+    // beginFrame() 之后有申请的标签，返回写入 counters 的个数，不会申请内存
+    static uint32_t getFrameCounters(Counter* counters, uint32_t maxCounters);
+
+    // 开启以来的申请和释放次数
+    static uint64_t getTotalAllocations();
+    static uint64_t getTotalFrees();
+
+    // 供 operator new 和 bgfx 分配器调用，tag 为空时使用当前线程的标签
+    static void recordAllocation(size_t size, const char* tag = nullptr);
+    static void recordFree();
+};
+
+// 在作用域内把当前线程的申请记到 tag 下，可以嵌套。tag 必须是字符串字面量
+class AllocScope
+{
+public:
+    explicit AllocScope(const char* tag);
+    ~AllocScope();
+
+    AllocScope(const AllocScope&)            = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    const char* m_previous;
+};
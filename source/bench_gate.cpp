@@ -0,0 +1,714 @@
+﻿/*
+ * 性能回退检查，在 CI 上运行
+ * bench_gate [--runs N] [--warmup-runs N] [--baseline file.json] [--report file.json] [--threshold pct]
+ *            [--image file] [--bin-dir dir] [--write-baseline]
+ * 每个测试作为单独的进程运行 runs 次（之前先运行 warmup-runs 次，结果丢弃），从输出的 JSON 中取出指标：
+ *   submit     bgfx_bench Noop 单线程提交：帧时间中位数和 p95、每秒提交次数、启动耗时、峰值内存
+ *   submit_mt  bgfx_bench Noop 4个线程提交：帧时间中位数、每秒提交次数
+ *   update     bgfx_bench Noop 更新动态顶点缓冲：帧时间中位数、峰值内存
+ *   encode     image_bench -e，只在指定 --image 时运行：PNG 和 QOI 编码吞吐量、峰值内存
+ * 和基线比较时每个指标计算均值和 95% 置信区间，用 Welch t 检验判断差异是否显著，
+ * 变差且显著、变化超过 threshold（默认 3%）时记为回退，有回退时返回 1。
+ * write-baseline 时把这次的样本写入基线文件，基线应该在固定的机器上生成，换机器后需要重新生成。
+ * 比较结果以 JSON 写入 report（默认 bench_report.json）
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+struct Options
+{
+    uint32_t runs {5};
+    uint32_t warmupRuns {1};
+    double threshold {3.0}; // 百分比
+    bool writeBaseline {false};
+    std::string baselinePath {"bench_baseline.json"};
+    std::string reportPath {"bench_report.json"};
+    std::string imagePath;
+    std::string binDir;
+};
+
+struct Metric
+{
+    const char* path; // 在测试程序输出的 JSON 中的路径，数组用下标
+    bool lowerIsBetter;
+};
+
+struct Benchmark
+{
+    const char* name;
+    const char* program;
+    const char* outputOption; // 指定输出文件的参数，放在其它参数之前
+    std::string args;
+    std::vector<Metric> metrics;
+};
+
+// 一个指标的所有样本，key 为 "测试名.路径"
+struct Samples
+{
+    bool lowerIsBetter {true};
+    std::vector<double> values;
+};
+
+using SampleMap = std::map<std::string, Samples>;
+
+// 只支持测试程序和基线文件用到的 JSON：对象、数组、数字、字符串、true/false/null
+struct JsonValue
+{
+    enum class Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    Type type {Type::Null};
+    bool boolean {false};
+    double number {0.0};
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* get(const std::string& key) const
+    {
+        for (const auto& [name, value] : members)
+        {
+            if (name == key)
+            {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+
+    // "frame_ms.median"、"images.0.png_encode_mbps"
+    const JsonValue* find(const char* path) const
+    {
+        const JsonValue* value = this;
+        while (value && *path)
+        {
+            const char* end = strchr(path, '.');
+            const std::string key(path, end ? end - path : strlen(path));
+            if (value->type == Type::Array)
+            {
+                const size_t index = static_cast<size_t>(atoi(key.c_str()));
+                value              = index < value->items.size() ? &value->items[index] : nullptr;
+            }
+            else
+            {
+                value = value->get(key);
+            }
+            path = end ? end + 1 : path + key.size();
+        }
+        return value;
+    }
+};
+
+class JsonParser
+{
+public:
+    explicit JsonParser(const std::string& text)
+        : m_text(text)
+    {
+    }
+
+    bool parse(JsonValue& value)
+    {
+        if (!parseValue(value))
+        {
+            return false;
+        }
+        skipSpace();
+        return m_pos == m_text.size();
+    }
+
+private:
+    void skipSpace()
+    {
+        while (m_pos < m_text.size() && strchr(" \t\r\n", m_text[m_pos]))
+        {
+            ++m_pos;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == c)
+        {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool consumeWord(const char* word)
+    {
+        const size_t length = strlen(word);
+        if (m_text.compare(m_pos, length, word) != 0)
+        {
+            return false;
+        }
+        m_pos += length;
+        return true;
+    }
+
+    bool parseString(std::string& str)
+    {
+        if (!consume('"'))
+        {
+            return false;
+        }
+        while (m_pos < m_text.size() && m_text[m_pos] != '"')
+        {
+            // 只处理测试程序会输出的转义
+            if (m_text[m_pos] == '\\' && m_pos + 1 < m_text.size())
+            {
+                ++m_pos;
+            }
+            str.push_back(m_text[m_pos++]);
+        }
+        return consume('"');
+    }
+
+    bool parseValue(JsonValue& value)
+    {
+        skipSpace();
+        if (m_pos >= m_text.size())
+        {
+            return false;
+        }
+
+        const char c = m_text[m_pos];
+        if (c == '{')
+        {
+            value.type = JsonValue::Type::Object;
+            ++m_pos;
+            if (consume('}'))
+            {
+                return true;
+            }
+            do
+            {
+                std::pair<std::string, JsonValue> member;
+                if (!parseString(member.first) || !consume(':') || !parseValue(member.second))
+                {
+                    return false;
+                }
+                value.members.push_back(std::move(member));
+            } while (consume(','));
+            return consume('}');
+        }
+        if (c == '[')
+        {
+            value.type = JsonValue::Type::Array;
+            ++m_pos;
+            if (consume(']'))
+            {
+                return true;
+            }
+            do
+            {
+                value.items.emplace_back();
+                if (!parseValue(value.items.back()))
+                {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(']');
+        }
+        if (c == '"')
+        {
+            value.type = JsonValue::Type::String;
+            return parseString(value.string);
+        }
+        if (consumeWord("true") || consumeWord("false"))
+        {
+            value.type    = JsonValue::Type::Bool;
+            value.boolean = c == 't';
+            return true;
+        }
+        if (consumeWord("null"))
+        {
+            return true;
+        }
+
+        char* end    = nullptr;
+        value.type   = JsonValue::Type::Number;
+        value.number = strtod(m_text.c_str() + m_pos, &end);
+        if (end == m_text.c_str() + m_pos)
+        {
+            return false;
+        }
+        m_pos = static_cast<size_t>(end - m_text.c_str());
+        return true;
+    }
+
+    const std::string& m_text;
+    size_t m_pos {0};
+};
+
+bool readJson(const std::string& filePath, JsonValue& value)
+{
+    FILE* file = fopen(filePath.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    std::string text;
+    char buffer[4096];
+    size_t readSize = 0;
+    while ((readSize = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        text.append(buffer, readSize);
+    }
+    fclose(file);
+
+    return JsonParser(text).parse(value);
+}
+
+// 双侧 95% 置信度的 t 分布临界值
+double tCritical(double df)
+{
+    static constexpr double kTable[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+        2.120,  2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+
+    if (df < 1.0)
+    {
+        return kTable[0];
+    }
+    if (df <= 30.0)
+    {
+        return kTable[static_cast<int>(df) - 1];
+    }
+    return df <= 40.0 ? 2.021 : df <= 60.0 ? 2.000 : df <= 120.0 ? 1.980 : 1.960;
+}
+
+struct Summary
+{
+    double mean {0.0};
+    double variance {0.0}; // 样本方差
+    double ci {0.0};       // 95% 置信区间的半宽
+    size_t count {0};
+};
+
+Summary summarize(const std::vector<double>& values)
+{
+    Summary summary;
+    summary.count = values.size();
+    if (values.empty())
+    {
+        return summary;
+    }
+
+    for (double value : values)
+    {
+        summary.mean += value;
+    }
+    summary.mean /= values.size();
+
+    if (values.size() > 1)
+    {
+        for (double value : values)
+        {
+            summary.variance += (value - summary.mean) * (value - summary.mean);
+        }
+        summary.variance /= values.size() - 1;
+        summary.ci = tCritical(double(values.size() - 1)) * std::sqrt(summary.variance / values.size());
+    }
+    return summary;
+}
+
+// Welch t 检验，两组样本的方差不要求相同
+bool isSignificant(const Summary& a, const Summary& b)
+{
+    if (a.count < 2 || b.count < 2)
+    {
+        return false;
+    }
+
+    const double va = a.variance / a.count;
+    const double vb = b.variance / b.count;
+    if (va + vb == 0.0)
+    {
+        return a.mean != b.mean;
+    }
+
+    const double t  = std::abs(a.mean - b.mean) / std::sqrt(va + vb);
+    const double df = (va + vb) * (va + vb) / (va * va / (a.count - 1) + vb * vb / (b.count - 1));
+    return t > tCritical(df);
+}
+
+std::vector<Benchmark> getSuite(const Options& options)
+{
+    const char* bgfxArgs = "--renderer noop --frames 300 --warmup 30";
+
+    std::vector<Benchmark> suite = {
+        {
+            "submit",
+            "bgfx_bench",
+            "--out",
+            std::string(bgfxArgs) + " --workload submit",
+            {
+                {"frame_ms.median", true},
+                {"frame_ms.p95", true},
+                {"submits_per_sec", false},
+                {"startup_ms", true},
+                {"peak_rss_kb", true},
+            },
+        },
+        {
+            "submit_mt",
+            "bgfx_bench",
+            "--out",
+            std::string(bgfxArgs) + " --workload submit --threads 4",
+            {
+                {"frame_ms.median", true},
+                {"submits_per_sec", false},
+            },
+        },
+        {
+            "update",
+            "bgfx_bench",
+            "--out",
+            std::string(bgfxArgs) + " --workload update",
+            {
+                {"frame_ms.median", true},
+                {"peak_rss_kb", true},
+            },
+        },
+    };
+
+    if (!options.imagePath.empty())
+    {
+        suite.push_back({
+            "encode",
+            "image_bench",
+            "-o",
+            "-e -n 5 \"" + options.imagePath + "\"",
+            {
+                {"images.0.png_encode_mbps", false},
+                {"images.0.qoi_encode_mbps", false},
+                {"peak_rss_kb", true},
+            },
+        });
+    }
+
+    return suite;
+}
+
+bool runBenchmark(const Options& options, const Benchmark& benchmark, SampleMap& samples)
+{
+    const std::string outputPath = (std::filesystem::temp_directory_path() / (std::string("bench_gate_") + benchmark.name + ".json")).string();
+    const std::string program    = (std::filesystem::path(options.binDir) / benchmark.program).string();
+
+    std::string command = "\"" + program + "\" " + benchmark.outputOption + " \"" + outputPath + "\" " + benchmark.args;
+#ifdef _WIN32
+    // cmd /c 会去掉第一个和最后一个引号
+    command = "\"" + command + "\"";
+#endif
+
+    for (uint32_t run = 0; run < options.warmupRuns + options.runs; ++run)
+    {
+        std::filesystem::remove(outputPath);
+        if (std::system(command.c_str()) != 0)
+        {
+            fprintf(stderr, "bench_gate: %s failed: %s\n", benchmark.name, command.c_str());
+            return false;
+        }
+
+        JsonValue result;
+        if (!readJson(outputPath, result))
+        {
+            fprintf(stderr, "bench_gate: %s: failed to read %s\n", benchmark.name, outputPath.c_str());
+            return false;
+        }
+
+        if (run < options.warmupRuns)
+        {
+            continue;
+        }
+
+        for (const Metric& metric : benchmark.metrics)
+        {
+            const JsonValue* value = result.find(metric.path);
+            if (!value || value->type != JsonValue::Type::Number)
+            {
+                fprintf(stderr, "bench_gate: %s: missing %s\n", benchmark.name, metric.path);
+                return false;
+            }
+
+            Samples& metricSamples      = samples[std::string(benchmark.name) + "." + metric.path];
+            metricSamples.lowerIsBetter = metric.lowerIsBetter;
+            metricSamples.values.push_back(value->number);
+        }
+    }
+
+    std::filesystem::remove(outputPath);
+    return true;
+}
+
+bool readBaseline(const std::string& filePath, SampleMap& samples)
+{
+    JsonValue baseline;
+    if (!readJson(filePath, baseline))
+    {
+        return false;
+    }
+
+    const JsonValue* metrics = baseline.get("metrics");
+    if (!metrics || metrics->type != JsonValue::Type::Object)
+    {
+        return false;
+    }
+
+    for (const auto& [name, value] : metrics->members)
+    {
+        const JsonValue* lowerIsBetter = value.get("lower_is_better");
+        const JsonValue* values        = value.get("samples");
+        if (!lowerIsBetter || !values || values->type != JsonValue::Type::Array)
+        {
+            return false;
+        }
+
+        Samples& metricSamples      = samples[name];
+        metricSamples.lowerIsBetter = lowerIsBetter->boolean;
+        for (const JsonValue& item : values->items)
+        {
+            metricSamples.values.push_back(item.number);
+        }
+    }
+    return true;
+}
+
+bool writeBaseline(const std::string& filePath, const Options& options, const SampleMap& samples)
+{
+    FILE* file = fopen(filePath.c_str(), "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"runs\": %u,\n  \"metrics\": {", options.runs);
+    bool first = true;
+    for (const auto& [name, metricSamples] : samples)
+    {
+        fprintf(file, "%s\n    \"%s\": {\"lower_is_better\": %s, \"samples\": [", first ? "" : ",", name.c_str(), metricSamples.lowerIsBetter ? "true" : "false");
+        for (size_t i = 0; i < metricSamples.values.size(); ++i)
+        {
+            fprintf(file, "%s%.6g", i == 0 ? "" : ", ", metricSamples.values[i]);
+        }
+        fprintf(file, "]}");
+        first = false;
+    }
+    fprintf(file, "\n  }\n}\n");
+
+    return fclose(file) == 0;
+}
+
+// 返回回退的指标个数，失败时返回 -1
+int compare(const Options& options, const SampleMap& baseline, const SampleMap& current)
+{
+    FILE* file = fopen(options.reportPath.c_str(), "w");
+    if (!file)
+    {
+        fprintf(stderr, "bench_gate: failed to write %s\n", options.reportPath.c_str());
+        return -1;
+    }
+
+    printf("%-40s %14s %14s %9s  %s\n", "metric", "baseline", "current", "change", "status");
+    fprintf(file, "{\n  \"threshold_pct\": %.2f,\n  \"runs\": %u,\n  \"metrics\": [", options.threshold, options.runs);
+
+    int regressions = 0;
+    bool first      = true;
+    for (const auto& [name, samples] : current)
+    {
+        const Summary now = summarize(samples.values);
+        const auto it     = baseline.find(name);
+
+        const char* status = "new";
+        Summary base;
+        double change    = 0.0;
+        bool significant = false;
+        if (it != baseline.end() && !it->second.values.empty())
+        {
+            base        = summarize(it->second.values);
+            change      = base.mean != 0.0 ? (now.mean - base.mean) / std::abs(base.mean) * 100.0 : 0.0;
+            significant = isSignificant(base, now);
+
+            const bool worse = samples.lowerIsBetter ? change > 0.0 : change < 0.0;
+            status           = "ok";
+            if (significant && std::abs(change) >= options.threshold)
+            {
+                status = worse ? "regression" : "improvement";
+                regressions += worse ? 1 : 0;
+            }
+        }
+
+        printf("%-40s %14.6g %14.6g %+8.2f%%  %s\n", name.c_str(), base.mean, now.mean, change, status);
+        fprintf(
+            file,
+            "%s\n    {\"name\": \"%s\", \"lower_is_better\": %s, \"baseline_mean\": %.6g, \"baseline_ci95\": %.6g, "
+            "\"current_mean\": %.6g, \"current_ci95\": %.6g, \"change_pct\": %.3f, \"significant\": %s, \"status\": \"%s\"}",
+            first ? "" : ",",
+            name.c_str(),
+            samples.lowerIsBetter ? "true" : "false",
+            base.mean,
+            base.ci,
+            now.mean,
+            now.ci,
+            change,
+            significant ? "true" : "false",
+            status
+        );
+        first = false;
+    }
+    fprintf(file, "\n  ],\n  \"regressions\": %d\n}\n", regressions);
+
+    if (fclose(file) != 0)
+    {
+        fprintf(stderr, "bench_gate: failed to write %s\n", options.reportPath.c_str());
+        return -1;
+    }
+    return regressions;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* name = argv[i];
+        if (strcmp(name, "--write-baseline") == 0)
+        {
+            options.writeBaseline = true;
+            continue;
+        }
+
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+        {
+            return false;
+        }
+        ++i;
+
+        if (strcmp(name, "--runs") == 0)
+        {
+            options.runs = static_cast<uint32_t>(std::max(2, atoi(value)));
+        }
+        else if (strcmp(name, "--warmup-runs") == 0)
+        {
+            options.warmupRuns = static_cast<uint32_t>(std::max(0, atoi(value)));
+        }
+        else if (strcmp(name, "--baseline") == 0)
+        {
+            options.baselinePath = value;
+        }
+        else if (strcmp(name, "--report") == 0)
+        {
+            options.reportPath = value;
+        }
+        else if (strcmp(name, "--threshold") == 0)
+        {
+            options.threshold = std::max(0.0, atof(value));
+        }
+        else if (strcmp(name, "--image") == 0)
+        {
+            options.imagePath = std::filesystem::absolute(value).string();
+        }
+        else if (strcmp(name, "--bin-dir") == 0)
+        {
+            options.binDir = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printf(
+            "usage: bench_gate [--runs N] [--warmup-runs N] [--baseline file.json] [--report file.json] [--threshold pct]\n"
+            "                  [--image file] [--bin-dir dir] [--write-baseline]\n"
+        );
+        return EXIT_FAILURE;
+    }
+
+    // bgfx_bench 从当前目录下的 shaders 目录加载着色器，所以在测试程序所在的目录中运行
+    options.baselinePath = std::filesystem::absolute(options.baselinePath).string();
+    options.reportPath   = std::filesystem::absolute(options.reportPath).string();
+    if (options.binDir.empty())
+    {
+        options.binDir = std::filesystem::absolute(argv[0]).parent_path().string();
+    }
+    std::error_code error;
+    std::filesystem::current_path(options.binDir, error);
+    if (error)
+    {
+        fprintf(stderr, "bench_gate: invalid bin dir %s\n", options.binDir.c_str());
+        return EXIT_FAILURE;
+    }
+
+    SampleMap baseline;
+    if (!options.writeBaseline && !readBaseline(options.baselinePath, baseline))
+    {
+        fprintf(stderr, "bench_gate: failed to read baseline %s, run with --write-baseline first\n", options.baselinePath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    SampleMap current;
+    for (const Benchmark& benchmark : getSuite(options))
+    {
+        printf("running %s (%u + %u runs)\n", benchmark.name, options.warmupRuns, options.runs);
+        fflush(stdout);
+        if (!runBenchmark(options, benchmark, current))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.writeBaseline)
+    {
+        if (!writeBaseline(options.baselinePath, options, current))
+        {
+            fprintf(stderr, "bench_gate: failed to write %s\n", options.baselinePath.c_str());
+            return EXIT_FAILURE;
+        }
+        printf("baseline written to %s\n", options.baselinePath.c_str());
+        return EXIT_SUCCESS;
+    }
+
+    const int regressions = compare(options, baseline, current);
+    if (regressions != 0)
+    {
+        if (regressions > 0)
+        {
+            printf("%d regression(s), report written to %s\n", regressions, options.reportPath.c_str());
+        }
+        return EXIT_FAILURE;
+    }
+
+    printf("no regressions, report written to %s\n", options.reportPath.c_str());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+﻿#include "bgfx_allocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+// 每个块前面的头，大小为 16 字节以保持返回地址对齐
+struct alignas(16) BlockHeader
+{
+    size_t capacity;
+    uint16_t sizeClass;  // kLargeClass 表示直接向系统堆申请的大块
+    uint16_t alignShift; // 大块：对齐的 log2
+    uint32_t offset;     // 大块：头相对 malloc 返回地址的偏移
+};
+
+constexpr uint16_t kLargeClass   = 0xffff;
+constexpr size_t kPoolAlignment  = sizeof(BlockHeader);
+constexpr size_t kPageHeaderSize = 16;
+
+BlockHeader* getHeader(void* ptr)
+{
+    return static_cast<BlockHeader*>(ptr) - 1;
+}
+
+const BlockHeader* getHeader(const void* ptr)
+{
+    return static_cast<const BlockHeader*>(ptr) - 1;
+}
+
+// 大块向系统堆申请的字节数，多出的部分用来对齐
+size_t getLargeSize(size_t size, uint16_t alignShift)
+{
+    return sizeof(BlockHeader) + size + (size_t(1) << alignShift) - kPoolAlignment;
+}
+
+uint32_t getSizeClass(size_t size, uint32_t minClass)
+{
+    uint32_t sizeClass = minClass;
+    while ((size_t(1) << sizeClass) < size)
+    {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+} // namespace
+
+PoolAllocator::~PoolAllocator()
+{
+    for (SizeClass& sizeClass : m_classes)
+    {
+        while (Page* page = sizeClass.pages)
+        {
+            sizeClass.pages = page->next;
+            free(page);
+        }
+    }
+}
+
+void* PoolAllocator::realloc(void* ptr, size_t size, size_t align, const char* filePath, uint32_t line)
+{
+    (void)filePath;
+    (void)line;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    void* result = nullptr;
+    if (size == 0)
+    {
+        deallocate(ptr);
+    }
+    else if (!ptr)
+    {
+        result = allocate(size, align);
+    }
+    else if (size <= getCapacity(ptr) && (align <= kPoolAlignment || (uintptr_t(ptr) & (align - 1)) == 0))
+    {
+        // 块的容量够用时原地返回
+        result = ptr;
+    }
+    else
+    {
+        result = allocate(size, align);
+        if (result)
+        {
+            memcpy(result, ptr, std::min(size, getCapacity(ptr)));
+            deallocate(ptr);
+        }
+    }
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    m_totalNs.fetch_add(uint64_t(elapsed), std::memory_order_relaxed);
+    return result;
+}
+
+PoolAllocator::Stats PoolAllocator::getStats() const
+{
+    Stats stats;
+    stats.allocations      = m_allocations.load(std::memory_order_relaxed);
+    stats.frees            = m_frees.load(std::memory_order_relaxed);
+    stats.poolAllocations  = m_poolAllocations.load(std::memory_order_relaxed);
+    stats.largeAllocations = m_largeAllocations.load(std::memory_order_relaxed);
+    stats.usedBytes        = m_usedBytes.load(std::memory_order_relaxed);
+    stats.peakUsedBytes    = m_peakUsedBytes.load(std::memory_order_relaxed);
+    stats.reservedBytes    = m_reservedBytes.load(std::memory_order_relaxed);
+    stats.totalNs          = m_totalNs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void* PoolAllocator::allocate(size_t size, size_t align)
+{
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    const uint32_t sizeClass = getSizeClass(size, kMinClass);
+    if (sizeClass <= kMaxClass && align <= kPoolAlignment)
+    {
+        const size_t capacity = size_t(1) << sizeClass;
+        SizeClass& pool       = m_classes[sizeClass - kMinClass];
+
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (!pool.freeBlocks)
+        {
+            // 新申请一页，全部切成这一级的块放入空闲链表
+            auto page = static_cast<Page*>(malloc(kPageSize));
+            if (!page)
+            {
+                return nullptr;
+            }
+            page->next = pool.pages;
+            pool.pages = page;
+            m_reservedBytes.fetch_add(kPageSize, std::memory_order_relaxed);
+
+            const size_t stride = sizeof(BlockHeader) + capacity;
+            uint8_t* block      = reinterpret_cast<uint8_t*>(page) + kPageHeaderSize;
+            for (size_t i = 0; i < (kPageSize - kPageHeaderSize) / stride; ++i, block += stride)
+            {
+                auto header        = reinterpret_cast<BlockHeader*>(block);
+                header->capacity   = capacity;
+                header->sizeClass  = static_cast<uint16_t>(sizeClass);
+                header->alignShift = 0;
+                header->offset     = 0;
+
+                auto freeBlock  = reinterpret_cast<FreeBlock*>(header + 1);
+                freeBlock->next = pool.freeBlocks;
+                pool.freeBlocks = freeBlock;
+            }
+        }
+
+        FreeBlock* freeBlock = pool.freeBlocks;
+        pool.freeBlocks      = freeBlock->next;
+
+        m_poolAllocations.fetch_add(1, std::memory_order_relaxed);
+        addUsed(capacity);
+        return freeBlock;
+    }
+
+    // 大块：多申请 align 字节，把头之后的地址对齐
+    uint16_t alignShift = 4;
+    while ((size_t(1) << alignShift) < align)
+    {
+        ++alignShift;
+    }
+    const size_t alignment = size_t(1) << alignShift;
+    const size_t total     = getLargeSize(size, alignShift);
+    auto base              = static_cast<uint8_t*>(malloc(total));
+    if (!base)
+    {
+        return nullptr;
+    }
+
+    const uintptr_t data = (uintptr_t(base) + sizeof(BlockHeader) + alignment - 1) & ~uintptr_t(alignment - 1);
+    auto header          = reinterpret_cast<BlockHeader*>(data) - 1;
+    header->capacity     = size;
+    header->sizeClass    = kLargeClass;
+    header->alignShift   = alignShift;
+    header->offset       = static_cast<uint32_t>(reinterpret_cast<uint8_t*>(header) - base);
+
+    m_largeAllocations.fetch_add(1, std::memory_order_relaxed);
+    m_reservedBytes.fetch_add(total, std::memory_order_relaxed);
+    addUsed(size);
+    return header + 1;
+}
+
+void PoolAllocator::deallocate(void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    m_frees.fetch_add(1, std::memory_order_relaxed);
+
+    BlockHeader* header = getHeader(ptr);
+    m_usedBytes.fetch_sub(header->capacity, std::memory_order_relaxed);
+
+    if (header->sizeClass == kLargeClass)
+    {
+        m_reservedBytes.fetch_sub(getLargeSize(header->capacity, header->alignShift), std::memory_order_relaxed);
+        free(reinterpret_cast<uint8_t*>(header) - header->offset);
+        return;
+    }
+
+    SizeClass& pool = m_classes[header->sizeClass - kMinClass];
+    auto freeBlock  = static_cast<FreeBlock*>(ptr);
+
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    freeBlock->next = pool.freeBlocks;
+    pool.freeBlocks = freeBlock;
+}
+
+size_t PoolAllocator::getCapacity(const void* ptr) const
+{
+    return getHeader(ptr)->capacity;
+}
+
+void PoolAllocator::addUsed(size_t bytes)
+{
+    const size_t used = m_usedBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak       = m_peakUsedBytes.load(std::memory_order_relaxed);
+    while (used > peak && !m_peakUsedBytes.compare_exchange_weak(peak, used, std::memory_order_relaxed))
+    {
+    }
+}
+
+FrameArena::FrameArena(uint32_t capacity, uint32_t frames)
+    : m_capacity(capacity)
+    , m_frameCount(std::max(frames, 3u))
+    , m_buffers(new Buffer[m_frameCount])
+{
+    for (uint32_t i = 0; i < m_frameCount; ++i)
+    {
+        m_buffers[i].data.reset(new uint8_t[capacity]);
+    }
+}
+
+const bgfx::Memory* FrameArena::alloc(uint32_t size)
+{
+    ++m_stats.allocations;
+
+    Buffer& buffer       = m_buffers[m_current];
+    const uint32_t begin = (buffer.used + 15) & ~15u;
+    if (begin > m_capacity || size > m_capacity - begin)
+    {
+        ++m_stats.fallbacks;
+        return bgfx::alloc(size);
+    }
+
+    buffer.used       = begin + size;
+    m_stats.peakBytes = std::max(m_stats.peakBytes, buffer.used);
+
+    buffer.references.fetch_add(1, std::memory_order_relaxed);
+    return bgfx::makeRef(buffer.data.get() + begin, size, release, &buffer);
+}
+
+const bgfx::Memory* FrameArena::copy(const void* data, uint32_t size)
+{
+    const bgfx::Memory* mem = alloc(size);
+    memcpy(mem->data, data, size);
+    return mem;
+}
+
+void FrameArena::frame()
+{
+    m_current      = (m_current + 1) % m_frameCount;
+    Buffer& buffer = m_buffers[m_current];
+
+    // bgfx 还没有用完时这一帧不使用这块缓冲
+    buffer.used = buffer.references.load(std::memory_order_acquire) == 0 ? 0 : m_capacity;
+}
+
+void FrameArena::release(void* ptr, void* userData)
+{
+    (void)ptr;
+    static_cast<Buffer*>(userData)->references.fetch_sub(1, std::memory_order_release);
+}
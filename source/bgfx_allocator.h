@@ -0,0 +1,129 @@
+﻿#pragma once
+
+#include "bgfx/bgfx.h"
+#include "bx/allocator.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// 给 bgfxInit.allocator 使用的分配器。bgfx 的命令缓冲、bgfx::alloc 返回的 bgfx::Memory、各种内部结构都通过它申请。
+// 不超过 4KB 且对齐要求不超过 16 的块按2的幂分级，从 64KB 的页中切出，释放后放回这一级的空闲链表，页不还给系统堆；
+// 更大或者对齐要求更高的块直接向系统堆申请。bgfx 在 API 线程和渲染线程中都会申请和释放，每一级一个锁。
+// 统计中的 usedBytes / reservedBytes 反映碎片程度，totalNs 为 realloc 的累计耗时，用于长时间运行时观察分配器开销。
+// 必须比 bgfx 活得更久，在 bgfx::shutdown() 之后销毁
+class PoolAllocator : public bx::AllocatorI
+{
+public:
+    struct Stats
+    {
+        uint64_t allocations {0};      // 申请次数，realloc 换块也算一次
+        uint64_t frees {0};            // 释放次数
+        uint64_t poolAllocations {0};  // 其中从分级池中分配的次数
+        uint64_t largeAllocations {0}; // 其中直接向系统堆申请的次数
+        size_t usedBytes {0};          // 正在使用的块的容量之和
+        size_t peakUsedBytes {0};
+        size_t reservedBytes {0}; // 池的页和大块占用的系统堆内存
+        uint64_t totalNs {0};     // realloc 的累计耗时（纳秒）
+    };
+
+    PoolAllocator() = default;
+    ~PoolAllocator() override;
+
+    PoolAllocator(const PoolAllocator&)            = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    void* realloc(void* ptr, size_t size, size_t align, const char* filePath, uint32_t line) override;
+
+    Stats getStats() const;
+
+private:
+    static constexpr uint32_t kMinClass   = 4;  // 最小 16 字节
+    static constexpr uint32_t kMaxClass   = 12; // 最大 4KB
+    static constexpr uint32_t kClassCount = kMaxClass - kMinClass + 1;
+    static constexpr size_t kPageSize     = 64 * 1024;
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct Page
+    {
+        Page* next;
+    };
+
+    struct SizeClass
+    {
+        std::mutex mutex;
+        FreeBlock* freeBlocks {nullptr};
+        Page* pages {nullptr};
+    };
+
+    void* allocate(size_t size, size_t align);
+    void deallocate(void* ptr);
+    size_t getCapacity(const void* ptr) const;
+
+    void addUsed(size_t bytes);
+
+    SizeClass m_classes[kClassCount];
+
+    std::atomic<uint64_t> m_allocations {0};
+    std::atomic<uint64_t> m_frees {0};
+    std::atomic<uint64_t> m_poolAllocations {0};
+    std::atomic<uint64_t> m_largeAllocations {0};
+    std::atomic<size_t> m_usedBytes {0};
+    std::atomic<size_t> m_peakUsedBytes {0};
+    std::atomic<size_t> m_reservedBytes {0};
+    std::atomic<uint64_t> m_totalNs {0};
+};
+
+// 每帧的线性内存，代替 bgfx::alloc / bgfx::copy 上传每帧变化的数据（动态顶点、纹理更新）。
+// 数据从当前帧的缓冲中顺序切出，通过 bgfx::makeRef 交给 bgfx，不逐个释放，切换帧时整块复用。
+// bgfx::makeRef 的数据至少要保留两次 bgfx::frame()，所以默认轮流使用3块缓冲；
+// bgfx 用完后通过释放回调计数，轮到的缓冲还有数据没有被 bgfx 用完时这一帧退回 bgfx::alloc。
+// 只能在调用 bgfx API 的线程中使用，必须在 bgfx::shutdown() 之后销毁
+class FrameArena
+{
+public:
+    struct Stats
+    {
+        uint64_t allocations {0}; // alloc/copy 的总次数
+        uint64_t fallbacks {0};   // 其中缓冲放不下或者还在被 bgfx 使用、退回 bgfx::alloc 的次数
+        uint32_t peakBytes {0};   // 一帧中使用的最大字节数
+    };
+
+    explicit FrameArena(uint32_t capacity, uint32_t frames = 3);
+
+    FrameArena(const FrameArena&)            = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    const bgfx::Memory* alloc(uint32_t size);
+    const bgfx::Memory* copy(const void* data, uint32_t size);
+
+    // 在 bgfx::frame() 之后调用，切换到下一块缓冲
+    void frame();
+
+    const Stats& getStats() const
+    {
+        return m_stats;
+    }
+
+private:
+    struct Buffer
+    {
+        std::unique_ptr<uint8_t[]> data;
+        uint32_t used {0};
+        std::atomic<uint32_t> references {0}; // bgfx 还没有释放的 makeRef 个数
+    };
+
+    static void release(void* ptr, void* userData);
+
+    uint32_t m_capacity;
+    uint32_t m_frameCount;
+    uint32_t m_current {0};
+    std::unique_ptr<Buffer[]> m_buffers;
+    Stats m_stats;
+};
@@ -0,0 +1,651 @@
+﻿/*
+ * 无窗口的 bgfx 性能测试，不需要 GPU，可以在 CI 上跟踪性能回退
+ * bgfx_bench [--renderer noop|vulkan] [--workload submit|update|capture] [--objects N] [--width W] [--height H]
+ *            [--frames N] [--warmup N] [--threads N] [--allocator default|pool] [--out file.json]
+ * submit  每帧提交 objects 个立方体，threads 大于 1 时用多个 bgfx::Encoder 在线程池中并行提交
+ * update  每帧更新一个动态顶点缓冲（所有立方体的顶点颜色）后再提交，和 main.cpp 的 TEST3 相同
+ * capture 渲染到 width x height 的渲染目标，拷贝到回读纹理并等待 readTexture 完成，和 main.cpp 的 TEST4 相同
+ * allocator pool 时 bgfx 使用 PoolAllocator，update 的顶点数据从 FrameArena 上传，结果中增加分配器的统计，
+ *         frames 设得很大时可以观察长时间运行后的碎片和分配器耗时
+ * vulkan 可以使用 CPU 实现（lavapipe / SwiftShader），通过 VK_ICD_FILENAMES 选择
+ * 结果（帧时间的中位数、p95、p99，每秒提交次数，启动耗时，峰值内存）以 JSON 输出
+ */
+
+#include "bgfx_allocator.h"
+#include "process_memory.h"
+#include "thread_pool.h"
+
+#include "bgfx/bgfx.h"
+#include "bgfx/platform.h"
+#include "bx/math.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+enum class Workload
+{
+    Submit,
+    Update,
+    Capture,
+};
+
+struct Options
+{
+    bgfx::RendererType::Enum renderer {bgfx::RendererType::Noop};
+    Workload workload {Workload::Submit};
+    uint32_t objects {1000};
+    uint16_t width {1280};
+    uint16_t height {720};
+    uint32_t frames {300};
+    uint32_t warmup {30};
+    uint32_t threads {1};
+    bool poolAllocator {false};
+    std::string output;
+};
+
+struct PosColorVertex
+{
+    float x;
+    float y;
+    float z;
+    uint32_t abgr;
+};
+
+// clang-format off
+const PosColorVertex kCubeVertices[] = {
+        {-1.0f,  1.0f,  1.0f,  0xff000000},
+        { 1.0f,  1.0f,  1.0f,  0xff0000ff},
+        {-1.0f, -1.0f,  1.0f,  0xff00ff00},
+        { 1.0f, -1.0f,  1.0f,  0xff00ffff},
+        {-1.0f,  1.0f, -1.0f,  0xffff0000},
+        { 1.0f,  1.0f, -1.0f,  0xffff00ff},
+        {-1.0f, -1.0f, -1.0f,  0xffffff00},
+        { 1.0f, -1.0f, -1.0f,  0xffffffff},
+    };
+
+const uint16_t kCubeTriList[] = {
+        0, 1, 2, 1, 3, 2,
+        4, 6, 5, 5, 6, 7,
+        0, 2, 4, 4, 2, 6,
+        1, 5, 3, 5, 7, 3,
+        0, 4, 1, 4, 5, 1,
+        2, 3, 6, 6, 3, 7,
+    };
+// clang-format on
+
+const char* getWorkloadName(Workload workload)
+{
+    switch (workload)
+    {
+        case Workload::Submit:
+            return "submit";
+        case Workload::Update:
+            return "update";
+        case Workload::Capture:
+            return "capture";
+    }
+    return "?";
+}
+
+// Noop 后端不使用着色器代码，但 bgfx 仍然需要解析着色器文件头，使用 SPIR-V 版本
+bgfx::ShaderHandle loadShader(const char* fileName)
+{
+    std::string shaderPath = bgfx::getRendererType() == bgfx::RendererType::Direct3D11 || bgfx::getRendererType() == bgfx::RendererType::Direct3D12
+        ? "shaders/dx11/"
+        : "shaders/spirv/";
+    shaderPath += fileName;
+
+    FILE* file = fopen(shaderPath.c_str(), "rb");
+    if (!file)
+    {
+        fprintf(stderr, "failed to open %s\n", shaderPath.c_str());
+        return BGFX_INVALID_HANDLE;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    const bgfx::Memory* mem = bgfx::alloc(static_cast<uint32_t>(fileSize + 1));
+    fread(mem->data, 1, fileSize, file);
+    mem->data[mem->size - 1] = '\0';
+    fclose(file);
+
+    return bgfx::createShader(mem);
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* name  = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+        {
+            return false;
+        }
+        ++i;
+
+        if (strcmp(name, "--renderer") == 0)
+        {
+            if (strcmp(value, "noop") == 0)
+            {
+                options.renderer = bgfx::RendererType::Noop;
+            }
+            else if (strcmp(value, "vulkan") == 0)
+            {
+                options.renderer = bgfx::RendererType::Vulkan;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (strcmp(name, "--workload") == 0)
+        {
+            if (strcmp(value, "submit") == 0)
+            {
+                options.workload = Workload::Submit;
+            }
+            else if (strcmp(value, "update") == 0)
+            {
+                options.workload = Workload::Update;
+            }
+            else if (strcmp(value, "capture") == 0)
+            {
+                options.workload = Workload::Capture;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (strcmp(name, "--objects") == 0)
+        {
+            options.objects = static_cast<uint32_t>(std::max(1, atoi(value)));
+        }
+        else if (strcmp(name, "--width") == 0)
+        {
+            options.width = static_cast<uint16_t>(std::clamp(atoi(value), 1, 16384));
+        }
+        else if (strcmp(name, "--height") == 0)
+        {
+            options.height = static_cast<uint16_t>(std::clamp(atoi(value), 1, 16384));
+        }
+        else if (strcmp(name, "--frames") == 0)
+        {
+            options.frames = static_cast<uint32_t>(std::max(1, atoi(value)));
+        }
+        else if (strcmp(name, "--warmup") == 0)
+        {
+            options.warmup = static_cast<uint32_t>(std::max(0, atoi(value)));
+        }
+        else if (strcmp(name, "--threads") == 0)
+        {
+            options.threads = static_cast<uint32_t>(std::clamp(atoi(value), 1, 8));
+        }
+        else if (strcmp(name, "--allocator") == 0)
+        {
+            if (strcmp(value, "default") == 0)
+            {
+                options.poolAllocator = false;
+            }
+            else if (strcmp(value, "pool") == 0)
+            {
+                options.poolAllocator = true;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (strcmp(name, "--out") == 0)
+        {
+            options.output = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 排好序的样本的百分位数（最近秩）
+double percentile(const std::vector<double>& sorted, double p)
+{
+    const size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+class Bench
+{
+public:
+    explicit Bench(const Options& options)
+        : m_options(options)
+    {
+    }
+
+    // 失败时也要调用 shutdown()，释放已经创建的资源
+    bool init();
+    // 只有 bgfx::init() 成功时才销毁资源并调用 bgfx::shutdown()
+    void shutdown();
+
+    // 执行一帧，返回这一帧提交的绘制次数
+    uint32_t runFrame(uint32_t frame);
+
+    // 没有使用 PoolAllocator 时为空
+    const PoolAllocator* getAllocator() const
+    {
+        return m_allocator.get();
+    }
+
+    const FrameArena* getFrameArena() const
+    {
+        return m_frameArena.get();
+    }
+
+private:
+    void submitObjects(bgfx::Encoder* encoder, bgfx::ViewId view, uint32_t begin, uint32_t end, uint32_t frame);
+
+    const Options& m_options;
+    std::unique_ptr<ThreadPool> m_threadPool;
+
+    // bgfx::shutdown() 之后才能销毁
+    std::unique_ptr<PoolAllocator> m_allocator;
+    std::unique_ptr<FrameArena> m_frameArena;
+
+    bgfx::VertexLayout m_layout;
+    bgfx::VertexBufferHandle m_vbh BGFX_INVALID_HANDLE;
+    bgfx::DynamicVertexBufferHandle m_dynamicVbh BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle m_ibh BGFX_INVALID_HANDLE;
+    bgfx::ProgramHandle m_program BGFX_INVALID_HANDLE;
+    std::vector<PosColorVertex> m_dynamicVertices;
+
+    bgfx::TextureHandle m_colorTexture BGFX_INVALID_HANDLE;
+    bgfx::FrameBufferHandle m_frameBuffer BGFX_INVALID_HANDLE;
+    bgfx::TextureHandle m_readbackTexture BGFX_INVALID_HANDLE;
+    std::vector<uint8_t> m_readbackData;
+
+    uint32_t m_gridSize {1};
+    bool m_initialized {false}; // bgfx::init() 是否成功
+};
+
+bool Bench::init()
+{
+    bgfx::renderFrame();
+
+    bgfx::Init bgfxInit;
+    bgfxInit.platformData.nwh   = nullptr;
+    bgfxInit.type               = m_options.renderer;
+    bgfxInit.resolution.width   = m_options.width;
+    bgfxInit.resolution.height  = m_options.height;
+    bgfxInit.resolution.reset   = BGFX_RESET_NONE;
+    bgfxInit.limits.maxEncoders = static_cast<uint16_t>(m_options.threads + 1);
+    if (m_options.poolAllocator)
+    {
+        m_allocator        = std::make_unique<PoolAllocator>();
+        bgfxInit.allocator = m_allocator.get();
+    }
+    if (!bgfx::init(bgfxInit))
+    {
+        return false;
+    }
+    m_initialized = true;
+
+    if (m_options.threads > 1)
+    {
+        // 调用线程也参与提交
+        m_threadPool = std::make_unique<ThreadPool>(m_options.threads - 1);
+    }
+
+    m_layout.begin().add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float).add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Uint8, true).end();
+    m_vbh = bgfx::createVertexBuffer(bgfx::makeRef(kCubeVertices, sizeof(kCubeVertices)), m_layout);
+    m_ibh = bgfx::createIndexBuffer(bgfx::makeRef(kCubeTriList, sizeof(kCubeTriList)));
+
+    const bgfx::ShaderHandle vsh = loadShader("vs_cubes.bin");
+    const bgfx::ShaderHandle fsh = loadShader("fs_cubes.bin");
+    if (!bgfx::isValid(vsh) || !bgfx::isValid(fsh))
+    {
+        for (bgfx::ShaderHandle handle : {vsh, fsh})
+        {
+            if (bgfx::isValid(handle))
+            {
+                bgfx::destroy(handle);
+            }
+        }
+        return false;
+    }
+    m_program = bgfx::createProgram(vsh, fsh, true);
+
+    if (m_options.workload == Workload::Update)
+    {
+        m_dynamicVertices.resize(size_t(m_options.objects) * 8);
+        m_dynamicVbh = bgfx::createDynamicVertexBuffer(static_cast<uint32_t>(m_dynamicVertices.size()), m_layout);
+        if (m_options.poolAllocator)
+        {
+            m_frameArena = std::make_unique<FrameArena>(static_cast<uint32_t>(m_dynamicVertices.size() * sizeof(PosColorVertex)));
+        }
+    }
+
+    if (m_options.workload == Workload::Capture)
+    {
+        m_colorTexture = bgfx::createTexture2D(
+            m_options.width,
+            m_options.height,
+            false,
+            1,
+            bgfx::TextureFormat::RGBA8,
+            0 | BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP
+        );
+        m_frameBuffer     = bgfx::createFrameBuffer(1, &m_colorTexture, false);
+        m_readbackTexture = bgfx::createTexture2D(
+            m_options.width,
+            m_options.height,
+            false,
+            1,
+            bgfx::TextureFormat::RGBA8,
+            0 | BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK | BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT | BGFX_SAMPLER_MIP_POINT
+                | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP
+        );
+        m_readbackData.resize(size_t(m_options.width) * m_options.height * 4);
+        bgfx::setViewFrameBuffer(0, m_frameBuffer);
+    }
+
+    bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0xFF0000FF, 1.0f, 0);
+    bgfx::setViewRect(0, 0, 0, m_options.width, m_options.height);
+
+    // 立方体排成正方形网格，相机距离随网格大小变化，全部都在视野内
+    m_gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(double(m_options.objects))));
+
+    const float distance = 3.0f * m_gridSize + 5.0f;
+    const bx::Vec3 at    = {0.0f, 0.0f, 0.0f};
+    const bx::Vec3 eye   = {0.0f, 0.0f, -distance};
+    float view[16];
+    bx::mtxLookAt(view, eye, at);
+    float proj[16];
+    bx::mtxProj(proj, 60.0f, float(m_options.width) / float(m_options.height), 0.1f, distance * 2.0f, bgfx::getCaps()->homogeneousDepth);
+    bgfx::setViewTransform(0, view, proj);
+
+    return true;
+}
+
+void Bench::shutdown()
+{
+    m_threadPool.reset();
+    if (!m_initialized)
+    {
+        return;
+    }
+
+    for (bgfx::TextureHandle handle : {m_readbackTexture, m_colorTexture})
+    {
+        if (bgfx::isValid(handle))
+        {
+            bgfx::destroy(handle);
+        }
+    }
+    if (bgfx::isValid(m_frameBuffer))
+    {
+        bgfx::destroy(m_frameBuffer);
+    }
+    if (bgfx::isValid(m_dynamicVbh))
+    {
+        bgfx::destroy(m_dynamicVbh);
+    }
+    if (bgfx::isValid(m_program))
+    {
+        bgfx::destroy(m_program);
+    }
+    if (bgfx::isValid(m_ibh))
+    {
+        bgfx::destroy(m_ibh);
+    }
+    if (bgfx::isValid(m_vbh))
+    {
+        bgfx::destroy(m_vbh);
+    }
+
+    bgfx::shutdown();
+    m_initialized = false;
+}
+
+void Bench::submitObjects(bgfx::Encoder* encoder, bgfx::ViewId view, uint32_t begin, uint32_t end, uint32_t frame)
+{
+    const float half = (m_gridSize - 1) * 1.5f;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        float mtx[16];
+        bx::mtxRotateXY(mtx, frame * 0.01f + i * 0.21f, frame * 0.01f + i * 0.37f);
+        mtx[12] = (i % m_gridSize) * 3.0f - half;
+        mtx[13] = (i / m_gridSize) * 3.0f - half;
+        mtx[14] = 0.0f;
+
+        encoder->setTransform(mtx);
+        if (bgfx::isValid(m_dynamicVbh))
+        {
+            encoder->setVertexBuffer(0, m_dynamicVbh, i * 8, 8);
+        }
+        else
+        {
+            encoder->setVertexBuffer(0, m_vbh);
+        }
+        encoder->setIndexBuffer(m_ibh);
+        encoder->submit(view, m_program);
+    }
+}
+
+uint32_t Bench::runFrame(uint32_t frame)
+{
+    if (m_options.workload == Workload::Update)
+    {
+        // 每帧改写所有立方体的顶点颜色
+        for (uint32_t i = 0; i < m_options.objects; ++i)
+        {
+            for (uint32_t v = 0; v < 8; ++v)
+            {
+                PosColorVertex& vertex = m_dynamicVertices[size_t(i) * 8 + v];
+                vertex                 = kCubeVertices[v];
+                vertex.abgr            = 0xff000000 | ((frame + i * 8 + v) * 2654435761u >> 8);
+            }
+        }
+        const void* vertices = m_dynamicVertices.data();
+        const uint32_t size  = static_cast<uint32_t>(m_dynamicVertices.size() * sizeof(PosColorVertex));
+        bgfx::update(m_dynamicVbh, 0, m_frameArena ? m_frameArena->copy(vertices, size) : bgfx::copy(vertices, size));
+    }
+
+    bgfx::touch(0);
+    if (m_threadPool)
+    {
+        const uint32_t grain = (m_options.objects + m_options.threads - 1) / m_options.threads;
+        m_threadPool->parallelFor(m_options.objects, grain, [this, frame](uint32_t begin, uint32_t end) {
+            bgfx::Encoder* encoder = bgfx::begin(true);
+            if (encoder)
+            {
+                submitObjects(encoder, 0, begin, end, frame);
+                bgfx::end(encoder);
+            }
+        });
+    }
+    else
+    {
+        bgfx::Encoder* encoder = bgfx::begin();
+        submitObjects(encoder, 0, 0, m_options.objects, frame);
+        bgfx::end(encoder);
+    }
+
+    if (m_options.workload == Workload::Capture)
+    {
+        // 渲染、拷贝和回读在同一帧中提交，等待数据可用后这一帧才算结束
+        bgfx::touch(1);
+        bgfx::blit(1, m_readbackTexture, 0, 0, m_colorTexture);
+        const uint32_t readyFrame = bgfx::readTexture(m_readbackTexture, m_readbackData.data());
+        while (bgfx::frame() < readyFrame)
+        {
+        }
+    }
+    else
+    {
+        bgfx::frame();
+    }
+
+    if (m_frameArena)
+    {
+        m_frameArena->frame();
+    }
+
+    return m_options.objects;
+}
+
+void writeJson(FILE* file, const Options& options, const Bench& bench, std::vector<double>& frameMs, uint64_t submits, double totalSeconds, double startupMs)
+{
+    std::sort(frameMs.begin(), frameMs.end());
+
+    double sum = 0.0;
+    for (double ms : frameMs)
+    {
+        sum += ms;
+    }
+
+    fprintf(
+        file,
+        "{\n"
+        "  \"renderer\": \"%s\",\n"
+        "  \"workload\": \"%s\",\n"
+        "  \"objects\": %u,\n"
+        "  \"width\": %u,\n"
+        "  \"height\": %u,\n"
+        "  \"frames\": %u,\n"
+        "  \"warmup\": %u,\n"
+        "  \"threads\": %u,\n"
+        "  \"frame_ms\": {\"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f},\n"
+        "  \"submits_per_sec\": %.1f,\n"
+        "  \"frames_per_sec\": %.2f,\n"
+        "  \"startup_ms\": %.3f,\n"
+        "  \"peak_rss_kb\": %llu,\n"
+        "  \"allocator\": \"%s\"",
+        bgfx::getRendererName(bgfx::getRendererType()),
+        getWorkloadName(options.workload),
+        options.objects,
+        options.width,
+        options.height,
+        options.frames,
+        options.warmup,
+        options.threads,
+        sum / frameMs.size(),
+        percentile(frameMs, 0.5),
+        percentile(frameMs, 0.95),
+        percentile(frameMs, 0.99),
+        frameMs.front(),
+        frameMs.back(),
+        submits / totalSeconds,
+        frameMs.size() / totalSeconds,
+        startupMs,
+        static_cast<unsigned long long>(getPeakMemoryKb()),
+        options.poolAllocator ? "pool" : "default"
+    );
+
+    // 碎片率：池和大块占用的系统堆内存中没有被使用的比例
+    if (const PoolAllocator* allocator = bench.getAllocator())
+    {
+        const PoolAllocator::Stats stats = allocator->getStats();
+        const uint64_t calls             = stats.allocations + stats.frees;
+        fprintf(
+            file,
+            ",\n  \"allocator_stats\": {\"allocations\": %llu, \"frees\": %llu, \"pool\": %llu, \"large\": %llu, \"used_kb\": %.1f, "
+            "\"peak_used_kb\": %.1f, \"reserved_kb\": %.1f, \"fragmentation\": %.3f, \"ns_per_call\": %.1f}",
+            static_cast<unsigned long long>(stats.allocations),
+            static_cast<unsigned long long>(stats.frees),
+            static_cast<unsigned long long>(stats.poolAllocations),
+            static_cast<unsigned long long>(stats.largeAllocations),
+            stats.usedBytes / 1024.0,
+            stats.peakUsedBytes / 1024.0,
+            stats.reservedBytes / 1024.0,
+            stats.reservedBytes > 0 ? 1.0 - double(stats.usedBytes) / double(stats.reservedBytes) : 0.0,
+            calls > 0 ? double(stats.totalNs) / double(calls) : 0.0
+        );
+    }
+    if (const FrameArena* frameArena = bench.getFrameArena())
+    {
+        const FrameArena::Stats& stats = frameArena->getStats();
+        fprintf(
+            file,
+            ",\n  \"frame_arena\": {\"allocations\": %llu, \"fallbacks\": %llu, \"peak_kb\": %.1f}",
+            static_cast<unsigned long long>(stats.allocations),
+            static_cast<unsigned long long>(stats.fallbacks),
+            stats.peakBytes / 1024.0
+        );
+    }
+    fprintf(file, "\n}\n");
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const auto processStart = std::chrono::steady_clock::now();
+
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printf(
+            "usage: bgfx_bench [--renderer noop|vulkan] [--workload submit|update|capture] [--objects N] [--width W] [--height H]\n"
+            "                  [--frames N] [--warmup N] [--threads N] [--allocator default|pool] [--out file.json]\n"
+        );
+        return EXIT_FAILURE;
+    }
+
+    Bench bench(options);
+    if (!bench.init())
+    {
+        fprintf(stderr, "failed to initialize bgfx\n");
+        bench.shutdown();
+        return EXIT_FAILURE;
+    }
+
+    // 启动耗时：bgfx::init 和创建资源，包括读取着色器文件
+    const double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+
+    // 预热：第一次使用资源时的创建开销不计入结果
+    uint32_t frame = 0;
+    for (uint32_t i = 0; i < options.warmup; ++i)
+    {
+        bench.runFrame(frame++);
+    }
+
+    std::vector<double> frameMs;
+    frameMs.reserve(options.frames);
+    uint64_t submits = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < options.frames; ++i)
+    {
+        const auto frameStart = std::chrono::steady_clock::now();
+        submits += bench.runFrame(frame++);
+        frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+    }
+    const double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    FILE* file = options.output.empty() ? stdout : fopen(options.output.c_str(), "w");
+    if (!file)
+    {
+        fprintf(stderr, "failed to open %s\n", options.output.c_str());
+        bench.shutdown();
+        return EXIT_FAILURE;
+    }
+    writeJson(file, options, bench, frameMs, submits, totalSeconds, startupMs);
+    if (file != stdout)
+    {
+        fclose(file);
+    }
+
+    bench.shutdown();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,924 @@
+﻿/*
+ * 重放 CommandRecorder 录制的 bgfx 调用，不运行应用逻辑，以最快速度提交，统计每帧耗时
+ * bgfx_replay commands.bin [--renderer noop|vulkan] [--warmup N] [--out file.json]
+ * 分辨率使用录制时的值，资源数据直接引用映射的文件，不再拷贝。
+ * 着色器优先从 shaders/<后端>/ 加载录制时的同名文件，不存在时使用录制的二进制，所以可以在和录制时不同的后端上重放。
+ * warmup 为开头不计入结果的帧数，默认为1，一般是创建资源的那一帧
+ */
+
+#include "command_recorder.h"
+#include "json_writer.h"
+#include "mapped_file.h"
+
+#include "bgfx/bgfx.h"
+#include "bgfx/platform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+using Op         = CommandRecorder::Op;
+using HandleType = CommandRecorder::HandleType;
+
+constexpr uint16_t kInvalidIdx    = UINT16_MAX;
+constexpr uint8_t kMaxAttachments = 8; // BGFX_CONFIG_MAX_FRAME_BUFFER_ATTACHMENTS 的默认值
+
+struct Options
+{
+    const char* input {nullptr};
+    bgfx::RendererType::Enum renderer {bgfx::RendererType::Noop};
+    uint32_t warmup {1};
+    std::string output;
+};
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* name = argv[i];
+        if (name[0] != '-')
+        {
+            if (options.input)
+            {
+                return false;
+            }
+            options.input = name;
+            continue;
+        }
+
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+        {
+            return false;
+        }
+        ++i;
+
+        if (strcmp(name, "--renderer") == 0)
+        {
+            if (strcmp(value, "noop") == 0)
+            {
+                options.renderer = bgfx::RendererType::Noop;
+            }
+            else if (strcmp(value, "vulkan") == 0)
+            {
+                options.renderer = bgfx::RendererType::Vulkan;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if (strcmp(name, "--warmup") == 0)
+        {
+            options.warmup = static_cast<uint32_t>(std::max(0, atoi(value)));
+        }
+        else if (strcmp(name, "--out") == 0)
+        {
+            options.output = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options.input != nullptr;
+}
+
+void destroyHandle(HandleType type, uint16_t idx)
+{
+    switch (type)
+    {
+        case HandleType::VertexBuffer:
+            bgfx::destroy(bgfx::VertexBufferHandle {idx});
+            break;
+        case HandleType::IndexBuffer:
+            bgfx::destroy(bgfx::IndexBufferHandle {idx});
+            break;
+        case HandleType::DynamicVertexBuffer:
+            bgfx::destroy(bgfx::DynamicVertexBufferHandle {idx});
+            break;
+        case HandleType::DynamicIndexBuffer:
+            bgfx::destroy(bgfx::DynamicIndexBufferHandle {idx});
+            break;
+        case HandleType::Shader:
+            bgfx::destroy(bgfx::ShaderHandle {idx});
+            break;
+        case HandleType::Program:
+            bgfx::destroy(bgfx::ProgramHandle {idx});
+            break;
+        case HandleType::Texture:
+            bgfx::destroy(bgfx::TextureHandle {idx});
+            break;
+        case HandleType::FrameBuffer:
+            bgfx::destroy(bgfx::FrameBufferHandle {idx});
+            break;
+        case HandleType::Uniform:
+            bgfx::destroy(bgfx::UniformHandle {idx});
+            break;
+        case HandleType::Count:
+            break;
+    }
+}
+
+// 和 bgfx_bench 相同的目录，文件不存在时返回空
+const bgfx::Memory* loadShader(const std::string& fileName)
+{
+    if (fileName.empty())
+    {
+        return nullptr;
+    }
+
+    std::string shaderPath = bgfx::getRendererType() == bgfx::RendererType::Direct3D11 || bgfx::getRendererType() == bgfx::RendererType::Direct3D12
+        ? "shaders/dx11/"
+        : "shaders/spirv/";
+    shaderPath += fileName;
+
+    FILE* file = fopen(shaderPath.c_str(), "rb");
+    if (!file)
+    {
+        return nullptr;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    const bgfx::Memory* mem = bgfx::alloc(static_cast<uint32_t>(fileSize + 1));
+    fread(mem->data, 1, fileSize, file);
+    mem->data[mem->size - 1] = '\0';
+    fclose(file);
+    return mem;
+}
+
+// 排好序的样本的百分位数（最近秩）
+double percentile(const std::vector<double>& sorted, double p)
+{
+    const size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+class Replayer
+{
+public:
+    Replayer(const uint8_t* data, size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    bool readHeader(CommandRecorder::FileHeader& header);
+
+    // 执行到下一个 Frame 命令（包括），没有更多命令或者数据有错误时返回 false
+    bool runFrame();
+
+    // 销毁重放时创建、还没有被录制的命令销毁的资源
+    void destroyAll();
+
+    bool hasError() const
+    {
+        return m_error;
+    }
+
+    size_t getOffset() const
+    {
+        return m_offset;
+    }
+
+    uint64_t getCommands() const
+    {
+        return m_commands;
+    }
+
+    uint64_t getSubmits() const
+    {
+        return m_submits;
+    }
+
+private:
+    bool execute(Op op);
+
+    template<typename T>
+    bool read(T& value)
+    {
+        if (m_size - m_offset < sizeof(T))
+        {
+            return false;
+        }
+        memcpy(&value, m_data + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return true;
+    }
+
+    const uint8_t* readBytes(size_t size);
+    bool readString(std::string& str);
+    bool readMemory(const bgfx::Memory*& mem);
+
+    void setHandle(HandleType type, uint16_t recorded, uint16_t idx);
+    uint16_t getHandle(HandleType type, uint16_t recorded) const;
+    bool isOwned(HandleType type, uint16_t recorded) const;
+    void release(HandleType type, uint16_t recorded);
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_offset {0};
+    bool m_error {false};
+    uint64_t m_commands {0};
+    uint64_t m_submits {0};
+    std::vector<float> m_matrices;
+    std::vector<float> m_uniformData;
+
+    // 录制时的 idx -> 重放时的 idx，m_owned 为 false 的资源由其他资源负责销毁
+    std::vector<uint16_t> m_handles[size_t(HandleType::Count)];
+    std::vector<bool> m_owned[size_t(HandleType::Count)];
+};
+
+bool Replayer::readHeader(CommandRecorder::FileHeader& header)
+{
+    if (!read(header) || memcmp(header.magic, CommandRecorder::kMagic, sizeof(header.magic)) != 0)
+    {
+        fprintf(stderr, "not a command trace\n");
+        return false;
+    }
+    if (header.version != CommandRecorder::kVersion)
+    {
+        fprintf(stderr, "unsupported trace version %u\n", header.version);
+        return false;
+    }
+
+    // VertexLayout 按内存布局记录，bgfx 版本不同时无法保证一致
+    if (header.apiVersion != BGFX_API_VERSION)
+    {
+        fprintf(stderr, "trace was recorded with bgfx API version %u, current is %u\n", header.apiVersion, BGFX_API_VERSION);
+        return false;
+    }
+    return true;
+}
+
+bool Replayer::runFrame()
+{
+    Op op;
+    while (read(op))
+    {
+        ++m_commands;
+        if (!execute(op))
+        {
+            m_error = true;
+            return false;
+        }
+        if (op == Op::Frame)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Replayer::execute(Op op)
+{
+    switch (op)
+    {
+        case Op::CreateVertexBuffer:
+        case Op::CreateDynamicVertexBuffer:
+        {
+            uint16_t idx;
+            bgfx::VertexLayout layout;
+            const bgfx::Memory* mem;
+            uint16_t flags;
+            if (!read(idx) || !read(layout) || !readMemory(mem) || !read(flags))
+            {
+                return false;
+            }
+            if (op == Op::CreateVertexBuffer)
+            {
+                setHandle(HandleType::VertexBuffer, idx, bgfx::createVertexBuffer(mem, layout, flags).idx);
+            }
+            else
+            {
+                setHandle(HandleType::DynamicVertexBuffer, idx, bgfx::createDynamicVertexBuffer(mem, layout, flags).idx);
+            }
+            return true;
+        }
+        case Op::CreateIndexBuffer:
+        case Op::CreateDynamicIndexBuffer:
+        {
+            uint16_t idx;
+            const bgfx::Memory* mem;
+            uint16_t flags;
+            if (!read(idx) || !readMemory(mem) || !read(flags))
+            {
+                return false;
+            }
+            if (op == Op::CreateIndexBuffer)
+            {
+                setHandle(HandleType::IndexBuffer, idx, bgfx::createIndexBuffer(mem, flags).idx);
+            }
+            else
+            {
+                setHandle(HandleType::DynamicIndexBuffer, idx, bgfx::createDynamicIndexBuffer(mem, flags).idx);
+            }
+            return true;
+        }
+        case Op::UpdateDynamicVertexBuffer:
+        case Op::UpdateDynamicIndexBuffer:
+        {
+            uint16_t idx;
+            uint32_t start;
+            const bgfx::Memory* mem;
+            if (!read(idx) || !read(start) || !readMemory(mem))
+            {
+                return false;
+            }
+            if (op == Op::UpdateDynamicVertexBuffer)
+            {
+                bgfx::update(bgfx::DynamicVertexBufferHandle {getHandle(HandleType::DynamicVertexBuffer, idx)}, start, mem);
+            }
+            else
+            {
+                bgfx::update(bgfx::DynamicIndexBufferHandle {getHandle(HandleType::DynamicIndexBuffer, idx)}, start, mem);
+            }
+            return true;
+        }
+        case Op::CreateShader:
+        {
+            uint16_t idx;
+            std::string name;
+            uint32_t size;
+            if (!read(idx) || !readString(name) || !read(size))
+            {
+                return false;
+            }
+            const uint8_t* data = readBytes(size);
+            if (!data)
+            {
+                return false;
+            }
+
+            // 录制的是录制时后端的着色器，优先使用重放后端的同名文件
+            const bgfx::Memory* mem = loadShader(name);
+            setHandle(HandleType::Shader, idx, bgfx::createShader(mem ? mem : bgfx::makeRef(data, size)).idx);
+            return true;
+        }
+        case Op::CreateProgram:
+        {
+            uint16_t idx;
+            uint16_t vsh;
+            uint16_t fsh;
+            uint8_t destroyShaders;
+            if (!read(idx) || !read(vsh) || !read(fsh) || !read(destroyShaders))
+            {
+                return false;
+            }
+            const bgfx::ShaderHandle vertex   = {getHandle(HandleType::Shader, vsh)};
+            const bgfx::ShaderHandle fragment = {getHandle(HandleType::Shader, fsh)};
+            setHandle(HandleType::Program, idx, bgfx::createProgram(vertex, fragment, destroyShaders != 0).idx);
+            if (destroyShaders)
+            {
+                release(HandleType::Shader, vsh);
+                release(HandleType::Shader, fsh);
+            }
+            return true;
+        }
+        case Op::CreateTexture2D:
+        {
+            uint16_t idx;
+            uint16_t width;
+            uint16_t height;
+            uint8_t hasMips;
+            uint16_t numLayers;
+            uint8_t format;
+            uint64_t flags;
+            const bgfx::Memory* mem;
+            if (!read(idx) || !read(width) || !read(height) || !read(hasMips) || !read(numLayers) || !read(format) || !read(flags) || !readMemory(mem))
+            {
+                return false;
+            }
+            const auto textureFormat = static_cast<bgfx::TextureFormat::Enum>(format);
+            setHandle(HandleType::Texture, idx, bgfx::createTexture2D(width, height, hasMips != 0, numLayers, textureFormat, flags, mem).idx);
+            return true;
+        }
+        case Op::CreateFrameBuffer:
+        {
+            uint16_t idx;
+            uint8_t num;
+            if (!read(idx) || !read(num))
+            {
+                return false;
+            }
+            bgfx::TextureHandle textures[kMaxAttachments];
+            uint16_t recordedTextures[kMaxAttachments];
+            if (num > kMaxAttachments)
+            {
+                return false;
+            }
+            for (uint8_t i = 0; i < num; ++i)
+            {
+                if (!read(recordedTextures[i]))
+                {
+                    return false;
+                }
+                textures[i].idx = getHandle(HandleType::Texture, recordedTextures[i]);
+            }
+            uint8_t destroyTextures;
+            if (!read(destroyTextures))
+            {
+                return false;
+            }
+            setHandle(HandleType::FrameBuffer, idx, bgfx::createFrameBuffer(num, textures, destroyTextures != 0).idx);
+            if (destroyTextures)
+            {
+                for (uint8_t i = 0; i < num; ++i)
+                {
+                    release(HandleType::Texture, recordedTextures[i]);
+                }
+            }
+            return true;
+        }
+        case Op::Destroy:
+        {
+            HandleType type;
+            uint16_t recorded;
+            if (!read(type) || !read(recorded) || type >= HandleType::Count)
+            {
+                return false;
+            }
+            // 录制开始前创建的资源没有映射，不属于自己的资源由引用它的资源销毁，这两种都跳过
+            if (isOwned(type, recorded))
+            {
+                destroyHandle(type, getHandle(type, recorded));
+            }
+            setHandle(type, recorded, kInvalidIdx);
+            return true;
+        }
+        case Op::SetViewName:
+        {
+            bgfx::ViewId view;
+            std::string name;
+            if (!read(view) || !readString(name))
+            {
+                return false;
+            }
+            bgfx::setViewName(view, name.c_str());
+            return true;
+        }
+        case Op::SetViewClear:
+        {
+            bgfx::ViewId view;
+            uint16_t flags;
+            uint32_t rgba;
+            float depth;
+            uint8_t stencil;
+            if (!read(view) || !read(flags) || !read(rgba) || !read(depth) || !read(stencil))
+            {
+                return false;
+            }
+            bgfx::setViewClear(view, flags, rgba, depth, stencil);
+            return true;
+        }
+        case Op::SetViewRect:
+        {
+            bgfx::ViewId view;
+            uint16_t x;
+            uint16_t y;
+            uint16_t width;
+            uint16_t height;
+            if (!read(view) || !read(x) || !read(y) || !read(width) || !read(height))
+            {
+                return false;
+            }
+            bgfx::setViewRect(view, x, y, width, height);
+            return true;
+        }
+        case Op::SetViewTransform:
+        {
+            bgfx::ViewId view;
+            uint8_t mask;
+            if (!read(view) || !read(mask))
+            {
+                return false;
+            }
+            // 文件中的矩阵不一定按 float 对齐，拷贝出来再使用
+            float viewMtx[16];
+            float projMtx[16];
+            if (((mask & 1) && !read(viewMtx)) || ((mask & 2) && !read(projMtx)))
+            {
+                return false;
+            }
+            bgfx::setViewTransform(view, (mask & 1) ? viewMtx : nullptr, (mask & 2) ? projMtx : nullptr);
+            return true;
+        }
+        case Op::SetViewFrameBuffer:
+        {
+            bgfx::ViewId view;
+            uint16_t idx;
+            if (!read(view) || !read(idx))
+            {
+                return false;
+            }
+            bgfx::setViewFrameBuffer(view, bgfx::FrameBufferHandle {getHandle(HandleType::FrameBuffer, idx)});
+            return true;
+        }
+        case Op::Touch:
+        {
+            bgfx::ViewId view;
+            if (!read(view))
+            {
+                return false;
+            }
+            bgfx::touch(view);
+            return true;
+        }
+        case Op::SetTransform:
+        {
+            uint16_t num;
+            if (!read(num))
+            {
+                return false;
+            }
+            const uint8_t* mtx = readBytes(sizeof(float) * 16 * num);
+            if (!mtx)
+            {
+                return false;
+            }
+            m_matrices.resize(size_t(num) * 16);
+            memcpy(m_matrices.data(), mtx, sizeof(float) * 16 * num);
+            bgfx::setTransform(m_matrices.data(), num);
+            return true;
+        }
+        case Op::SetVertexBuffer:
+        case Op::SetDynamicVertexBuffer:
+        {
+            uint8_t stream;
+            uint16_t idx;
+            uint32_t start;
+            uint32_t num;
+            if (!read(stream) || !read(idx) || !read(start) || !read(num))
+            {
+                return false;
+            }
+            if (op == Op::SetVertexBuffer)
+            {
+                bgfx::setVertexBuffer(stream, bgfx::VertexBufferHandle {getHandle(HandleType::VertexBuffer, idx)}, start, num);
+            }
+            else
+            {
+                bgfx::setVertexBuffer(stream, bgfx::DynamicVertexBufferHandle {getHandle(HandleType::DynamicVertexBuffer, idx)}, start, num);
+            }
+            return true;
+        }
+        case Op::SetIndexBuffer:
+        case Op::SetDynamicIndexBuffer:
+        {
+            uint16_t idx;
+            uint32_t first;
+            uint32_t num;
+            if (!read(idx) || !read(first) || !read(num))
+            {
+                return false;
+            }
+            if (op == Op::SetIndexBuffer)
+            {
+                bgfx::setIndexBuffer(bgfx::IndexBufferHandle {getHandle(HandleType::IndexBuffer, idx)}, first, num);
+            }
+            else
+            {
+                bgfx::setIndexBuffer(bgfx::DynamicIndexBufferHandle {getHandle(HandleType::DynamicIndexBuffer, idx)}, first, num);
+            }
+            return true;
+        }
+        case Op::SetState:
+        {
+            uint64_t state;
+            uint32_t rgba;
+            if (!read(state) || !read(rgba))
+            {
+                return false;
+            }
+            bgfx::setState(state, rgba);
+            return true;
+        }
+        case Op::Submit:
+        {
+            bgfx::ViewId view;
+            uint16_t program;
+            uint32_t depth;
+            uint8_t flags;
+            if (!read(view) || !read(program) || !read(depth) || !read(flags))
+            {
+                return false;
+            }
+            bgfx::submit(view, bgfx::ProgramHandle {getHandle(HandleType::Program, program)}, depth, flags);
+            ++m_submits;
+            return true;
+        }
+        case Op::Frame:
+            bgfx::frame();
+            return true;
+        case Op::CreateUniform:
+        {
+            uint16_t idx;
+            std::string name;
+            uint8_t type;
+            uint16_t num;
+            if (!read(idx) || !readString(name) || !read(type) || !read(num) || type >= bgfx::UniformType::Count)
+            {
+                return false;
+            }
+            const auto uniformType = static_cast<bgfx::UniformType::Enum>(type);
+            setHandle(HandleType::Uniform, idx, bgfx::createUniform(name.c_str(), uniformType, num).idx);
+            return true;
+        }
+        case Op::SetUniform:
+        {
+            uint16_t idx;
+            uint16_t num;
+            uint32_t size;
+            if (!read(idx) || !read(num) || !read(size))
+            {
+                return false;
+            }
+            const uint8_t* data = readBytes(size);
+            if (!data)
+            {
+                return false;
+            }
+            // uniform 在录制开始前创建时没有映射，跳过
+            const uint16_t uniform = getHandle(HandleType::Uniform, idx);
+            if (uniform == kInvalidIdx)
+            {
+                return true;
+            }
+            // 映射的文件中没有对齐，和矩阵一样先拷贝出来
+            m_uniformData.resize((size_t(size) + sizeof(float) - 1) / sizeof(float));
+            memcpy(m_uniformData.data(), data, size);
+            bgfx::setUniform(bgfx::UniformHandle {uniform}, m_uniformData.data(), num);
+            return true;
+        }
+        case Op::SetTexture:
+        {
+            uint8_t stage;
+            uint16_t sampler;
+            uint16_t texture;
+            uint32_t flags;
+            if (!read(stage) || !read(sampler) || !read(texture) || !read(flags))
+            {
+                return false;
+            }
+            const bgfx::UniformHandle samplerHandle = {getHandle(HandleType::Uniform, sampler)};
+            const bgfx::TextureHandle textureHandle = {getHandle(HandleType::Texture, texture)};
+            if (samplerHandle.idx != kInvalidIdx)
+            {
+                bgfx::setTexture(stage, samplerHandle, textureHandle, flags);
+            }
+            return true;
+        }
+        case Op::Count:
+            break;
+    }
+    return false;
+}
+
+void Replayer::destroyAll()
+{
+    // 先销毁引用其他资源的帧缓冲和程序
+    const HandleType order[] = {
+        HandleType::FrameBuffer,
+        HandleType::Program,
+        HandleType::Texture,
+        HandleType::Shader,
+        HandleType::DynamicVertexBuffer,
+        HandleType::DynamicIndexBuffer,
+        HandleType::VertexBuffer,
+        HandleType::IndexBuffer,
+        HandleType::Uniform,
+    };
+    for (HandleType type : order)
+    {
+        const std::vector<uint16_t>& handles = m_handles[size_t(type)];
+        for (size_t recorded = 0; recorded < handles.size(); ++recorded)
+        {
+            if (isOwned(type, static_cast<uint16_t>(recorded)))
+            {
+                destroyHandle(type, handles[recorded]);
+            }
+        }
+        m_handles[size_t(type)].clear();
+        m_owned[size_t(type)].clear();
+    }
+}
+
+const uint8_t* Replayer::readBytes(size_t size)
+{
+    if (m_size - m_offset < size)
+    {
+        return nullptr;
+    }
+    const uint8_t* data = m_data + m_offset;
+    m_offset += size;
+    return data;
+}
+
+bool Replayer::readString(std::string& str)
+{
+    uint16_t length;
+    if (!read(length))
+    {
+        return false;
+    }
+    const uint8_t* data = readBytes(length);
+    if (!data)
+    {
+        return false;
+    }
+    str.assign(reinterpret_cast<const char*>(data), length);
+    return true;
+}
+
+// 直接引用映射的文件，映射在 bgfx::shutdown() 之后才关闭
+bool Replayer::readMemory(const bgfx::Memory*& mem)
+{
+    uint32_t size;
+    if (!read(size))
+    {
+        return false;
+    }
+    const uint8_t* data = readBytes(size);
+    if (!data)
+    {
+        return false;
+    }
+    mem = size > 0 ? bgfx::makeRef(data, size) : nullptr;
+    return true;
+}
+
+void Replayer::setHandle(HandleType type, uint16_t recorded, uint16_t idx)
+{
+    std::vector<uint16_t>& handles = m_handles[size_t(type)];
+    std::vector<bool>& owned       = m_owned[size_t(type)];
+    if (recorded >= handles.size())
+    {
+        handles.resize(size_t(recorded) + 1, kInvalidIdx);
+        owned.resize(handles.size(), false);
+    }
+    handles[recorded] = idx;
+    owned[recorded]   = idx != kInvalidIdx;
+}
+
+uint16_t Replayer::getHandle(HandleType type, uint16_t recorded) const
+{
+    const std::vector<uint16_t>& handles = m_handles[size_t(type)];
+    return recorded < handles.size() ? handles[recorded] : kInvalidIdx;
+}
+
+// setHandle 只把有效的 idx 标记为 owned，没有映射的资源总是返回 false
+bool Replayer::isOwned(HandleType type, uint16_t recorded) const
+{
+    const std::vector<bool>& owned = m_owned[size_t(type)];
+    return recorded < owned.size() && owned[recorded];
+}
+
+void Replayer::release(HandleType type, uint16_t recorded)
+{
+    if (recorded < m_owned[size_t(type)].size())
+    {
+        m_owned[size_t(type)][recorded] = false;
+    }
+}
+
+void writeJson(FILE* file, const Options& options, const Replayer& replayer, std::vector<double>& frameMs, double totalSeconds)
+{
+    std::sort(frameMs.begin(), frameMs.end());
+
+    double sum = 0.0;
+    for (double ms : frameMs)
+    {
+        sum += ms;
+    }
+
+    fprintf(file, "{\n  \"renderer\": ");
+    writeJsonString(file, bgfx::getRendererName(bgfx::getRendererType()));
+    fprintf(file, ",\n  \"trace\": ");
+    writeJsonString(file, options.input);
+    fprintf(
+        file,
+        ",\n"
+        "  \"frames\": %zu,\n"
+        "  \"warmup\": %u,\n"
+        "  \"commands\": %llu,\n"
+        "  \"submits\": %llu,\n"
+        "  \"frame_ms\": {\"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f},\n"
+        "  \"submits_per_sec\": %.1f,\n"
+        "  \"frames_per_sec\": %.2f\n"
+        "}\n",
+        frameMs.size(),
+        options.warmup,
+        static_cast<unsigned long long>(replayer.getCommands()),
+        static_cast<unsigned long long>(replayer.getSubmits()),
+        sum / frameMs.size(),
+        percentile(frameMs, 0.5),
+        percentile(frameMs, 0.95),
+        percentile(frameMs, 0.99),
+        frameMs.front(),
+        frameMs.back(),
+        replayer.getSubmits() / totalSeconds,
+        frameMs.size() / totalSeconds
+    );
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printf("usage: bgfx_replay commands.bin [--renderer noop|vulkan] [--warmup N] [--out file.json]\n");
+        return EXIT_FAILURE;
+    }
+
+    MappedFile trace;
+    if (!trace.open(options.input))
+    {
+        fprintf(stderr, "failed to open %s\n", options.input);
+        return EXIT_FAILURE;
+    }
+
+    Replayer replayer(trace.getData(), trace.getSize());
+    CommandRecorder::FileHeader header;
+    if (!replayer.readHeader(header))
+    {
+        return EXIT_FAILURE;
+    }
+
+    bgfx::renderFrame();
+
+    bgfx::Init bgfxInit;
+    bgfxInit.platformData.nwh  = nullptr;
+    bgfxInit.type              = options.renderer;
+    bgfxInit.resolution.width  = header.width;
+    bgfxInit.resolution.height = header.height;
+    bgfxInit.resolution.reset  = BGFX_RESET_NONE;
+    if (!bgfx::init(bgfxInit))
+    {
+        fprintf(stderr, "failed to initialize bgfx\n");
+        return EXIT_FAILURE;
+    }
+
+    // 预热：录制开头的资源创建不计入结果
+    bool running = true;
+    for (uint32_t i = 0; i < options.warmup && running; ++i)
+    {
+        running = replayer.runFrame();
+    }
+
+    std::vector<double> frameMs;
+    const auto start = std::chrono::steady_clock::now();
+    while (running)
+    {
+        const auto frameStart = std::chrono::steady_clock::now();
+        running               = replayer.runFrame();
+        if (running)
+        {
+            frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        }
+    }
+    const double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int result = EXIT_SUCCESS;
+    if (replayer.hasError())
+    {
+        fprintf(stderr, "invalid command at offset %zu\n", replayer.getOffset());
+        result = EXIT_FAILURE;
+    }
+    else if (frameMs.empty())
+    {
+        fprintf(stderr, "no frames after warmup\n");
+        result = EXIT_FAILURE;
+    }
+    else
+    {
+        FILE* file = options.output.empty() ? stdout : fopen(options.output.c_str(), "w");
+        if (file)
+        {
+            writeJson(file, options, replayer, frameMs, totalSeconds);
+            if (file != stdout)
+            {
+                fclose(file);
+            }
+        }
+        else
+        {
+            fprintf(stderr, "failed to open %s\n", options.output.c_str());
+            result = EXIT_FAILURE;
+        }
+    }
+
+    replayer.destroyAll();
+    bgfx::frame();
+    bgfx::shutdown();
+    return result;
+}
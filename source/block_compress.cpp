@@ -0,0 +1,962 @@
+﻿#include "block_compress.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+// 4x4 块按通道分开存放（SoA），方便一次计算4个像素
+struct BlockPixels
+{
+    alignas(16) float c[4][16];
+};
+
+void loadBlock(const uint8_t rgba[64], BlockPixels& px)
+{
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int ch = 0; ch < 4; ++ch)
+        {
+            px.c[ch][i] = rgba[i * 4 + ch];
+        }
+    }
+}
+
+// 为每个像素找到调色板中最近的颜色，只比较 [channelBegin, channelEnd) 通道，
+// mask 中为 false 的像素跳过（索引保持不变、不计误差）。返回误差平方和
+float fitIndices(
+    const BlockPixels& px,
+    const float (*palette)[4],
+    int paletteSize,
+    int channelBegin,
+    int channelEnd,
+    const bool* mask,
+    uint8_t indices[16]
+)
+{
+#ifdef BLOCK_COMPRESS_SSE2
+    __m128 total = _mm_setzero_ps();
+    for (int group = 0; group < 16; group += 4)
+    {
+        __m128 best     = _mm_set1_ps(1e30f);
+        __m128i bestIdx = _mm_setzero_si128();
+        for (int p = 0; p < paletteSize; ++p)
+        {
+            __m128 dist = _mm_setzero_ps();
+            for (int ch = channelBegin; ch < channelEnd; ++ch)
+            {
+                const __m128 d = _mm_sub_ps(_mm_load_ps(px.c[ch] + group), _mm_set1_ps(palette[p][ch]));
+                dist           = _mm_add_ps(dist, _mm_mul_ps(d, d));
+            }
+
+            // 严格小于，距离相同时保留较小的索引
+            const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(dist, best));
+            bestIdx              = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIdx));
+            best                 = _mm_min_ps(dist, best);
+        }
+
+        alignas(16) int32_t idx[4];
+        alignas(16) float err[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(idx), bestIdx);
+        _mm_store_ps(err, best);
+        for (int i = 0; i < 4; ++i)
+        {
+            if (!mask || mask[group + i])
+            {
+                indices[group + i] = static_cast<uint8_t>(idx[i]);
+            }
+            else
+            {
+                err[i] = 0.0f;
+            }
+        }
+        total = _mm_add_ps(total, _mm_load_ps(err));
+    }
+
+    alignas(16) float sum[4];
+    _mm_store_ps(sum, total);
+    return sum[0] + sum[1] + sum[2] + sum[3];
+#else
+    float total = 0.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        if (mask && !mask[i])
+        {
+            continue;
+        }
+
+        float best  = 1e30f;
+        int bestIdx = 0;
+        for (int p = 0; p < paletteSize; ++p)
+        {
+            float dist = 0.0f;
+            for (int ch = channelBegin; ch < channelEnd; ++ch)
+            {
+                const float d = px.c[ch][i] - palette[p][ch];
+                dist += d * d;
+            }
+            if (dist < best)
+            {
+                best    = dist;
+                bestIdx = p;
+            }
+        }
+
+        indices[i] = static_cast<uint8_t>(bestIdx);
+        total += best;
+    }
+    return total;
+#endif
+}
+
+// 给定每个像素插值位置 t（0 为端点0，1 为端点1），用最小二乘求端点。矩阵奇异时返回 false
+bool solveEndpoints(const BlockPixels& px, const float t[16], const bool* mask, int channels, float e0[4], float e1[4])
+{
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float xa[4] {};
+    float xb[4] {};
+    for (int i = 0; i < 16; ++i)
+    {
+        if (mask && !mask[i])
+        {
+            continue;
+        }
+
+        const float a = 1.0f - t[i];
+        const float b = t[i];
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            xa[ch] += a * px.c[ch][i];
+            xb[ch] += b * px.c[ch][i];
+        }
+    }
+
+    const float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f)
+    {
+        return false;
+    }
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        e0[ch] = std::clamp((bb * xa[ch] - ab * xb[ch]) / det, 0.0f, 255.0f);
+        e1[ch] = std::clamp((aa * xb[ch] - ab * xa[ch]) / det, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+// 主成分方向上投影最远的两个点作为初始端点
+void principalEndpoints(const BlockPixels& px, const bool* mask, int channels, float e0[4], float e1[4])
+{
+    float mean[4] {};
+    int count = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        if (mask && !mask[i])
+        {
+            continue;
+        }
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            mean[ch] += px.c[ch][i];
+        }
+        ++count;
+    }
+
+    if (count == 0)
+    {
+        std::fill(e0, e0 + 4, 0.0f);
+        std::fill(e1, e1 + 4, 0.0f);
+        return;
+    }
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        mean[ch] /= count;
+    }
+
+    float cov[4][4] {};
+    for (int i = 0; i < 16; ++i)
+    {
+        if (mask && !mask[i])
+        {
+            continue;
+        }
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = a; b < channels; ++b)
+            {
+                cov[a][b] += (px.c[a][i] - mean[a]) * (px.c[b][i] - mean[b]);
+            }
+        }
+    }
+    for (int a = 0; a < channels; ++a)
+    {
+        for (int b = 0; b < a; ++b)
+        {
+            cov[a][b] = cov[b][a];
+        }
+    }
+
+    // 幂迭代求最大特征向量
+    float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (int iter = 0; iter < 8; ++iter)
+    {
+        float next[4] {};
+        float length = 0.0f;
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = 0; b < channels; ++b)
+            {
+                next[a] += cov[a][b] * axis[b];
+            }
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if (length < 1e-6f)
+        {
+            break;
+        }
+        for (int a = 0; a < channels; ++a)
+        {
+            axis[a] = next[a] / length;
+        }
+    }
+
+    float minT = 1e30f;
+    float maxT = -1e30f;
+    for (int i = 0; i < 16; ++i)
+    {
+        if (mask && !mask[i])
+        {
+            continue;
+        }
+        float proj = 0.0f;
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            proj += (px.c[ch][i] - mean[ch]) * axis[ch];
+        }
+        minT = std::min(minT, proj);
+        maxT = std::max(maxT, proj);
+    }
+
+    float axisLength = 0.0f;
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        axisLength += axis[ch] * axis[ch];
+    }
+    axisLength = axisLength > 0.0f ? axisLength : 1.0f;
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        e0[ch] = std::clamp(mean[ch] + axis[ch] * minT / axisLength, 0.0f, 255.0f);
+        e1[ch] = std::clamp(mean[ch] + axis[ch] * maxT / axisLength, 0.0f, 255.0f);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// BC1
+
+uint16_t packRgb565(const float color[4])
+{
+    const int r = std::clamp(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+    const int g = std::clamp(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+    const int b = std::clamp(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+    return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+void unpackRgb565(uint16_t value, int rgb[3])
+{
+    const int r = value >> 11 & 31;
+    const int g = value >> 5 & 63;
+    const int b = value & 31;
+    rgb[0]      = r << 3 | r >> 2;
+    rgb[1]      = g << 2 | g >> 4;
+    rgb[2]      = b << 3 | b >> 2;
+}
+
+// 和解码器一致的调色板。BC2/BC3 的颜色块总是4色模式
+void buildBc1Palette(uint16_t c0, uint16_t c1, bool forceFourColor, int palette[4][4])
+{
+    int a[3];
+    int b[3];
+    unpackRgb565(c0, a);
+    unpackRgb565(c1, b);
+    for (int ch = 0; ch < 3; ++ch)
+    {
+        palette[0][ch] = a[ch];
+        palette[1][ch] = b[ch];
+        if (c0 > c1 || forceFourColor)
+        {
+            palette[2][ch] = (2 * a[ch] + b[ch]) / 3;
+            palette[3][ch] = (a[ch] + 2 * b[ch]) / 3;
+        }
+        else
+        {
+            palette[2][ch] = (a[ch] + b[ch]) / 2;
+            palette[3][ch] = 0;
+        }
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = (c0 > c1 || forceFourColor) ? 255 : 0;
+}
+
+struct Bc1Result
+{
+    uint16_t c0 {0};
+    uint16_t c1 {0};
+    uint8_t indices[16] {};
+    float error {1e30f};
+};
+
+// 按给定端点和模式（4色 / 3色）编码，transparent 中的像素使用索引3
+Bc1Result evaluateBc1(const BlockPixels& px, const float e0[4], const float e1[4], bool threeColor, const bool* opaque)
+{
+    Bc1Result result;
+    uint16_t c0 = packRgb565(e0);
+    uint16_t c1 = packRgb565(e1);
+
+    // 4色模式需要 c0 > c1，3色模式需要 c0 <= c1
+    if ((!threeColor && c0 < c1) || (threeColor && c0 > c1))
+    {
+        std::swap(c0, c1);
+    }
+    if (!threeColor && c0 == c1)
+    {
+        // 相等时解码器会按3色模式解释，所有像素用索引0即可
+        result.c0 = c0;
+        result.c1 = c1;
+        int palette[4][4];
+        buildBc1Palette(c0, c1, false, palette);
+        const float color[1][4] = {
+            {float(palette[0][0]), float(palette[0][1]), float(palette[0][2]), 255.0f}
+        };
+        result.error = fitIndices(px, color, 1, 0, 3, opaque, result.indices);
+        return result;
+    }
+
+    int palette[4][4];
+    buildBc1Palette(c0, c1, false, palette);
+    float paletteF[4][4];
+    for (int p = 0; p < 4; ++p)
+    {
+        for (int ch = 0; ch < 4; ++ch)
+        {
+            paletteF[p][ch] = static_cast<float>(palette[p][ch]);
+        }
+    }
+
+    result.c0    = c0;
+    result.c1    = c1;
+    result.error = fitIndices(px, paletteF, threeColor ? 3 : 4, 0, 3, opaque, result.indices);
+    if (opaque)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            if (!opaque[i])
+            {
+                result.indices[i] = 3;
+            }
+        }
+    }
+    return result;
+}
+
+void refineBc1(const BlockPixels& px, bool threeColor, const bool* opaque, Bc1Result& best, int iterations)
+{
+    // 索引对应的插值位置，4色：0, 1, 1/3, 2/3；3色：0, 1, 1/2
+    static const float kFourColorT[4]  = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+    static const float kThreeColorT[4] = {0.0f, 1.0f, 0.5f, 0.0f};
+
+    for (int iter = 0; iter < iterations; ++iter)
+    {
+        float t[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            t[i] = threeColor ? kThreeColorT[best.indices[i]] : kFourColorT[best.indices[i]];
+        }
+
+        float e0[4];
+        float e1[4];
+        if (!solveEndpoints(px, t, opaque, 3, e0, e1))
+        {
+            break;
+        }
+
+        const Bc1Result candidate = evaluateBc1(px, e0, e1, threeColor, opaque);
+        if (candidate.error >= best.error)
+        {
+            break;
+        }
+        best = candidate;
+    }
+}
+
+void writeBc1(const Bc1Result& result, uint8_t* output)
+{
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        bits |= uint32_t(result.indices[i] & 3) << (i * 2);
+    }
+
+    output[0] = static_cast<uint8_t>(result.c0);
+    output[1] = static_cast<uint8_t>(result.c0 >> 8);
+    output[2] = static_cast<uint8_t>(result.c1);
+    output[3] = static_cast<uint8_t>(result.c1 >> 8);
+    memcpy(output + 4, &bits, 4);
+}
+
+// allowAlpha 为 true 时 alpha < 128 的像素编码为透明（BC1 的 1-bit alpha）。
+// forceFourColor 用于 BC2/BC3 的颜色块：解码器总是按4色模式解释，不能使用3色模式
+void compressBc1(const BlockPixels& px, BlockQuality quality, bool allowAlpha, bool forceFourColor, uint8_t* output)
+{
+    bool opaque[16];
+    bool hasTransparent = false;
+    for (int i = 0; i < 16; ++i)
+    {
+        opaque[i] = !allowAlpha || px.c[3][i] >= 128.0f;
+        hasTransparent |= !opaque[i];
+    }
+    const bool* mask = hasTransparent ? opaque : nullptr;
+
+    float e0[4];
+    float e1[4];
+    principalEndpoints(px, mask, 3, e0, e1);
+
+    const int iterations = quality == BlockQuality::Quality ? 3 : 0;
+    Bc1Result best;
+    if (!hasTransparent)
+    {
+        best = evaluateBc1(px, e0, e1, false, nullptr);
+        refineBc1(px, false, nullptr, best, iterations);
+    }
+
+    // 有透明像素时只能用3色模式，质量模式下不透明块也尝试一下3色模式
+    if (!forceFourColor && (hasTransparent || quality == BlockQuality::Quality))
+    {
+        Bc1Result threeColor = evaluateBc1(px, e0, e1, true, mask);
+        refineBc1(px, true, mask, threeColor, iterations);
+        if (hasTransparent || threeColor.error < best.error)
+        {
+            best = threeColor;
+        }
+    }
+
+    writeBc1(best, output);
+}
+
+void decompressBc1(const uint8_t* block, bool forceFourColor, uint8_t rgba[64])
+{
+    const uint16_t c0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+    const uint16_t c1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+    uint32_t bits;
+    memcpy(&bits, block + 4, 4);
+
+    int palette[4][4];
+    buildBc1Palette(c0, c1, forceFourColor, palette);
+    for (int i = 0; i < 16; ++i)
+    {
+        const int index = bits >> (i * 2) & 3;
+        for (int ch = 0; ch < 4; ++ch)
+        {
+            rgba[i * 4 + ch] = static_cast<uint8_t>(palette[index][ch]);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// BC4（BC3 的 alpha 块、BC5 的两个通道都是同样的格式）
+
+void buildBc4Palette(int a0, int a1, int palette[8])
+{
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1)
+    {
+        for (int i = 1; i < 7; ++i)
+        {
+            palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+        }
+    }
+    else
+    {
+        for (int i = 1; i < 5; ++i)
+        {
+            palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+struct Bc4Result
+{
+    int a0 {0};
+    int a1 {0};
+    uint8_t indices[16] {};
+    float error {1e30f};
+};
+
+Bc4Result evaluateBc4(const BlockPixels& px, int channel, int a0, int a1)
+{
+    int palette[8];
+    buildBc4Palette(a0, a1, palette);
+    float paletteF[8][4] {};
+    for (int p = 0; p < 8; ++p)
+    {
+        paletteF[p][channel] = static_cast<float>(palette[p]);
+    }
+
+    Bc4Result result;
+    result.a0    = a0;
+    result.a1    = a1;
+    result.error = fitIndices(px, paletteF, 8, channel, channel + 1, nullptr, result.indices);
+    return result;
+}
+
+void compressBc4(const BlockPixels& px, int channel, BlockQuality quality, uint8_t* output)
+{
+    int minValue     = 255;
+    int maxValue     = 0;
+    int minInterior  = 255; // 不含 0 和 255 的范围，6值模式用
+    int maxInterior  = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        const int v = static_cast<int>(px.c[channel][i]);
+        minValue    = std::min(minValue, v);
+        maxValue    = std::max(maxValue, v);
+        if (v != 0 && v != 255)
+        {
+            minInterior = std::min(minInterior, v);
+            maxInterior = std::max(maxInterior, v);
+        }
+    }
+
+    // 8值模式要求 a0 > a1，相等时所有索引为0
+    Bc4Result best = evaluateBc4(px, channel, maxValue, minValue);
+    if (quality == BlockQuality::Quality)
+    {
+        // 端点向内收缩几步，通常能降低中间值的误差
+        for (int inset0 = 0; inset0 <= 4; ++inset0)
+        {
+            for (int inset1 = 0; inset1 <= 4; ++inset1)
+            {
+                const int a0 = maxValue - inset0;
+                const int a1 = minValue + inset1;
+                if (a0 <= a1 || (inset0 == 0 && inset1 == 0))
+                {
+                    continue;
+                }
+
+                const Bc4Result candidate = evaluateBc4(px, channel, a0, a1);
+                if (candidate.error < best.error)
+                {
+                    best = candidate;
+                }
+            }
+        }
+
+        // 6值模式：端点覆盖中间值，0 和 255 用额外的两个索引表示
+        if (minInterior <= maxInterior)
+        {
+            const Bc4Result candidate = evaluateBc4(px, channel, minInterior, maxInterior);
+            if (candidate.error < best.error)
+            {
+                best = candidate;
+            }
+        }
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        bits |= uint64_t(best.indices[i] & 7) << (i * 3);
+    }
+
+    output[0] = static_cast<uint8_t>(best.a0);
+    output[1] = static_cast<uint8_t>(best.a1);
+    for (int i = 0; i < 6; ++i)
+    {
+        output[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+    }
+}
+
+void decompressBc4(const uint8_t* block, int channel, uint8_t rgba[64])
+{
+    int palette[8];
+    buildBc4Palette(block[0], block[1], palette);
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; ++i)
+    {
+        bits |= uint64_t(block[2 + i]) << (i * 8);
+    }
+
+    for (int i = 0; i < 16; ++i)
+    {
+        rgba[i * 4 + channel] = static_cast<uint8_t>(palette[bits >> (i * 3) & 7]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// BC7 mode 6：单分区，RGBA 端点各7位加每个端点1个 p-bit，4位索引
+
+const int kBc7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Result
+{
+    int e0[4] {};   // 7位
+    int e1[4] {};
+    int p0 {0};
+    int p1 {0};
+    uint8_t indices[16] {};
+    float error {1e30f};
+};
+
+void buildBc7Palette(const int e0[4], const int e1[4], int p0, int p1, float palette[16][4])
+{
+    for (int ch = 0; ch < 4; ++ch)
+    {
+        const int a = e0[ch] << 1 | p0;
+        const int b = e1[ch] << 1 | p1;
+        for (int i = 0; i < 16; ++i)
+        {
+            palette[i][ch] = static_cast<float>(((64 - kBc7Weights4[i]) * a + kBc7Weights4[i] * b + 32) >> 6);
+        }
+    }
+}
+
+Bc7Result evaluateBc7(const BlockPixels& px, const float e0[4], const float e1[4], int p0, int p1)
+{
+    Bc7Result result;
+    result.p0 = p0;
+    result.p1 = p1;
+    for (int ch = 0; ch < 4; ++ch)
+    {
+        result.e0[ch] = std::clamp(static_cast<int>((e0[ch] - p0) * 0.5f + 0.5f), 0, 127);
+        result.e1[ch] = std::clamp(static_cast<int>((e1[ch] - p1) * 0.5f + 0.5f), 0, 127);
+    }
+
+    float palette[16][4];
+    buildBc7Palette(result.e0, result.e1, p0, p1, palette);
+    result.error = fitIndices(px, palette, 16, 0, 4, nullptr, result.indices);
+    return result;
+}
+
+// 每个端点单独选量化误差最小的 p-bit
+int chooseBc7PBit(const float endpoint[4])
+{
+    float error[2] {};
+    for (int p = 0; p < 2; ++p)
+    {
+        for (int ch = 0; ch < 4; ++ch)
+        {
+            const int q       = std::clamp(static_cast<int>((endpoint[ch] - p) * 0.5f + 0.5f), 0, 127);
+            const float delta = endpoint[ch] - static_cast<float>(q << 1 | p);
+            error[p] += delta * delta;
+        }
+    }
+    return error[1] < error[0] ? 1 : 0;
+}
+
+Bc7Result fitBc7(const BlockPixels& px, const float e0[4], const float e1[4], BlockQuality quality)
+{
+    if (quality == BlockQuality::Fast)
+    {
+        return evaluateBc7(px, e0, e1, chooseBc7PBit(e0), chooseBc7PBit(e1));
+    }
+
+    Bc7Result best;
+    for (int p = 0; p < 4; ++p)
+    {
+        const Bc7Result candidate = evaluateBc7(px, e0, e1, p & 1, p >> 1);
+        if (candidate.error < best.error)
+        {
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t* output)
+        : m_output(output)
+    {
+        memset(m_output, 0, 16);
+    }
+
+    void write(uint32_t value, int count)
+    {
+        for (int i = 0; i < count; ++i, ++m_position)
+        {
+            m_output[m_position >> 3] |= static_cast<uint8_t>((value >> i & 1) << (m_position & 7));
+        }
+    }
+
+private:
+    uint8_t* m_output;
+    int m_position {0};
+};
+
+class BitReader
+{
+public:
+    explicit BitReader(const uint8_t* input)
+        : m_input(input)
+    {
+    }
+
+    uint32_t read(int count)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < count; ++i, ++m_position)
+        {
+            value |= uint32_t(m_input[m_position >> 3] >> (m_position & 7) & 1) << i;
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* m_input;
+    int m_position {0};
+};
+
+void compressBc7(const BlockPixels& px, BlockQuality quality, uint8_t* output)
+{
+    float e0[4];
+    float e1[4];
+    principalEndpoints(px, nullptr, 4, e0, e1);
+    Bc7Result best = fitBc7(px, e0, e1, quality);
+
+    if (quality == BlockQuality::Quality)
+    {
+        for (int iter = 0; iter < 3; ++iter)
+        {
+            float t[16];
+            for (int i = 0; i < 16; ++i)
+            {
+                t[i] = kBc7Weights4[best.indices[i]] / 64.0f;
+            }
+            if (!solveEndpoints(px, t, nullptr, 4, e0, e1))
+            {
+                break;
+            }
+
+            const Bc7Result candidate = fitBc7(px, e0, e1, quality);
+            if (candidate.error >= best.error)
+            {
+                break;
+            }
+            best = candidate;
+        }
+    }
+
+    // 第0个像素的索引最高位隐含为0，不满足时交换端点并翻转索引
+    if (best.indices[0] & 8)
+    {
+        std::swap(best.e0, best.e1);
+        std::swap(best.p0, best.p1);
+        for (auto& index : best.indices)
+        {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    BitWriter writer(output);
+    writer.write(1u << 6, 7); // mode 6
+    for (int ch = 0; ch < 4; ++ch)
+    {
+        writer.write(best.e0[ch], 7);
+        writer.write(best.e1[ch], 7);
+    }
+    writer.write(best.p0, 1);
+    writer.write(best.p1, 1);
+    writer.write(best.indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+    {
+        writer.write(best.indices[i], 4);
+    }
+}
+
+// 只解码 mode 6（编码器只输出这一种），其他模式输出洋红色
+void decompressBc7(const uint8_t* block, uint8_t rgba[64])
+{
+    BitReader reader(block);
+    if (reader.read(7) != 1u << 6)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            rgba[i * 4 + 0] = 255;
+            rgba[i * 4 + 1] = 0;
+            rgba[i * 4 + 2] = 255;
+            rgba[i * 4 + 3] = 255;
+        }
+        return;
+    }
+
+    int e0[4];
+    int e1[4];
+    for (int ch = 0; ch < 4; ++ch)
+    {
+        e0[ch] = static_cast<int>(reader.read(7));
+        e1[ch] = static_cast<int>(reader.read(7));
+    }
+    const int p0 = static_cast<int>(reader.read(1));
+    const int p1 = static_cast<int>(reader.read(1));
+
+    float palette[16][4];
+    buildBc7Palette(e0, e1, p0, p1, palette);
+    for (int i = 0; i < 16; ++i)
+    {
+        const uint32_t index = reader.read(i == 0 ? 3 : 4);
+        for (int ch = 0; ch < 4; ++ch)
+        {
+            rgba[i * 4 + ch] = static_cast<uint8_t>(palette[index][ch]);
+        }
+    }
+}
+} // namespace
+
+uint32_t getBlockSize(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+uint32_t getCompressedSize(BlockFormat format, uint32_t width, uint32_t height)
+{
+    return ((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+}
+
+void compressBlock(BlockFormat format, BlockQuality quality, const uint8_t rgba[64], uint8_t* output)
+{
+    BlockPixels px;
+    loadBlock(rgba, px);
+
+    switch (format)
+    {
+        case BlockFormat::BC1:
+            compressBc1(px, quality, true, false, output);
+            break;
+        case BlockFormat::BC3:
+            compressBc4(px, 3, quality, output);
+            compressBc1(px, quality, false, true, output + 8);
+            break;
+        case BlockFormat::BC4:
+            compressBc4(px, 0, quality, output);
+            break;
+        case BlockFormat::BC5:
+            compressBc4(px, 0, quality, output);
+            compressBc4(px, 1, quality, output + 8);
+            break;
+        case BlockFormat::BC7:
+            compressBc7(px, quality, output);
+            break;
+    }
+}
+
+void decompressBlock(BlockFormat format, const uint8_t* block, uint8_t rgba[64])
+{
+    switch (format)
+    {
+        case BlockFormat::BC1:
+            decompressBc1(block, false, rgba);
+            break;
+        case BlockFormat::BC3:
+            decompressBc1(block + 8, true, rgba);
+            decompressBc4(block, 3, rgba);
+            break;
+        case BlockFormat::BC4:
+            memset(rgba, 0, 64);
+            decompressBc4(block, 0, rgba);
+            for (int i = 0; i < 16; ++i)
+            {
+                rgba[i * 4 + 3] = 255;
+            }
+            break;
+        case BlockFormat::BC5:
+            memset(rgba, 0, 64);
+            decompressBc4(block, 0, rgba);
+            decompressBc4(block + 8, 1, rgba);
+            for (int i = 0; i < 16; ++i)
+            {
+                rgba[i * 4 + 3] = 255;
+            }
+            break;
+        case BlockFormat::BC7:
+            decompressBc7(block, rgba);
+            break;
+    }
+}
+
+void compressImage(ThreadPool* threadPool, BlockFormat format, BlockQuality quality, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output)
+{
+    const uint32_t blocksX   = (width + 3) / 4;
+    const uint32_t blocksY   = (height + 3) / 4;
+    const uint32_t blockSize = getBlockSize(format);
+
+    auto compressRows = [=](uint32_t begin, uint32_t end) {
+        uint8_t block[64];
+        for (uint32_t by = begin; by < end; ++by)
+        {
+            for (uint32_t bx = 0; bx < blocksX; ++bx)
+            {
+                for (uint32_t y = 0; y < 4; ++y)
+                {
+                    const uint32_t srcY = std::min(by * 4 + y, height - 1);
+                    for (uint32_t x = 0; x < 4; ++x)
+                    {
+                        const uint32_t srcX = std::min(bx * 4 + x, width - 1);
+                        memcpy(block + (y * 4 + x) * 4, rgba + (size_t(srcY) * width + srcX) * 4, 4);
+                    }
+                }
+
+                compressBlock(format, quality, block, output + (size_t(by) * blocksX + bx) * blockSize);
+            }
+        }
+    };
+
+    if (threadPool)
+    {
+        threadPool->parallelFor(blocksY, 1, compressRows);
+    }
+    else
+    {
+        compressRows(0, blocksY);
+    }
+}
+
+void decompressImage(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba)
+{
+    const uint32_t blocksX   = (width + 3) / 4;
+    const uint32_t blocksY   = (height + 3) / 4;
+    const uint32_t blockSize = getBlockSize(format);
+
+    uint8_t block[64];
+    for (uint32_t by = 0; by < blocksY; ++by)
+    {
+        for (uint32_t bx = 0; bx < blocksX; ++bx)
+        {
+            decompressBlock(format, blocks + (size_t(by) * blocksX + bx) * blockSize, block);
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+            {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+                {
+                    memcpy(rgba + (size_t(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+}
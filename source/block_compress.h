@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include <cstdint>
+
+class ThreadPool;
+
+// BC 块压缩格式，编码器输入统一为 RGBA8
+// BC4 只使用 R 通道，BC5 使用 RG 通道（法线贴图），BC7 只输出 mode 6（单分区 RGBA）
+enum class BlockFormat
+{
+    BC1,
+    BC3,
+    BC4,
+    BC5,
+    BC7,
+};
+
+enum class BlockQuality
+{
+    Fast,    // 主成分方向求端点，只做一次索引匹配
+    Quality, // 最小二乘迭代优化端点，BC4/BC7 额外搜索模式和 p-bit
+};
+
+// 每个 4x4 块的字节数：BC1/BC4 为8，其他为16
+uint32_t getBlockSize(BlockFormat format);
+
+// 压缩后的数据大小，宽高不是4的倍数时按整块计算
+uint32_t getCompressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+// rgba 为 4x4 个像素，按行存放，共64字节
+void compressBlock(BlockFormat format, BlockQuality quality, const uint8_t rgba[64], uint8_t* output);
+void decompressBlock(BlockFormat format, const uint8_t* block, uint8_t rgba[64]);
+
+// 压缩整张图片，按块行在线程池中并行，threadPool 为空时在调用线程中执行；右边和下边不足4个像素的块用边缘像素填充
+void compressImage(ThreadPool* threadPool, BlockFormat format, BlockQuality quality, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output);
+
+// 解压整张图片到 RGBA8，用于计算压缩误差
+void decompressImage(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
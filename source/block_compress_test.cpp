@@ -0,0 +1,125 @@
+﻿#include "block_compress.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+// 块压缩的回归测试：压缩后经 decompressBlock 解码，比较误差
+namespace {
+int g_failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        ++g_failures;
+    }
+}
+
+// 解码后 RGB 的均方误差
+double colorError(BlockFormat format, BlockQuality quality, const uint8_t rgba[64])
+{
+    uint8_t block[16];
+    uint8_t decoded[64];
+    compressBlock(format, quality, rgba, block);
+    decompressBlock(format, block, decoded);
+
+    double error = 0.0;
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            const double d = double(rgba[i * 4 + ch]) - double(decoded[i * 4 + ch]);
+            error += d * d;
+        }
+    }
+    return error / 48.0;
+}
+
+// 每块只有三种颜色，其中一种是另外两种的中点，3色模式的编码误差最小
+void makeThreeLevelBlock(std::mt19937& random, uint8_t rgba[64])
+{
+    std::uniform_int_distribution<int> value(0, 255);
+    std::uniform_int_distribution<int> level(0, 2);
+    int a[3];
+    int b[3];
+    for (int ch = 0; ch < 3; ++ch)
+    {
+        a[ch] = value(random);
+        b[ch] = value(random);
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+        const int l = level(random);
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            rgba[i * 4 + ch] = static_cast<uint8_t>(l == 0 ? a[ch] : l == 1 ? b[ch] : (a[ch] + b[ch]) / 2);
+        }
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+// BC3 的颜色块总是按4色模式解码，Quality 的误差不能比 Fast 大，写出的端点必须满足 c0 >= c1
+void testBc3ColorQuality()
+{
+    constexpr int kBlocks = 5000;
+    std::mt19937 random(12345);
+
+    double fastError    = 0.0;
+    double qualityError = 0.0;
+    int swappedBlocks   = 0;
+    for (int n = 0; n < kBlocks; ++n)
+    {
+        uint8_t rgba[64];
+        makeThreeLevelBlock(random, rgba);
+        fastError += colorError(BlockFormat::BC3, BlockQuality::Fast, rgba);
+        qualityError += colorError(BlockFormat::BC3, BlockQuality::Quality, rgba);
+
+        uint8_t block[16];
+        compressBlock(BlockFormat::BC3, BlockQuality::Quality, rgba, block);
+        const int c0 = block[8] | block[9] << 8;
+        const int c1 = block[10] | block[11] << 8;
+        swappedBlocks += c0 < c1 ? 1 : 0;
+    }
+
+    printf("BC3 color MSE: fast %.2f, quality %.2f, c0 < c1 in %d / %d blocks\n", fastError / kBlocks, qualityError / kBlocks, swappedBlocks, kBlocks);
+    check(qualityError <= fastError, "BC3 quality error <= fast error");
+    check(swappedBlocks == 0, "BC3 color endpoints keep c0 >= c1");
+}
+
+// BC1 的 Quality 可以使用3色模式，同样不能比 Fast 差
+void testBc1ColorQuality()
+{
+    constexpr int kBlocks = 5000;
+    std::mt19937 random(54321);
+
+    double fastError    = 0.0;
+    double qualityError = 0.0;
+    for (int n = 0; n < kBlocks; ++n)
+    {
+        uint8_t rgba[64];
+        makeThreeLevelBlock(random, rgba);
+        fastError += colorError(BlockFormat::BC1, BlockQuality::Fast, rgba);
+        qualityError += colorError(BlockFormat::BC1, BlockQuality::Quality, rgba);
+    }
+
+    printf("BC1 color MSE: fast %.2f, quality %.2f\n", fastError / kBlocks, qualityError / kBlocks);
+    check(qualityError <= fastError, "BC1 quality error <= fast error");
+}
+} // namespace
+
+int main()
+{
+    testBc3ColorQuality();
+    testBc1ColorQuality();
+
+    if (g_failures != 0)
+    {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    printf("all passed\n");
+    return EXIT_SUCCESS;
+}
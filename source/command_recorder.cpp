@@ -0,0 +1,581 @@
+﻿#include "command_recorder.h"
+
+#include <algorithm>
+#include <cstring>
+
+CommandRecorder::~CommandRecorder()
+{
+    close();
+}
+
+bool CommandRecorder::open(const char* filePath, uint16_t width, uint16_t height)
+{
+    close();
+
+    m_file = fopen(filePath, "wb");
+    if (!m_file)
+    {
+        return false;
+    }
+
+    m_stats = Stats();
+    m_buffer.clear();
+    m_buffer.reserve(kFlushSize * 2);
+
+    FileHeader header {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version    = kVersion;
+    header.apiVersion = BGFX_API_VERSION;
+    header.width      = width;
+    header.height     = height;
+    write(header);
+    return true;
+}
+
+void CommandRecorder::close()
+{
+    if (m_file)
+    {
+        flush();
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+bgfx::VertexBufferHandle CommandRecorder::createVertexBuffer(const bgfx::Memory* mem, const bgfx::VertexLayout& layout, uint16_t flags)
+{
+    // 先记录数据，bgfx 可能在创建时就释放 mem
+    const size_t position = m_buffer.size();
+    if (isOpen())
+    {
+        beginCommand(Op::CreateVertexBuffer);
+        write(uint16_t(0));
+        write(layout);
+        writeMemory(mem);
+        write(flags);
+    }
+
+    const bgfx::VertexBufferHandle handle = bgfx::createVertexBuffer(mem, layout, flags);
+    if (isOpen())
+    {
+        memcpy(&m_buffer[position + 1], &handle.idx, sizeof(handle.idx));
+    }
+    return handle;
+}
+
+bgfx::IndexBufferHandle CommandRecorder::createIndexBuffer(const bgfx::Memory* mem, uint16_t flags)
+{
+    const size_t position = m_buffer.size();
+    if (isOpen())
+    {
+        beginCommand(Op::CreateIndexBuffer);
+        write(uint16_t(0));
+        writeMemory(mem);
+        write(flags);
+    }
+
+    const bgfx::IndexBufferHandle handle = bgfx::createIndexBuffer(mem, flags);
+    if (isOpen())
+    {
+        memcpy(&m_buffer[position + 1], &handle.idx, sizeof(handle.idx));
+    }
+    return handle;
+}
+
+bgfx::DynamicVertexBufferHandle CommandRecorder::createDynamicVertexBuffer(const bgfx::Memory* mem, const bgfx::VertexLayout& layout, uint16_t flags)
+{
+    const size_t position = m_buffer.size();
+    if (isOpen())
+    {
+        beginCommand(Op::CreateDynamicVertexBuffer);
+        write(uint16_t(0));
+        write(layout);
+        writeMemory(mem);
+        write(flags);
+    }
+
+    const bgfx::DynamicVertexBufferHandle handle = bgfx::createDynamicVertexBuffer(mem, layout, flags);
+    if (isOpen())
+    {
+        memcpy(&m_buffer[position + 1], &handle.idx, sizeof(handle.idx));
+    }
+    return handle;
+}
+
+bgfx::DynamicIndexBufferHandle CommandRecorder::createDynamicIndexBuffer(const bgfx::Memory* mem, uint16_t flags)
+{
+    const size_t position = m_buffer.size();
+    if (isOpen())
+    {
+        beginCommand(Op::CreateDynamicIndexBuffer);
+        write(uint16_t(0));
+        writeMemory(mem);
+        write(flags);
+    }
+
+    const bgfx::DynamicIndexBufferHandle handle = bgfx::createDynamicIndexBuffer(mem, flags);
+    if (isOpen())
+    {
+        memcpy(&m_buffer[position + 1], &handle.idx, sizeof(handle.idx));
+    }
+    return handle;
+}
+
+void CommandRecorder::update(bgfx::DynamicVertexBufferHandle handle, uint32_t startVertex, const bgfx::Memory* mem)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::UpdateDynamicVertexBuffer);
+        write(handle.idx);
+        write(startVertex);
+        writeMemory(mem);
+    }
+    bgfx::update(handle, startVertex, mem);
+}
+
+void CommandRecorder::update(bgfx::DynamicIndexBufferHandle handle, uint32_t startIndex, const bgfx::Memory* mem)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::UpdateDynamicIndexBuffer);
+        write(handle.idx);
+        write(startIndex);
+        writeMemory(mem);
+    }
+    bgfx::update(handle, startIndex, mem);
+}
+
+bgfx::ShaderHandle CommandRecorder::createShader(const char* fileName, const bgfx::Memory* mem)
+{
+    const size_t position = m_buffer.size();
+    if (isOpen())
+    {
+        beginCommand(Op::CreateShader);
+        write(uint16_t(0));
+        writeString(fileName);
+        writeMemory(mem);
+    }
+
+    const bgfx::ShaderHandle handle = bgfx::createShader(mem);
+    if (isOpen())
+    {
+        memcpy(&m_buffer[position + 1], &handle.idx, sizeof(handle.idx));
+    }
+    return handle;
+}
+
+bgfx::ProgramHandle CommandRecorder::createProgram(bgfx::ShaderHandle vsh, bgfx::ShaderHandle fsh, bool destroyShaders)
+{
+    const bgfx::ProgramHandle handle = bgfx::createProgram(vsh, fsh, destroyShaders);
+    if (isOpen())
+    {
+        beginCommand(Op::CreateProgram);
+        write(handle.idx);
+        write(vsh.idx);
+        write(fsh.idx);
+        write(uint8_t(destroyShaders));
+    }
+    return handle;
+}
+
+bgfx::TextureHandle CommandRecorder::createTexture2D(
+    uint16_t width,
+    uint16_t height,
+    bool hasMips,
+    uint16_t numLayers,
+    bgfx::TextureFormat::Enum format,
+    uint64_t flags,
+    const bgfx::Memory* mem
+)
+{
+    const size_t position = m_buffer.size();
+    if (isOpen())
+    {
+        beginCommand(Op::CreateTexture2D);
+        write(uint16_t(0));
+        write(width);
+        write(height);
+        write(uint8_t(hasMips));
+        write(numLayers);
+        write(uint8_t(format));
+        write(flags);
+        writeMemory(mem);
+    }
+
+    const bgfx::TextureHandle handle = bgfx::createTexture2D(width, height, hasMips, numLayers, format, flags, mem);
+    if (isOpen())
+    {
+        memcpy(&m_buffer[position + 1], &handle.idx, sizeof(handle.idx));
+    }
+    return handle;
+}
+
+bgfx::FrameBufferHandle CommandRecorder::createFrameBuffer(uint8_t num, const bgfx::TextureHandle* handles, bool destroyTextures)
+{
+    const bgfx::FrameBufferHandle handle = bgfx::createFrameBuffer(num, handles, destroyTextures);
+    if (isOpen())
+    {
+        beginCommand(Op::CreateFrameBuffer);
+        write(handle.idx);
+        write(num);
+        for (uint8_t i = 0; i < num; ++i)
+        {
+            write(handles[i].idx);
+        }
+        write(uint8_t(destroyTextures));
+    }
+    return handle;
+}
+
+bgfx::UniformHandle CommandRecorder::createUniform(const char* name, bgfx::UniformType::Enum type, uint16_t num)
+{
+    const bgfx::UniformHandle handle = bgfx::createUniform(name, type, num);
+    if (!bgfx::isValid(handle))
+    {
+        return handle;
+    }
+
+    // 关闭录制时也要记录，之后打开录制还会用到
+    if (handle.idx >= m_uniforms.size())
+    {
+        m_uniforms.resize(size_t(handle.idx) + 1);
+    }
+    UniformInfo& info = m_uniforms[handle.idx];
+    switch (type)
+    {
+        case bgfx::UniformType::Vec4:
+            info.elementSize = sizeof(float) * 4;
+            break;
+        case bgfx::UniformType::Mat3:
+            info.elementSize = sizeof(float) * 9;
+            break;
+        case bgfx::UniformType::Mat4:
+            info.elementSize = sizeof(float) * 16;
+            break;
+        default:
+            // Sampler 的值是纹理单元
+            info.elementSize = sizeof(int32_t);
+            break;
+    }
+    info.num = num;
+
+    if (isOpen())
+    {
+        beginCommand(Op::CreateUniform);
+        write(handle.idx);
+        writeString(name);
+        write(uint8_t(type));
+        write(num);
+    }
+    return handle;
+}
+
+void CommandRecorder::destroy(bgfx::VertexBufferHandle handle)
+{
+    writeDestroy(HandleType::VertexBuffer, handle.idx);
+    bgfx::destroy(handle);
+}
+
+void CommandRecorder::destroy(bgfx::IndexBufferHandle handle)
+{
+    writeDestroy(HandleType::IndexBuffer, handle.idx);
+    bgfx::destroy(handle);
+}
+
+void CommandRecorder::destroy(bgfx::DynamicVertexBufferHandle handle)
+{
+    writeDestroy(HandleType::DynamicVertexBuffer, handle.idx);
+    bgfx::destroy(handle);
+}
+
+void CommandRecorder::destroy(bgfx::DynamicIndexBufferHandle handle)
+{
+    writeDestroy(HandleType::DynamicIndexBuffer, handle.idx);
+    bgfx::destroy(handle);
+}
+
+void CommandRecorder::destroy(bgfx::ShaderHandle handle)
+{
+    writeDestroy(HandleType::Shader, handle.idx);
+    bgfx::destroy(handle);
+}
+
+void CommandRecorder::destroy(bgfx::ProgramHandle handle)
+{
+    writeDestroy(HandleType::Program, handle.idx);
+    bgfx::destroy(handle);
+}
+
+void CommandRecorder::destroy(bgfx::TextureHandle handle)
+{
+    writeDestroy(HandleType::Texture, handle.idx);
+    bgfx::destroy(handle);
+}
+
+void CommandRecorder::destroy(bgfx::FrameBufferHandle handle)
+{
+    writeDestroy(HandleType::FrameBuffer, handle.idx);
+    bgfx::destroy(handle);
+}
+
+void CommandRecorder::destroy(bgfx::UniformHandle handle)
+{
+    writeDestroy(HandleType::Uniform, handle.idx);
+    bgfx::destroy(handle);
+}
+
+void CommandRecorder::setViewName(bgfx::ViewId view, const char* name)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetViewName);
+        write(view);
+        writeString(name);
+    }
+    bgfx::setViewName(view, name);
+}
+
+void CommandRecorder::setViewClear(bgfx::ViewId view, uint16_t flags, uint32_t rgba, float depth, uint8_t stencil)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetViewClear);
+        write(view);
+        write(flags);
+        write(rgba);
+        write(depth);
+        write(stencil);
+    }
+    bgfx::setViewClear(view, flags, rgba, depth, stencil);
+}
+
+void CommandRecorder::setViewRect(bgfx::ViewId view, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetViewRect);
+        write(view);
+        write(x);
+        write(y);
+        write(width);
+        write(height);
+    }
+    bgfx::setViewRect(view, x, y, width, height);
+}
+
+void CommandRecorder::setViewTransform(bgfx::ViewId view, const float* viewMtx, const float* projMtx)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetViewTransform);
+        write(view);
+        write(uint8_t((viewMtx ? 1 : 0) | (projMtx ? 2 : 0)));
+        if (viewMtx)
+        {
+            writeBytes(viewMtx, sizeof(float) * 16);
+        }
+        if (projMtx)
+        {
+            writeBytes(projMtx, sizeof(float) * 16);
+        }
+    }
+    bgfx::setViewTransform(view, viewMtx, projMtx);
+}
+
+void CommandRecorder::setViewFrameBuffer(bgfx::ViewId view, bgfx::FrameBufferHandle handle)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetViewFrameBuffer);
+        write(view);
+        write(handle.idx);
+    }
+    bgfx::setViewFrameBuffer(view, handle);
+}
+
+void CommandRecorder::touch(bgfx::ViewId view)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::Touch);
+        write(view);
+    }
+    bgfx::touch(view);
+}
+
+void CommandRecorder::setTransform(const float* mtx, uint16_t num)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetTransform);
+        write(num);
+        writeBytes(mtx, sizeof(float) * 16 * num);
+    }
+    bgfx::setTransform(mtx, num);
+}
+
+void CommandRecorder::setVertexBuffer(uint8_t stream, bgfx::VertexBufferHandle handle, uint32_t startVertex, uint32_t numVertices)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetVertexBuffer);
+        write(stream);
+        write(handle.idx);
+        write(startVertex);
+        write(numVertices);
+    }
+    bgfx::setVertexBuffer(stream, handle, startVertex, numVertices);
+}
+
+void CommandRecorder::setVertexBuffer(uint8_t stream, bgfx::DynamicVertexBufferHandle handle, uint32_t startVertex, uint32_t numVertices)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetDynamicVertexBuffer);
+        write(stream);
+        write(handle.idx);
+        write(startVertex);
+        write(numVertices);
+    }
+    bgfx::setVertexBuffer(stream, handle, startVertex, numVertices);
+}
+
+void CommandRecorder::setIndexBuffer(bgfx::IndexBufferHandle handle, uint32_t firstIndex, uint32_t numIndices)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetIndexBuffer);
+        write(handle.idx);
+        write(firstIndex);
+        write(numIndices);
+    }
+    bgfx::setIndexBuffer(handle, firstIndex, numIndices);
+}
+
+void CommandRecorder::setIndexBuffer(bgfx::DynamicIndexBufferHandle handle, uint32_t firstIndex, uint32_t numIndices)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetDynamicIndexBuffer);
+        write(handle.idx);
+        write(firstIndex);
+        write(numIndices);
+    }
+    bgfx::setIndexBuffer(handle, firstIndex, numIndices);
+}
+
+void CommandRecorder::setState(uint64_t state, uint32_t rgba)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetState);
+        write(state);
+        write(rgba);
+    }
+    bgfx::setState(state, rgba);
+}
+
+void CommandRecorder::setUniform(bgfx::UniformHandle handle, const void* value, uint16_t num)
+{
+    if (isOpen() && handle.idx < m_uniforms.size())
+    {
+        const UniformInfo& info = m_uniforms[handle.idx];
+        const uint16_t count    = num == UINT16_MAX ? info.num : std::min(num, info.num);
+        const uint32_t size     = uint32_t(info.elementSize) * count;
+        beginCommand(Op::SetUniform);
+        write(handle.idx);
+        write(count);
+        write(size);
+        writeBytes(value, size);
+    }
+    bgfx::setUniform(handle, value, num);
+}
+
+void CommandRecorder::setTexture(uint8_t stage, bgfx::UniformHandle sampler, bgfx::TextureHandle handle, uint32_t flags)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::SetTexture);
+        write(stage);
+        write(sampler.idx);
+        write(handle.idx);
+        write(flags);
+    }
+    bgfx::setTexture(stage, sampler, handle, flags);
+}
+
+void CommandRecorder::submit(bgfx::ViewId view, bgfx::ProgramHandle program, uint32_t depth, uint8_t flags)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::Submit);
+        write(view);
+        write(program.idx);
+        write(depth);
+        write(flags);
+    }
+    bgfx::submit(view, program, depth, flags);
+}
+
+uint32_t CommandRecorder::frame(bool capture)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::Frame);
+        ++m_stats.frames;
+        if (m_buffer.size() >= kFlushSize)
+        {
+            flush();
+        }
+    }
+    return bgfx::frame(capture);
+}
+
+void CommandRecorder::beginCommand(Op op)
+{
+    ++m_stats.commands;
+    write(op);
+}
+
+void CommandRecorder::writeBytes(const void* data, uint32_t size)
+{
+    const auto bytes = static_cast<const uint8_t*>(data);
+    m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+}
+
+void CommandRecorder::writeString(const char* str)
+{
+    const uint16_t length = str ? static_cast<uint16_t>(strlen(str)) : 0;
+    write(length);
+    writeBytes(str, length);
+}
+
+void CommandRecorder::writeMemory(const bgfx::Memory* mem)
+{
+    const uint32_t size = mem ? mem->size : 0;
+    write(size);
+    if (size > 0)
+    {
+        writeBytes(mem->data, size);
+    }
+}
+
+void CommandRecorder::writeDestroy(HandleType type, uint16_t idx)
+{
+    if (isOpen())
+    {
+        beginCommand(Op::Destroy);
+        write(type);
+        write(idx);
+    }
+}
+
+void CommandRecorder::flush()
+{
+    if (!m_buffer.empty())
+    {
+        fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+        m_stats.bytes += m_buffer.size();
+        m_buffer.clear();
+    }
+}
@@ -0,0 +1,188 @@
+﻿#pragma once
+
+#include "bgfx/bgfx.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// 录制 bgfx 调用：资源创建、更新、view 设置、变换、uniform、纹理绑定、提交和 frame 写入紧凑的二进制文件，由 bgfx_replay 以最快速度重放。
+// 所有函数和 bgfx 的同名函数参数相同，先记录再转发给 bgfx；没有 open() 时只转发。
+// 用来在不运行应用逻辑的情况下对比 bgfx API 层和各个后端（包括 Noop）的开销，也可以把录下的真实场景拿到离线环境中测试。
+// 只能在调用 bgfx API 的线程中使用，不支持 bgfx::Encoder。数据按本机字节序写入，文件头中记录 BGFX_API_VERSION
+//
+// 文件格式：FileHeader，之后是一串命令，每条命令为1字节的 Op 和它的参数。
+// 句柄只记录 idx，重放时按类型映射到新创建的句柄；bgfx::Memory 记录为 uint32_t 大小和数据。
+// 着色器同时记录文件名和二进制，重放时优先加载重放后端对应目录中的同名文件
+class CommandRecorder
+{
+public:
+    static constexpr char kMagic[8]      = {'B', 'G', 'F', 'X', 'C', 'M', 'D', '\0'};
+    static constexpr uint32_t kVersion   = 1;
+    static constexpr uint32_t kFlushSize = 1 << 20;
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t apiVersion;
+        uint16_t width;
+        uint16_t height;
+        uint32_t reserved;
+    };
+
+    enum class Op : uint8_t
+    {
+        CreateVertexBuffer,        // idx, layout, memory, flags
+        CreateIndexBuffer,         // idx, memory, flags
+        CreateDynamicVertexBuffer, // idx, layout, memory, flags
+        CreateDynamicIndexBuffer,  // idx, memory, flags
+        UpdateDynamicVertexBuffer, // idx, start, memory
+        UpdateDynamicIndexBuffer,  // idx, start, memory
+        CreateShader,              // idx, name, memory
+        CreateProgram,             // idx, vsh, fsh, destroyShaders
+        CreateTexture2D,           // idx, width, height, hasMips, numLayers, format, flags, memory（大小为0表示没有初始数据）
+        CreateFrameBuffer,         // idx, num, textures[num], destroyTextures
+        Destroy,                   // HandleType, idx
+        SetViewName,               // view, name
+        SetViewClear,              // view, flags, rgba, depth, stencil
+        SetViewRect,               // view, x, y, width, height
+        SetViewTransform,          // view, mask（bit0 view，bit1 proj）, 矩阵
+        SetViewFrameBuffer,        // view, idx
+        Touch,                     // view
+        SetTransform,              // num, num 个矩阵
+        SetVertexBuffer,           // stream, idx, start, num
+        SetDynamicVertexBuffer,    // stream, idx, start, num
+        SetIndexBuffer,            // idx, first, num
+        SetDynamicIndexBuffer,     // idx, first, num
+        SetState,                  // state, rgba
+        Submit,                    // view, program, depth, flags
+        Frame,
+        CreateUniform, // idx, name, type, num
+        SetUniform,    // idx, num, uint32_t 大小和数据（大小由创建时的类型和 num 决定）
+        SetTexture,    // stage, sampler, texture, flags
+        Count,
+    };
+
+    enum class HandleType : uint8_t
+    {
+        VertexBuffer,
+        IndexBuffer,
+        DynamicVertexBuffer,
+        DynamicIndexBuffer,
+        Shader,
+        Program,
+        Texture,
+        FrameBuffer,
+        Uniform,
+        Count,
+    };
+
+    struct Stats
+    {
+        uint64_t commands {0};
+        uint64_t frames {0};
+        uint64_t bytes {0}; // 已经写入文件的字节数
+    };
+
+    CommandRecorder() = default;
+    ~CommandRecorder();
+
+    CommandRecorder(const CommandRecorder&)            = delete;
+    CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+    // width、height 为 bgfx::init 的分辨率，重放时使用
+    bool open(const char* filePath, uint16_t width, uint16_t height);
+    void close();
+
+    bool isOpen() const
+    {
+        return m_file != nullptr;
+    }
+
+    const Stats& getStats() const
+    {
+        return m_stats;
+    }
+
+    bgfx::VertexBufferHandle createVertexBuffer(const bgfx::Memory* mem, const bgfx::VertexLayout& layout, uint16_t flags = BGFX_BUFFER_NONE);
+    bgfx::IndexBufferHandle createIndexBuffer(const bgfx::Memory* mem, uint16_t flags = BGFX_BUFFER_NONE);
+    bgfx::DynamicVertexBufferHandle createDynamicVertexBuffer(const bgfx::Memory* mem, const bgfx::VertexLayout& layout, uint16_t flags = BGFX_BUFFER_NONE);
+    bgfx::DynamicIndexBufferHandle createDynamicIndexBuffer(const bgfx::Memory* mem, uint16_t flags = BGFX_BUFFER_NONE);
+    void update(bgfx::DynamicVertexBufferHandle handle, uint32_t startVertex, const bgfx::Memory* mem);
+    void update(bgfx::DynamicIndexBufferHandle handle, uint32_t startIndex, const bgfx::Memory* mem);
+
+    // fileName 为 shaders/<后端>/ 下的文件名，不包括目录
+    bgfx::ShaderHandle createShader(const char* fileName, const bgfx::Memory* mem);
+    bgfx::ProgramHandle createProgram(bgfx::ShaderHandle vsh, bgfx::ShaderHandle fsh, bool destroyShaders = false);
+
+    bgfx::TextureHandle createTexture2D(
+        uint16_t width,
+        uint16_t height,
+        bool hasMips,
+        uint16_t numLayers,
+        bgfx::TextureFormat::Enum format,
+        uint64_t flags          = BGFX_TEXTURE_NONE | BGFX_SAMPLER_NONE,
+        const bgfx::Memory* mem = nullptr
+    );
+    bgfx::FrameBufferHandle createFrameBuffer(uint8_t num, const bgfx::TextureHandle* handles, bool destroyTextures = false);
+    bgfx::UniformHandle createUniform(const char* name, bgfx::UniformType::Enum type, uint16_t num = 1);
+
+    void destroy(bgfx::VertexBufferHandle handle);
+    void destroy(bgfx::IndexBufferHandle handle);
+    void destroy(bgfx::DynamicVertexBufferHandle handle);
+    void destroy(bgfx::DynamicIndexBufferHandle handle);
+    void destroy(bgfx::ShaderHandle handle);
+    void destroy(bgfx::ProgramHandle handle);
+    void destroy(bgfx::TextureHandle handle);
+    void destroy(bgfx::FrameBufferHandle handle);
+    void destroy(bgfx::UniformHandle handle);
+
+    void setViewName(bgfx::ViewId view, const char* name);
+    void setViewClear(bgfx::ViewId view, uint16_t flags, uint32_t rgba = 0x000000ff, float depth = 1.0f, uint8_t stencil = 0);
+    void setViewRect(bgfx::ViewId view, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+    void setViewTransform(bgfx::ViewId view, const float* viewMtx, const float* projMtx);
+    void setViewFrameBuffer(bgfx::ViewId view, bgfx::FrameBufferHandle handle);
+    void touch(bgfx::ViewId view);
+
+    void setTransform(const float* mtx, uint16_t num = 1);
+    void setVertexBuffer(uint8_t stream, bgfx::VertexBufferHandle handle, uint32_t startVertex = 0, uint32_t numVertices = UINT32_MAX);
+    void setVertexBuffer(uint8_t stream, bgfx::DynamicVertexBufferHandle handle, uint32_t startVertex = 0, uint32_t numVertices = UINT32_MAX);
+    void setIndexBuffer(bgfx::IndexBufferHandle handle, uint32_t firstIndex = 0, uint32_t numIndices = UINT32_MAX);
+    void setIndexBuffer(bgfx::DynamicIndexBufferHandle handle, uint32_t firstIndex = 0, uint32_t numIndices = UINT32_MAX);
+    void setState(uint64_t state, uint32_t rgba = 0);
+    // num 为 UINT16_MAX 时使用创建时的个数
+    void setUniform(bgfx::UniformHandle handle, const void* value, uint16_t num = 1);
+    void setTexture(uint8_t stage, bgfx::UniformHandle sampler, bgfx::TextureHandle handle, uint32_t flags = UINT32_MAX);
+    void submit(bgfx::ViewId view, bgfx::ProgramHandle program, uint32_t depth = 0, uint8_t flags = BGFX_DISCARD_ALL);
+
+    // 缓冲超过 kFlushSize 时在这里写入文件
+    uint32_t frame(bool capture = false);
+
+private:
+    void beginCommand(Op op);
+
+    template<typename T>
+    void write(const T& value)
+    {
+        const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void writeBytes(const void* data, uint32_t size);
+    void writeString(const char* str);
+    void writeMemory(const bgfx::Memory* mem);
+    void writeDestroy(HandleType type, uint16_t idx);
+    void flush();
+
+    struct UniformInfo
+    {
+        uint16_t elementSize {0}; // 一个元素的字节数
+        uint16_t num {0};
+    };
+
+    FILE* m_file {nullptr};
+    std::vector<uint8_t> m_buffer;
+    std::vector<UniformInfo> m_uniforms; // 按 idx，setUniform 时计算数据大小
+    Stats m_stats;
+};
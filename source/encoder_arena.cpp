@@ -0,0 +1,121 @@
+﻿#include "encoder_arena.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+// 每个块前面的头，记录块所属的级别，大小为 16 字节以保持返回地址对齐
+struct alignas(16) BlockHeader
+{
+    uint32_t sizeClass;
+};
+
+uint32_t getSizeClass(size_t size, uint32_t minClass)
+{
+    uint32_t sizeClass = minClass;
+    while ((size_t(1) << sizeClass) < size)
+    {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+BlockHeader* getHeader(void* ptr)
+{
+    return static_cast<BlockHeader*>(ptr) - 1;
+}
+} // namespace
+
+EncoderArena::~EncoderArena()
+{
+    trim();
+}
+
+EncoderArena& EncoderArena::current()
+{
+    thread_local EncoderArena arena;
+    return arena;
+}
+
+void* EncoderArena::allocate(size_t size)
+{
+    ++m_stats.allocations;
+
+    const uint32_t sizeClass = getSizeClass(size, kMinClass);
+    if (sizeClass >= kClassCount)
+    {
+        return nullptr;
+    }
+
+    std::vector<void*>& freeBlocks = m_freeBlocks[sizeClass];
+    if (!freeBlocks.empty())
+    {
+        void* ptr = freeBlocks.back();
+        freeBlocks.pop_back();
+        return ptr;
+    }
+
+    const size_t blockSize = sizeof(BlockHeader) + (size_t(1) << sizeClass);
+    auto header            = static_cast<BlockHeader*>(malloc(blockSize));
+    if (!header)
+    {
+        return nullptr;
+    }
+
+    // 空闲列表的容量不小于这一级的块数，释放时 push_back 不会再申请内存
+    if (freeBlocks.capacity() < ++m_blockCounts[sizeClass])
+    {
+        freeBlocks.reserve(size_t(m_blockCounts[sizeClass]) * 2);
+    }
+
+    header->sizeClass = sizeClass;
+    ++m_stats.heapAllocations;
+    m_stats.reservedBytes += blockSize;
+    return header + 1;
+}
+
+void* EncoderArena::reallocate(void* ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return allocate(size);
+    }
+
+    // 块的实际容量够用时原地返回，stb 的可增长数组大部分扩容都走这里
+    const uint32_t sizeClass = getHeader(ptr)->sizeClass;
+    if (size <= (size_t(1) << sizeClass))
+    {
+        ++m_stats.allocations;
+        return ptr;
+    }
+
+    void* result = allocate(size);
+    if (result)
+    {
+        memcpy(result, ptr, size_t(1) << sizeClass);
+        deallocate(ptr);
+    }
+    return result;
+}
+
+void EncoderArena::deallocate(void* ptr)
+{
+    if (ptr)
+    {
+        m_freeBlocks[getHeader(ptr)->sizeClass].push_back(ptr);
+    }
+}
+
+void EncoderArena::trim()
+{
+    for (uint32_t sizeClass = 0; sizeClass < kClassCount; ++sizeClass)
+    {
+        for (void* ptr : m_freeBlocks[sizeClass])
+        {
+            m_stats.reservedBytes -= sizeof(BlockHeader) + (size_t(1) << sizeClass);
+            free(getHeader(ptr));
+        }
+        m_blockCounts[sizeClass] -= static_cast<uint32_t>(m_freeBlocks[sizeClass].size());
+        m_freeBlocks[sizeClass].clear();
+    }
+}
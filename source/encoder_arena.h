@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 编码器临时内存池：按2的幂分级缓存释放的内存块，下次申请相同级别时直接复用。
+// stbi_write_png 每次调用都会申请滤波缓冲、行缓冲、哈希链和输出缓冲，
+// 连续编码相同尺寸的图片时，从第二帧开始不再向系统堆申请内存。
+// 每个线程一个实例（current()），不需要加锁，在哪个线程申请的内存就必须在哪个线程释放
+class EncoderArena
+{
+public:
+    struct Stats
+    {
+        uint64_t allocations {0};     // allocate/reallocate 的总次数
+        uint64_t heapAllocations {0}; // 其中缓存中没有合适的块、向系统堆申请的次数
+        size_t reservedBytes {0};     // 当前从系统堆申请的总字节数（包括缓存中的空闲块）
+    };
+
+    EncoderArena() = default;
+    ~EncoderArena();
+
+    EncoderArena(const EncoderArena&)            = delete;
+    EncoderArena& operator=(const EncoderArena&) = delete;
+
+    // 当前线程的内存池
+    static EncoderArena& current();
+
+    void* allocate(size_t size);
+    void* reallocate(void* ptr, size_t size);
+    void deallocate(void* ptr);
+
+    // 把缓存的空闲块还给系统堆
+    void trim();
+
+    const Stats& getStats() const
+    {
+        return m_stats;
+    }
+
+private:
+    static constexpr uint32_t kMinClass   = 4; // 最小 16 字节
+    static constexpr uint32_t kClassCount = 48;
+
+    std::vector<void*> m_freeBlocks[kClassCount];
+    uint32_t m_blockCounts[kClassCount] {}; // 每一级从系统堆申请的块数（包括正在使用的）
+    Stats m_stats;
+};
+
+// 给 stb_image_write 使用，在包含 stb_image_write.h 之前定义：
+//   #define STBIW_MALLOC(size)       EncoderArena::current().allocate(size)
+//   #define STBIW_REALLOC(ptr, size) EncoderArena::current().reallocate(ptr, size)
+//   #define STBIW_FREE(ptr)          EncoderArena::current().deallocate(ptr)
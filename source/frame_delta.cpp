@@ -0,0 +1,232 @@
+﻿#include "frame_delta.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRAME_DELTA_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr uint64_t kSeed0   = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kSeed1   = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kKey0    = 0xBE4BA423396CFEB8ull;
+constexpr uint64_t kKey1    = 0x1CAD21F72C81017Cull;
+constexpr uint64_t kKeyStep = 0x165667B19E3779F9ull;
+
+uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// splitmix64 的结尾混合
+uint64_t avalanche(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return h;
+}
+
+// 和 XXH3 的累加步骤相同：每 16 字节两个 64 位通道，(数据 ^ 密钥) 的高低 32 位相乘后累加，再加上另一个通道的原始数据。
+// 密钥随块内位置递增，换行时不重置，同一块内交换两段数据或者两行的位置都会得到不同的哈希。SSE2 和标量版本的结果相同
+uint64_t hashTile(const uint8_t* pixels, uint32_t stride, uint32_t rowBytes, uint32_t rows)
+{
+    const uint32_t vectorBytes = rowBytes & ~15u;
+
+#ifdef FRAME_DELTA_SSE2
+    __m128i acc           = _mm_set_epi64x(static_cast<long long>(kSeed1), static_cast<long long>(kSeed0));
+    __m128i key           = _mm_set_epi64x(static_cast<long long>(kKey1), static_cast<long long>(kKey0));
+    const __m128i keyStep = _mm_set1_epi64x(static_cast<long long>(kKeyStep));
+#else
+    auto load64 = [](const uint8_t* p) {
+        uint64_t value;
+        memcpy(&value, p, 8);
+        return value;
+    };
+    uint64_t acc0 = kSeed0;
+    uint64_t acc1 = kSeed1;
+    uint64_t key0 = kKey0;
+    uint64_t key1 = kKey1;
+#endif
+    uint64_t tail = 0;
+
+    for (uint32_t y = 0; y < rows; ++y)
+    {
+        const uint8_t* row = pixels + size_t(y) * stride;
+
+#ifdef FRAME_DELTA_SSE2
+        for (uint32_t x = 0; x < vectorBytes; x += 16)
+        {
+            const __m128i data    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            const __m128i dataKey = _mm_xor_si128(data, key);
+            const __m128i product = _mm_mul_epu32(dataKey, _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+            acc                   = _mm_add_epi64(acc, _mm_add_epi64(product, _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2))));
+            key                   = _mm_add_epi64(key, keyStep);
+        }
+#else
+        for (uint32_t x = 0; x < vectorBytes; x += 16)
+        {
+            const uint64_t data0 = load64(row + x);
+            const uint64_t data1 = load64(row + x + 8);
+            const uint64_t dk0   = data0 ^ key0;
+            const uint64_t dk1   = data1 ^ key1;
+            acc0 += (dk0 & 0xFFFFFFFFu) * (dk0 >> 32) + data1;
+            acc1 += (dk1 & 0xFFFFFFFFu) * (dk1 >> 32) + data0;
+            key0 += kKeyStep;
+            key1 += kKeyStep;
+        }
+#endif
+
+        // 每行剩下不到 16 字节（3通道等情况）逐字节混入
+        for (uint32_t x = vectorBytes; x < rowBytes; ++x)
+        {
+            tail = (tail ^ row[x]) * 0x100000001B3ull;
+        }
+    }
+
+#ifdef FRAME_DELTA_SSE2
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    const uint64_t acc0 = lanes[0];
+    const uint64_t acc1 = lanes[1];
+#endif
+
+    return avalanche(acc0 ^ rotl64(acc1, 31) ^ rotl64(tail, 17) ^ (uint64_t(rowBytes) << 32 | rows));
+}
+} // namespace
+
+FrameDelta::FrameDelta(uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t tileSize)
+    : m_width(width)
+    , m_height(height)
+    , m_bytesPerPixel(bytesPerPixel)
+    , m_tileSize(std::max(tileSize, 1u))
+{
+    m_tilesX = (m_width + m_tileSize - 1) / m_tileSize;
+    m_tilesY = (m_height + m_tileSize - 1) / m_tileSize;
+    m_hashes.resize(size_t(m_tilesX) * m_tilesY);
+    m_changed.resize(m_hashes.size());
+    m_changedTiles.reserve(m_hashes.size());
+}
+
+uint32_t FrameDelta::update(ThreadPool* threadPool, const uint8_t* pixels, uint32_t stride)
+{
+    stride = stride ? stride : m_width * m_bytesPerPixel;
+
+    auto hashRows = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t ty = begin; ty < end; ++ty)
+        {
+            const uint32_t y      = ty * m_tileSize;
+            const uint32_t height = std::min(m_tileSize, m_height - y);
+            for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+            {
+                const uint32_t x     = tx * m_tileSize;
+                const uint32_t width = std::min(m_tileSize, m_width - x);
+                const uint64_t hash  = hashTile(pixels + size_t(y) * stride + size_t(x) * m_bytesPerPixel, stride, width * m_bytesPerPixel, height);
+
+                const size_t index = size_t(ty) * m_tilesX + tx;
+                m_changed[index]   = !m_hasPrevious || m_hashes[index] != hash;
+                m_hashes[index]    = hash;
+            }
+        }
+    };
+
+    if (threadPool)
+    {
+        threadPool->parallelFor(m_tilesY, 1, hashRows);
+    }
+    else
+    {
+        hashRows(0, m_tilesY);
+    }
+    m_hasPrevious = true;
+
+    // 收集变化的块和包围矩形
+    m_changedTiles.clear();
+    uint32_t minX  = UINT32_MAX;
+    uint32_t minY  = UINT32_MAX;
+    uint32_t maxX  = 0;
+    uint32_t maxY  = 0;
+    uint64_t bytes = 0;
+    for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+    {
+        for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+        {
+            if (!m_changed[size_t(ty) * m_tilesX + tx])
+            {
+                continue;
+            }
+
+            Tile tile;
+            tile.x      = static_cast<uint16_t>(tx * m_tileSize);
+            tile.y      = static_cast<uint16_t>(ty * m_tileSize);
+            tile.width  = static_cast<uint16_t>(std::min(m_tileSize, m_width - tile.x));
+            tile.height = static_cast<uint16_t>(std::min(m_tileSize, m_height - tile.y));
+            m_changedTiles.push_back(tile);
+
+            minX = std::min<uint32_t>(minX, tile.x);
+            minY = std::min<uint32_t>(minY, tile.y);
+            maxX = std::max<uint32_t>(maxX, tile.x + tile.width);
+            maxY = std::max<uint32_t>(maxY, tile.y + tile.height);
+            bytes += uint64_t(tile.width) * tile.height * m_bytesPerPixel;
+        }
+    }
+
+    m_dirtyBounds = {};
+    if (!m_changedTiles.empty())
+    {
+        m_dirtyBounds.x      = static_cast<uint16_t>(minX);
+        m_dirtyBounds.y      = static_cast<uint16_t>(minY);
+        m_dirtyBounds.width  = static_cast<uint16_t>(maxX - minX);
+        m_dirtyBounds.height = static_cast<uint16_t>(maxY - minY);
+    }
+
+    m_stats.frames += 1;
+    m_stats.skippedFrames += m_changedTiles.empty() ? 1 : 0;
+    m_stats.tiles += m_hashes.size();
+    m_stats.changedTiles += m_changedTiles.size();
+    m_stats.inputBytes += uint64_t(m_width) * m_height * m_bytesPerPixel;
+    m_stats.changedBytes += bytes;
+    return static_cast<uint32_t>(m_changedTiles.size());
+}
+
+bool FrameDelta::writeChangedTiles(const uint8_t* pixels, uint32_t stride, const Sink& sink)
+{
+    stride = stride ? stride : m_width * m_bytesPerPixel;
+
+    const uint32_t header[2] = {static_cast<uint32_t>(m_stats.frames - 1), static_cast<uint32_t>(m_changedTiles.size())};
+    if (!sink(reinterpret_cast<const uint8_t*>(header), sizeof(header)))
+    {
+        return false;
+    }
+
+    // 每块先拷贝成紧密排列，一次交给 sink
+    m_tileBuffer.resize(8 + size_t(m_tileSize) * m_tileSize * m_bytesPerPixel);
+    for (const Tile& tile : m_changedTiles)
+    {
+        const uint16_t rect[4] = {tile.x, tile.y, tile.width, tile.height};
+        memcpy(m_tileBuffer.data(), rect, sizeof(rect));
+
+        const size_t rowBytes = size_t(tile.width) * m_bytesPerPixel;
+        uint8_t* dst          = m_tileBuffer.data() + sizeof(rect);
+        for (uint32_t row = 0; row < tile.height; ++row)
+        {
+            memcpy(dst + row * rowBytes, pixels + (size_t(tile.y) + row) * stride + size_t(tile.x) * m_bytesPerPixel, rowBytes);
+        }
+
+        if (!sink(m_tileBuffer.data(), sizeof(rect) + rowBytes * tile.height))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrameDelta::reset()
+{
+    m_hasPrevious = false;
+}
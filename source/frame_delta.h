@@ -0,0 +1,83 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class ThreadPool;
+
+// 帧差分：把图片分成固定大小的块，每块计算一个 64 位哈希（SSE2），和上一帧的哈希比较，
+// 只保留变化的块。静止画面的长时间录制中大部分帧完全不变或者只有很小的区域变化，
+// 可以整帧跳过，或者只编码变化区域的包围矩形（类似 APNG 的部分帧），或者只写出变化的块
+class FrameDelta
+{
+public:
+    struct Tile
+    {
+        uint16_t x {0}; // 像素坐标
+        uint16_t y {0};
+        uint16_t width {0};
+        uint16_t height {0};
+    };
+
+    struct Stats
+    {
+        uint64_t frames {0};
+        uint64_t skippedFrames {0}; // 完全没有变化的帧
+        uint64_t tiles {0};
+        uint64_t changedTiles {0};
+        uint64_t inputBytes {0};   // 输入的总字节数
+        uint64_t changedBytes {0}; // 其中变化的块的字节数，差值就是节省的数据量
+    };
+
+    // 输出回调，返回 false 时停止写入
+    using Sink = std::function<bool(const uint8_t* data, size_t size)>;
+
+    FrameDelta(uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t tileSize = 64);
+
+    // 计算各块的哈希并和上一帧比较，返回变化的块的个数。第一帧和 reset() 之后的一帧全部视为变化。
+    // 按块行在线程池中并行，threadPool 为空时在调用线程中执行
+    uint32_t update(ThreadPool* threadPool, const uint8_t* pixels, uint32_t stride);
+
+    // 最近一次 update() 中变化的块
+    const std::vector<Tile>& getChangedTiles() const
+    {
+        return m_changedTiles;
+    }
+
+    // 变化的块的包围矩形，没有变化时宽高为0
+    Tile getDirtyBounds() const
+    {
+        return m_dirtyBounds;
+    }
+
+    // 把最近一次 update() 中变化的块写入 sink：
+    // 帧头 {uint32 帧序号, uint32 块数}，之后每块 {uint16 x, y, width, height} + 紧密排列的像素，数值为小端。
+    // pixels 必须和 update() 传入的相同
+    bool writeChangedTiles(const uint8_t* pixels, uint32_t stride, const Sink& sink);
+
+    // 丢弃上一帧的哈希，下一帧全部视为变化（例如切换场景或者输出文件时）
+    void reset();
+
+    const Stats& getStats() const
+    {
+        return m_stats;
+    }
+
+private:
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_bytesPerPixel;
+    uint32_t m_tileSize;
+    uint32_t m_tilesX;
+    uint32_t m_tilesY;
+    bool m_hasPrevious {false};
+
+    std::vector<uint64_t> m_hashes;
+    std::vector<uint8_t> m_changed;
+    std::vector<Tile> m_changedTiles;
+    std::vector<uint8_t> m_tileBuffer;
+    Tile m_dirtyBounds;
+    Stats m_stats;
+};
@@ -0,0 +1,87 @@
+﻿#include "frame_delta.h"
+#include "thread_pool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// FrameDelta 的回归测试：块内的内容移动位置时必须检测到变化
+namespace {
+int g_failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        ++g_failures;
+    }
+}
+
+// 在一帧空白图片的第 row 行画一条横线
+std::vector<uint8_t> makeFrame(uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t row)
+{
+    std::vector<uint8_t> pixels(size_t(width) * height * bytesPerPixel, 0);
+    for (uint32_t x = 0; x < width * bytesPerPixel; ++x)
+    {
+        pixels[size_t(row) * width * bytesPerPixel + x] = 0xFF;
+    }
+    return pixels;
+}
+
+void testMoveRow(ThreadPool* threadPool, uint32_t bytesPerPixel, const char* name)
+{
+    constexpr uint32_t kSize = 64;
+    FrameDelta delta(kSize, kSize, bytesPerPixel, kSize);
+
+    const auto first  = makeFrame(kSize, kSize, bytesPerPixel, 10);
+    const auto second = makeFrame(kSize, kSize, bytesPerPixel, 40);
+
+    printf("%s\n", name);
+    check(delta.update(threadPool, first.data(), 0) == 1, "first frame is changed");
+    check(delta.update(threadPool, first.data(), 0) == 0, "same frame is unchanged");
+    check(delta.update(threadPool, second.data(), 0) == 1, "row moved inside the tile is changed");
+    check(delta.update(threadPool, first.data(), 0) == 1, "row moved back is changed");
+}
+
+// 交换块内相邻两行（内容不同），只改变位置
+void testSwapRows(uint32_t bytesPerPixel, const char* name)
+{
+    constexpr uint32_t kSize = 32;
+    FrameDelta delta(kSize, kSize, bytesPerPixel, kSize);
+
+    const size_t rowBytes = size_t(kSize) * bytesPerPixel;
+    std::vector<uint8_t> pixels(rowBytes * kSize);
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        pixels[i] = static_cast<uint8_t>(i * 7 + i / rowBytes);
+    }
+    std::vector<uint8_t> swapped = pixels;
+    std::copy(pixels.begin() + rowBytes * 3, pixels.begin() + rowBytes * 4, swapped.begin() + rowBytes * 5);
+    std::copy(pixels.begin() + rowBytes * 5, pixels.begin() + rowBytes * 6, swapped.begin() + rowBytes * 3);
+
+    printf("%s\n", name);
+    check(delta.update(nullptr, pixels.data(), 0) == 1, "first frame is changed");
+    check(delta.update(nullptr, swapped.data(), 0) == 1, "swapped rows are changed");
+}
+} // namespace
+
+int main()
+{
+    ThreadPool threadPool;
+
+    testMoveRow(nullptr, 4, "move row, RGBA");
+    testMoveRow(&threadPool, 4, "move row, RGBA, thread pool");
+    testMoveRow(nullptr, 3, "move row, RGB");
+    testMoveRow(nullptr, 1, "move row, R8");
+    testSwapRows(4, "swap rows, RGBA");
+    testSwapRows(3, "swap rows, RGB");
+
+    if (g_failures != 0)
+    {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    printf("all passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+﻿/*
+ * 图片解码性能测试
+ * image_bench [-n 次数] [-j 线程数] [-e] [-o result.json] a.png b.jpg c.qoi ...
+ * 对每张图片重复调用 stbi_load_from_memory（.qoi 调用 qoiDecode），输出单张图片的解码耗时和吞吐量
+ * -j 大于 1 时，大尺寸 JPEG 的 IDCT 和颜色转换在线程池中并行执行
+ * -e 时改为比较截图保存格式：解码得到 RGBA 像素后，分别用 PNG（stb_image_write）和 QOI 编码、解码
+ * -o 时把每张图片的结果和进程的峰值内存写入 JSON 文件，供 bench_gate 使用
+ */
+
+#include "json_writer.h"
+#include "process_memory.h"
+#include "qoi_codec.h"
+#include "stb_image.h"
+#include "thread_pool.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+// 单张图片的结果，吞吐量都按中位数耗时计算
+struct ImageResult
+{
+    const char* filePath {nullptr};
+    int width {0};
+    int height {0};
+    double decodeMs {0.0};
+    double decodeMPps {0.0};
+    double decodeMBps {0.0};
+    double pngEncodeMBps {0.0};
+    double pngDecodeMBps {0.0};
+    double qoiEncodeMBps {0.0};
+    double qoiDecodeMBps {0.0};
+};
+
+void stbiParallelFor(void* user, int count, stbi_parallel_task* task, void* taskData)
+{
+    static_cast<ThreadPool*>(user)->parallelFor(static_cast<uint32_t>(count), 1, [task, taskData](uint32_t begin, uint32_t end) {
+        task(taskData, static_cast<int>(begin), static_cast<int>(end));
+    });
+}
+
+bool readFile(const char* filePath, std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(filePath, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data.resize(fileSize > 0 ? static_cast<size_t>(fileSize) : 0);
+    const size_t readSize = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+
+    return fileSize > 0 && readSize == data.size();
+}
+
+// QOI 不在 stb_image 的格式中，按文件头判断。结果统一为 RGBA8，用 stbi_image_free 释放
+stbi_uc* loadImage(const std::vector<uint8_t>& fileData, int& width, int& height, int& channels)
+{
+    QoiHeader header;
+    if (qoiReadHeader(fileData.data(), fileData.size(), header))
+    {
+        auto pixels = static_cast<stbi_uc*>(STBI_MALLOC(size_t(header.width) * header.height * 4));
+        if (!pixels || !qoiDecode(fileData.data(), fileData.size(), pixels, 4))
+        {
+            STBI_FREE(pixels);
+            return nullptr;
+        }
+
+        width    = static_cast<int>(header.width);
+        height   = static_cast<int>(header.height);
+        channels = header.channels;
+        return pixels;
+    }
+
+    return stbi_load_from_memory(fileData.data(), static_cast<int>(fileData.size()), &width, &height, &channels, 4);
+}
+
+template <typename Func>
+double medianMs(int iterations, Func&& func)
+{
+    std::vector<double> times;
+    times.reserve(iterations);
+    for (int i = 0; i < iterations; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+bool benchDecode(const char* filePath, int iterations, ImageResult& result)
+{
+    std::vector<uint8_t> fileData;
+    if (!readFile(filePath, fileData))
+    {
+        printf("%-40s read failed\n", filePath);
+        return false;
+    }
+
+    int width    = 0;
+    int height   = 0;
+    int channels = 0;
+    std::vector<double> times;
+    times.reserve(iterations);
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        stbi_uc* pixels  = loadImage(fileData, width, height, channels);
+        const auto end   = std::chrono::steady_clock::now();
+
+        if (!pixels)
+        {
+            printf("%-40s decode failed: %s\n", filePath, stbi_failure_reason());
+            return false;
+        }
+        stbi_image_free(pixels);
+
+        times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    // 取中位数，避免偶发的调度抖动影响结果
+    std::sort(times.begin(), times.end());
+    const double medianMs  = times[times.size() / 2];
+    const double megapixel = double(width) * height / 1.0e6;
+
+    result.filePath   = filePath;
+    result.width      = width;
+    result.height     = height;
+    result.decodeMs   = medianMs;
+    result.decodeMPps = megapixel / (medianMs / 1000.0);
+    result.decodeMBps = fileData.size() / 1.0e6 / (medianMs / 1000.0);
+
+    printf(
+        "%-40s %5dx%-5d %d ch  median %8.3f ms  min %8.3f ms  %8.2f MP/s  %8.2f MB/s in\n",
+        filePath,
+        width,
+        height,
+        channels,
+        medianMs,
+        times.front(),
+        result.decodeMPps,
+        result.decodeMBps
+    );
+    return true;
+}
+
+bool benchEncode(const char* filePath, int iterations, ImageResult& result)
+{
+    std::vector<uint8_t> fileData;
+    int width       = 0;
+    int height      = 0;
+    int channels    = 0;
+    stbi_uc* pixels = readFile(filePath, fileData) ? loadImage(fileData, width, height, channels) : nullptr;
+    if (!pixels)
+    {
+        printf("%-40s load failed\n", filePath);
+        return false;
+    }
+
+    const double rawMB = double(width) * height * 4 / 1.0e6;
+    std::vector<uint8_t> decoded(size_t(width) * height * 4);
+
+    // PNG：和截图循环一样使用 stb_image_write 的默认压缩级别
+    int pngSize              = 0;
+    const double pngEncodeMs = medianMs(iterations, [&]() {
+        unsigned char* png = stbi_write_png_to_mem(pixels, width * 4, width, height, 4, &pngSize);
+        STBIW_FREE(png);
+    });
+    unsigned char* png       = stbi_write_png_to_mem(pixels, width * 4, width, height, 4, &pngSize);
+    const double pngDecodeMs = medianMs(iterations, [&]() {
+        int w = 0;
+        int h = 0;
+        int c = 0;
+        stbi_image_free(stbi_load_from_memory(png, pngSize, &w, &h, &c, 4));
+    });
+    STBIW_FREE(png);
+
+    std::vector<uint8_t> qoi;
+    const double qoiEncodeMs = medianMs(iterations, [&]() { qoiEncode(pixels, width, height, 4, 0, qoi); });
+    const double qoiDecodeMs = medianMs(iterations, [&]() { qoiDecode(qoi.data(), qoi.size(), decoded.data(), 4); });
+    const bool lossless      = memcmp(decoded.data(), pixels, decoded.size()) == 0;
+
+    result.filePath      = filePath;
+    result.width         = width;
+    result.height        = height;
+    result.pngEncodeMBps = rawMB / (pngEncodeMs / 1000.0);
+    result.pngDecodeMBps = rawMB / (pngDecodeMs / 1000.0);
+    result.qoiEncodeMBps = rawMB / (qoiEncodeMs / 1000.0);
+    result.qoiDecodeMBps = rawMB / (qoiDecodeMs / 1000.0);
+
+    printf(
+        "%-40s %5dx%-5d png: enc %8.2f MB/s  dec %8.2f MB/s  %6.2f%%   qoi: enc %8.2f MB/s  dec %8.2f MB/s  %6.2f%%%s\n",
+        filePath,
+        width,
+        height,
+        result.pngEncodeMBps,
+        result.pngDecodeMBps,
+        pngSize / (rawMB * 1.0e4),
+        result.qoiEncodeMBps,
+        result.qoiDecodeMBps,
+        qoi.size() / (rawMB * 1.0e4),
+        lossless ? "" : "  MISMATCH"
+    );
+
+    stbi_image_free(pixels);
+    return true;
+}
+
+// 文件名中的反斜杠和引号需要转义
+bool writeJson(const char* filePath, bool encode, int iterations, int threads, const std::vector<ImageResult>& results)
+{
+    FILE* file = fopen(filePath, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"mode\": \"%s\",\n  \"iterations\": %d,\n  \"threads\": %d,\n", encode ? "encode" : "decode", iterations, threads);
+    fprintf(file, "  \"peak_rss_kb\": %llu,\n  \"images\": [", static_cast<unsigned long long>(getPeakMemoryKb()));
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const ImageResult& result = results[i];
+        fprintf(file, "%s\n    {\"file\": ", i == 0 ? "" : ",");
+        writeJsonString(file, result.filePath);
+        fprintf(file, ", \"width\": %d, \"height\": %d, ", result.width, result.height);
+        if (encode)
+        {
+            fprintf(
+                file,
+                "\"png_encode_mbps\": %.3f, \"png_decode_mbps\": %.3f, \"qoi_encode_mbps\": %.3f, \"qoi_decode_mbps\": %.3f}",
+                result.pngEncodeMBps,
+                result.pngDecodeMBps,
+                result.qoiEncodeMBps,
+                result.qoiDecodeMBps
+            );
+        }
+        else
+        {
+            fprintf(file, "\"decode_ms\": %.4f, \"decode_mpps\": %.3f, \"decode_mbps\": %.3f}", result.decodeMs, result.decodeMPps, result.decodeMBps);
+        }
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    return fclose(file) == 0;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int iterations         = 10;
+    int threads            = 0;
+    int first              = 1;
+    bool encode            = false;
+    const char* outputPath = nullptr;
+    while (first < argc)
+    {
+        if (strcmp(argv[first], "-e") == 0)
+        {
+            encode = true;
+            ++first;
+            continue;
+        }
+        if (first + 1 >= argc || (strcmp(argv[first], "-n") != 0 && strcmp(argv[first], "-j") != 0 && strcmp(argv[first], "-o") != 0))
+        {
+            break;
+        }
+
+        if (strcmp(argv[first], "-o") == 0)
+        {
+            outputPath = argv[first + 1];
+        }
+        else if (strcmp(argv[first], "-n") == 0)
+        {
+            iterations = std::max(1, atoi(argv[first + 1]));
+        }
+        else
+        {
+            threads = std::max(0, atoi(argv[first + 1]));
+        }
+        first += 2;
+    }
+
+    if (first >= argc)
+    {
+        printf("usage: image_bench [-n iterations] [-j threads] [-e] [-o result.json] image...\n");
+        return EXIT_FAILURE;
+    }
+
+    // 调用线程也参与计算，所以线程池只需要 threads - 1 个工作线程
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threads > 1)
+    {
+        threadPool = std::make_unique<ThreadPool>(static_cast<uint32_t>(threads - 1));
+        stbi_set_jpeg_parallel_for(stbiParallelFor, threadPool.get());
+    }
+
+    std::vector<ImageResult> results;
+    bool failed = false;
+    for (int i = first; i < argc; ++i)
+    {
+        ImageResult result;
+        if (encode ? benchEncode(argv[i], iterations, result) : benchDecode(argv[i], iterations, result))
+        {
+            results.push_back(result);
+        }
+        else
+        {
+            failed = true;
+        }
+    }
+
+    if (outputPath)
+    {
+        // 有图片失败时不写结果，避免性能检查把缺少的图片和基线中的其它图片对应起来
+        if (failed)
+        {
+            fprintf(stderr, "image_bench: some images failed, %s not written\n", outputPath);
+            return EXIT_FAILURE;
+        }
+        if (!writeJson(outputPath, encode, iterations, threads, results))
+        {
+            fprintf(stderr, "image_bench: failed to write %s\n", outputPath);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
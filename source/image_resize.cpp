@@ -0,0 +1,466 @@
+﻿#include "image_resize.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_RESIZE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+// 每个任务处理的输出行数，相邻分块需要的输入行有少量重叠，会重复做水平滤波
+constexpr uint32_t kRowsPerChunk = 16;
+
+// 线性值转 sRGB 的查找表大小，精度足够让结果和直接计算的舍入一致（最暗处可能差1）
+constexpr uint32_t kLinearToSrgbSize = 1u << 14;
+
+struct SrgbTables
+{
+    float toLinear[256];
+    uint8_t fromLinear[kLinearToSrgbSize];
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            const float c = i / 255.0f;
+            toLinear[i]   = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        for (uint32_t i = 0; i < kLinearToSrgbSize; ++i)
+        {
+            const float l = float(i) / float(kLinearToSrgbSize - 1);
+            const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            fromLinear[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+const SrgbTables& getSrgbTables()
+{
+    static const SrgbTables tables;
+    return tables;
+}
+
+float getFilterRadius(ResizeFilter filter)
+{
+    switch (filter)
+    {
+        case ResizeFilter::Box:
+            return 0.5f;
+        case ResizeFilter::Triangle:
+            return 1.0f;
+        case ResizeFilter::Lanczos3:
+            return 3.0f;
+    }
+    return 1.0f;
+}
+
+float sinc(float x)
+{
+    if (std::fabs(x) < 1e-6f)
+    {
+        return 1.0f;
+    }
+
+    const float px = 3.14159265358979f * x;
+    return std::sin(px) / px;
+}
+
+float evaluateFilter(ResizeFilter filter, float t)
+{
+    t = std::fabs(t);
+    switch (filter)
+    {
+        case ResizeFilter::Box:
+            return t < 0.5f ? 1.0f : (t == 0.5f ? 0.5f : 0.0f);
+        case ResizeFilter::Triangle:
+            return t < 1.0f ? 1.0f - t : 0.0f;
+        case ResizeFilter::Lanczos3:
+            return t < 3.0f ? sinc(t) * sinc(t / 3.0f) : 0.0f;
+    }
+    return 0.0f;
+}
+
+// 一个方向上每个输出像素对应的输入像素和权重，输出像素 i 的权重为 [offset[i], offset[i + 1])
+struct FilterTaps
+{
+    std::vector<uint32_t> offset;
+    std::vector<uint32_t> index;
+    std::vector<float> weight;
+};
+
+// taps 的内存在多次调用之间复用
+void computeTaps(ResizeFilter filter, uint32_t srcSize, uint32_t dstSize, FilterTaps& taps)
+{
+    // 缩小时按比例展宽滤波核，放大时保持原始宽度
+    const float scale       = float(srcSize) / float(dstSize);
+    const float filterScale = std::max(scale, 1.0f);
+    const float support     = getFilterRadius(filter) * filterScale;
+
+    taps.offset.clear();
+    taps.index.clear();
+    taps.weight.clear();
+    taps.offset.reserve(dstSize + 1);
+    for (uint32_t i = 0; i < dstSize; ++i)
+    {
+        taps.offset.push_back(static_cast<uint32_t>(taps.index.size()));
+
+        const float center = (i + 0.5f) * scale - 0.5f;
+        const int first    = static_cast<int>(std::ceil(center - support));
+        const int last     = static_cast<int>(std::floor(center + support));
+
+        float sum          = 0.0f;
+        const size_t begin = taps.weight.size();
+        for (int j = first; j <= last; ++j)
+        {
+            const float w = evaluateFilter(filter, (j - center) / filterScale);
+            if (w == 0.0f)
+            {
+                continue;
+            }
+
+            // 超出边界的像素用边缘像素代替
+            taps.index.push_back(static_cast<uint32_t>(std::clamp(j, 0, int(srcSize) - 1)));
+            taps.weight.push_back(w);
+            sum += w;
+        }
+
+        if (taps.weight.size() == begin || sum == 0.0f)
+        {
+            taps.weight.resize(begin);
+            taps.index.resize(begin);
+            taps.index.push_back(std::min(static_cast<uint32_t>(center + 0.5f), srcSize - 1));
+            taps.weight.push_back(1.0f);
+            continue;
+        }
+
+        for (size_t k = begin; k < taps.weight.size(); ++k)
+        {
+            taps.weight[k] /= sum;
+        }
+    }
+    taps.offset.push_back(static_cast<uint32_t>(taps.index.size()));
+}
+
+// 一行 RGBA 浮点像素的水平滤波
+void filterRow(const float* src, const FilterTaps& taps, uint32_t dstWidth, float* dst)
+{
+    for (uint32_t x = 0; x < dstWidth; ++x)
+    {
+        const uint32_t begin = taps.offset[x];
+        const uint32_t end   = taps.offset[x + 1];
+#ifdef IMAGE_RESIZE_SSE2
+        __m128 acc = _mm_setzero_ps();
+        for (uint32_t k = begin; k < end; ++k)
+        {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(taps.weight[k]), _mm_loadu_ps(src + taps.index[k] * 4)));
+        }
+        _mm_storeu_ps(dst + x * 4, acc);
+#else
+        float acc[4] {};
+        for (uint32_t k = begin; k < end; ++k)
+        {
+            const float* pixel = src + taps.index[k] * 4;
+            for (int ch = 0; ch < 4; ++ch)
+            {
+                acc[ch] += taps.weight[k] * pixel[ch];
+            }
+        }
+        memcpy(dst + x * 4, acc, sizeof(acc));
+#endif
+    }
+}
+
+// dst += weight * src，count 为4的倍数
+void accumulateRow(float weight, const float* src, uint32_t count, float* dst)
+{
+#ifdef IMAGE_RESIZE_SSE2
+    const __m128 w = _mm_set1_ps(weight);
+    for (uint32_t i = 0; i < count; i += 4)
+    {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+    }
+#else
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        dst[i] += weight * src[i];
+    }
+#endif
+}
+
+struct Rgba8Pixels
+{
+    using Pixel = uint8_t;
+
+    bool srgb {false};
+
+    void load(const uint8_t* src, uint32_t width, float* dst) const
+    {
+        if (srgb)
+        {
+            const float* toLinear = getSrgbTables().toLinear;
+            for (uint32_t i = 0; i < width; ++i)
+            {
+                dst[i * 4 + 0] = toLinear[src[i * 4 + 0]];
+                dst[i * 4 + 1] = toLinear[src[i * 4 + 1]];
+                dst[i * 4 + 2] = toLinear[src[i * 4 + 2]];
+                dst[i * 4 + 3] = src[i * 4 + 3] * (1.0f / 255.0f);
+            }
+            return;
+        }
+
+        for (uint32_t i = 0; i < width * 4; ++i)
+        {
+            dst[i] = src[i] * (1.0f / 255.0f);
+        }
+    }
+
+    void store(const float* src, uint32_t width, uint8_t* dst) const
+    {
+        if (srgb)
+        {
+            const uint8_t* fromLinear = getSrgbTables().fromLinear;
+            const float scale         = float(kLinearToSrgbSize - 1);
+            for (uint32_t i = 0; i < width; ++i)
+            {
+                for (int ch = 0; ch < 3; ++ch)
+                {
+                    const float v   = std::clamp(src[i * 4 + ch], 0.0f, 1.0f);
+                    dst[i * 4 + ch] = fromLinear[static_cast<uint32_t>(v * scale + 0.5f)];
+                }
+                dst[i * 4 + 3] = static_cast<uint8_t>(std::clamp(src[i * 4 + 3] * 255.0f + 0.5f, 0.0f, 255.0f));
+            }
+            return;
+        }
+
+        uint32_t i = 0;
+#ifdef IMAGE_RESIZE_SSE2
+        // 一次转换4个像素，饱和打包到 uint8
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128 half  = _mm_set1_ps(0.5f);
+        const __m128 zero  = _mm_setzero_ps();
+        for (; i + 16 <= width * 4; i += 16)
+        {
+            __m128i v[4];
+            for (int k = 0; k < 4; ++k)
+            {
+                const __m128 f = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + k * 4), scale), zero), scale);
+                v[k]           = _mm_cvttps_epi32(_mm_add_ps(f, half));
+            }
+            const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+        }
+#endif
+        for (; i < width * 4; ++i)
+        {
+            dst[i] = static_cast<uint8_t>(std::clamp(src[i] * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+struct Rgba32fPixels
+{
+    using Pixel = float;
+
+    void load(const float* src, uint32_t width, float* dst) const
+    {
+        memcpy(dst, src, width * 4 * sizeof(float));
+    }
+
+    void store(const float* src, uint32_t width, float* dst) const
+    {
+        memcpy(dst, src, width * 4 * sizeof(float));
+    }
+};
+
+template <typename Pixels>
+void resize(
+    ThreadPool* threadPool,
+    const Pixels& pixels,
+    const typename Pixels::Pixel* src,
+    uint32_t srcWidth,
+    uint32_t srcHeight,
+    uint32_t srcStride,
+    typename Pixels::Pixel* dst,
+    uint32_t dstWidth,
+    uint32_t dstHeight,
+    uint32_t dstStride,
+    ResizeFilter filter
+)
+{
+    if (srcWidth == 0 || srcHeight == 0 || dstWidth == 0 || dstHeight == 0)
+    {
+        return;
+    }
+
+    if (srcWidth == dstWidth && srcHeight == dstHeight)
+    {
+        for (uint32_t y = 0; y < dstHeight; ++y)
+        {
+            memcpy(dst + size_t(y) * dstStride, src + size_t(y) * srcStride, dstWidth * 4 * sizeof(typename Pixels::Pixel));
+        }
+        return;
+    }
+
+    // 滤波权重和行缓冲都是线程局部的，连续缩放相同尺寸的图片（例如每帧的缩略图）时不再申请内存
+    // 分块在其它线程中执行，通过引用访问调用线程的权重
+    thread_local FilterTaps taps[2];
+    FilterTaps& horizontal = taps[0];
+    FilterTaps& vertical   = taps[1];
+    computeTaps(filter, srcWidth, dstWidth, horizontal);
+    computeTaps(filter, srcHeight, dstHeight, vertical);
+    const uint32_t numChunks = (dstHeight + kRowsPerChunk - 1) / kRowsPerChunk;
+
+    auto resizeChunks = [&](uint32_t begin, uint32_t end) {
+        thread_local std::vector<float> srcRow;
+        thread_local std::vector<float> dstRow;
+        thread_local std::vector<float> rows;
+        srcRow.resize(size_t(srcWidth) * 4);
+        dstRow.resize(size_t(dstWidth) * 4);
+
+        for (uint32_t chunk = begin; chunk < end; ++chunk)
+        {
+            const uint32_t y0 = chunk * kRowsPerChunk;
+            const uint32_t y1 = std::min(y0 + kRowsPerChunk, dstHeight);
+
+            // 这些输出行用到的输入行范围，先全部做水平滤波
+            uint32_t firstRow = srcHeight;
+            uint32_t lastRow  = 0;
+            for (uint32_t k = vertical.offset[y0]; k < vertical.offset[y1]; ++k)
+            {
+                firstRow = std::min(firstRow, vertical.index[k]);
+                lastRow  = std::max(lastRow, vertical.index[k]);
+            }
+
+            rows.resize(size_t(lastRow - firstRow + 1) * dstWidth * 4);
+            for (uint32_t y = firstRow; y <= lastRow; ++y)
+            {
+                pixels.load(src + size_t(y) * srcStride, srcWidth, srcRow.data());
+                filterRow(srcRow.data(), horizontal, dstWidth, rows.data() + size_t(y - firstRow) * dstWidth * 4);
+            }
+
+            for (uint32_t y = y0; y < y1; ++y)
+            {
+                std::fill(dstRow.begin(), dstRow.end(), 0.0f);
+                for (uint32_t k = vertical.offset[y]; k < vertical.offset[y + 1]; ++k)
+                {
+                    accumulateRow(vertical.weight[k], rows.data() + size_t(vertical.index[k] - firstRow) * dstWidth * 4, dstWidth * 4, dstRow.data());
+                }
+                pixels.store(dstRow.data(), dstWidth, dst + size_t(y) * dstStride);
+            }
+        }
+    };
+
+    if (threadPool)
+    {
+        threadPool->parallelFor(numChunks, 1, resizeChunks);
+    }
+    else
+    {
+        resizeChunks(0, numChunks);
+    }
+}
+
+template <typename Pixels>
+void buildMipChain(
+    ThreadPool* threadPool,
+    const Pixels& pixels,
+    const typename Pixels::Pixel* rgba,
+    uint32_t width,
+    uint32_t height,
+    ResizeFilter filter,
+    typename Pixels::Pixel* output
+)
+{
+    memcpy(output, rgba, size_t(width) * height * 4 * sizeof(typename Pixels::Pixel));
+
+    const uint32_t mipCount = getMipCount(width, height);
+    for (uint32_t i = 1; i < mipCount; ++i)
+    {
+        const uint32_t mipWidth  = std::max(width >> 1, 1u);
+        const uint32_t mipHeight = std::max(height >> 1, 1u);
+        auto next                = output + size_t(width) * height * 4;
+        resize(threadPool, pixels, output, width, height, width * 4, next, mipWidth, mipHeight, mipWidth * 4, filter);
+
+        output = next;
+        width  = mipWidth;
+        height = mipHeight;
+    }
+}
+} // namespace
+
+void resizeImage(
+    ThreadPool* threadPool,
+    const uint8_t* src,
+    uint32_t srcWidth,
+    uint32_t srcHeight,
+    uint32_t srcStride,
+    uint8_t* dst,
+    uint32_t dstWidth,
+    uint32_t dstHeight,
+    uint32_t dstStride,
+    ResizeFilter filter,
+    bool srgb
+)
+{
+    Rgba8Pixels pixels;
+    pixels.srgb = srgb;
+    resize(threadPool, pixels, src, srcWidth, srcHeight, srcStride, dst, dstWidth, dstHeight, dstStride, filter);
+}
+
+void resizeImage(
+    ThreadPool* threadPool,
+    const float* src,
+    uint32_t srcWidth,
+    uint32_t srcHeight,
+    uint32_t srcStride,
+    float* dst,
+    uint32_t dstWidth,
+    uint32_t dstHeight,
+    uint32_t dstStride,
+    ResizeFilter filter
+)
+{
+    resize(threadPool, Rgba32fPixels(), src, srcWidth, srcHeight, srcStride, dst, dstWidth, dstHeight, dstStride, filter);
+}
+
+uint32_t getMipCount(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    while (width > 1 || height > 1)
+    {
+        width  = std::max(width >> 1, 1u);
+        height = std::max(height >> 1, 1u);
+        ++count;
+    }
+    return count;
+}
+
+size_t getMipChainSize(uint32_t width, uint32_t height, uint32_t bytesPerPixel)
+{
+    size_t size = 0;
+    for (uint32_t i = 0, count = getMipCount(width, height); i < count; ++i)
+    {
+        size += size_t(width) * height * bytesPerPixel;
+        width  = std::max(width >> 1, 1u);
+        height = std::max(height >> 1, 1u);
+    }
+    return size;
+}
+
+void generateMipChain(ThreadPool* threadPool, const uint8_t* rgba, uint32_t width, uint32_t height, ResizeFilter filter, bool srgb, uint8_t* output)
+{
+    Rgba8Pixels pixels;
+    pixels.srgb = srgb;
+    buildMipChain(threadPool, pixels, rgba, width, height, filter, output);
+}
+
+void generateMipChain(ThreadPool* threadPool, const float* rgba, uint32_t width, uint32_t height, ResizeFilter filter, float* output)
+{
+    buildMipChain(threadPool, Rgba32fPixels(), rgba, width, height, filter, output);
+}
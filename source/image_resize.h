@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+// 图片缩放和 mipmap 生成，先水平后垂直的可分离滤波，像素格式为 RGBA8 或 RGBA32F
+enum class ResizeFilter
+{
+    Box,      // 2:1 缩小时等价于 2x2 平均
+    Triangle, // 双线性
+    Lanczos3, // 最清晰，会有轻微的振铃
+};
+
+// RGBA8 缩放，stride 为每行字节数。srgb 为 true 时 RGB 转换到线性空间后再滤波，alpha 始终按线性处理
+// 按输出行分块在线程池中并行，threadPool 为空时在调用线程中执行
+void resizeImage(
+    ThreadPool* threadPool,
+    const uint8_t* src,
+    uint32_t srcWidth,
+    uint32_t srcHeight,
+    uint32_t srcStride,
+    uint8_t* dst,
+    uint32_t dstWidth,
+    uint32_t dstHeight,
+    uint32_t dstStride,
+    ResizeFilter filter,
+    bool srgb
+);
+
+// RGBA32F 缩放，stride 为每行 float 个数
+void resizeImage(
+    ThreadPool* threadPool,
+    const float* src,
+    uint32_t srcWidth,
+    uint32_t srcHeight,
+    uint32_t srcStride,
+    float* dst,
+    uint32_t dstWidth,
+    uint32_t dstHeight,
+    uint32_t dstStride,
+    ResizeFilter filter
+);
+
+// 完整 mip 链的级数，最后一级为 1x1
+uint32_t getMipCount(uint32_t width, uint32_t height);
+
+// 完整 mip 链的字节数，各级紧密排列，和 bgfx::createTexture2D(hasMips = true) 要求的内存布局一致
+size_t getMipChainSize(uint32_t width, uint32_t height, uint32_t bytesPerPixel);
+
+// 生成完整 mip 链到 output（大小为 getMipChainSize），第0级直接拷贝 rgba，之后每一级由上一级缩小一半
+void generateMipChain(ThreadPool* threadPool, const uint8_t* rgba, uint32_t width, uint32_t height, ResizeFilter filter, bool srgb, uint8_t* output);
+void generateMipChain(ThreadPool* threadPool, const float* rgba, uint32_t width, uint32_t height, ResizeFilter filter, float* output);
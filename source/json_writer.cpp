@@ -0,0 +1,24 @@
+﻿#include "json_writer.h"
+
+void writeJsonString(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for (; *str; ++str)
+    {
+        const unsigned char c = static_cast<unsigned char>(*str);
+        if (c == '"' || c == '\\')
+        {
+            fputc('\\', file);
+            fputc(c, file);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(file, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
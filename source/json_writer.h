@@ -0,0 +1,7 @@
+﻿#pragma once
+
+#include <cstdio>
+
+// 把 str 作为 JSON 字符串（带引号）写入 file，转义引号、反斜杠和控制字符。
+// 文件路径（Windows 路径中的反斜杠）、view 名、trace 事件名等写入 JSON 时使用
+void writeJsonString(FILE* file, const char* str);
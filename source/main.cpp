@@ -2,9 +2,15 @@
  * 1. BGFX绘制一个立方体
  * 2. 将BGFX绘制的结果保存为图片
  * 3. 更新vertexBuffer，修改立方体颜色
- * 4. 使用 Vulkan 无头渲染(Headless)
+ * 4. 使用 Vulkan 无头渲染(Headless)，保存截图（PNG 或 QOI）和缩略图
  * 5. 修改窗口大小
- * 6. 使用 Vulkan 渲染
+ * 6. 使用 Vulkan 渲染，每帧记录 bgfx::Stats 并写入 CSV/JSON 文件，bgfx 使用分级内存池，可以录制 bgfx 调用用于重放
+ * 7. 使用 stb_image 在工作线程中解码图片，绘制带纹理的立方体，也可以直接加载 DDS/KTX 压缩纹理，
+ *    着色器和纹理在 bgfx::init 的同时加载，输出启动各阶段的耗时和第一帧的时间。
+ *    指定多张图片时放进同一张纹理图集，所有立方体合并成一次绘制
+ * 8. 分块渲染超过最大纹理尺寸的图片，逐块回读后拼接，流式压缩写入 PNG 文件
+ * 9. 在 GPU 上把渲染结果转换为 YUV420，只回读 Y、UV 两个平面，写入 Y4M 视频
+ * 10. 双线程模式：窗口线程调用 bgfx::renderFrame，API 线程提交绘制，和单线程模式比较吞吐量和输入延迟
  */
 
 #define TEST4
@@ -17,6 +23,7 @@
 #include "bgfx/bgfx.h"
 #include "bgfx/platform.h"
 #include "bx/math.h"
+#include "trace.h"
 
 #include <string>
 
@@ -25,6 +32,7 @@ const int WNDW_HEIGHT = 600;
 
 bgfx::ShaderHandle loadShader(const char* FILENAME)
 {
+    TRACE_ZONE("loadShader");
     std::string shaderPath = "???";
 
     switch (bgfx::getRendererType())
@@ -57,6 +65,7 @@ bgfx::ShaderHandle loadShader(const char* FILENAME)
 
 int main()
 {
+    TRACE_THREAD_NAME("main");
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     GLFWwindow* window = glfwCreateWindow(WNDW_WIDTH, WNDW_HEIGHT, "GLFW_BGFX", nullptr, nullptr);
@@ -127,7 +136,10 @@ int main()
     unsigned int counter = 0;
     while (!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
+        {
+            TRACE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         {
             glfwSetWindowShouldClose(window, true);
@@ -139,27 +151,38 @@ int main()
         // This dummy draw call is here to make sure that view 0 is cleared if no other draw calls are submitted to view 0.
         bgfx::touch(0);
 
-        const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
-        const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
-        float view[16];
-        bx::mtxLookAt(view, eye, at);
-        float proj[16];
-        bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
-        bgfx::setViewTransform(0, view, proj);
-        float mtx[16];
-        bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
-        bgfx::setTransform(mtx);
+        {
+            TRACE_ZONE("matrix setup");
+            const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+            const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
+            float view[16];
+            bx::mtxLookAt(view, eye, at);
+            float proj[16];
+            bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
+            bgfx::setViewTransform(0, view, proj);
+            float mtx[16];
+            bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
+            bgfx::setTransform(mtx);
+        }
 
         bgfx::setVertexBuffer(0, vbh);
         bgfx::setIndexBuffer(ibh);
 
         // submit的第一个参数表示viewid
-        bgfx::submit(0, program);
-        bgfx::frame();
+        {
+            TRACE_ZONE("bgfx::submit");
+            bgfx::submit(0, program);
+        }
+        {
+            TRACE_ZONE("bgfx::frame");
+            bgfx::frame();
+        }
+        TRACE_GPU_FRAME(*bgfx::getStats());
 
         counter++;
     }
 
+    TRACE_WRITE("trace.json");
     bgfx::shutdown();
     glfwTerminate();
     return EXIT_SUCCESS;
@@ -175,6 +198,7 @@ int main()
 #include "bgfx/bgfx.h"
 #include "bgfx/platform.h"
 #include "bx/math.h"
+#include "trace.h"
 
 #include <iostream>
 #include <string>
@@ -188,6 +212,7 @@ const int WNDW_HEIGHT = 600;
 
 bgfx::ShaderHandle loadShader(const char* FILENAME)
 {
+    TRACE_ZONE("loadShader");
     std::string shaderPath = "???";
 
     switch (bgfx::getRendererType())
@@ -220,6 +245,7 @@ bgfx::ShaderHandle loadShader(const char* FILENAME)
 
 int main()
 {
+    TRACE_THREAD_NAME("main");
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     GLFWwindow* window = glfwCreateWindow(WNDW_WIDTH, WNDW_HEIGHT, "GLFW_BGFX", nullptr, nullptr);
@@ -294,7 +320,10 @@ int main()
     unsigned int counter = 0;
     while (!glfwWindowShouldClose(window) && counter < 10)
     {
-        glfwPollEvents();
+        {
+            TRACE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         {
             glfwSetWindowShouldClose(window, true);
@@ -323,22 +352,32 @@ int main()
         // This dummy draw call is here to make sure that view 0 is cleared if no other draw calls are submitted to view 0.
         bgfx::touch(0);
 
-        const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
-        const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
-        float view[16];
-        bx::mtxLookAt(view, eye, at);
-        float proj[16];
-        bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
-        bgfx::setViewTransform(0, view, proj);
-        float mtx[16];
-        bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
-        bgfx::setTransform(mtx);
+        {
+            TRACE_ZONE("matrix setup");
+            const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+            const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
+            float view[16];
+            bx::mtxLookAt(view, eye, at);
+            float proj[16];
+            bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
+            bgfx::setViewTransform(0, view, proj);
+            float mtx[16];
+            bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
+            bgfx::setTransform(mtx);
+        }
 
         bgfx::setVertexBuffer(0, vbh);
         bgfx::setIndexBuffer(ibh);
 
-        bgfx::submit(0, program);
-        bgfx::frame();
+        {
+            TRACE_ZONE("bgfx::submit");
+            bgfx::submit(0, program);
+        }
+        {
+            TRACE_ZONE("bgfx::frame");
+            bgfx::frame();
+        }
+        TRACE_GPU_FRAME(*bgfx::getStats());
 
         // Create a texture with the BGFX_TEXTURE_READ_BACK flag to indicate that it can be read back from the GPU.
         auto textureHandle = bgfx::createTexture2D(
@@ -352,15 +391,24 @@ int main()
         );
 
         // Blit the color attachment of the frame buffer object to the read-back texture.
-        bgfx::blit(0, textureHandle, 0, 0, colorTexture);
+        {
+            TRACE_ZONE("bgfx::blit");
+            bgfx::blit(0, textureHandle, 0, 0, colorTexture);
+        }
 
         // Read the texture data using bgfx::readTexture().
-        bgfx::readTexture(textureHandle, data.data());
+        {
+            TRACE_ZONE("readTexture");
+            bgfx::readTexture(textureHandle, data.data());
+        }
 
         // Save the texture data to an image file using a library such as stb_image_write.
         // 第0帧即第一次调用bgfx::frame()之后，图像数据全为0，第1帧即第二次调用bgfx::frame()之后，图像数据不为0
         auto fileName = "output_" + std::to_string(counter++) + ".png";
-        stbi_write_png(fileName.c_str(), WNDW_WIDTH, WNDW_HEIGHT, 4, data.data(), WNDW_WIDTH * 4);
+        {
+            TRACE_ZONE("stbi_write_png");
+            stbi_write_png(fileName.c_str(), WNDW_WIDTH, WNDW_HEIGHT, 4, data.data(), WNDW_WIDTH * 4);
+        }
 
         // Destroy the texture and frame buffer object.
         bgfx::destroy(colorTexture);
@@ -370,6 +418,7 @@ int main()
 
     std::cout << "save " << counter << " images\n";
 
+    TRACE_WRITE("trace.json");
     bgfx::shutdown();
     glfwTerminate();
     return EXIT_SUCCESS;
@@ -385,6 +434,7 @@ int main()
 #include "bgfx/bgfx.h"
 #include "bgfx/platform.h"
 #include "bx/math.h"
+#include "trace.h"
 
 #include <string>
 
@@ -393,6 +443,7 @@ const int WNDW_HEIGHT = 600;
 
 bgfx::ShaderHandle loadShader(const char* FILENAME)
 {
+    TRACE_ZONE("loadShader");
     std::string shaderPath = "???";
 
     switch (bgfx::getRendererType())
@@ -425,6 +476,7 @@ bgfx::ShaderHandle loadShader(const char* FILENAME)
 
 int main()
 {
+    TRACE_THREAD_NAME("main");
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     GLFWwindow* window = glfwCreateWindow(WNDW_WIDTH, WNDW_HEIGHT, "GLFW_BGFX", nullptr, nullptr);
@@ -508,7 +560,10 @@ int main()
     unsigned int counter = 0;
     while (!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
+        {
+            TRACE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         {
             glfwSetWindowShouldClose(window, true);
@@ -520,27 +575,38 @@ int main()
         // This dummy draw call is here to make sure that view 0 is cleared if no other draw calls are submitted to view 0.
         bgfx::touch(0);
 
-        const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
-        const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
-        float view[16];
-        bx::mtxLookAt(view, eye, at);
-        float proj[16];
-        bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
-        bgfx::setViewTransform(0, view, proj);
-        float mtx[16];
-        bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
-        bgfx::setTransform(mtx);
+        {
+            TRACE_ZONE("matrix setup");
+            const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+            const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
+            float view[16];
+            bx::mtxLookAt(view, eye, at);
+            float proj[16];
+            bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
+            bgfx::setViewTransform(0, view, proj);
+            float mtx[16];
+            bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
+            bgfx::setTransform(mtx);
+        }
 
         bgfx::setVertexBuffer(0, vbh);
         bgfx::setIndexBuffer(ibh);
 
         // submit的第一个参数表示viewid
-        bgfx::submit(0, program);
-        bgfx::frame();
+        {
+            TRACE_ZONE("bgfx::submit");
+            bgfx::submit(0, program);
+        }
+        {
+            TRACE_ZONE("bgfx::frame");
+            bgfx::frame();
+        }
+        TRACE_GPU_FRAME(*bgfx::getStats());
 
         counter++;
     }
 
+    TRACE_WRITE("trace.json");
     bgfx::shutdown();
     glfwTerminate();
     return EXIT_SUCCESS;
@@ -553,19 +619,65 @@ int main()
 #include "bgfx/bgfx.h"
 #include "bgfx/platform.h"
 #include "bx/math.h"
-
+#include "alloc_tracker.h"
+#include "encoder_arena.h"
+#include "frame_delta.h"
+#include "image_resize.h"
+#include "pixel_transform.h"
+#include "qoi_codec.h"
+#include "stats_recorder.h"
+#include "texture_readback.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "view_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <vector>
 
+// stb_image_write 的临时缓冲从当前线程的内存池申请，连续截图时复用上一帧的缓冲
+#define STBIW_MALLOC(size)       EncoderArena::current().allocate(size)
+#define STBIW_REALLOC(ptr, size) EncoderArena::current().reallocate(ptr, size)
+#define STBIW_FREE(ptr)          EncoderArena::current().deallocate(ptr)
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
 const int WNDW_WIDTH  = 800;
 const int WNDW_HEIGHT = 600;
 
+// 每张截图额外保存一张缩略图
+const int THUMB_WIDTH  = 200;
+const int THUMB_HEIGHT = 150;
+
+// 截图只回读这个区域（像素坐标，原点在左上角），默认为整个窗口
+const TextureReadback::Region CAPTURE_REGION = {0, 0, WNDW_WIDTH, WNDW_HEIGHT, 0};
+
+// 大于等于0时缩略图直接回读 GPU 自动生成的这一级 mip（2x2 平均），第2级正好是 200x150，传输量只有整张的 1/16；
+// 为 -1 时在 CPU 上用 Lanczos3 把截图缩小到 THUMB_WIDTH x THUMB_HEIGHT，更清晰
+const int THUMB_MIP = -1;
+
+// 和上一帧按 64x64 的块比较，完全相同时不保存，只有一部分变化时只保存变化区域的包围矩形，
+// 文件名中带上矩形左上角的坐标（类似 APNG 的部分帧），用于静止画面的长时间录制
+const bool SAVE_DIRTY_REGION = false;
+
+// 截图保存为 QOI：编码比 PNG 快几十倍，文件稍大，适合后处理程序读一次就删除的中间结果。缩略图始终为 PNG
+const bool SAVE_AS_QOI = false;
+
+// 每帧的 bgfx::Stats（包括各个 view 的 GPU 耗时）写入这个文件，结束时输出各个 view 的平均耗时
+const char* STATS_FILE = "stats.json";
+
+// 统计每帧的内存申请（全局 operator new 和 bgfx 分配器，按步骤分别计数），每帧输出申请次数。
+// 为 true 时预热帧之后还有申请就输出各个步骤的申请次数并返回失败，用来确认截图循环稳定后不再申请内存。
+// 预热帧内创建回读纹理、线程池各线程第一次缩放时申请行缓冲、编码器内存池扩容
+const bool CHECK_STEADY_STATE_ALLOCATIONS = false;
+const unsigned int ALLOC_WARMUP_FRAMES    = 3;
+
 bgfx::ShaderHandle loadShader(const char* FILENAME)
 {
+    TRACE_ZONE("loadShader");
     std::string shaderPath = "???";
 
     switch (bgfx::getRendererType())
@@ -598,6 +710,7 @@ bgfx::ShaderHandle loadShader(const char* FILENAME)
 
 int main()
 {
+    TRACE_THREAD_NAME("main");
     // Call bgfx::renderFrame before bgfx::init to signal to bgfx not to create a render thread.
     // Most graphics APIs must be used on the same thread that created the window.
     bgfx::renderFrame();
@@ -611,6 +724,8 @@ int main()
     bgfxInit.resolution.width  = WNDW_WIDTH;
     bgfxInit.resolution.height = WNDW_HEIGHT;
     bgfxInit.resolution.reset  = BGFX_RESET_VSYNC;
+    bgfxInit.allocator         = AllocTracker::getBgfxAllocator();
+    AllocTracker::setEnabled(true);
     bgfx::init(bgfxInit);
 
     struct PosColorVertex
@@ -662,24 +777,80 @@ int main()
 
     // storage pixels
     // 使用new char[]，delete[] 时会崩溃，std::array也是如此
-    std::vector<uint8_t> data(WNDW_WIDTH * WNDW_HEIGHT * 4);
+    // 回读纹理的大小和区域相同，只在区域大小变化时重新创建
+    TextureReadback captureReadback(bgfx::TextureFormat::RGBA8, 4);
+    TextureReadback thumbReadback(bgfx::TextureFormat::RGBA8, 4);
+
+    TextureReadback::Region thumbRegion;
+    thumbRegion.mip = static_cast<uint8_t>(std::max(THUMB_MIP, 0));
+
+    const TextureReadback::Region capture = TextureReadback::clip(CAPTURE_REGION, WNDW_WIDTH, WNDW_HEIGHT);
+    const TextureReadback::Region thumb   = THUMB_MIP >= 0 ? TextureReadback::clip(thumbRegion, WNDW_WIDTH, WNDW_HEIGHT)
+                                                           : TextureReadback::Region {0, 0, THUMB_WIDTH, THUMB_HEIGHT, 0};
+
+    std::vector<uint8_t> data(size_t(capture.width) * capture.height * 4);
+    std::vector<uint8_t> thumbnail(size_t(thumb.width) * thumb.height * 4);
+    std::vector<uint8_t> image(size_t(capture.width) * capture.height * 3);
+    std::vector<uint8_t> thumbnailImage(size_t(thumb.width) * thumb.height * 3);
+    std::vector<uint8_t> qoiData;
+    FrameDelta frameDelta(capture.width, capture.height, 3);
+
+    // 回读结果保存前的处理，一遍完成：修正行顺序，去掉全为 255 的 alpha，编码的数据量少 1/4
+    PixelTransform transform;
+    transform.flipVertical = bgfx::getCaps()->originBottomLeft;
+    transform.dropAlpha    = true;
+
+    // 缩略图按行分块在线程池中缩放
+    ThreadPool threadPool;
+
+    // view 0 渲染到 MSAA 渲染目标（resolve 计入 view 0 的 GPU 耗时），view 1 拷贝到回读纹理
+    bgfx::setViewName(0, "main pass");
+    bgfx::setViewName(1, "readback blit");
+    bgfx::setDebug(BGFX_DEBUG_PROFILER);
+
+    StatsRecorder statsRecorder;
+    statsRecorder.open(STATS_FILE, StatsRecorder::Format::Json);
+    ViewProfiler viewProfiler;
+
+    // 渲染和回读拷贝在不同的帧中执行，每次 bgfx::frame() 之后都要记录
+    auto profileFrame = [&statsRecorder, &viewProfiler](uint32_t frame) {
+        const bgfx::Stats* stats = bgfx::getStats();
+        statsRecorder.sample(frame, *stats);
+        viewProfiler.update(*stats);
+        TRACE_GPU_FRAME(*stats);
+    };
+
+    // Create a texture with the BGFX_TEXTURE_RT flag to indicate that it is a render target texture.
+    // 缩略图回读 mip 时渲染目标带完整 mip 链，帧缓冲默认的 BGFX_RESOLVE_AUTO_GEN_MIPS 在渲染后生成各级 mip
+    // 渲染目标所有截图共用，不在每帧中创建和销毁
+    auto colorTexture = bgfx::createTexture2D(
+        WNDW_WIDTH,
+        WNDW_HEIGHT,
+        THUMB_MIP > 0,
+        1,
+        bgfx::TextureFormat::RGBA8,
+        0 | BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP | BGFX_TEXTURE_RT_MSAA_X16
+    );
+
+    // Create a frame buffer object with the texture as its color attachment.
+    bgfx::FrameBufferHandle frameBuffer = bgfx::createFrameBuffer(1, &colorTexture, false);
+
+    // 文件名写到固定的缓冲中，避免每帧拼接字符串
+    char fileName[64];
+    char thumbName[64];
 
     // Rendering Loop
-    unsigned int counter = 0;
-    while (counter < 10)
+    // counter 是渲染的帧数，savedImages 只统计实际保存的图片，SAVE_DIRTY_REGION 跳过的帧不计入。
+    // 画面一直不变时最多渲染 MAX_FRAMES 帧
+    const unsigned int SAVE_COUNT = 10;
+    const unsigned int MAX_FRAMES = 1000;
+    unsigned int counter          = 0;
+    unsigned int savedImages      = 0;
+    bool steadyStateFailed        = false;
+    while (savedImages < SAVE_COUNT && counter < MAX_FRAMES)
     {
-        // Create a texture with the BGFX_TEXTURE_RT flag to indicate that it is a render target texture.
-        auto colorTexture = bgfx::createTexture2D(
-            WNDW_WIDTH,
-            WNDW_HEIGHT,
-            false,
-            1,
-            bgfx::TextureFormat::RGBA8,
-            0 | BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP | BGFX_TEXTURE_RT_MSAA_X16
-        );
-
-        // Create a frame buffer object with the texture as its color attachment.
-        bgfx::FrameBufferHandle frameBuffer = bgfx::createFrameBuffer(1, &colorTexture, false);
+        AllocTracker::beginFrame();
+        AllocScope renderScope("render");
 
         // Set the current view's frame buffer to the frame buffer object.
         bgfx::setViewFrameBuffer(0, frameBuffer);
@@ -691,55 +862,179 @@ int main()
         // This dummy draw call is here to make sure that view 0 is cleared if no other draw calls are submitted to view 0.
         bgfx::touch(0);
 
-        const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
-        const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
-        float view[16];
-        bx::mtxLookAt(view, eye, at);
-        float proj[16];
-        bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
-        bgfx::setViewTransform(0, view, proj);
-        float mtx[16];
-        bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
-        bgfx::setTransform(mtx);
+        {
+            TRACE_ZONE("matrix setup");
+            const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+            const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
+            float view[16];
+            bx::mtxLookAt(view, eye, at);
+            float proj[16];
+            bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
+            bgfx::setViewTransform(0, view, proj);
+            float mtx[16];
+            bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
+            bgfx::setTransform(mtx);
+        }
 
         bgfx::setVertexBuffer(0, vbh);
         bgfx::setIndexBuffer(ibh);
 
-        bgfx::submit(0, program);
-        bgfx::frame();
+        {
+            TRACE_ZONE("bgfx::submit");
+            bgfx::submit(0, program);
+        }
+        {
+            TRACE_ZONE("bgfx::frame");
+            profileFrame(bgfx::frame());
+        }
 
-        // Create a texture with the BGFX_TEXTURE_READ_BACK flag to indicate that it can be read back from the GPU.
-        auto textureHandle = bgfx::createTexture2D(
-            WNDW_WIDTH,
-            WNDW_HEIGHT,
-            false,
-            1,
-            bgfx::TextureFormat::RGBA8,
-            0 | BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK | BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT | BGFX_SAMPLER_MIP_POINT
-                | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP
-        );
+        // Blit the requested region of the color attachment to the read-back texture and read it using bgfx::readTexture().
+        {
+            TRACE_ZONE("readTexture");
+            AllocScope scope("readback");
+            bgfx::touch(1);
+            uint32_t readyFrame = captureReadback.read(1, colorTexture, WNDW_WIDTH, WNDW_HEIGHT, capture, data.data());
+            if (THUMB_MIP >= 0)
+            {
+                readyFrame = std::max(readyFrame, thumbReadback.read(1, colorTexture, WNDW_WIDTH, WNDW_HEIGHT, thumb, thumbnail.data()));
+            }
+
+            // readTexture 是异步的，等到返回的帧号之后数据才可用
+            uint32_t frame = 0;
+            while (frame < readyFrame)
+            {
+                frame = bgfx::frame();
+                profileFrame(frame);
+            }
+        }
 
-        // Blit the color attachment of the frame buffer object to the read-back texture.
-        bgfx::blit(0, textureHandle, 0, 0, colorTexture);
+        // Save the texture data to an image file using a library such as stb_image_write.
+        const unsigned int index = counter++;
+        const char* extension    = SAVE_AS_QOI ? ".qoi" : ".png";
+        snprintf(thumbName, sizeof(thumbName), "thumb_%u.png", index);
+        snprintf(fileName, sizeof(fileName), "output_%u%s", index, extension);
 
-        // Read the texture data using bgfx::readTexture().
-        bgfx::readTexture(textureHandle, data.data());
+        AllocScope transformScope("transform");
+        transformPixels(&threadPool, data.data(), capture.width, capture.height, capture.width * 4, image.data(), capture.width * 3, transform);
 
-        // Save the texture data to an image file using a library such as stb_image_write.
-        // 第0帧即第一次调用bgfx::frame()之后，图像数据全为0，第1帧即第二次调用bgfx::frame()之后，图像数据不为0
-        auto fileName = "output_" + std::to_string(counter++) + ".png";
-        stbi_write_png(fileName.c_str(), WNDW_WIDTH, WNDW_HEIGHT, 4, data.data(), WNDW_WIDTH * 4);
+        FrameDelta::Tile dirty = {0, 0, capture.width, capture.height};
+        if (SAVE_DIRTY_REGION)
+        {
+            AllocScope scope("frame delta");
+            if (frameDelta.update(&threadPool, image.data(), capture.width * 3) == 0)
+            {
+                std::cout << fileName << ": unchanged, skipped\n";
+                continue;
+            }
+
+            dirty = frameDelta.getDirtyBounds();
+            if (dirty.width != capture.width || dirty.height != capture.height)
+            {
+                snprintf(fileName, sizeof(fileName), "output_%u_%u_%u%s", index, dirty.x, dirty.y, extension);
+            }
+        }
+        const uint8_t* dirtyPixels = image.data() + (size_t(dirty.y) * capture.width + dirty.x) * 3;
 
-        // Destroy the texture and frame buffer object.
-        bgfx::destroy(colorTexture);
-        bgfx::destroy(frameBuffer);
-        bgfx::destroy(textureHandle);
+        AllocScope encodeScope("encode");
+        const EncoderArena::Stats encStart = EncoderArena::current().getStats();
+        const auto encodeStart             = std::chrono::steady_clock::now();
+        if (SAVE_AS_QOI)
+        {
+            TRACE_ZONE("qoiEncode");
+            qoiEncode(dirtyPixels, dirty.width, dirty.height, 3, capture.width * 3, qoiData);
+            if (FILE* file = fopen(fileName, "wb"))
+            {
+                fwrite(qoiData.data(), 1, qoiData.size(), file);
+                fclose(file);
+            }
+        }
+        else
+        {
+            TRACE_ZONE("stbi_write_png");
+            stbi_write_png(fileName, dirty.width, dirty.height, 3, dirtyPixels, capture.width * 3);
+        }
+        ++savedImages;
+        const double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - encodeStart).count();
+
+        // 在线性空间中缩小，避免 sRGB 图片缩小后整体偏暗
+        AllocScope thumbnailScope("thumbnail");
+        if (THUMB_MIP < 0)
+        {
+            resizeImage(
+                &threadPool,
+                data.data(),
+                capture.width,
+                capture.height,
+                capture.width * 4,
+                thumbnail.data(),
+                thumb.width,
+                thumb.height,
+                thumb.width * 4,
+                ResizeFilter::Lanczos3,
+                true
+            );
+        }
+        transformPixels(nullptr, thumbnail.data(), thumb.width, thumb.height, thumb.width * 4, thumbnailImage.data(), thumb.width * 3, transform);
+        {
+            TRACE_ZONE("stbi_write_png");
+            stbi_write_png(thumbName, thumb.width, thumb.height, 3, thumbnailImage.data(), thumb.width * 3);
+        }
+
+        // 第一帧之后 heap 应该为0，图片内容变化很大时哈希链变长，偶尔会多申请几块
+        const EncoderArena::Stats& encEnd = EncoderArena::current().getStats();
+        std::cout << fileName << ": " << encodeMs << " ms, encoder allocations " << encEnd.allocations - encStart.allocations << ", heap "
+                  << encEnd.heapAllocations - encStart.heapAllocations << ", reserved " << encEnd.reservedBytes / 1024 << " KB";
+
+        // 编码器内存池直接使用 malloc，单独计数
+        const uint64_t encoderHeapAllocations = encEnd.heapAllocations - encStart.heapAllocations;
+        const uint64_t frameAllocations       = AllocTracker::getFrameAllocations() + encoderHeapAllocations;
+        std::cout << ", frame allocations " << frameAllocations << "\n";
+
+        if (CHECK_STEADY_STATE_ALLOCATIONS && index >= ALLOC_WARMUP_FRAMES && frameAllocations > 0)
+        {
+            std::cout << "frame " << index << " allocated after warmup:\n";
+            AllocTracker::Counter counters[AllocTracker::kMaxTags];
+            const uint32_t numCounters = AllocTracker::getFrameCounters(counters, AllocTracker::kMaxTags);
+            for (uint32_t i = 0; i < numCounters; ++i)
+            {
+                std::cout << "  " << counters[i].tag << ": " << counters[i].allocations << " allocations, " << counters[i].bytes << " bytes\n";
+            }
+            if (encoderHeapAllocations > 0)
+            {
+                std::cout << "  stb encoder: " << encoderHeapAllocations << " allocations\n";
+            }
+            steadyStateFailed = true;
+            break;
+        }
     }
 
-    std::cout << "save " << counter << " images\n";
+    std::cout << "save " << savedImages << " images\n";
+    if (SAVE_DIRTY_REGION)
+    {
+        const FrameDelta::Stats& stats = frameDelta.getStats();
+        std::cout << "skipped " << stats.skippedFrames << " unchanged frames, changed tiles " << stats.changedTiles << " / " << stats.tiles << ", saved "
+                  << (stats.inputBytes - stats.changedBytes) / 1024 << " KB of " << stats.inputBytes / 1024 << " KB\n";
+    }
+
+    statsRecorder.close();
+    for (const ViewProfiler::ViewTiming& timing : viewProfiler.getViews())
+    {
+        std::cout << "view " << timing.view << " " << timing.name << ": gpu " << timing.gpuMs << " ms (max " << timing.gpuMaxMs << "), cpu " << timing.cpuMs
+                  << " ms\n";
+    }
+
+    std::cout << "allocations " << AllocTracker::getTotalAllocations() << ", frees " << AllocTracker::getTotalFrees() << "\n";
+
+    // Destroy the texture and frame buffer object.
+    bgfx::destroy(colorTexture);
+    bgfx::destroy(frameBuffer);
+
+    captureReadback.destroy();
+    thumbReadback.destroy();
 
+    TRACE_WRITE("trace.json");
     bgfx::shutdown();
-    return EXIT_SUCCESS;
+    return steadyStateFailed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 #endif // TEST4
@@ -753,6 +1048,7 @@ int main()
 #include "bgfx/bgfx.h"
 #include "bgfx/platform.h"
 #include "bx/math.h"
+#include "trace.h"
 
 #include <iostream>
 #include <string>
@@ -762,6 +1058,7 @@ int WNDW_HEIGHT = 600;
 
 bgfx::ShaderHandle loadShader(const char* FILENAME)
 {
+    TRACE_ZONE("loadShader");
     std::string shaderPath = "???";
 
     switch (bgfx::getRendererType())
@@ -803,6 +1100,7 @@ static void FramebufferResizeCallback(GLFWwindow* window, int width, int height)
 
 int main()
 {
+    TRACE_THREAD_NAME("main");
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     GLFWwindow* window = glfwCreateWindow(WNDW_WIDTH, WNDW_HEIGHT, "GLFW_BGFX", nullptr, nullptr);
@@ -874,7 +1172,10 @@ int main()
     unsigned int counter = 0;
     while (!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
+        {
+            TRACE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         {
             glfwSetWindowShouldClose(window, true);
@@ -888,27 +1189,38 @@ int main()
         // This dummy draw call is here to make sure that view 0 is cleared if no other draw calls are submitted to view 0.
         bgfx::touch(0);
 
-        const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
-        const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
-        float view[16];
-        bx::mtxLookAt(view, eye, at);
-        float proj[16];
-        bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
-        bgfx::setViewTransform(0, view, proj);
-        float mtx[16];
-        bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
-        bgfx::setTransform(mtx);
+        {
+            TRACE_ZONE("matrix setup");
+            const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+            const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
+            float view[16];
+            bx::mtxLookAt(view, eye, at);
+            float proj[16];
+            bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
+            bgfx::setViewTransform(0, view, proj);
+            float mtx[16];
+            bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
+            bgfx::setTransform(mtx);
+        }
 
         bgfx::setVertexBuffer(0, vbh);
         bgfx::setIndexBuffer(ibh);
 
         // submit的第一个参数表示viewid
-        bgfx::submit(0, program);
-        bgfx::frame();
+        {
+            TRACE_ZONE("bgfx::submit");
+            bgfx::submit(0, program);
+        }
+        {
+            TRACE_ZONE("bgfx::frame");
+            bgfx::frame();
+        }
+        TRACE_GPU_FRAME(*bgfx::getStats());
 
         counter++;
     }
 
+    TRACE_WRITE("trace.json");
     bgfx::shutdown();
     glfwTerminate();
     return EXIT_SUCCESS;
@@ -924,14 +1236,30 @@ int main()
 #include "bgfx/bgfx.h"
 #include "bgfx/platform.h"
 #include "bx/math.h"
+#include "bgfx_allocator.h"
+#include "command_recorder.h"
+#include "stats_recorder.h"
+#include "trace.h"
+#include "view_profiler.h"
 
+#include <algorithm>
+#include <iostream>
 #include <string>
 
 const int WNDW_WIDTH  = 800;
 const int WNDW_HEIGHT = 600;
 
-bgfx::ShaderHandle loadShader(const char* FILENAME)
+// 每帧的 bgfx::Stats 写入文件，运行时按 F1 开关。窗口左上角显示各个 view 的平均耗时
+const char* STATS_FILE                   = "stats.csv";
+const StatsRecorder::Format STATS_FORMAT = StatsRecorder::Format::Csv;
+
+// 为 true 时把所有 bgfx 调用录制到 COMMAND_FILE，用 bgfx_replay 在任意后端（包括 Noop）上重放
+const bool RECORD_COMMANDS = false;
+const char* COMMAND_FILE   = "commands.bin";
+
+bgfx::ShaderHandle loadShader(CommandRecorder& recorder, const char* FILENAME)
 {
+    TRACE_ZONE("loadShader");
     std::string shaderPath = "???";
 
     switch (bgfx::getRendererType())
@@ -959,11 +1287,12 @@ bgfx::ShaderHandle loadShader(const char* FILENAME)
     mem->data[mem->size - 1] = '\0';
     fclose(file);
 
-    return bgfx::createShader(mem);
+    return recorder.createShader(FILENAME, mem);
 }
 
 int main()
 {
+    TRACE_THREAD_NAME("main");
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     GLFWwindow* window = glfwCreateWindow(WNDW_WIDTH, WNDW_HEIGHT, "GLFW_BGFX", nullptr, nullptr);
@@ -978,8 +1307,19 @@ int main()
     bgfxInit.resolution.width  = WNDW_WIDTH;
     bgfxInit.resolution.height = WNDW_HEIGHT;
     bgfxInit.resolution.reset  = BGFX_RESET_VSYNC;
+
+    // bgfx 的内存从分级内存池申请，窗口中显示碎片和分配器耗时，长时间运行时观察是否持续增长
+    PoolAllocator bgfxAllocator;
+    bgfxInit.allocator = &bgfxAllocator;
     bgfx::init(bgfxInit);
 
+    // 没有录制时 recorder 只转发给 bgfx
+    CommandRecorder recorder;
+    if (RECORD_COMMANDS)
+    {
+        recorder.open(COMMAND_FILE, WNDW_WIDTH, WNDW_HEIGHT);
+    }
+
     struct PosColorVertex
     {
         float x;
@@ -1018,54 +1358,1702 @@ int main()
     // VBO EBO
     bgfx::VertexLayout pcvDecl;
     pcvDecl.begin().add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float).add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Uint8, true).end();
-    bgfx::VertexBufferHandle vbh = bgfx::createVertexBuffer(bgfx::makeRef(cubeVertices, sizeof(cubeVertices)), pcvDecl);
-    bgfx::IndexBufferHandle ibh  = bgfx::createIndexBuffer(bgfx::makeRef(cubeTriList, sizeof(cubeTriList)));
+    bgfx::VertexBufferHandle vbh = recorder.createVertexBuffer(bgfx::makeRef(cubeVertices, sizeof(cubeVertices)), pcvDecl);
+    bgfx::IndexBufferHandle ibh  = recorder.createIndexBuffer(bgfx::makeRef(cubeTriList, sizeof(cubeTriList)));
 
     // 着色器程序
     // shaderProgram
-    bgfx::ShaderHandle vsh      = loadShader("vs_cubes.bin");
-    bgfx::ShaderHandle fsh      = loadShader("fs_cubes.bin");
-    bgfx::ProgramHandle program = bgfx::createProgram(vsh, fsh, true);
+    bgfx::ShaderHandle vsh      = loadShader(recorder, "vs_cubes.bin");
+    bgfx::ShaderHandle fsh      = loadShader(recorder, "fs_cubes.bin");
+    bgfx::ProgramHandle program = recorder.createProgram(vsh, fsh, true);
+
+    // 各个 view 的 CPU/GPU 耗时只在开启 profiler 时统计
+    StatsRecorder statsRecorder;
+    statsRecorder.open(STATS_FILE, STATS_FORMAT);
+    ViewProfiler viewProfiler;
+    recorder.setViewName(0, "main pass");
+    bgfx::setDebug(BGFX_DEBUG_PROFILER | BGFX_DEBUG_TEXT);
+    bool f1Pressed = false;
 
     // Rendering Loop
     unsigned int counter = 0;
     while (!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
+        {
+            TRACE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         {
             glfwSetWindowShouldClose(window, true);
         }
 
-        bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x443355FF, 1.0f, 0);
-        bgfx::setViewRect(0, 0, 0, WNDW_WIDTH, WNDW_HEIGHT);
+        const bool f1Down = glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS;
+        if (f1Down && !f1Pressed)
+        {
+            statsRecorder.setEnabled(!statsRecorder.isEnabled());
+        }
+        f1Pressed = f1Down;
+
+        recorder.setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x443355FF, 1.0f, 0);
+        recorder.setViewRect(0, 0, 0, WNDW_WIDTH, WNDW_HEIGHT);
 
         // This dummy draw call is here to make sure that view 0 is cleared if no other draw calls are submitted to view 0.
-        bgfx::touch(0);
+        recorder.touch(0);
 
-        const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
-        const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
-        float view[16];
-        bx::mtxLookAt(view, eye, at);
-        float proj[16];
-        bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
-        bgfx::setViewTransform(0, view, proj);
-        float mtx[16];
-        bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
-        bgfx::setTransform(mtx);
+        bgfx::dbgTextClear();
+        const uint16_t overlayEnd             = viewProfiler.drawOverlay(1, 1);
+        const PoolAllocator::Stats allocStats = bgfxAllocator.getStats();
+        bgfx::dbgTextPrintf(
+            1,
+            overlayEnd,
+            0x0f,
+            "alloc: %llu calls, %.0f ns/call, used %zu KB / reserved %zu KB",
+            static_cast<unsigned long long>(allocStats.allocations + allocStats.frees),
+            double(allocStats.totalNs) / double(std::max<uint64_t>(allocStats.allocations + allocStats.frees, 1)),
+            allocStats.usedBytes / 1024,
+            allocStats.reservedBytes / 1024
+        );
+        bgfx::dbgTextPrintf(1, 0, statsRecorder.isEnabled() ? 0x0a : 0x08, "F1: stats %s", statsRecorder.isEnabled() ? "recording" : "paused");
 
-        bgfx::setVertexBuffer(0, vbh);
-        bgfx::setIndexBuffer(ibh);
+        {
+            TRACE_ZONE("matrix setup");
+            const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+            const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
+            float view[16];
+            bx::mtxLookAt(view, eye, at);
+            float proj[16];
+            bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
+            recorder.setViewTransform(0, view, proj);
+            float mtx[16];
+            bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
+            recorder.setTransform(mtx);
+        }
+
+        recorder.setVertexBuffer(0, vbh);
+        recorder.setIndexBuffer(ibh);
 
-        bgfx::submit(0, program);
-        bgfx::frame();
+        {
+            TRACE_ZONE("bgfx::submit");
+            recorder.submit(0, program);
+        }
+        {
+            TRACE_ZONE("bgfx::frame");
+            recorder.frame();
+        }
+        TRACE_GPU_FRAME(*bgfx::getStats());
+        statsRecorder.sample(counter);
+        viewProfiler.update(*bgfx::getStats());
 
         counter++;
     }
 
+    statsRecorder.close();
+    const StatsRecorder::Stats stats = statsRecorder.getStats();
+    std::cout << "stats: " << stats.written << " frames written to " << STATS_FILE << ", " << stats.dropped << " dropped\n";
+
+    if (recorder.isOpen())
+    {
+        recorder.close();
+        std::cout << "commands: " << recorder.getStats().commands << " commands, " << recorder.getStats().frames << " frames written to " << COMMAND_FILE
+                  << "\n";
+    }
+
+    TRACE_WRITE("trace.json");
     bgfx::shutdown();
     glfwTerminate();
     return EXIT_SUCCESS;
 }
 
 #endif // TEST6
+
+#ifdef TEST7
+
+#include "GLFW/glfw3.h"
+#define GLFW_EXPOSE_NATIVE_WIN32
+#include "GLFW/glfw3native.h"
+#include "bgfx/bgfx.h"
+#include "bgfx/platform.h"
+#include "bx/math.h"
+#include "trace.h"
+
+#include "startup_timeline.h"
+#include "texture_atlas.h"
+#include "texture_manager.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+const int WNDW_WIDTH      = 800;
+const int WNDW_HEIGHT     = 600;
+const uint16_t ATLAS_SIZE = 2048;
+
+struct PosTexcoordVertex
+{
+    float x;
+    float y;
+    float z;
+    float u;
+    float v;
+};
+
+// 后端在 bgfx::init 之前已经确定，着色器文件在工作线程中读取，和 bgfx::init 并行
+std::vector<uint8_t> readShaderFile(bgfx::RendererType::Enum rendererType, const char* FILENAME)
+{
+    TRACE_ZONE("readShaderFile");
+    std::string shaderPath = "???";
+
+    switch (rendererType)
+    {
+        case bgfx::RendererType::Direct3D11:
+        case bgfx::RendererType::Direct3D12:
+            shaderPath = "shaders/dx11/";
+            break;
+        case bgfx::RendererType::Vulkan:
+            shaderPath = "shaders/spirv/";
+            break;
+        default:
+            shaderPath = "???";
+    }
+
+    shaderPath += FILENAME;
+
+    std::vector<uint8_t> data;
+    FILE* file = fopen(shaderPath.c_str(), "rb");
+    if (!file)
+    {
+        return data;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // 末尾多一个 '\0'
+    data.resize(fileSize > 0 ? size_t(fileSize) + 1 : 0);
+    if (fileSize > 0 && fread(data.data(), 1, size_t(fileSize), file) != size_t(fileSize))
+    {
+        data.clear();
+    }
+    fclose(file);
+    return data;
+}
+
+std::future<std::vector<uint8_t>> readShaderAsync(ThreadPool& threadPool, StartupTimeline& timeline, bgfx::RendererType::Enum rendererType, const char* FILENAME)
+{
+    auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+    threadPool.submit([promise, &timeline, rendererType, FILENAME]() {
+        StartupTimeline::Scope scope(timeline, FILENAME);
+        promise->set_value(readShaderFile(rendererType, FILENAME));
+    });
+    return promise->get_future();
+}
+
+// bgfx::init 之后调用，等待文件读取完成后创建着色器，文件不存在或者读取失败时返回无效句柄
+bgfx::ShaderHandle loadShader(std::future<std::vector<uint8_t>>& shaderFile, const char* FILENAME)
+{
+    TRACE_ZONE("loadShader");
+    const std::vector<uint8_t> data = shaderFile.get();
+    if (data.empty())
+    {
+        fprintf(stderr, "failed to load shader: %s\n", FILENAME);
+        return BGFX_INVALID_HANDLE;
+    }
+    return bgfx::createShader(bgfx::copy(data.data(), static_cast<uint32_t>(data.size())));
+}
+
+// 图集模式：每个子图贴一个缩小的立方体，排成网格后合并到同一个顶点缓冲，UV 换算到图集中的子图，
+// 所有立方体只需要一次 submit
+void buildAtlasBatch(
+    const TextureAtlas& atlas,
+    const std::vector<int32_t>& regions,
+    const PosTexcoordVertex* cubeVertices,
+    uint32_t numCubeVertices,
+    const uint16_t* cubeIndices,
+    uint32_t numCubeIndices,
+    std::vector<PosTexcoordVertex>& vertices,
+    std::vector<uint16_t>& indices
+)
+{
+    const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(double(regions.size()))));
+    const float scale      = 1.0f / float(columns);
+    const float spacing    = 2.5f * scale;
+    const float center     = float(columns - 1) * 0.5f;
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        const float offsetX = (float(i % columns) - center) * spacing;
+        const float offsetY = (center - float(i / columns)) * spacing;
+        const size_t first  = vertices.size();
+        for (uint32_t v = 0; v < numCubeVertices; ++v)
+        {
+            PosTexcoordVertex vertex = cubeVertices[v];
+            vertex.x                 = vertex.x * scale + offsetX;
+            vertex.y                 = vertex.y * scale + offsetY;
+            vertex.z                 = vertex.z * scale;
+            vertices.push_back(vertex);
+        }
+        atlas.remapUvs(regions[i], vertices.data() + first, numCubeVertices, sizeof(PosTexcoordVertex), offsetof(PosTexcoordVertex, u));
+        for (uint32_t n = 0; n < numCubeIndices; ++n)
+        {
+            indices.push_back(static_cast<uint16_t>(first + cubeIndices[n]));
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    TRACE_THREAD_NAME("main");
+    StartupTimeline timeline;
+    // 纹理路径可以通过命令行参数指定，支持 PNG/JPEG 等图片和 DDS/KTX 压缩纹理。
+    // 指定多张图片时放进同一张图集，每张图片贴一个立方体，合并成一次绘制
+    std::vector<const char*> texturePaths(argv + 1, argv + argc);
+    if (texturePaths.empty())
+    {
+        texturePaths.push_back("textures/cube.png");
+    }
+    const bool useAtlas     = texturePaths.size() > 1;
+    const auto rendererType = bgfx::RendererType::Vulkan;
+
+    // 先启动文件读取和解码，和创建窗口、bgfx::init 并行，主线程只负责上传。
+    // 第一帧只需要着色器，所以着色器先投递；纹理没有解码完成时先用棋盘格纹理
+    ThreadPool threadPool;
+    auto vsFile = readShaderAsync(threadPool, timeline, rendererType, "vs_textured.bin");
+    auto fsFile = readShaderAsync(threadPool, timeline, rendererType, "fs_textured.bin");
+    TextureManager textureManager(threadPool);
+    TextureAtlas atlas(ATLAS_SIZE, ATLAS_SIZE);
+    // 立方体旋转时纹理会被缩小采样，在解码线程中顺便生成 mip 链，图集自己生成 mip
+    const double textureLoadMs = timeline.now();
+    std::vector<TextureManager::TextureId> textureIds;
+    for (const char* texturePath : texturePaths)
+    {
+        if (useAtlas)
+        {
+            textureIds.push_back(textureManager.loadToAtlas(texturePath, atlas));
+        }
+        else
+        {
+            textureIds.push_back(textureManager.load(texturePath, BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP, true));
+        }
+    }
+    timeline.mark("start loading");
+
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    GLFWwindow* window = glfwCreateWindow(WNDW_WIDTH, WNDW_HEIGHT, "GLFW_BGFX", nullptr, nullptr);
+    timeline.mark("create window");
+
+    // Call bgfx::renderFrame before bgfx::init to signal to bgfx not to create a render thread.
+    // Most graphics APIs must be used on the same thread that created the window.
+    bgfx::renderFrame();
+
+    bgfx::Init bgfxInit;
+    bgfxInit.platformData.nwh  = glfwGetWin32Window(window);
+    bgfxInit.type              = rendererType;
+    bgfxInit.resolution.width  = WNDW_WIDTH;
+    bgfxInit.resolution.height = WNDW_HEIGHT;
+    bgfxInit.resolution.reset  = BGFX_RESET_VSYNC;
+    {
+        TRACE_ZONE("bgfx::init");
+        bgfx::init(bgfxInit);
+    }
+    timeline.mark("bgfx::init");
+
+    // 顶点数据 每个面单独4个顶点，共24个顶点，这样每个面都有完整的纹理坐标
+    // clang-format off
+    static PosTexcoordVertex cubeVertices[] = {
+            {-1.0f,  1.0f,  1.0f,  0.0f, 0.0f},
+            { 1.0f,  1.0f,  1.0f,  1.0f, 0.0f},
+            {-1.0f, -1.0f,  1.0f,  0.0f, 1.0f},
+            { 1.0f, -1.0f,  1.0f,  1.0f, 1.0f},
+            {-1.0f,  1.0f, -1.0f,  0.0f, 0.0f},
+            { 1.0f,  1.0f, -1.0f,  1.0f, 0.0f},
+            {-1.0f, -1.0f, -1.0f,  0.0f, 1.0f},
+            { 1.0f, -1.0f, -1.0f,  1.0f, 1.0f},
+            {-1.0f,  1.0f,  1.0f,  0.0f, 0.0f},
+            { 1.0f,  1.0f,  1.0f,  1.0f, 0.0f},
+            {-1.0f,  1.0f, -1.0f,  0.0f, 1.0f},
+            { 1.0f,  1.0f, -1.0f,  1.0f, 1.0f},
+            {-1.0f, -1.0f,  1.0f,  0.0f, 0.0f},
+            { 1.0f, -1.0f,  1.0f,  1.0f, 0.0f},
+            {-1.0f, -1.0f, -1.0f,  0.0f, 1.0f},
+            { 1.0f, -1.0f, -1.0f,  1.0f, 1.0f},
+            { 1.0f, -1.0f,  1.0f,  0.0f, 0.0f},
+            { 1.0f,  1.0f,  1.0f,  1.0f, 0.0f},
+            { 1.0f, -1.0f, -1.0f,  0.0f, 1.0f},
+            { 1.0f,  1.0f, -1.0f,  1.0f, 1.0f},
+            {-1.0f, -1.0f,  1.0f,  0.0f, 0.0f},
+            {-1.0f,  1.0f,  1.0f,  1.0f, 0.0f},
+            {-1.0f, -1.0f, -1.0f,  0.0f, 1.0f},
+            {-1.0f,  1.0f, -1.0f,  1.0f, 1.0f},
+        };
+    // clang-format on
+
+    // 索引数据 立方体共6个面，每个面2个三角形
+    // clang-format off
+    static const uint16_t cubeTriList[] = {
+             0,  1,  2,  1,  3,  2,
+             4,  6,  5,  5,  6,  7,
+             8, 10,  9,  9, 10, 11,
+            12, 13, 14, 14, 13, 15,
+            16, 17, 18, 17, 19, 18,
+            20, 22, 21, 21, 22, 23,
+        };
+    // clang-format on
+
+    // 数据填充
+    // VBO EBO
+    bgfx::VertexLayout ptvDecl;
+    ptvDecl.begin().add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float).add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float).end();
+    bgfx::VertexBufferHandle vbh = bgfx::createVertexBuffer(bgfx::makeRef(cubeVertices, sizeof(cubeVertices)), ptvDecl);
+    bgfx::IndexBufferHandle ibh  = bgfx::createIndexBuffer(bgfx::makeRef(cubeTriList, sizeof(cubeTriList)));
+
+    // 着色器程序
+    // shaderProgram
+    bgfx::ShaderHandle vsh = loadShader(vsFile, "vs_textured.bin");
+    bgfx::ShaderHandle fsh = loadShader(fsFile, "fs_textured.bin");
+    if (!bgfx::isValid(vsh) || !bgfx::isValid(fsh))
+    {
+        // vs_textured/fs_textured 由 CMake 调用 shaderc 编译，没有找到 shaderc 时不存在
+        fprintf(stderr, "build the textured shaders with shaderc (see source/CMakeLists.txt)\n");
+        if (bgfx::isValid(vsh))
+        {
+            bgfx::destroy(vsh);
+        }
+        if (bgfx::isValid(fsh))
+        {
+            bgfx::destroy(fsh);
+        }
+        textureManager.destroyAll();
+        atlas.destroy();
+        bgfx::destroy(vbh);
+        bgfx::destroy(ibh);
+        bgfx::shutdown();
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    bgfx::ProgramHandle program = bgfx::createProgram(vsh, fsh, true);
+    bgfx::UniformHandle sampler = bgfx::createUniform("s_texColor", bgfx::UniformType::Sampler);
+
+    // 纹理还没解码完成或者加载失败时使用的棋盘格纹理
+    // clang-format off
+    static const uint32_t checkerPixels[] = {
+            0xffffffff, 0xff808080,
+            0xff808080, 0xffffffff,
+        };
+    // clang-format on
+    bgfx::TextureHandle fallbackTexture = bgfx::createTexture2D(
+        2,
+        2,
+        false,
+        1,
+        bgfx::TextureFormat::RGBA8,
+        BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT | BGFX_SAMPLER_MIP_POINT,
+        bgfx::makeRef(checkerPixels, sizeof(checkerPixels))
+    );
+    timeline.mark("create resources");
+
+    // 图集模式的合批顶点缓冲，所有纹理加载完成后创建
+    bgfx::VertexBufferHandle batchVbh = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle batchIbh  = BGFX_INVALID_HANDLE;
+
+    // Rendering Loop
+    unsigned int counter  = 0;
+    bool loadReported     = false;
+    bool timelineReported = false;
+    while (!glfwWindowShouldClose(window))
+    {
+        {
+            TRACE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
+        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        {
+            glfwSetWindowShouldClose(window, true);
+        }
+
+        // 上传已经解码完成的纹理
+        textureManager.update();
+
+        // 所有纹理加载完成（或失败）后输出加载耗时和显存占用，用来对比图片和压缩纹理
+        bool texturesLoaded = true;
+        for (const auto textureId : textureIds)
+        {
+            texturesLoaded = texturesLoaded && (textureManager.isReady(textureId) || textureManager.isFailed(textureId));
+        }
+        if (!loadReported && texturesLoaded)
+        {
+            loadReported = true;
+            timeline.record("texture load", textureLoadMs, timeline.now(), true);
+            for (size_t i = 0; i < textureIds.size(); ++i)
+            {
+                if (textureManager.isReady(textureIds[i]))
+                {
+                    printf("%s: loaded in %.2f ms\n", texturePaths[i], textureManager.getLoadTime(textureIds[i]));
+                }
+            }
+            printf("texture memory %.2f MB\n", bgfx::getStats()->textureMemoryUsed / (1024.0 * 1024.0));
+
+            // 放不进图集的纹理是单独的纹理，不能和其他立方体合批，这里不绘制
+            std::vector<int32_t> regions;
+            for (size_t i = 0; useAtlas && i < textureIds.size(); ++i)
+            {
+                const int32_t region = textureManager.getAtlasRegion(textureIds[i]);
+                if (region != TextureAtlas::kInvalidRegion)
+                {
+                    regions.push_back(region);
+                }
+                else if (textureManager.isReady(textureIds[i]))
+                {
+                    printf("%s: does not fit in the atlas, skipped\n", texturePaths[i]);
+                }
+            }
+            if (!regions.empty())
+            {
+                std::vector<PosTexcoordVertex> batchVertices;
+                std::vector<uint16_t> batchIndices;
+                const auto numCubeVertices = static_cast<uint32_t>(std::size(cubeVertices));
+                const auto numCubeIndices  = static_cast<uint32_t>(std::size(cubeTriList));
+                buildAtlasBatch(atlas, regions, cubeVertices, numCubeVertices, cubeTriList, numCubeIndices, batchVertices, batchIndices);
+
+                const auto vertexBytes = static_cast<uint32_t>(batchVertices.size() * sizeof(PosTexcoordVertex));
+                const auto indexBytes  = static_cast<uint32_t>(batchIndices.size() * sizeof(uint16_t));
+                batchVbh               = bgfx::createVertexBuffer(bgfx::copy(batchVertices.data(), vertexBytes), ptvDecl);
+                batchIbh               = bgfx::createIndexBuffer(bgfx::copy(batchIndices.data(), indexBytes));
+                printf("%zu textures in one atlas (%.1f%% used), drawn with one submit\n", regions.size(), atlas.getOccupancy() * 100.0f);
+            }
+        }
+
+        bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x443355FF, 1.0f, 0);
+        bgfx::setViewRect(0, 0, 0, WNDW_WIDTH, WNDW_HEIGHT);
+
+        // This dummy draw call is here to make sure that view 0 is cleared if no other draw calls are submitted to view 0.
+        bgfx::touch(0);
+
+        {
+            TRACE_ZONE("matrix setup");
+            const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+            const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
+            float view[16];
+            bx::mtxLookAt(view, eye, at);
+            float proj[16];
+            bx::mtxProj(proj, 60.0f, float(WNDW_WIDTH) / float(WNDW_HEIGHT), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
+            bgfx::setViewTransform(0, view, proj);
+            float mtx[16];
+            bx::mtxRotateXY(mtx, counter * 0.01f, counter * 0.01f);
+            bgfx::setTransform(mtx);
+        }
+
+        // 图集模式合批之前先绘制一个棋盘格立方体
+        if (bgfx::isValid(batchVbh))
+        {
+            bgfx::setVertexBuffer(0, batchVbh);
+            bgfx::setIndexBuffer(batchIbh);
+            bgfx::setTexture(0, sampler, atlas.getHandle());
+        }
+        else
+        {
+            bgfx::setVertexBuffer(0, vbh);
+            bgfx::setIndexBuffer(ibh);
+
+            const bool textureReady           = !useAtlas && textureManager.isReady(textureIds[0]);
+            const bgfx::TextureHandle texture = textureReady ? textureManager.getHandle(textureIds[0]) : fallbackTexture;
+            bgfx::setTexture(0, sampler, texture);
+        }
+
+        {
+            TRACE_ZONE("bgfx::submit");
+            bgfx::submit(0, program);
+        }
+        {
+            TRACE_ZONE("bgfx::frame");
+            bgfx::frame();
+        }
+        TRACE_GPU_FRAME(*bgfx::getStats());
+
+        if (counter == 0)
+        {
+            timeline.markFirstFrame();
+        }
+        // 纹理加载完成（或失败）后输出启动时间线，这时所有阶段都已经记录
+        if (!timelineReported && loadReported)
+        {
+            timelineReported = true;
+            timeline.print(stdout);
+        }
+
+        counter++;
+    }
+
+    textureManager.destroyAll();
+    atlas.destroy();
+    if (bgfx::isValid(batchVbh))
+    {
+        bgfx::destroy(batchVbh);
+        bgfx::destroy(batchIbh);
+    }
+    bgfx::destroy(fallbackTexture);
+    bgfx::destroy(sampler);
+    bgfx::destroy(program);
+    bgfx::destroy(vbh);
+    bgfx::destroy(ibh);
+
+    TRACE_WRITE("trace.json");
+    bgfx::shutdown();
+    glfwTerminate();
+    return EXIT_SUCCESS;
+}
+
+#endif // TEST7
+
+#ifdef TEST8
+
+#include "bgfx/bgfx.h"
+#include "bgfx/platform.h"
+#include "bx/math.h"
+#include "pixel_transform.h"
+#include "png_stream_writer.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 输出图片的尺寸，超过最大纹理尺寸时分块渲染
+const int OUTPUT_WIDTH  = 16384;
+const int OUTPUT_HEIGHT = 12288;
+
+// 每一块的最大尺寸，实际大小不超过 caps->limits.maxTextureSize
+// 峰值内存：一块的回读缓冲 + 一行块（OUTPUT_WIDTH * TILE_SIZE）的拼接缓冲，PNG 编码器本身只占几行
+const int TILE_SIZE = 1024;
+
+bgfx::ShaderHandle loadShader(const char* FILENAME)
+{
+    TRACE_ZONE("loadShader");
+    std::string shaderPath = "???";
+
+    switch (bgfx::getRendererType())
+    {
+        case bgfx::RendererType::Direct3D11:
+        case bgfx::RendererType::Direct3D12:
+            shaderPath = "shaders/dx11/";
+            break;
+        case bgfx::RendererType::Vulkan:
+            shaderPath = "shaders/spirv/";
+            break;
+        default:
+            shaderPath = "???";
+    }
+
+    shaderPath += FILENAME;
+
+    FILE* file = fopen(shaderPath.c_str(), "rb");
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    const bgfx::Memory* mem = bgfx::alloc(fileSize + 1);
+    fread(mem->data, 1, fileSize, file);
+    mem->data[mem->size - 1] = '\0';
+    fclose(file);
+
+    return bgfx::createShader(mem);
+}
+
+// 把整张图片的投影矩阵裁剪到像素区域 [x0, x1) x [y0, y1)（原点在左上角）：
+// 在裁剪空间中对 x、y 缩放和平移，让这块区域正好铺满 NDC。
+// bx 的矩阵中 mtx[i * 4 + 0]、mtx[i * 4 + 1]、mtx[i * 4 + 3] 是输入分量 i 对裁剪空间 x、y、w 的系数
+void tileProjection(const float* proj, float x0, float y0, float x1, float y1, float width, float height, float* result)
+{
+    // NDC 的 y 轴向上
+    const float left   = x0 / width * 2.0f - 1.0f;
+    const float right  = x1 / width * 2.0f - 1.0f;
+    const float top    = 1.0f - y0 / height * 2.0f;
+    const float bottom = 1.0f - y1 / height * 2.0f;
+
+    const float scaleX  = 2.0f / (right - left);
+    const float offsetX = -(right + left) / (right - left);
+    const float scaleY  = 2.0f / (top - bottom);
+    const float offsetY = -(top + bottom) / (top - bottom);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        result[i * 4 + 0] = scaleX * proj[i * 4 + 0] + offsetX * proj[i * 4 + 3];
+        result[i * 4 + 1] = scaleY * proj[i * 4 + 1] + offsetY * proj[i * 4 + 3];
+        result[i * 4 + 2] = proj[i * 4 + 2];
+        result[i * 4 + 3] = proj[i * 4 + 3];
+    }
+}
+
+int main()
+{
+    TRACE_THREAD_NAME("main");
+    // Call bgfx::renderFrame before bgfx::init to signal to bgfx not to create a render thread.
+    bgfx::renderFrame();
+
+    bgfx::Init bgfxInit;
+    bgfxInit.platformData.nwh  = nullptr;
+    bgfxInit.type              = bgfx::RendererType::Vulkan;
+    bgfxInit.resolution.width  = TILE_SIZE;
+    bgfxInit.resolution.height = TILE_SIZE;
+    bgfxInit.resolution.reset  = BGFX_RESET_NONE;
+    bgfx::init(bgfxInit);
+
+    const bgfx::Caps* caps  = bgfx::getCaps();
+    const uint16_t tileSize = static_cast<uint16_t>(std::min<uint32_t>(TILE_SIZE, caps->limits.maxTextureSize));
+
+    struct PosColorVertex
+    {
+        float x;
+        float y;
+        float z;
+        uint32_t abgr;
+    };
+
+    // 顶点数据 立方体共8个顶点
+    // clang-format off
+    static PosColorVertex cubeVertices[] = {
+            {-1.0f,  1.0f,  1.0f,  0xff000000},
+            { 1.0f,  1.0f,  1.0f,  0xff0000ff},
+            {-1.0f, -1.0f,  1.0f,  0xff00ff00},
+            { 1.0f, -1.0f,  1.0f,  0xff00ffff},
+            {-1.0f,  1.0f, -1.0f,  0xffff0000},
+            { 1.0f,  1.0f, -1.0f,  0xffff00ff},
+            {-1.0f, -1.0f, -1.0f,  0xffffff00},
+            { 1.0f, -1.0f, -1.0f,  0xffffffff},
+        };
+    // clang-format on
+
+    // 索引数据 立方体共6个面，每个面2个三角形
+    // clang-format off
+    static const uint16_t cubeTriList[] = {
+            0, 1, 2, 1, 3, 2,
+            4, 6, 5, 5, 6, 7,
+            0, 2, 4, 4, 2, 6,
+            1, 5, 3, 5, 7, 3,
+            0, 4, 1, 4, 5, 1,
+            2, 3, 6, 6, 3, 7,
+        };
+    // clang-format on
+
+    bgfx::VertexLayout pcvDecl;
+    pcvDecl.begin().add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float).add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Uint8, true).end();
+    bgfx::VertexBufferHandle vbh = bgfx::createVertexBuffer(bgfx::makeRef(cubeVertices, sizeof(cubeVertices)), pcvDecl);
+    bgfx::IndexBufferHandle ibh  = bgfx::createIndexBuffer(bgfx::makeRef(cubeTriList, sizeof(cubeTriList)));
+
+    bgfx::ShaderHandle vsh      = loadShader("vs_cubes.bin");
+    bgfx::ShaderHandle fsh      = loadShader("fs_cubes.bin");
+    bgfx::ProgramHandle program = bgfx::createProgram(vsh, fsh, true);
+
+    // 渲染目标和回读纹理都只有一块大小，所有块复用
+    auto colorTexture = bgfx::createTexture2D(
+        tileSize,
+        tileSize,
+        false,
+        1,
+        bgfx::TextureFormat::RGBA8,
+        0 | BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP | BGFX_TEXTURE_RT_MSAA_X4
+    );
+    bgfx::FrameBufferHandle frameBuffer = bgfx::createFrameBuffer(1, &colorTexture, false);
+
+    auto readbackTexture = bgfx::createTexture2D(
+        tileSize,
+        tileSize,
+        false,
+        1,
+        bgfx::TextureFormat::RGBA8,
+        0 | BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK | BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT | BGFX_SAMPLER_MIP_POINT
+            | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP
+    );
+
+    std::vector<uint8_t> tileData(size_t(tileSize) * tileSize * 4);
+    std::vector<uint8_t> band(size_t(OUTPUT_WIDTH) * tileSize * 4);
+
+    PixelTransform tileTransform;
+    tileTransform.flipVertical = caps->originBottomLeft;
+
+    // 每拼好一行块就滤波、压缩，压缩数据直接写入文件
+    FILE* file = fopen("output_tiled.png", "wb");
+    PngStreamWriter writer;
+    if (!file || !writer.begin(OUTPUT_WIDTH, OUTPUT_HEIGHT, 4, [file](const uint8_t* data, size_t size) { return fwrite(data, 1, size, file) == size; }))
+    {
+        std::cerr << "failed to open output_tiled.png\n";
+        if (file)
+        {
+            fclose(file);
+        }
+        bgfx::shutdown();
+        return EXIT_FAILURE;
+    }
+
+    // 整张图片的相机参数，和窗口渲染时一样，每一块只在此基础上裁剪
+    const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+    const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
+    float view[16];
+    bx::mtxLookAt(view, eye, at);
+    float proj[16];
+    bx::mtxProj(proj, 60.0f, float(OUTPUT_WIDTH) / float(OUTPUT_HEIGHT), 0.1f, 100.0f, caps->homogeneousDepth);
+    float mtx[16];
+    bx::mtxRotateXY(mtx, 0.5f, 0.5f);
+
+    const auto start      = std::chrono::steady_clock::now();
+    const uint32_t tilesX = (OUTPUT_WIDTH + tileSize - 1) / tileSize;
+    const uint32_t tilesY = (OUTPUT_HEIGHT + tileSize - 1) / tileSize;
+    for (uint32_t ty = 0; ty < tilesY; ++ty)
+    {
+        const uint32_t y0         = ty * tileSize;
+        const uint16_t tileHeight = static_cast<uint16_t>(std::min<uint32_t>(tileSize, OUTPUT_HEIGHT - y0));
+
+        for (uint32_t tx = 0; tx < tilesX; ++tx)
+        {
+            const uint32_t x0        = tx * tileSize;
+            const uint16_t tileWidth = static_cast<uint16_t>(std::min<uint32_t>(tileSize, OUTPUT_WIDTH - x0));
+
+            float tileProj[16];
+            tileProjection(proj, float(x0), float(y0), float(x0 + tileWidth), float(y0 + tileHeight), OUTPUT_WIDTH, OUTPUT_HEIGHT, tileProj);
+
+            bgfx::setViewFrameBuffer(0, frameBuffer);
+            bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0xFF0000FF, 1.0f, 0);
+            bgfx::setViewRect(0, 0, 0, tileWidth, tileHeight);
+            bgfx::setViewTransform(0, view, tileProj);
+            bgfx::touch(0);
+
+            bgfx::setTransform(mtx);
+            bgfx::setVertexBuffer(0, vbh);
+            bgfx::setIndexBuffer(ibh);
+            {
+                TRACE_ZONE("bgfx::submit");
+                bgfx::submit(0, program);
+            }
+
+            // view 1 在 view 0 之后执行，同一帧内完成渲染和拷贝
+            bgfx::touch(1);
+            {
+                TRACE_ZONE("bgfx::blit");
+                bgfx::blit(1, readbackTexture, 0, 0, colorTexture, 0, 0, tileWidth, tileHeight);
+            }
+
+            // readTexture 是异步的，返回数据可用时的帧号
+            {
+                TRACE_ZONE("readTexture");
+                const uint32_t readyFrame = bgfx::readTexture(readbackTexture, tileData.data());
+                while (bgfx::frame() < readyFrame)
+                {
+                }
+            }
+
+            // 左下角为原点的后端（OpenGL）回读的行顺序是从下到上，有效区域在回读纹理的底部
+            const uint32_t srcY = caps->originBottomLeft ? tileSize - tileHeight : 0;
+            transformPixels(
+                nullptr,
+                tileData.data() + size_t(srcY) * tileSize * 4,
+                tileWidth,
+                tileHeight,
+                tileSize * 4,
+                band.data() + size_t(x0) * 4,
+                OUTPUT_WIDTH * 4,
+                tileTransform
+            );
+        }
+
+        {
+            TRACE_ZONE("writer.writeRows");
+            writer.writeRows(band.data(), tileHeight);
+        }
+        std::cout << "tile row " << ty + 1 << " / " << tilesY << "\n";
+    }
+    if (!writer.end())
+    {
+        std::cerr << "failed to write output_tiled.png\n";
+    }
+    fclose(file);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "save output_tiled.png " << OUTPUT_WIDTH << "x" << OUTPUT_HEIGHT << " in " << tilesX * tilesY << " tiles of " << tileSize << ", "
+              << seconds << " s, peak buffer " << (tileData.size() + band.size()) / (1024 * 1024) << " MB\n";
+
+    bgfx::destroy(readbackTexture);
+    bgfx::destroy(frameBuffer);
+    bgfx::destroy(colorTexture);
+    bgfx::destroy(ibh);
+    bgfx::destroy(vbh);
+    bgfx::destroy(program);
+
+    TRACE_WRITE("trace.json");
+    bgfx::shutdown();
+    return EXIT_SUCCESS;
+}
+
+#endif // TEST8
+
+#ifdef TEST9
+
+#include "bgfx/bgfx.h"
+#include "bgfx/platform.h"
+#include "bx/math.h"
+#include "trace.h"
+#include "yuv_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 视频尺寸必须是偶数
+const int VIDEO_WIDTH  = 1280;
+const int VIDEO_HEIGHT = 720;
+const int VIDEO_FPS    = 60;
+const int FRAME_COUNT  = 120;
+
+bgfx::ShaderHandle loadShader(const char* FILENAME)
+{
+    TRACE_ZONE("loadShader");
+    std::string shaderPath = "???";
+
+    switch (bgfx::getRendererType())
+    {
+        case bgfx::RendererType::Direct3D11:
+        case bgfx::RendererType::Direct3D12:
+            shaderPath = "shaders/dx11/";
+            break;
+        case bgfx::RendererType::Vulkan:
+            shaderPath = "shaders/spirv/";
+            break;
+        default:
+            shaderPath = "???";
+    }
+
+    shaderPath += FILENAME;
+
+    FILE* file = fopen(shaderPath.c_str(), "rb");
+    if (!file)
+    {
+        std::cerr << "failed to open shader " << shaderPath << "\n";
+        return BGFX_INVALID_HANDLE;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    const bgfx::Memory* mem = bgfx::alloc(fileSize + 1);
+    fread(mem->data, 1, fileSize, file);
+    mem->data[mem->size - 1] = '\0';
+    fclose(file);
+
+    return bgfx::createShader(mem);
+}
+
+int main()
+{
+    TRACE_THREAD_NAME("main");
+    // Call bgfx::renderFrame before bgfx::init to signal to bgfx not to create a render thread.
+    bgfx::renderFrame();
+
+    bgfx::Init bgfxInit;
+    bgfxInit.platformData.nwh  = nullptr;
+    bgfxInit.type              = bgfx::RendererType::Vulkan;
+    bgfxInit.resolution.width  = VIDEO_WIDTH;
+    bgfxInit.resolution.height = VIDEO_HEIGHT;
+    bgfxInit.resolution.reset  = BGFX_RESET_NONE;
+    bgfx::init(bgfxInit);
+
+    // Y 平面为 R8，UV 平面为 RG8，都需要能作为渲染目标
+    const bgfx::Caps* caps = bgfx::getCaps();
+    const uint16_t rtCaps  = BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER;
+    if ((caps->formats[bgfx::TextureFormat::R8] & rtCaps) == 0 || (caps->formats[bgfx::TextureFormat::RG8] & rtCaps) == 0)
+    {
+        std::cerr << "R8/RG8 render targets are not supported\n";
+        bgfx::shutdown();
+        return EXIT_FAILURE;
+    }
+
+    struct PosColorVertex
+    {
+        float x;
+        float y;
+        float z;
+        uint32_t abgr;
+    };
+
+    // 顶点数据 立方体共8个顶点
+    // clang-format off
+    static PosColorVertex cubeVertices[] = {
+            {-1.0f,  1.0f,  1.0f,  0xff000000},
+            { 1.0f,  1.0f,  1.0f,  0xff0000ff},
+            {-1.0f, -1.0f,  1.0f,  0xff00ff00},
+            { 1.0f, -1.0f,  1.0f,  0xff00ffff},
+            {-1.0f,  1.0f, -1.0f,  0xffff0000},
+            { 1.0f,  1.0f, -1.0f,  0xffff00ff},
+            {-1.0f, -1.0f, -1.0f,  0xffffff00},
+            { 1.0f, -1.0f, -1.0f,  0xffffffff},
+        };
+    // clang-format on
+
+    // 索引数据 立方体共6个面，每个面2个三角形
+    // clang-format off
+    static const uint16_t cubeTriList[] = {
+            0, 1, 2, 1, 3, 2,
+            4, 6, 5, 5, 6, 7,
+            0, 2, 4, 4, 2, 6,
+            1, 5, 3, 5, 7, 3,
+            0, 4, 1, 4, 5, 1,
+            2, 3, 6, 6, 3, 7,
+        };
+    // clang-format on
+
+    struct PosTexVertex
+    {
+        float x;
+        float y;
+        float z;
+        float u;
+        float v;
+    };
+
+    // 覆盖整个屏幕的三角形，坐标直接是 NDC。
+    // NDC 底部对应 v = 1：D3D/Vulkan 中是源纹理的最后一行，OpenGL 中是源纹理的最后一行（画面顶部）写到目标的第一行，
+    // 两种情况下回读结果的第一行都是画面顶部
+    // clang-format off
+    static PosTexVertex fullscreenVertices[] = {
+            {-1.0f, -1.0f, 0.0f, 0.0f,  1.0f},
+            { 3.0f, -1.0f, 0.0f, 2.0f,  1.0f},
+            {-1.0f,  3.0f, 0.0f, 0.0f, -1.0f},
+        };
+    // clang-format on
+
+    bgfx::VertexLayout pcvDecl;
+    pcvDecl.begin().add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float).add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Uint8, true).end();
+    bgfx::VertexBufferHandle vbh = bgfx::createVertexBuffer(bgfx::makeRef(cubeVertices, sizeof(cubeVertices)), pcvDecl);
+    bgfx::IndexBufferHandle ibh  = bgfx::createIndexBuffer(bgfx::makeRef(cubeTriList, sizeof(cubeTriList)));
+
+    bgfx::VertexLayout ptDecl;
+    ptDecl.begin().add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float).add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float).end();
+    bgfx::VertexBufferHandle fullscreenVbh = bgfx::createVertexBuffer(bgfx::makeRef(fullscreenVertices, sizeof(fullscreenVertices)), ptDecl);
+
+    // vs_yuv/fs_yuv 由 CMake 的 shaders 目标调用 shaderc 编译，缺少任何一个都无法继续
+    bgfx::ShaderHandle shaders[] = {loadShader("vs_cubes.bin"), loadShader("fs_cubes.bin"), loadShader("vs_yuv.bin"), loadShader("fs_yuv.bin")};
+    bool shadersValid            = true;
+    for (bgfx::ShaderHandle shader : shaders)
+    {
+        shadersValid = shadersValid && bgfx::isValid(shader);
+    }
+    if (!shadersValid)
+    {
+        for (bgfx::ShaderHandle shader : shaders)
+        {
+            if (bgfx::isValid(shader))
+            {
+                bgfx::destroy(shader);
+            }
+        }
+        bgfx::destroy(fullscreenVbh);
+        bgfx::destroy(ibh);
+        bgfx::destroy(vbh);
+        bgfx::shutdown();
+        return EXIT_FAILURE;
+    }
+
+    bgfx::ProgramHandle program     = bgfx::createProgram(shaders[0], shaders[1], true);
+    bgfx::ProgramHandle yuvProgram  = bgfx::createProgram(shaders[2], shaders[3], true);
+    bgfx::UniformHandle s_texColor  = bgfx::createUniform("s_texColor", bgfx::UniformType::Sampler);
+    bgfx::UniformHandle u_yuvParams = bgfx::createUniform("u_yuvParams", bgfx::UniformType::Vec4);
+
+    // view 0 渲染立方体，MSAA 在作为纹理采样之前自动 resolve
+    auto colorTexture = bgfx::createTexture2D(
+        VIDEO_WIDTH,
+        VIDEO_HEIGHT,
+        false,
+        1,
+        bgfx::TextureFormat::RGBA8,
+        0 | BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP | BGFX_TEXTURE_RT_MSAA_X4
+    );
+    bgfx::FrameBufferHandle frameBuffer = bgfx::createFrameBuffer(1, &colorTexture, false);
+
+    // view 1 输出 Y 平面，view 2 输出半分辨率的 UV 平面。
+    // UV 的每个像素中心正好落在源图 2x2 像素的交点上，线性过滤一次采样就是 2x2 的平均
+    const uint16_t chromaWidth            = VIDEO_WIDTH / 2;
+    const uint16_t chromaHeight           = VIDEO_HEIGHT / 2;
+    const uint64_t planeFlags             = BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP;
+    auto yTexture                         = bgfx::createTexture2D(VIDEO_WIDTH, VIDEO_HEIGHT, false, 1, bgfx::TextureFormat::R8, planeFlags);
+    auto uvTexture                        = bgfx::createTexture2D(chromaWidth, chromaHeight, false, 1, bgfx::TextureFormat::RG8, planeFlags);
+    bgfx::FrameBufferHandle yFrameBuffer  = bgfx::createFrameBuffer(1, &yTexture, false);
+    bgfx::FrameBufferHandle uvFrameBuffer = bgfx::createFrameBuffer(1, &uvTexture, false);
+
+    // view 3 拷贝到回读纹理，每像素只回读 1.5 字节，RGBA8 需要 4 字节
+    const uint64_t readbackFlags = BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK | BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT
+        | BGFX_SAMPLER_MIP_POINT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP;
+    auto yReadback  = bgfx::createTexture2D(VIDEO_WIDTH, VIDEO_HEIGHT, false, 1, bgfx::TextureFormat::R8, readbackFlags);
+    auto uvReadback = bgfx::createTexture2D(chromaWidth, chromaHeight, false, 1, bgfx::TextureFormat::RG8, readbackFlags);
+
+    std::vector<uint8_t> yData(size_t(VIDEO_WIDTH) * VIDEO_HEIGHT);
+    std::vector<uint8_t> uvData(size_t(chromaWidth) * chromaHeight * 2);
+
+    YuvWriter writer;
+    if (!writer.open("output.y4m", YuvWriter::Format::Y4m, VIDEO_WIDTH, VIDEO_HEIGHT, VIDEO_FPS))
+    {
+        std::cerr << "failed to open output.y4m\n";
+        bgfx::shutdown();
+        return EXIT_FAILURE;
+    }
+
+    const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+    const bx::Vec3 eye = {0.0f, 0.0f, -5.0f};
+    float view[16];
+    bx::mtxLookAt(view, eye, at);
+    float proj[16];
+    bx::mtxProj(proj, 60.0f, float(VIDEO_WIDTH) / float(VIDEO_HEIGHT), 0.1f, 100.0f, caps->homogeneousDepth);
+
+    bgfx::setViewFrameBuffer(0, frameBuffer);
+    bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0xFF0000FF, 1.0f, 0);
+    bgfx::setViewRect(0, 0, 0, VIDEO_WIDTH, VIDEO_HEIGHT);
+    bgfx::setViewFrameBuffer(1, yFrameBuffer);
+    bgfx::setViewRect(1, 0, 0, VIDEO_WIDTH, VIDEO_HEIGHT);
+    bgfx::setViewFrameBuffer(2, uvFrameBuffer);
+    bgfx::setViewRect(2, 0, 0, chromaWidth, chromaHeight);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        bgfx::setViewTransform(0, view, proj);
+        bgfx::touch(0);
+
+        float mtx[16];
+        bx::mtxRotateXY(mtx, frame * 0.02f, frame * 0.03f);
+        bgfx::setTransform(mtx);
+        bgfx::setVertexBuffer(0, vbh);
+        bgfx::setIndexBuffer(ibh);
+        {
+            TRACE_ZONE("bgfx::submit");
+            bgfx::submit(0, program);
+        }
+
+        // x 为0输出 Y，为1输出 UV
+        for (bgfx::ViewId viewId = 1; viewId <= 2; ++viewId)
+        {
+            const float params[4] = {float(viewId - 1), 0.0f, 0.0f, 0.0f};
+            bgfx::setUniform(u_yuvParams, params);
+            bgfx::setTexture(0, s_texColor, colorTexture);
+            bgfx::setVertexBuffer(0, fullscreenVbh);
+            bgfx::setState(BGFX_STATE_WRITE_RGB);
+            {
+                TRACE_ZONE("bgfx::submit");
+                bgfx::submit(viewId, yuvProgram);
+            }
+        }
+
+        bgfx::touch(3);
+        {
+            TRACE_ZONE("bgfx::blit");
+            bgfx::blit(3, yReadback, 0, 0, yTexture);
+            bgfx::blit(3, uvReadback, 0, 0, uvTexture);
+        }
+
+        // readTexture 是异步的，返回数据可用时的帧号
+        {
+            TRACE_ZONE("readTexture");
+            bgfx::readTexture(yReadback, yData.data());
+            const uint32_t readyFrame = bgfx::readTexture(uvReadback, uvData.data());
+            while (bgfx::frame() < readyFrame)
+            {
+            }
+        }
+
+        {
+            TRACE_ZONE("writer.writeFrame");
+            writer.writeFrame(yData.data(), VIDEO_WIDTH, uvData.data(), chromaWidth * 2);
+        }
+    }
+    writer.close();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "save output.y4m " << writer.getFrameCount() << " frames " << VIDEO_WIDTH << "x" << VIDEO_HEIGHT << ", " << seconds << " s, readback "
+              << (yData.size() + uvData.size()) / 1024 << " KB per frame (RGBA8 " << size_t(VIDEO_WIDTH) * VIDEO_HEIGHT * 4 / 1024 << " KB)\n";
+
+    bgfx::destroy(uvReadback);
+    bgfx::destroy(yReadback);
+    bgfx::destroy(uvFrameBuffer);
+    bgfx::destroy(yFrameBuffer);
+    bgfx::destroy(uvTexture);
+    bgfx::destroy(yTexture);
+    bgfx::destroy(frameBuffer);
+    bgfx::destroy(colorTexture);
+    bgfx::destroy(u_yuvParams);
+    bgfx::destroy(s_texColor);
+    bgfx::destroy(yuvProgram);
+    bgfx::destroy(program);
+    bgfx::destroy(fullscreenVbh);
+    bgfx::destroy(ibh);
+    bgfx::destroy(vbh);
+
+    TRACE_WRITE("trace.json");
+    bgfx::shutdown();
+    return EXIT_SUCCESS;
+}
+
+#endif // TEST9
+
+#ifdef TEST10
+
+#include "GLFW/glfw3.h"
+#define GLFW_EXPOSE_NATIVE_WIN32
+#include "GLFW/glfw3native.h"
+#include "bgfx/bgfx.h"
+#include "bgfx/platform.h"
+#include "bx/math.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int WNDW_WIDTH  = 800;
+const int WNDW_HEIGHT = 600;
+
+// 每帧提交 GRID_SIZE x GRID_SIZE 个立方体，让 API 线程和渲染线程都有一定的工作量
+const int GRID_SIZE = 32;
+// 每 REPORT_FRAMES 帧输出一次吞吐量和输入延迟。比较吞吐量时关闭垂直同步
+const uint32_t REPORT_FRAMES = 300;
+const uint32_t RESET_FLAGS   = BGFX_RESET_NONE;
+
+using Clock = std::chrono::steady_clock;
+
+bgfx::ShaderHandle loadShader(const char* FILENAME)
+{
+    TRACE_ZONE("loadShader");
+    std::string shaderPath = "???";
+
+    switch (bgfx::getRendererType())
+    {
+        case bgfx::RendererType::Direct3D11:
+        case bgfx::RendererType::Direct3D12:
+            shaderPath = "shaders/dx11/";
+            break;
+        case bgfx::RendererType::Vulkan:
+            shaderPath = "shaders/spirv/";
+            break;
+        default:
+            shaderPath = "???";
+    }
+
+    shaderPath += FILENAME;
+
+    FILE* file = fopen(shaderPath.c_str(), "rb");
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    const bgfx::Memory* mem = bgfx::alloc(fileSize + 1);
+    fread(mem->data, 1, fileSize, file);
+    mem->data[mem->size - 1] = '\0';
+    fclose(file);
+
+    return bgfx::createShader(mem);
+}
+
+// GLFW 回调中收到的窗口事件，由窗口线程交给调用 bgfx API 的线程处理
+struct WindowEvent
+{
+    enum class Type
+    {
+        Resize,
+        CursorPos,
+        Close,
+    };
+
+    Type type {Type::Close};
+    int width {0}; // Resize
+    int height {0};
+    double x {0.0}; // CursorPos
+    double y {0.0};
+    Clock::time_point time; // 窗口线程收到事件的时间，用于计算输入延迟
+};
+
+// 窗口线程在 GLFW 回调中写入，API 线程每帧开始时一次取出全部事件。两个 vector 交换使用，容量稳定后不再申请内存
+class EventQueue
+{
+public:
+    void push(const WindowEvent& event)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.push_back(event);
+    }
+
+    void pop(std::vector<WindowEvent>& events)
+    {
+        events.clear();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.swap(events);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<WindowEvent> m_events;
+};
+
+void pushEvent(GLFWwindow* window, WindowEvent event)
+{
+    event.time = Clock::now();
+    static_cast<EventQueue*>(glfwGetWindowUserPointer(window))->push(event);
+}
+
+// 所有回调都在调用 glfwPollEvents 的窗口线程中执行。ESC 直接在这里关闭窗口，两种模式的退出流程相同
+void installCallbacks(GLFWwindow* window, EventQueue& queue)
+{
+    glfwSetWindowUserPointer(window, &queue);
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int width, int height) {
+        WindowEvent event;
+        event.type   = WindowEvent::Type::Resize;
+        event.width  = width;
+        event.height = height;
+        pushEvent(w, event);
+    });
+    glfwSetCursorPosCallback(window, [](GLFWwindow* w, double x, double y) {
+        WindowEvent event;
+        event.type = WindowEvent::Type::CursorPos;
+        event.x    = x;
+        event.y    = y;
+        pushEvent(w, event);
+    });
+    glfwSetKeyCallback(window, [](GLFWwindow* w, int key, int scancode, int action, int mods) {
+        (void)scancode;
+        (void)mods;
+        if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        {
+            glfwSetWindowShouldClose(w, true);
+        }
+    });
+}
+
+// 输入延迟：窗口线程收到事件到渲染包含它的一帧的 renderFrame() 返回，两种模式的终点相同。
+// 单线程模式下 renderFrame 在 bgfx::frame() 内部执行；双线程模式下 bgfx::frame() 返回时这一帧才交给渲染线程，
+// 只统计到 bgfx::frame() 返回会少算渲染这一帧的时间。
+// 每帧用 makeRef 更新一个很小的动态索引缓冲作为标记，bgfx 在执行这一帧的命令时释放它，
+// 释放回调在执行 renderFrame 的线程中调用，由此知道接下来返回的 renderFrame 渲染的是哪一帧
+class LatencyProbe
+{
+public:
+    // API 线程：bgfx::init 之后调用
+    void init()
+    {
+        m_marker = bgfx::createDynamicIndexBuffer(1);
+    }
+
+    // API 线程：bgfx::shutdown 之前调用
+    void shutdown()
+    {
+        bgfx::destroy(m_marker);
+    }
+
+    // API 线程：bgfx::frame() 之前调用，记录这一帧处理的 CursorPos 事件
+    void submit(const std::vector<WindowEvent>& events)
+    {
+        // bgfx 最多有两帧在处理中，环形缓冲足够大时写入的槽位一定已经统计过
+        Batch& batch = m_batches[m_submitted++ % kMaxBatches];
+        batch.probe  = this;
+        batch.times.clear();
+        for (const WindowEvent& event : events)
+        {
+            if (event.type == WindowEvent::Type::CursorPos)
+            {
+                batch.times.push_back(event.time);
+            }
+        }
+        bgfx::update(m_marker, 0, bgfx::makeRef(&s_markerIndex, sizeof(s_markerIndex), onRelease, &batch));
+    }
+
+    // 调用 renderFrame 的线程：renderFrame() 返回后调用（单线程模式下为 bgfx::frame() 返回后）
+    void rendered()
+    {
+        if (!m_rendering)
+        {
+            return;
+        }
+
+        const auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const Clock::time_point& time : m_rendering->times)
+        {
+            const double latencyMs = std::chrono::duration<double, std::milli>(now - time).count();
+            m_sumMs += latencyMs;
+            m_maxMs = std::max(m_maxMs, latencyMs);
+            ++m_count;
+        }
+        m_rendering = nullptr;
+    }
+
+    // 返回上次调用以来的平均值、最大值和事件数并清零
+    uint32_t take(double& avgMs, double& maxMs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const uint32_t count = m_count;
+        avgMs                = count > 0 ? m_sumMs / count : 0.0;
+        maxMs                = m_maxMs;
+        m_sumMs              = 0.0;
+        m_maxMs              = 0.0;
+        m_count              = 0;
+        return count;
+    }
+
+private:
+    static constexpr uint32_t kMaxBatches = 4;
+
+    struct Batch
+    {
+        LatencyProbe* probe {nullptr};
+        std::vector<Clock::time_point> times;
+    };
+
+    static void onRelease(void* ptr, void* userData)
+    {
+        (void)ptr;
+        Batch* batch              = static_cast<Batch*>(userData);
+        batch->probe->m_rendering = batch;
+    }
+
+    static constexpr uint16_t s_markerIndex = 0;
+
+    bgfx::DynamicIndexBufferHandle m_marker BGFX_INVALID_HANDLE;
+    Batch m_batches[kMaxBatches];
+    uint32_t m_submitted {0};
+    Batch* m_rendering {nullptr}; // 只在调用 renderFrame 的线程中访问
+
+    std::mutex m_mutex;
+    double m_sumMs {0.0};
+    double m_maxMs {0.0};
+    uint32_t m_count {0};
+};
+
+// 调用 bgfx API 的一侧：单线程模式下在主线程中运行，双线程模式下在单独的 API 线程中运行
+class CubeApp
+{
+public:
+    CubeApp(const char* mode, LatencyProbe& latencyProbe)
+        : m_mode(mode)
+        , m_latencyProbe(latencyProbe)
+    {
+    }
+
+    bool init(const bgfx::Init& bgfxInit)
+    {
+        if (!bgfx::init(bgfxInit))
+        {
+            return false;
+        }
+        m_width  = bgfxInit.resolution.width;
+        m_height = bgfxInit.resolution.height;
+
+        bgfx::VertexLayout pcvDecl;
+        pcvDecl.begin().add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float).add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Uint8, true).end();
+        m_vbh     = bgfx::createVertexBuffer(bgfx::makeRef(s_cubeVertices, sizeof(s_cubeVertices)), pcvDecl);
+        m_ibh     = bgfx::createIndexBuffer(bgfx::makeRef(s_cubeTriList, sizeof(s_cubeTriList)));
+        m_program = bgfx::createProgram(loadShader("vs_cubes.bin"), loadShader("fs_cubes.bin"), true);
+        m_latencyProbe.init();
+
+        m_reportStart = Clock::now();
+        return true;
+    }
+
+    // 处理窗口事件并提交一帧，收到 Close 时返回 false
+    bool frame(EventQueue& queue)
+    {
+        TRACE_ZONE("CubeApp::frame");
+        const auto frameStart = Clock::now();
+
+        bool running = true;
+        queue.pop(m_events);
+        for (const WindowEvent& event : m_events)
+        {
+            switch (event.type)
+            {
+                case WindowEvent::Type::Resize:
+                    m_width  = static_cast<uint32_t>(std::max(event.width, 1));
+                    m_height = static_cast<uint32_t>(std::max(event.height, 1));
+                    bgfx::reset(m_width, m_height, RESET_FLAGS);
+                    break;
+                case WindowEvent::Type::CursorPos:
+                    m_cursorX = event.x;
+                    break;
+                case WindowEvent::Type::Close:
+                    running = false;
+                    break;
+            }
+        }
+
+        bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x443355FF, 1.0f, 0);
+        bgfx::setViewRect(0, 0, 0, static_cast<uint16_t>(m_width), static_cast<uint16_t>(m_height));
+        bgfx::touch(0);
+
+        const bx::Vec3 at  = {0.0f, 0.0f, 0.0f};
+        const bx::Vec3 eye = {0.0f, 0.0f, -3.0f * GRID_SIZE};
+        float view[16];
+        bx::mtxLookAt(view, eye, at);
+        float proj[16];
+        bx::mtxProj(proj, 60.0f, float(m_width) / float(m_height), 0.1f, 1000.0f, bgfx::getCaps()->homogeneousDepth);
+        bgfx::setViewTransform(0, view, proj);
+
+        // 鼠标的水平位置控制旋转，用来观察输入延迟
+        const float angle = m_frame * 0.01f + float(m_cursorX / m_width) * bx::kPi2;
+        {
+            TRACE_ZONE("bgfx::submit");
+            for (int y = 0; y < GRID_SIZE; ++y)
+            {
+                for (int x = 0; x < GRID_SIZE; ++x)
+                {
+                    float mtx[16];
+                    bx::mtxRotateXY(mtx, angle + x * 0.21f, angle + y * 0.37f);
+                    mtx[12] = (x - GRID_SIZE / 2) * 3.0f;
+                    mtx[13] = (y - GRID_SIZE / 2) * 3.0f;
+                    mtx[14] = 0.0f;
+                    bgfx::setTransform(mtx);
+                    bgfx::setVertexBuffer(0, m_vbh);
+                    bgfx::setIndexBuffer(m_ibh);
+                    bgfx::submit(0, m_program);
+                }
+            }
+        }
+
+        m_latencyProbe.submit(m_events);
+        const auto submitEnd = Clock::now();
+        {
+            TRACE_ZONE("bgfx::frame");
+            bgfx::frame();
+        }
+        const auto frameEnd = Clock::now();
+        TRACE_GPU_FRAME(*bgfx::getStats());
+
+        const bgfx::Stats* stats = bgfx::getStats();
+        const double toMs        = 1000.0 / double(stats->cpuTimerFreq);
+        m_apiMs += std::chrono::duration<double, std::milli>(submitEnd - frameStart).count();
+        m_frameMs += std::chrono::duration<double, std::milli>(frameEnd - submitEnd).count();
+        m_renderMs += double(stats->cpuTimeEnd - stats->cpuTimeBegin) * toMs;
+        m_waitRenderMs += double(stats->waitRender) * toMs;
+        m_waitSubmitMs += double(stats->waitSubmit) * toMs;
+
+        ++m_frame;
+        if (++m_reportFrames == REPORT_FRAMES)
+        {
+            report();
+        }
+        return running;
+    }
+
+    void shutdown()
+    {
+        if (m_reportFrames > 0)
+        {
+            report();
+        }
+
+        m_latencyProbe.shutdown();
+        bgfx::destroy(m_program);
+        bgfx::destroy(m_vbh);
+        bgfx::destroy(m_ibh);
+        bgfx::shutdown();
+    }
+
+private:
+    // api 为处理事件和提交绘制的耗时，bgfx::frame 为等待渲染线程交换的耗时，render 为后端处理一帧的耗时
+    void report()
+    {
+        const double seconds = std::chrono::duration<double>(Clock::now() - m_reportStart).count();
+        const double frames  = double(m_reportFrames);
+        printf(
+            "[%s] %7.1f fps  api %6.3f ms  bgfx::frame %6.3f ms  render %6.3f ms  wait render %6.3f ms  wait submit %6.3f ms",
+            m_mode,
+            frames / seconds,
+            m_apiMs / frames,
+            m_frameMs / frames,
+            m_renderMs / frames,
+            m_waitRenderMs / frames,
+            m_waitSubmitMs / frames
+        );
+        double latencyAvgMs         = 0.0;
+        double latencyMaxMs         = 0.0;
+        const uint32_t latencyCount = m_latencyProbe.take(latencyAvgMs, latencyMaxMs);
+        if (latencyCount > 0)
+        {
+            printf("  input latency avg %6.3f ms max %6.3f ms (%u events)\n", latencyAvgMs, latencyMaxMs, latencyCount);
+        }
+        else
+        {
+            printf("  input latency n/a (move the mouse)\n");
+        }
+
+        m_reportStart  = Clock::now();
+        m_reportFrames = 0;
+        m_apiMs        = 0.0;
+        m_frameMs      = 0.0;
+        m_renderMs     = 0.0;
+        m_waitRenderMs = 0.0;
+        m_waitSubmitMs = 0.0;
+    }
+
+    struct PosColorVertex
+    {
+        float x;
+        float y;
+        float z;
+        uint32_t abgr;
+    };
+
+    // clang-format off
+    static constexpr PosColorVertex s_cubeVertices[] = {
+            {-1.0f,  1.0f,  1.0f,  0xff000000},
+            { 1.0f,  1.0f,  1.0f,  0xff0000ff},
+            {-1.0f, -1.0f,  1.0f,  0xff00ff00},
+            { 1.0f, -1.0f,  1.0f,  0xff00ffff},
+            {-1.0f,  1.0f, -1.0f,  0xffff0000},
+            { 1.0f,  1.0f, -1.0f,  0xffff00ff},
+            {-1.0f, -1.0f, -1.0f,  0xffffff00},
+            { 1.0f, -1.0f, -1.0f,  0xffffffff},
+        };
+
+    static constexpr uint16_t s_cubeTriList[] = {
+            0, 1, 2, 1, 3, 2,
+            4, 6, 5, 5, 6, 7,
+            0, 2, 4, 4, 2, 6,
+            1, 5, 3, 5, 7, 3,
+            0, 4, 1, 4, 5, 1,
+            2, 3, 6, 6, 3, 7,
+        };
+    // clang-format on
+
+    const char* m_mode;
+    LatencyProbe& m_latencyProbe;
+    uint32_t m_width {WNDW_WIDTH};
+    uint32_t m_height {WNDW_HEIGHT};
+    double m_cursorX {0.0};
+    uint32_t m_frame {0};
+    std::vector<WindowEvent> m_events;
+
+    bgfx::VertexBufferHandle m_vbh BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle m_ibh BGFX_INVALID_HANDLE;
+    bgfx::ProgramHandle m_program BGFX_INVALID_HANDLE;
+
+    Clock::time_point m_reportStart;
+    uint32_t m_reportFrames {0};
+    double m_apiMs {0.0};
+    double m_frameMs {0.0};
+    double m_renderMs {0.0};
+    double m_waitRenderMs {0.0};
+    double m_waitSubmitMs {0.0};
+};
+
+int main(int argc, char** argv)
+{
+    // 默认使用双线程模式；--single-thread 时和其它示例一样所有工作都在主线程中，用来比较两种模式
+    const bool singleThread = argc > 1 && strcmp(argv[1], "--single-thread") == 0;
+
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    GLFWwindow* window = glfwCreateWindow(WNDW_WIDTH, WNDW_HEIGHT, "GLFW_BGFX", nullptr, nullptr);
+
+    EventQueue eventQueue;
+    installCallbacks(window, eventQueue);
+    LatencyProbe latencyProbe;
+
+    // 两种模式都在 bgfx::init 之前在窗口线程中调用一次 bgfx::renderFrame()，bgfx 不会再创建自己的渲染线程，
+    // 之后调用 renderFrame 的窗口线程就是渲染线程。大多数图形 API 需要在创建窗口的线程中使用
+    bgfx::renderFrame();
+
+    bgfx::Init bgfxInit;
+    bgfxInit.platformData.nwh  = glfwGetWin32Window(window);
+    bgfxInit.type              = bgfx::RendererType::Vulkan;
+    bgfxInit.resolution.width  = WNDW_WIDTH;
+    bgfxInit.resolution.height = WNDW_HEIGHT;
+    bgfxInit.resolution.reset  = RESET_FLAGS;
+
+    if (singleThread)
+    {
+        TRACE_THREAD_NAME("main");
+        CubeApp app("single-thread", latencyProbe);
+        if (app.init(bgfxInit))
+        {
+            bool running = true;
+            while (running)
+            {
+                {
+                    TRACE_ZONE("glfwPollEvents");
+                    glfwPollEvents();
+                }
+                if (glfwWindowShouldClose(window))
+                {
+                    WindowEvent event;
+                    event.type = WindowEvent::Type::Close;
+                    pushEvent(window, event);
+                }
+                // 单线程模式下 bgfx::frame() 内部直接调用 renderFrame
+                running = app.frame(eventQueue);
+                latencyProbe.rendered();
+            }
+            app.shutdown();
+        }
+    }
+    else
+    {
+        TRACE_THREAD_NAME("render");
+        std::atomic<bool> apiExited {false};
+        std::thread apiThread([&]() {
+            TRACE_THREAD_NAME("api");
+            CubeApp app("two-thread", latencyProbe);
+            if (app.init(bgfxInit))
+            {
+                while (app.frame(eventQueue))
+                {
+                }
+                app.shutdown();
+            }
+            apiExited = true;
+        });
+
+        // 窗口线程：处理窗口事件，每次 renderFrame 等待 API 线程的 bgfx::frame()，把提交的这一帧交给渲染后端。
+        // bgfx::init 在渲染线程调用 renderFrame 时才能完成，所以 API 线程初始化期间也要一直调用
+        bool closeSent = false;
+        while (!closeSent && !apiExited)
+        {
+            {
+                TRACE_ZONE("glfwPollEvents");
+                glfwPollEvents();
+            }
+            if (glfwWindowShouldClose(window))
+            {
+                WindowEvent event;
+                event.type = WindowEvent::Type::Close;
+                pushEvent(window, event);
+                closeSent = true;
+            }
+            {
+                TRACE_ZONE("bgfx::renderFrame");
+                bgfx::renderFrame();
+            }
+            latencyProbe.rendered();
+        }
+
+        // API 线程调用 bgfx::shutdown() 时也需要渲染线程配合，直到上下文销毁
+        while (bgfx::renderFrame() != bgfx::RenderFrame::NoContext)
+        {
+        }
+        apiThread.join();
+    }
+
+    TRACE_WRITE("trace.json");
+    glfwTerminate();
+    return EXIT_SUCCESS;
+}
+
+#endif // TEST10
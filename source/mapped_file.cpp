@@ -0,0 +1,128 @@
+﻿#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* filePath)
+{
+    close();
+
+    HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize {};
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file    = file;
+    m_mapping = mapping;
+    m_data    = static_cast<const uint8_t*>(view);
+    m_size    = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+    }
+    if (m_file)
+    {
+        CloseHandle(m_file);
+    }
+
+    m_data    = nullptr;
+    m_size    = 0;
+    m_file    = nullptr;
+    m_mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* filePath)
+{
+    close();
+
+    const int fd = ::open(filePath, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // 映射建立后就不再需要文件描述符
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+    {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 只读的内存映射文件，Windows 使用 CreateFileMapping，其他平台使用 mmap
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // 文件不存在或者大小为0时返回 false
+    bool open(const char* filePath);
+    void close();
+
+    const uint8_t* getData() const
+    {
+        return m_data;
+    }
+
+    size_t getSize() const
+    {
+        return m_size;
+    }
+
+private:
+    const uint8_t* m_data {nullptr};
+    size_t m_size {0};
+#ifdef _WIN32
+    void* m_file {nullptr};
+    void* m_mapping {nullptr};
+#endif
+};
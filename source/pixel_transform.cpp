@@ -0,0 +1,180 @@
+﻿#include "pixel_transform.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+// 每个行块的目标大小，输入和输出都能留在 L2 中
+constexpr size_t kChunkBytes = 64 * 1024;
+
+struct GammaTables
+{
+    uint8_t toSrgb[256];
+    uint8_t toLinear[256];
+
+    GammaTables()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            const float c = i / 255.0f;
+            const float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+            const float l = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            toSrgb[i]     = static_cast<uint8_t>(std::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+            toLinear[i]   = static_cast<uint8_t>(std::clamp(l * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+const GammaTables& getGammaTables()
+{
+    static const GammaTables tables;
+    return tables;
+}
+
+using RowFunc = void (*)(const uint8_t* src, uint8_t* dst, uint32_t width, const uint8_t* lut);
+
+// 每种组合单独实例化，内层循环中没有分支
+template <bool SwapRedBlue, bool DropAlpha, bool ApplyGamma>
+void transformRow(const uint8_t* src, uint8_t* dst, uint32_t width, const uint8_t* lut)
+{
+    uint32_t x = 0;
+
+#ifdef PIXEL_TRANSFORM_SSE2
+    // 拷贝、交换 R/B 和 4 -> 3 通道每次处理4个像素。gamma 是 256 项的查表，SSE2 没有 gather，仍然逐字节处理
+    if constexpr (!ApplyGamma)
+    {
+        const __m128i maskGA = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+        const __m128i maskR  = _mm_set1_epi32(0x000000FF);
+        // 每个 64 位中的两个像素：低像素的 RGB 留在 0~2 字节，高像素的 RGB 右移1字节到 3~5 字节
+        const __m128i maskLowRgb  = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+        const __m128i maskHighRgb = _mm_set_epi32(0x0000FFFF, static_cast<int>(0xFF000000), 0x0000FFFF, static_cast<int>(0xFF000000));
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + size_t(x) * 4));
+            if constexpr (SwapRedBlue)
+            {
+                const __m128i r = _mm_slli_epi32(_mm_and_si128(v, maskR), 16);
+                const __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), maskR);
+                v               = _mm_or_si128(_mm_and_si128(v, maskGA), _mm_or_si128(r, b));
+            }
+            if constexpr (DropAlpha)
+            {
+                // 两个 64 位各得到6字节，再把高 64 位的6字节接到低 64 位后面，共写出12字节
+                const __m128i packed = _mm_or_si128(_mm_and_si128(v, maskLowRgb), _mm_and_si128(_mm_srli_epi64(v, 8), maskHighRgb));
+                const __m128i rgb    = _mm_or_si128(_mm_move_epi64(packed), _mm_slli_si128(_mm_unpackhi_epi64(packed, packed), 6));
+                const uint32_t tail  = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(rgb, 8)));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + size_t(x) * 3), rgb);
+                memcpy(dst + size_t(x) * 3 + 8, &tail, sizeof(tail));
+            }
+            else
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + size_t(x) * 4), v);
+            }
+        }
+    }
+#endif
+
+    constexpr uint32_t dstChannels = DropAlpha ? 3 : 4;
+    for (; x < width; ++x)
+    {
+        const uint8_t* s = src + size_t(x) * 4;
+        uint8_t* d       = dst + size_t(x) * dstChannels;
+
+        uint8_t r = SwapRedBlue ? s[2] : s[0];
+        uint8_t g = s[1];
+        uint8_t b = SwapRedBlue ? s[0] : s[2];
+        if constexpr (ApplyGamma)
+        {
+            r = lut[r];
+            g = lut[g];
+            b = lut[b];
+        }
+
+        const uint8_t a = s[3]; // 先读出 alpha，dst 等于 src 时写入不会覆盖还没读的数据
+        d[0]            = r;
+        d[1]            = g;
+        d[2]            = b;
+        if constexpr (!DropAlpha)
+        {
+            d[3] = a;
+        }
+    }
+}
+
+RowFunc selectRowFunc(const PixelTransform& transform)
+{
+    static const RowFunc kFuncs[8] = {
+        transformRow<false, false, false>,
+        transformRow<false, false, true>,
+        transformRow<false, true, false>,
+        transformRow<false, true, true>,
+        transformRow<true, false, false>,
+        transformRow<true, false, true>,
+        transformRow<true, true, false>,
+        transformRow<true, true, true>,
+    };
+
+    const uint32_t index = (transform.swapRedBlue ? 4 : 0) | (transform.dropAlpha ? 2 : 0) | (transform.gamma != PixelTransform::Gamma::None ? 1 : 0);
+    return kFuncs[index];
+}
+} // namespace
+
+void transformPixels(
+    ThreadPool* threadPool,
+    const uint8_t* src,
+    uint32_t width,
+    uint32_t height,
+    uint32_t srcStride,
+    uint8_t* dst,
+    uint32_t dstStride,
+    const PixelTransform& transform
+)
+{
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+
+    const RowFunc rowFunc = selectRowFunc(transform);
+    const uint8_t* lut    = nullptr;
+    if (transform.gamma == PixelTransform::Gamma::LinearToSrgb)
+    {
+        lut = getGammaTables().toSrgb;
+    }
+    else if (transform.gamma == PixelTransform::Gamma::SrgbToLinear)
+    {
+        lut = getGammaTables().toLinear;
+    }
+
+    const uint32_t rowsPerChunk = static_cast<uint32_t>(std::max<size_t>(1, kChunkBytes / (size_t(width) * 4)));
+    const uint32_t numChunks    = (height + rowsPerChunk - 1) / rowsPerChunk;
+
+    auto processChunks = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; ++chunk)
+        {
+            const uint32_t rowBegin = chunk * rowsPerChunk;
+            const uint32_t rowEnd   = std::min(rowBegin + rowsPerChunk, height);
+            for (uint32_t y = rowBegin; y < rowEnd; ++y)
+            {
+                const uint32_t srcRow = transform.flipVertical ? height - 1 - y : y;
+                rowFunc(src + size_t(srcRow) * srcStride, dst + size_t(y) * dstStride, width, lut);
+            }
+        }
+    };
+
+    if (threadPool)
+    {
+        threadPool->parallelFor(numChunks, 1, processChunks);
+    }
+    else
+    {
+        processChunks(0, numChunks);
+    }
+}
@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include <cstdint>
+
+class ThreadPool;
+
+// 回读后的像素处理：上下翻转、交换 R/B、去掉 alpha、gamma 转换合并成一遍完成，
+// 不需要为每一步单独遍历一次整张图片
+struct PixelTransform
+{
+    enum class Gamma
+    {
+        None,
+        LinearToSrgb, // 渲染目标是线性的 RGBA8，保存成 sRGB 图片
+        SrgbToLinear,
+    };
+
+    bool flipVertical {false}; // 左下角为原点的后端（OpenGL）回读的行顺序是从下到上
+    bool swapRedBlue {false};  // BGRA8 <-> RGBA8
+    bool dropAlpha {false};    // 输出3通道
+    Gamma gamma {Gamma::None}; // 只作用于 RGB，alpha 不变
+};
+
+// 输入为 4 通道图片，输出为 4 或 3 通道（dropAlpha），stride 为每行字节数。
+// 按约 64KB 的行块处理，行块在线程池中并行，threadPool 为空时在调用线程中执行。
+// 不翻转、不去掉 alpha 并且 stride 相同时，dst 可以等于 src
+void transformPixels(
+    ThreadPool* threadPool,
+    const uint8_t* src,
+    uint32_t width,
+    uint32_t height,
+    uint32_t srcStride,
+    uint8_t* dst,
+    uint32_t dstStride,
+    const PixelTransform& transform
+);
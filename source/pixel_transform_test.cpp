@@ -0,0 +1,135 @@
+﻿#include "pixel_transform.h"
+#include "thread_pool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// transformPixels 的回归测试：SSE2 路径和逐像素的参考实现结果相同
+namespace {
+int g_failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        ++g_failures;
+    }
+}
+
+// 逐像素的参考实现，gamma 只检查不查表的组合，查表本身在 transformPixels 中是标量代码
+void referenceTransform(const uint8_t* src, uint32_t width, uint32_t height, uint32_t srcStride, uint8_t* dst, uint32_t dstStride, const PixelTransform& transform)
+{
+    const uint32_t dstChannels = transform.dropAlpha ? 3 : 4;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* srcRow = src + size_t(transform.flipVertical ? height - 1 - y : y) * srcStride;
+        uint8_t* dstRow       = dst + size_t(y) * dstStride;
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const uint8_t* s = srcRow + size_t(x) * 4;
+            uint8_t* d       = dstRow + size_t(x) * dstChannels;
+            d[0]             = transform.swapRedBlue ? s[2] : s[0];
+            d[1]             = s[1];
+            d[2]             = transform.swapRedBlue ? s[0] : s[2];
+            if (!transform.dropAlpha)
+            {
+                d[3] = s[3];
+            }
+        }
+    }
+}
+
+// 宽度覆盖不足4个像素和不是4的倍数的情况，行尾留出空隙检查没有越界写入
+void testMatchesReference(ThreadPool* threadPool, bool swapRedBlue, bool dropAlpha, bool flipVertical, const char* name)
+{
+    PixelTransform transform;
+    transform.swapRedBlue  = swapRedBlue;
+    transform.dropAlpha    = dropAlpha;
+    transform.flipVertical = flipVertical;
+
+    bool same = true;
+    for (uint32_t width = 1; width <= 37; ++width)
+    {
+        constexpr uint32_t kHeight = 5;
+        const uint32_t srcStride   = width * 4 + 8;
+        const uint32_t dstStride   = width * (dropAlpha ? 3 : 4) + 5;
+
+        std::vector<uint8_t> src(size_t(srcStride) * kHeight);
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            src[i] = static_cast<uint8_t>(i * 29 + i / 7);
+        }
+        std::vector<uint8_t> expected(size_t(dstStride) * kHeight, 0xCD);
+        std::vector<uint8_t> actual(size_t(dstStride) * kHeight, 0xCD);
+
+        referenceTransform(src.data(), width, kHeight, srcStride, expected.data(), dstStride, transform);
+        transformPixels(threadPool, src.data(), width, kHeight, srcStride, actual.data(), dstStride, transform);
+        same = same && expected == actual;
+    }
+
+    printf("%s\n", name);
+    check(same, "output matches the reference, padding is untouched");
+}
+
+// dst 等于 src 时原地转换
+void testInPlace()
+{
+    PixelTransform transform;
+    transform.swapRedBlue = true;
+
+    constexpr uint32_t kWidth = 13;
+    std::vector<uint8_t> pixels(kWidth * 4);
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        pixels[i] = static_cast<uint8_t>(i);
+    }
+    std::vector<uint8_t> expected(pixels.size());
+    referenceTransform(pixels.data(), kWidth, 1, kWidth * 4, expected.data(), kWidth * 4, transform);
+    transformPixels(nullptr, pixels.data(), kWidth, 1, kWidth * 4, pixels.data(), kWidth * 4, transform);
+
+    printf("in place\n");
+    check(pixels == expected, "in-place swap matches the reference");
+}
+
+// gamma 查表只作用于 RGB，alpha 不变，0 和 255 保持不变
+void testGamma()
+{
+    PixelTransform transform;
+    transform.dropAlpha = false;
+    transform.gamma     = PixelTransform::Gamma::LinearToSrgb;
+
+    const uint8_t src[] = {0, 255, 128, 77, 10, 20, 30, 200};
+    uint8_t dst[8];
+    transformPixels(nullptr, src, 2, 1, sizeof(src), dst, sizeof(dst), transform);
+
+    printf("gamma\n");
+    check(dst[0] == 0 && dst[1] == 255, "0 and 255 are unchanged");
+    check(dst[2] > 128 && dst[4] > 10, "linear to sRGB brightens mid tones");
+    check(dst[3] == 77 && dst[7] == 200, "alpha is unchanged");
+}
+} // namespace
+
+int main()
+{
+    ThreadPool threadPool;
+
+    testMatchesReference(nullptr, false, false, false, "copy");
+    testMatchesReference(nullptr, true, false, false, "swap R/B");
+    testMatchesReference(nullptr, false, true, false, "drop alpha");
+    testMatchesReference(nullptr, true, true, false, "swap R/B, drop alpha");
+    testMatchesReference(nullptr, false, true, true, "drop alpha, flip");
+    testMatchesReference(&threadPool, true, true, true, "swap R/B, drop alpha, flip, thread pool");
+    testInPlace();
+    testGamma();
+
+    if (g_failures != 0)
+    {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    printf("all passed\n");
+    return EXIT_SUCCESS;
+}
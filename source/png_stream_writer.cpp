@@ -0,0 +1,520 @@
+﻿#include "png_stream_writer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+constexpr uint32_t kWindowSize = 32768;           // deflate 最大回溯距离
+constexpr uint32_t kBufferSize = kWindowSize * 2; // 滑动窗口缓冲，写满后整体前移 kWindowSize
+constexpr uint32_t kHashSize   = 1u << 15;
+constexpr uint32_t kMinMatch   = 3;
+constexpr uint32_t kMaxMatch   = 258;
+constexpr size_t kChunkSize    = 64 * 1024; // 每个 IDAT 块的大小
+
+// deflate 固定 Huffman 编码和长度、距离码表，码字已经按位反转，可以直接低位在前写入
+struct DeflateTables
+{
+    uint16_t literalCode[288];
+    uint8_t literalLength[288];
+    uint16_t lengthSymbol[kMaxMatch + 1];
+    uint8_t distanceSymbol[512];
+
+    DeflateTables()
+    {
+        for (uint32_t i = 0; i < 288; ++i)
+        {
+            uint32_t code   = 0;
+            uint32_t length = 0;
+            if (i < 144)
+            {
+                code   = 0x30 + i;
+                length = 8;
+            }
+            else if (i < 256)
+            {
+                code   = 0x190 + (i - 144);
+                length = 9;
+            }
+            else if (i < 280)
+            {
+                code   = i - 256;
+                length = 7;
+            }
+            else
+            {
+                code   = 0xC0 + (i - 280);
+                length = 8;
+            }
+            literalCode[i]   = static_cast<uint16_t>(reverseBits(code, length));
+            literalLength[i] = static_cast<uint8_t>(length);
+        }
+
+        for (uint32_t length = kMinMatch; length <= kMaxMatch; ++length)
+        {
+            uint32_t symbol = 0;
+            while (symbol + 1 < 29 && kLengthBase[symbol + 1] <= length)
+            {
+                ++symbol;
+            }
+            lengthSymbol[length] = static_cast<uint16_t>(symbol);
+        }
+
+        // 和 zlib 一样：距离 <= 256 直接查表，更大的距离按 128 分段查表
+        for (uint32_t i = 0; i < 512; ++i)
+        {
+            const uint32_t distance = i < 256 ? i + 1 : ((i - 256) << 7) + 1;
+            uint32_t symbol         = 0;
+            while (symbol + 1 < 30 && kDistanceBase[symbol + 1] <= distance)
+            {
+                ++symbol;
+            }
+            distanceSymbol[i] = static_cast<uint8_t>(symbol);
+        }
+    }
+
+    static uint32_t reverseBits(uint32_t code, uint32_t length)
+    {
+        uint32_t result = 0;
+        for (uint32_t i = 0; i < length; ++i)
+        {
+            result = result << 1 | (code >> i & 1);
+        }
+        return result;
+    }
+
+    static constexpr uint16_t kLengthBase[29]   = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static constexpr uint8_t kLengthExtra[29]   = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static constexpr uint16_t kDistanceBase[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                                   193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static constexpr uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+};
+
+const DeflateTables& getDeflateTables()
+{
+    static const DeflateTables tables;
+    return tables;
+}
+
+struct CrcTable
+{
+    uint32_t table[256];
+
+    CrcTable()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    }
+};
+
+uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size)
+{
+    static const CrcTable crcTable;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = crcTable.table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+uint32_t updateAdler(uint32_t adler, const uint8_t* data, size_t size)
+{
+    // 每 5552 字节取一次模，和 zlib 相同，保证 32 位不溢出
+    uint32_t s1 = adler & 0xFFFF;
+    uint32_t s2 = adler >> 16;
+    while (size > 0)
+    {
+        const size_t n = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < n; ++i)
+        {
+            s1 += data[i];
+            s2 += s1;
+        }
+        s1 %= 65521;
+        s2 %= 65521;
+        data += n;
+        size -= n;
+    }
+    return s2 << 16 | s1;
+}
+
+void writeU32BE(uint8_t* dst, uint32_t value)
+{
+    dst[0] = static_cast<uint8_t>(value >> 24);
+    dst[1] = static_cast<uint8_t>(value >> 16);
+    dst[2] = static_cast<uint8_t>(value >> 8);
+    dst[3] = static_cast<uint8_t>(value);
+}
+
+uint32_t hash3(const uint8_t* p)
+{
+    return ((uint32_t(p[0]) << 10) ^ (uint32_t(p[1]) << 5) ^ p[2]) & (kHashSize - 1);
+}
+
+uint8_t paeth(int a, int b, int c)
+{
+    const int p  = a + b - c;
+    const int pa = abs(p - a);
+    const int pb = abs(p - b);
+    const int pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+    {
+        return static_cast<uint8_t>(a);
+    }
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+} // namespace
+
+PngStreamWriter::PngStreamWriter()  = default;
+PngStreamWriter::~PngStreamWriter() = default;
+
+bool PngStreamWriter::begin(uint32_t width, uint32_t height, uint32_t channels, Sink sink)
+{
+    if (width == 0 || height == 0 || channels < 1 || channels > 4 || !sink)
+    {
+        return false;
+    }
+
+    m_sink        = std::move(sink);
+    m_width       = width;
+    m_height      = height;
+    m_channels    = channels;
+    m_rowsWritten = 0;
+    m_failed      = false;
+    m_windowEnd   = 0;
+    m_position    = 0;
+    m_adler       = 1;
+    m_bitBuffer   = 0;
+    m_bitCount    = 0;
+
+    const size_t rowBytes = size_t(width) * channels;
+    m_prevRow.assign(rowBytes, 0);
+    for (auto& filtered : m_filtered)
+    {
+        filtered.resize(rowBytes + 1);
+    }
+    m_window.resize(kBufferSize);
+    m_hashHead.assign(kHashSize, -1);
+    m_hashPrev.assign(kWindowSize, -1);
+    m_output.clear();
+    m_output.reserve(kChunkSize + 1024);
+
+    static const uint8_t kSignature[8]  = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    static const uint8_t kColorTypes[5] = {0, 0, 4, 2, 6};
+
+    uint8_t header[13];
+    writeU32BE(header, width);
+    writeU32BE(header + 4, height);
+    header[8]  = 8; // 每个通道8位
+    header[9]  = kColorTypes[channels];
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+    if (!m_sink(kSignature, sizeof(kSignature)) || !writeChunk("IHDR", header, sizeof(header)))
+    {
+        m_failed = true;
+        return false;
+    }
+
+    // zlib 头，然后开始一个使用固定 Huffman 编码的 deflate 块，整个图片都在这个块中
+    m_output.push_back(0x78);
+    m_output.push_back(0x01);
+    putBits(0, 1);
+    putBits(1, 2);
+    return true;
+}
+
+bool PngStreamWriter::writeRows(const uint8_t* rows, uint32_t numRows, uint32_t stride)
+{
+    if (m_failed || m_rowsWritten + numRows > m_height)
+    {
+        return false;
+    }
+
+    stride = stride ? stride : m_width * m_channels;
+    for (uint32_t i = 0; i < numRows && !m_failed; ++i)
+    {
+        filterRow(rows + size_t(i) * stride);
+        ++m_rowsWritten;
+    }
+    return !m_failed;
+}
+
+bool PngStreamWriter::end()
+{
+    if (m_failed || m_rowsWritten != m_height)
+    {
+        return false;
+    }
+
+    compress(true);
+
+    // 结束当前块，再写一个只有结束符的最后一块
+    putLiteral(256);
+    putBits(1, 1);
+    putBits(1, 2);
+    putLiteral(256);
+    if (m_bitCount > 0)
+    {
+        putBits(0, 8 - m_bitCount);
+    }
+
+    uint8_t adler[4];
+    writeU32BE(adler, m_adler);
+    m_output.insert(m_output.end(), adler, adler + 4);
+
+    if (!flushChunk(true) || !writeChunk("IEND", nullptr, 0))
+    {
+        m_failed = true;
+    }
+
+    m_sink = nullptr;
+    return !m_failed;
+}
+
+void PngStreamWriter::filterRow(const uint8_t* row)
+{
+    // 和 stb_image_write 相同：5种滤波都试一遍，选残差绝对值之和最小的
+    const size_t rowBytes = size_t(m_width) * m_channels;
+    const uint32_t bpp    = m_channels;
+    const uint8_t* prev   = m_prevRow.data();
+
+    uint32_t bestFilter = 0;
+    uint64_t bestScore  = UINT64_MAX;
+    for (uint32_t filter = 0; filter < 5; ++filter)
+    {
+        uint8_t* out = m_filtered[filter].data();
+        out[0]       = static_cast<uint8_t>(filter);
+        out++;
+
+        for (size_t i = 0; i < rowBytes; ++i)
+        {
+            const int left    = i >= bpp ? row[i - bpp] : 0;
+            const int up      = prev[i];
+            const int upLeft  = i >= bpp ? prev[i - bpp] : 0;
+            uint8_t predicted = 0;
+            switch (filter)
+            {
+                case 1:
+                    predicted = static_cast<uint8_t>(left);
+                    break;
+                case 2:
+                    predicted = static_cast<uint8_t>(up);
+                    break;
+                case 3:
+                    predicted = static_cast<uint8_t>((left + up) >> 1);
+                    break;
+                case 4:
+                    predicted = paeth(left, up, upLeft);
+                    break;
+                default:
+                    break;
+            }
+            out[i] = static_cast<uint8_t>(row[i] - predicted);
+        }
+
+        uint64_t score = 0;
+        for (size_t i = 0; i < rowBytes; ++i)
+        {
+            score += abs(static_cast<int8_t>(out[i]));
+        }
+        if (score < bestScore)
+        {
+            bestScore  = score;
+            bestFilter = filter;
+        }
+    }
+
+    appendData(m_filtered[bestFilter].data(), rowBytes + 1);
+    memcpy(m_prevRow.data(), row, rowBytes);
+}
+
+void PngStreamWriter::appendData(const uint8_t* data, size_t size)
+{
+    m_adler = updateAdler(m_adler, data, size);
+    while (size > 0 && !m_failed)
+    {
+        if (m_windowEnd == kBufferSize)
+        {
+            compress(false);
+            slideWindow();
+        }
+
+        const size_t n = std::min<size_t>(size, kBufferSize - m_windowEnd);
+        memcpy(m_window.data() + m_windowEnd, data, n);
+        m_windowEnd += static_cast<uint32_t>(n);
+        data += n;
+        size -= n;
+    }
+}
+
+void PngStreamWriter::compress(bool flush)
+{
+    // 不是最后一次时保留 kMaxMatch 字节，保证匹配长度不会被缓冲边界截断
+    const uint32_t limit = flush ? m_windowEnd : (m_windowEnd > kMaxMatch ? m_windowEnd - kMaxMatch : 0);
+    const uint8_t* data  = m_window.data();
+
+    while (m_position < limit && !m_failed)
+    {
+        const uint32_t pos    = m_position;
+        uint32_t bestLength   = 0;
+        uint32_t bestDistance = 0;
+
+        if (pos + kMinMatch <= m_windowEnd)
+        {
+            const uint32_t h                    = hash3(data + pos);
+            int32_t candidate                   = m_hashHead[h];
+            m_hashPrev[pos & (kWindowSize - 1)] = candidate;
+            m_hashHead[h]                       = static_cast<int32_t>(pos);
+
+            const uint32_t maxLength = std::min(kMaxMatch, m_windowEnd - pos);
+            for (uint32_t chain = m_maxChain; candidate >= 0 && chain > 0; --chain)
+            {
+                const uint32_t distance = pos - static_cast<uint32_t>(candidate);
+                if (distance > kWindowSize)
+                {
+                    break;
+                }
+
+                // 先比较当前最长匹配的下一个字节，不相等时不可能更长
+                const uint8_t* a = data + candidate;
+                const uint8_t* b = data + pos;
+                if (a[bestLength] == b[bestLength])
+                {
+                    uint32_t length = 0;
+                    while (length < maxLength && a[length] == b[length])
+                    {
+                        ++length;
+                    }
+                    if (length > bestLength)
+                    {
+                        bestLength   = length;
+                        bestDistance = distance;
+                        if (length == maxLength)
+                        {
+                            break;
+                        }
+                    }
+                }
+
+                const int32_t next = m_hashPrev[candidate & (kWindowSize - 1)];
+                if (next >= candidate)
+                {
+                    break;
+                }
+                candidate = next;
+            }
+        }
+
+        if (bestLength >= kMinMatch)
+        {
+            putMatch(bestLength, bestDistance);
+
+            // 匹配覆盖的位置也加入哈希链
+            for (uint32_t i = pos + 1; i < pos + bestLength && i + kMinMatch <= m_windowEnd; ++i)
+            {
+                const uint32_t h                  = hash3(data + i);
+                m_hashPrev[i & (kWindowSize - 1)] = m_hashHead[h];
+                m_hashHead[h]                     = static_cast<int32_t>(i);
+            }
+            m_position += bestLength;
+        }
+        else
+        {
+            putLiteral(data[pos]);
+            m_position += 1;
+        }
+
+        if (m_output.size() >= kChunkSize)
+        {
+            flushChunk(false);
+        }
+    }
+}
+
+void PngStreamWriter::slideWindow()
+{
+    // 只保留最近 kWindowSize 字节，哈希表中的位置同步前移，移出窗口的位置置为 -1
+    memmove(m_window.data(), m_window.data() + kWindowSize, kBufferSize - kWindowSize);
+    m_windowEnd -= kWindowSize;
+    m_position -= kWindowSize;
+
+    const int32_t shift = static_cast<int32_t>(kWindowSize);
+    for (auto& head : m_hashHead)
+    {
+        head = head >= shift ? head - shift : -1;
+    }
+    for (auto& prev : m_hashPrev)
+    {
+        prev = prev >= shift ? prev - shift : -1;
+    }
+}
+
+void PngStreamWriter::putBits(uint32_t bits, uint32_t count)
+{
+    m_bitBuffer |= uint64_t(bits) << m_bitCount;
+    m_bitCount += count;
+    while (m_bitCount >= 8)
+    {
+        m_output.push_back(static_cast<uint8_t>(m_bitBuffer));
+        m_bitBuffer >>= 8;
+        m_bitCount -= 8;
+    }
+}
+
+void PngStreamWriter::putLiteral(uint32_t literal)
+{
+    const DeflateTables& tables = getDeflateTables();
+    putBits(tables.literalCode[literal], tables.literalLength[literal]);
+}
+
+void PngStreamWriter::putMatch(uint32_t length, uint32_t distance)
+{
+    const DeflateTables& tables = getDeflateTables();
+
+    const uint32_t lengthSymbol = tables.lengthSymbol[length];
+    putLiteral(257 + lengthSymbol);
+    putBits(length - DeflateTables::kLengthBase[lengthSymbol], DeflateTables::kLengthExtra[lengthSymbol]);
+
+    // 固定编码中距离码都是5位
+    const uint32_t distanceSymbol = tables.distanceSymbol[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)];
+    putBits(DeflateTables::reverseBits(distanceSymbol, 5), 5);
+    putBits(distance - DeflateTables::kDistanceBase[distanceSymbol], DeflateTables::kDistanceExtra[distanceSymbol]);
+}
+
+bool PngStreamWriter::flushChunk(bool force)
+{
+    if (m_output.empty() || (!force && m_output.size() < kChunkSize))
+    {
+        return !m_failed;
+    }
+
+    if (!writeChunk("IDAT", m_output.data(), m_output.size()))
+    {
+        m_failed = true;
+    }
+    m_output.clear();
+    return !m_failed;
+}
+
+bool PngStreamWriter::writeChunk(const char* type, const uint8_t* data, size_t size)
+{
+    uint8_t header[8];
+    writeU32BE(header, static_cast<uint32_t>(size));
+    memcpy(header + 4, type, 4);
+
+    uint32_t crc = updateCrc(0xFFFFFFFFu, header + 4, 4);
+    crc          = updateCrc(crc, data, size);
+
+    uint8_t footer[4];
+    writeU32BE(footer, crc ^ 0xFFFFFFFFu);
+
+    return m_sink(header, sizeof(header)) && (size == 0 || m_sink(data, size)) && m_sink(footer, sizeof(footer));
+}
@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// 流式 PNG 编码：按行（或行块）输入像素，边滤波边压缩，压缩数据攒够一个 IDAT 块就交给输出回调。
+// 和 stbi_write_png 不同，不需要整张图片的滤波缓冲、zlib 缓冲和输出缓冲，
+// 内存占用只有几行像素、64KB 滑动窗口缓冲和一个 IDAT 块，适合分块渲染和分批回读的超大图片
+class PngStreamWriter
+{
+public:
+    // 输出回调，返回 false 时停止编码（例如磁盘写满）
+    using Sink = std::function<bool(const uint8_t* data, size_t size)>;
+
+    PngStreamWriter();
+    ~PngStreamWriter();
+
+    PngStreamWriter(const PngStreamWriter&)            = delete;
+    PngStreamWriter& operator=(const PngStreamWriter&) = delete;
+
+    // channels 为 1（灰度）、2（灰度 + alpha）、3（RGB）、4（RGBA），写入 PNG 文件头
+    bool begin(uint32_t width, uint32_t height, uint32_t channels, Sink sink);
+
+    // 写入若干行，stride 为0时按紧密排列处理，行数累计不能超过 height
+    bool writeRows(const uint8_t* rows, uint32_t numRows, uint32_t stride = 0);
+
+    // 结束压缩流，写入最后的 IDAT 块和 IEND。写入的行数不等于 height 时返回 false
+    bool end();
+
+    // 哈希链最多比较的次数，越大压缩率越高、速度越慢，默认 32
+    void setMaxChainLength(uint32_t length)
+    {
+        m_maxChain = length;
+    }
+
+private:
+    void filterRow(const uint8_t* row);
+    void appendData(const uint8_t* data, size_t size);
+    void compress(bool flush);
+    void slideWindow();
+    void putBits(uint32_t bits, uint32_t count);
+    void putLiteral(uint32_t literal);
+    void putMatch(uint32_t length, uint32_t distance);
+    bool flushChunk(bool force);
+    bool writeChunk(const char* type, const uint8_t* data, size_t size);
+
+    Sink m_sink;
+    uint32_t m_width {0};
+    uint32_t m_height {0};
+    uint32_t m_channels {0};
+    uint32_t m_rowsWritten {0};
+    uint32_t m_maxChain {32};
+    bool m_failed {false};
+
+    // 滤波：上一行和当前行的原始像素，以及5种滤波方式的结果
+    std::vector<uint8_t> m_prevRow;
+    std::vector<uint8_t> m_filtered[5];
+
+    // LZ77 滑动窗口，m_window 中 [0, m_windowEnd) 为已经输入的数据，m_position 之前的已经压缩
+    std::vector<uint8_t> m_window;
+    uint32_t m_windowEnd {0};
+    uint32_t m_position {0};
+    std::vector<int32_t> m_hashHead;
+    std::vector<int32_t> m_hashPrev;
+    uint32_t m_adler {1};
+
+    // 压缩输出
+    std::vector<uint8_t> m_output;
+    uint64_t m_bitBuffer {0};
+    uint32_t m_bitCount {0};
+};
@@ -0,0 +1,44 @@
+﻿#include "process_memory.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef _WIN32
+
+uint64_t getPeakMemoryKb()
+{
+    PROCESS_MEMORY_COUNTERS counters {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize / 1024;
+}
+
+#else
+
+uint64_t getPeakMemoryKb()
+{
+    rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return uint64_t(usage.ru_maxrss) / 1024; // macOS 为字节
+#else
+    return uint64_t(usage.ru_maxrss);
+#endif
+}
+
+#endif
@@ -0,0 +1,7 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// 当前进程的峰值常驻内存（Windows 为 PeakWorkingSetSize，其他平台为 getrusage 的 ru_maxrss），单位 KB，取不到时返回0。
+// 性能测试在结果中输出，用于发现内存占用的回退
+uint64_t getPeakMemoryKb();
@@ -0,0 +1,332 @@
+﻿#include "qoi_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define QOI_SSE2 1
+#endif
+
+namespace {
+constexpr uint8_t kOpIndex    = 0x00;
+constexpr uint8_t kOpDiff     = 0x40;
+constexpr uint8_t kOpLuma     = 0x80;
+constexpr uint8_t kOpRun      = 0xC0;
+constexpr uint8_t kOpRgb      = 0xFE;
+constexpr uint8_t kOpRgba     = 0xFF;
+constexpr uint8_t kMask2      = 0xC0;
+constexpr uint32_t kMaxRun    = 62;
+constexpr size_t kHeaderSize  = 14;
+constexpr uint8_t kPadding[8] = {0, 0, 0, 0, 0, 0, 0, 1}; // 文件结尾标记
+
+// 像素按 r、g、b、a 的顺序存放在 uint32_t 的内存中（和 RGBA8 图片相同），只做相等比较和按字节读取
+struct Pixel
+{
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+uint32_t toU32(Pixel px)
+{
+    uint32_t value;
+    memcpy(&value, &px, 4);
+    return value;
+}
+
+uint32_t hashPixel(Pixel px)
+{
+    return (px.r * 3u + px.g * 5u + px.b * 7u + px.a * 11u) & 63;
+}
+
+void writeU32BE(uint8_t* dst, uint32_t value)
+{
+    dst[0] = static_cast<uint8_t>(value >> 24);
+    dst[1] = static_cast<uint8_t>(value >> 16);
+    dst[2] = static_cast<uint8_t>(value >> 8);
+    dst[3] = static_cast<uint8_t>(value);
+}
+
+uint32_t readU32BE(const uint8_t* src)
+{
+    return uint32_t(src[0]) << 24 | uint32_t(src[1]) << 16 | uint32_t(src[2]) << 8 | src[3];
+}
+
+template <uint32_t Channels>
+Pixel loadPixel(const uint8_t* src)
+{
+    Pixel px;
+    px.r = src[0];
+    px.g = src[1];
+    px.b = src[2];
+    px.a = Channels == 4 ? src[3] : 255;
+    return px;
+}
+
+// 从 src 开始和 value 相同的像素个数，最多 count 个。截图的背景是大片纯色，SSE2 每次比较4个像素
+template <uint32_t Channels>
+uint32_t countRun(const uint8_t* src, uint32_t count, Pixel value)
+{
+    const uint32_t ref = toU32(value);
+    uint32_t n         = 0;
+#ifdef QOI_SSE2
+    if constexpr (Channels == 4)
+    {
+        const __m128i refs = _mm_set1_epi32(static_cast<int>(ref));
+        for (; n + 4 <= count; n += 4)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + size_t(n) * 4));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, refs)) != 0xFFFF)
+            {
+                break; // 剩下不到4个相同的像素由下面逐个比较
+            }
+        }
+    }
+#endif
+    while (n < count && toU32(loadPixel<Channels>(src + size_t(n) * Channels)) == ref)
+    {
+        ++n;
+    }
+    return n;
+}
+
+template <uint32_t Channels>
+uint8_t* encodePixels(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t stride, uint8_t* out)
+{
+    Pixel index[64] {};
+    Pixel prev {0, 0, 0, 255};
+    uint32_t run = 0;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = pixels + size_t(y) * stride;
+        for (uint32_t x = 0; x < width;)
+        {
+            const Pixel px = loadPixel<Channels>(row + size_t(x) * Channels);
+            if (toU32(px) == toU32(prev))
+            {
+                // 游程可以跨行，满 kMaxRun 个输出一次
+                const uint32_t n = 1 + countRun<Channels>(row + size_t(x + 1) * Channels, width - x - 1, prev);
+                run += n;
+                x += n;
+                while (run >= kMaxRun)
+                {
+                    *out++ = kOpRun | (kMaxRun - 1);
+                    run -= kMaxRun;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                *out++ = static_cast<uint8_t>(kOpRun | (run - 1));
+                run    = 0;
+            }
+
+            const uint32_t hash = hashPixel(px);
+            if (toU32(index[hash]) == toU32(px))
+            {
+                *out++ = static_cast<uint8_t>(kOpIndex | hash);
+            }
+            else
+            {
+                index[hash] = px;
+                if (px.a == prev.a)
+                {
+                    const int8_t vr   = static_cast<int8_t>(px.r - prev.r);
+                    const int8_t vg   = static_cast<int8_t>(px.g - prev.g);
+                    const int8_t vb   = static_cast<int8_t>(px.b - prev.b);
+                    const int8_t vg_r = static_cast<int8_t>(vr - vg);
+                    const int8_t vg_b = static_cast<int8_t>(vb - vg);
+
+                    if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1)
+                    {
+                        *out++ = static_cast<uint8_t>(kOpDiff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                    }
+                    else if (vg_r >= -8 && vg_r <= 7 && vg >= -32 && vg <= 31 && vg_b >= -8 && vg_b <= 7)
+                    {
+                        *out++ = static_cast<uint8_t>(kOpLuma | (vg + 32));
+                        *out++ = static_cast<uint8_t>((vg_r + 8) << 4 | (vg_b + 8));
+                    }
+                    else
+                    {
+                        *out++ = kOpRgb;
+                        *out++ = px.r;
+                        *out++ = px.g;
+                        *out++ = px.b;
+                    }
+                }
+                else
+                {
+                    *out++ = kOpRgba;
+                    *out++ = px.r;
+                    *out++ = px.g;
+                    *out++ = px.b;
+                    *out++ = px.a;
+                }
+            }
+
+            prev = px;
+            ++x;
+        }
+    }
+
+    if (run > 0)
+    {
+        *out++ = static_cast<uint8_t>(kOpRun | (run - 1));
+    }
+    return out;
+}
+
+template <uint32_t Channels>
+bool decodePixels(const uint8_t* data, const uint8_t* end, uint8_t* dst, size_t pixelCount)
+{
+    Pixel index[64] {};
+    Pixel px {0, 0, 0, 255};
+
+    for (size_t i = 0; i < pixelCount;)
+    {
+        if (data >= end)
+        {
+            return false;
+        }
+
+        const uint8_t op = *data++;
+        uint32_t count   = 1;
+        if (op == kOpRgb)
+        {
+            if (end - data < 3)
+            {
+                return false;
+            }
+            px.r = data[0];
+            px.g = data[1];
+            px.b = data[2];
+            data += 3;
+        }
+        else if (op == kOpRgba)
+        {
+            if (end - data < 4)
+            {
+                return false;
+            }
+            px.r = data[0];
+            px.g = data[1];
+            px.b = data[2];
+            px.a = data[3];
+            data += 4;
+        }
+        else if ((op & kMask2) == kOpIndex)
+        {
+            px = index[op];
+        }
+        else if ((op & kMask2) == kOpDiff)
+        {
+            px.r = static_cast<uint8_t>(px.r + ((op >> 4) & 3) - 2);
+            px.g = static_cast<uint8_t>(px.g + ((op >> 2) & 3) - 2);
+            px.b = static_cast<uint8_t>(px.b + (op & 3) - 2);
+        }
+        else if ((op & kMask2) == kOpLuma)
+        {
+            if (data >= end)
+            {
+                return false;
+            }
+            const int vg       = (op & 0x3F) - 32;
+            const uint8_t next = *data++;
+            px.r               = static_cast<uint8_t>(px.r + vg - 8 + (next >> 4));
+            px.g               = static_cast<uint8_t>(px.g + vg);
+            px.b               = static_cast<uint8_t>(px.b + vg - 8 + (next & 0x0F));
+        }
+        else
+        {
+            count = std::min<size_t>((op & 0x3F) + 1, pixelCount - i);
+        }
+
+        index[hashPixel(px)] = px;
+
+        uint8_t* out = dst + i * Channels;
+        if constexpr (Channels == 4)
+        {
+            const uint32_t value = toU32(px);
+            for (uint32_t k = 0; k < count; ++k)
+            {
+                memcpy(out + k * 4, &value, 4);
+            }
+        }
+        else
+        {
+            for (uint32_t k = 0; k < count; ++k)
+            {
+                out[k * 3 + 0] = px.r;
+                out[k * 3 + 1] = px.g;
+                out[k * 3 + 2] = px.b;
+            }
+        }
+        i += count;
+    }
+    return true;
+}
+} // namespace
+
+bool qoiEncode(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, uint32_t stride, std::vector<uint8_t>& output)
+{
+    output.clear();
+    if (!pixels || width == 0 || height == 0 || (channels != 3 && channels != 4))
+    {
+        return false;
+    }
+
+    // 最坏情况每个像素都是 QOI_OP_RGBA
+    stride               = stride ? stride : width * channels;
+    const size_t maxSize = kHeaderSize + size_t(width) * height * (channels + 1) + sizeof(kPadding);
+    output.resize(maxSize);
+
+    uint8_t* out = output.data();
+    memcpy(out, "qoif", 4);
+    writeU32BE(out + 4, width);
+    writeU32BE(out + 8, height);
+    out[12] = static_cast<uint8_t>(channels);
+    out[13] = 0;
+    out += kHeaderSize;
+
+    out = channels == 4 ? encodePixels<4>(pixels, width, height, stride, out) : encodePixels<3>(pixels, width, height, stride, out);
+
+    memcpy(out, kPadding, sizeof(kPadding));
+    out += sizeof(kPadding);
+
+    // resize 缩小不会释放容量
+    output.resize(out - output.data());
+    return true;
+}
+
+bool qoiReadHeader(const uint8_t* data, size_t size, QoiHeader& header)
+{
+    if (!data || size < kHeaderSize + sizeof(kPadding) || memcmp(data, "qoif", 4) != 0)
+    {
+        return false;
+    }
+
+    header.width      = readU32BE(data + 4);
+    header.height     = readU32BE(data + 8);
+    header.channels   = data[12];
+    header.colorspace = data[13];
+    return header.width > 0 && header.height > 0 && (header.channels == 3 || header.channels == 4) && header.colorspace <= 1;
+}
+
+bool qoiDecode(const uint8_t* data, size_t size, uint8_t* dst, uint32_t dstChannels)
+{
+    QoiHeader header;
+    if (!dst || !qoiReadHeader(data, size, header) || (dstChannels != 3 && dstChannels != 4))
+    {
+        return false;
+    }
+
+    // 数据中的末尾标记不参与解码
+    const uint8_t* begin    = data + kHeaderSize;
+    const uint8_t* end      = data + size - sizeof(kPadding);
+    const size_t pixelCount = size_t(header.width) * header.height;
+    return dstChannels == 4 ? decodePixels<4>(begin, end, dst, pixelCount) : decodePixels<3>(begin, end, dst, pixelCount);
+}
@@ -0,0 +1,25 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// QOI 无损图片格式（https://qoiformat.org），编码、解码都只需要遍历一次像素，
+// 速度是 PNG 的几十倍，压缩率接近 PNG 的默认级别，适合只写一次、读一次的中间截图
+struct QoiHeader
+{
+    uint32_t width {0};
+    uint32_t height {0};
+    uint8_t channels {0};   // 3 = RGB, 4 = RGBA
+    uint8_t colorspace {0}; // 0 = sRGB（alpha 线性），1 = 全部线性
+};
+
+// 编码一张 3 或 4 通道的图片，stride 为0时按紧密排列处理。
+// output 先清空再写入，调用方复用同一个 vector 时连续编码相同尺寸的图片不会再申请内存
+bool qoiEncode(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, uint32_t stride, std::vector<uint8_t>& output);
+
+// 解析文件头，data 不是 QOI 数据时返回 false
+bool qoiReadHeader(const uint8_t* data, size_t size, QoiHeader& header);
+
+// 解码到 dst（width * height * dstChannels 字节），dstChannels 为 3 或 4，和文件中的通道数无关
+bool qoiDecode(const uint8_t* data, size_t size, uint8_t* dst, uint32_t dstChannels);
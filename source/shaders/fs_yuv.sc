@@ -0,0 +1,21 @@
+$input v_texcoord0
+
+#include <bgfx_shader.sh>
+
+SAMPLER2D(s_texColor, 0);
+
+// x: 0 = luma plane (R8), 1 = interleaved chroma plane (RG8, half resolution)
+uniform vec4 u_yuvParams;
+
+void main()
+{
+	// BT.709, limited range
+	vec3 rgb = texture2D(s_texColor, v_texcoord0).rgb;
+	float y  = dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+	float cb = (rgb.b - y) / 1.8556;
+	float cr = (rgb.r - y) / 1.5748;
+
+	vec4 luma   = vec4((16.0 + 219.0 * y) / 255.0, 0.0, 0.0, 1.0);
+	vec4 chroma = vec4((128.0 + 224.0 * cb) / 255.0, (128.0 + 224.0 * cr) / 255.0, 0.0, 1.0);
+	gl_FragColor = u_yuvParams.x < 0.5 ? luma : chroma;
+}
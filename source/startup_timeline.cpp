@@ -0,0 +1,58 @@
+﻿#include "startup_timeline.h"
+#include "trace.h"
+
+#include <algorithm>
+
+StartupTimeline::StartupTimeline()
+    : m_start(std::chrono::steady_clock::now())
+{
+    m_phases.reserve(32);
+}
+
+double StartupTimeline::now() const
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+void StartupTimeline::mark(const char* name)
+{
+    const double nowMs = now();
+    record(name, m_lastMarkMs, nowMs, false);
+    m_lastMarkMs = nowMs;
+}
+
+void StartupTimeline::record(const char* name, double beginMs, double endMs, bool worker)
+{
+#ifdef ENABLE_TRACE
+    // trace 的时间是 steady_clock 的纳秒数
+    const auto startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(m_start.time_since_epoch()).count();
+    trace::record(name, uint64_t(startNs + beginMs * 1.0e6), uint64_t(startNs + endMs * 1.0e6));
+#endif
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_phases.push_back({name, beginMs, endMs, worker});
+}
+
+void StartupTimeline::markFirstFrame()
+{
+    mark("first frame");
+    m_firstFrameMs = m_lastMarkMs;
+}
+
+void StartupTimeline::print(FILE* file) const
+{
+    std::vector<Phase> phases;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        phases = m_phases;
+    }
+    std::stable_sort(phases.begin(), phases.end(), [](const Phase& a, const Phase& b) { return a.beginMs < b.beginMs; });
+
+    fprintf(file, "startup timeline (ms, * = worker thread):\n");
+    fprintf(file, "  %10s %10s %10s\n", "begin", "end", "duration");
+    for (const Phase& phase : phases)
+    {
+        fprintf(file, "  %10.2f %10.2f %10.2f  %s%s\n", phase.beginMs, phase.endMs, phase.endMs - phase.beginMs, phase.worker ? "* " : "", phase.name);
+    }
+    fprintf(file, "time to first frame: %.2f ms\n", m_firstFrameMs);
+}
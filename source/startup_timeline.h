@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+// 启动阶段的时间线，在 main 的开头构造，时间都是相对构造时刻的毫秒数。
+// 主线程上顺序执行的阶段（创建窗口、bgfx::init、创建资源……）用 mark() 记录，
+// 工作线程中和它们并行执行的任务（读取着色器、解码纹理）用 Scope 或 record() 记录。
+// 第一次 bgfx::frame() 返回后调用 markFirstFrame()，print() 输出每个阶段的起止时间和启动到第一帧的耗时。
+// 定义了 ENABLE_TRACE 时同时写入 trace 时间线
+class StartupTimeline
+{
+public:
+    struct Phase
+    {
+        const char* name; // 必须是字符串字面量
+        double beginMs;
+        double endMs;
+        bool worker; // 是否在工作线程中执行
+    };
+
+    // 记录所在作用域的耗时，用于工作线程中的任务
+    class Scope
+    {
+    public:
+        Scope(StartupTimeline& timeline, const char* name)
+            : m_timeline(timeline)
+            , m_name(name)
+            , m_beginMs(timeline.now())
+        {
+        }
+
+        ~Scope()
+        {
+            m_timeline.record(m_name, m_beginMs, m_timeline.now(), true);
+        }
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StartupTimeline& m_timeline;
+        const char* m_name;
+        double m_beginMs;
+    };
+
+    StartupTimeline();
+
+    double now() const;
+
+    // 主线程：记录从上一次 mark() 到现在的阶段
+    void mark(const char* name);
+
+    // 线程安全
+    void record(const char* name, double beginMs, double endMs, bool worker);
+
+    void markFirstFrame();
+
+    // 还没有调用 markFirstFrame() 时返回0
+    double getTimeToFirstFrame() const
+    {
+        return m_firstFrameMs;
+    }
+
+    // 按开始时间排序输出，工作线程中的任务前面加 *
+    void print(FILE* file) const;
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+    double m_lastMarkMs {0.0};
+    double m_firstFrameMs {0.0};
+    mutable std::mutex m_mutex;
+    std::vector<Phase> m_phases;
+};
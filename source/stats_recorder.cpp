@@ -0,0 +1,243 @@
+﻿#include "stats_recorder.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+// 写线程没有被唤醒时，每隔这么久检查一次环形缓冲
+constexpr auto kFlushInterval = std::chrono::milliseconds(100);
+
+float toMs(int64_t ticks, int64_t frequency)
+{
+    return frequency > 0 ? float(double(ticks) * 1000.0 / double(frequency)) : 0.0f;
+}
+} // namespace
+
+StatsRecorder::StatsRecorder(uint32_t capacity)
+    : m_ring(std::max<uint32_t>(capacity, 2))
+{
+}
+
+StatsRecorder::~StatsRecorder()
+{
+    close();
+}
+
+bool StatsRecorder::open(const char* filePath, Format format)
+{
+    close();
+
+    m_file = fopen(filePath, "w");
+    if (!m_file)
+    {
+        return false;
+    }
+
+    m_format = format;
+    m_stop   = false;
+    m_writeIndex.store(0);
+    m_readIndex.store(0);
+    m_dropped.store(0);
+    writeHeader();
+    m_writer = std::thread(&StatsRecorder::writerLoop, this);
+    return true;
+}
+
+void StatsRecorder::close()
+{
+    if (!m_file)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_writer.join();
+
+    if (m_format == Format::Json)
+    {
+        fprintf(m_file, "\n]\n");
+    }
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void StatsRecorder::sample(uint64_t frame)
+{
+    if (isEnabled())
+    {
+        sample(frame, *bgfx::getStats());
+    }
+}
+
+void StatsRecorder::sample(uint64_t frame, const bgfx::Stats& stats)
+{
+    if (!m_file || !isEnabled())
+    {
+        return;
+    }
+
+    // 单生产者单消费者：只有这里写 m_writeIndex，只有写线程写 m_readIndex
+    const uint64_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+    const uint64_t readIndex  = m_readIndex.load(std::memory_order_acquire);
+    if (writeIndex - readIndex >= m_ring.size())
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Sample& entry           = m_ring[writeIndex % m_ring.size()];
+    entry.frame             = frame;
+    entry.cpuFrameMs        = toMs(stats.cpuTimeFrame, stats.cpuTimerFreq);
+    entry.gpuFrameMs        = toMs(stats.gpuTimeEnd - stats.gpuTimeBegin, stats.gpuTimerFreq);
+    entry.waitRenderMs      = toMs(stats.waitRender, stats.cpuTimerFreq);
+    entry.waitSubmitMs      = toMs(stats.waitSubmit, stats.cpuTimerFreq);
+    entry.numDraw           = stats.numDraw;
+    entry.numCompute        = stats.numCompute;
+    entry.numBlit           = stats.numBlit;
+    entry.transientVbUsed   = stats.transientVbUsed;
+    entry.transientIbUsed   = stats.transientIbUsed;
+    entry.textureMemoryUsed = stats.textureMemoryUsed;
+    entry.rtMemoryUsed      = stats.rtMemoryUsed;
+    entry.gpuMemoryUsed     = stats.gpuMemoryUsed;
+    entry.numViews          = std::min(stats.numViews, kMaxViews);
+    for (uint16_t i = 0; i < entry.numViews; ++i)
+    {
+        const bgfx::ViewStats& viewStats = stats.viewStats[i];
+        entry.views[i].view              = viewStats.view;
+        entry.views[i].cpuMs             = toMs(viewStats.cpuTimeEnd - viewStats.cpuTimeBegin, stats.cpuTimerFreq);
+        entry.views[i].gpuMs             = toMs(viewStats.gpuTimeEnd - viewStats.gpuTimeBegin, stats.gpuTimerFreq);
+
+        char* name = entry.views[i].name;
+        strncpy(name, viewStats.name, sizeof(entry.views[i].name) - 1);
+        name[sizeof(entry.views[i].name) - 1] = '\0';
+    }
+
+    m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+
+    // 缓冲过半时提前唤醒写线程，notify 不需要加锁
+    if (writeIndex + 1 - readIndex == m_ring.size() / 2)
+    {
+        m_cv.notify_one();
+    }
+}
+
+StatsRecorder::Stats StatsRecorder::getStats() const
+{
+    Stats stats;
+    stats.written  = m_readIndex.load(std::memory_order_acquire);
+    stats.recorded = m_writeIndex.load(std::memory_order_acquire);
+    stats.dropped  = m_dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void StatsRecorder::writerLoop()
+{
+    bool stop = false;
+    while (!stop)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait_for(lock, kFlushInterval, [this] { return m_stop; });
+            stop = m_stop;
+        }
+
+        const uint64_t writeIndex = m_writeIndex.load(std::memory_order_acquire);
+        uint64_t readIndex        = m_readIndex.load(std::memory_order_relaxed);
+        if (readIndex == writeIndex)
+        {
+            continue;
+        }
+
+        for (; readIndex < writeIndex; ++readIndex)
+        {
+            writeSample(m_ring[readIndex % m_ring.size()], readIndex == 0);
+            // 逐条归还，渲染线程可以尽早复用这个位置
+            m_readIndex.store(readIndex + 1, std::memory_order_release);
+        }
+        fflush(m_file);
+    }
+}
+
+void StatsRecorder::writeHeader()
+{
+    if (m_format == Format::Csv)
+    {
+        fprintf(
+            m_file,
+            "frame,cpu_frame_ms,gpu_frame_ms,wait_render_ms,wait_submit_ms,num_draw,num_compute,num_blit,"
+            "transient_vb_used,transient_ib_used,texture_memory,rt_memory,gpu_memory,views\n"
+        );
+    }
+    else
+    {
+        fprintf(m_file, "[");
+    }
+}
+
+void StatsRecorder::writeSample(const Sample& sample, bool first)
+{
+    if (m_format == Format::Csv)
+    {
+        fprintf(
+            m_file,
+            "%llu,%.4f,%.4f,%.4f,%.4f,%u,%u,%u,%d,%d,%lld,%lld,%lld,",
+            static_cast<unsigned long long>(sample.frame),
+            sample.cpuFrameMs,
+            sample.gpuFrameMs,
+            sample.waitRenderMs,
+            sample.waitSubmitMs,
+            sample.numDraw,
+            sample.numCompute,
+            sample.numBlit,
+            sample.transientVbUsed,
+            sample.transientIbUsed,
+            static_cast<long long>(sample.textureMemoryUsed),
+            static_cast<long long>(sample.rtMemoryUsed),
+            static_cast<long long>(sample.gpuMemoryUsed)
+        );
+
+        // 每个 view 写成 "id:cpu:gpu"，用空格分隔
+        for (uint16_t i = 0; i < sample.numViews; ++i)
+        {
+            const ViewSample& view = sample.views[i];
+            fprintf(m_file, "%s%u:%.4f:%.4f", i == 0 ? "" : " ", view.view, view.cpuMs, view.gpuMs);
+        }
+        fprintf(m_file, "\n");
+        return;
+    }
+
+    fprintf(
+        m_file,
+        "%s\n  {\"frame\": %llu, \"cpu_frame_ms\": %.4f, \"gpu_frame_ms\": %.4f, \"wait_render_ms\": %.4f, \"wait_submit_ms\": %.4f, "
+        "\"num_draw\": %u, \"num_compute\": %u, \"num_blit\": %u, \"transient_vb_used\": %d, \"transient_ib_used\": %d, "
+        "\"texture_memory\": %lld, \"rt_memory\": %lld, \"gpu_memory\": %lld, \"views\": [",
+        first ? "" : ",",
+        static_cast<unsigned long long>(sample.frame),
+        sample.cpuFrameMs,
+        sample.gpuFrameMs,
+        sample.waitRenderMs,
+        sample.waitSubmitMs,
+        sample.numDraw,
+        sample.numCompute,
+        sample.numBlit,
+        sample.transientVbUsed,
+        sample.transientIbUsed,
+        static_cast<long long>(sample.textureMemoryUsed),
+        static_cast<long long>(sample.rtMemoryUsed),
+        static_cast<long long>(sample.gpuMemoryUsed)
+    );
+    for (uint16_t i = 0; i < sample.numViews; ++i)
+    {
+        const ViewSample& view = sample.views[i];
+        fprintf(m_file, "%s{\"view\": %u, \"name\": ", i == 0 ? "" : ", ", view.view);
+        writeJsonString(m_file, view.name);
+        fprintf(m_file, ", \"cpu_ms\": %.4f, \"gpu_ms\": %.4f}", view.cpuMs, view.gpuMs);
+    }
+    fprintf(m_file, "]}");
+}
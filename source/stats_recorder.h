@@ -0,0 +1,109 @@
+﻿#pragma once
+
+#include "bgfx/bgfx.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 每帧记录一次 bgfx::Stats（帧时间、绘制次数、瞬态缓冲和显存占用、各个 view 的耗时），
+// 放入预先分配的环形缓冲，由后台线程写入 CSV 或 JSON 文件。
+// sample() 只拷贝数值，不分配内存、不加锁、不做文件 IO，可以每帧在渲染线程中调用。
+// 写线程来不及消费时丢弃新的记录，getStats().dropped 为丢弃的数量
+class StatsRecorder
+{
+public:
+    enum class Format
+    {
+        Csv,
+        Json,
+    };
+
+    static constexpr uint16_t kMaxViews = 16;
+
+    struct ViewSample
+    {
+        bgfx::ViewId view;
+        char name[32]; // bgfx::setViewName 设置的名字，只写入 JSON
+        float cpuMs;
+        float gpuMs;
+    };
+
+    struct Sample
+    {
+        uint64_t frame;
+        float cpuFrameMs;
+        float gpuFrameMs;
+        float waitRenderMs;
+        float waitSubmitMs;
+        uint32_t numDraw;
+        uint32_t numCompute;
+        uint32_t numBlit;
+        int32_t transientVbUsed;
+        int32_t transientIbUsed;
+        int64_t textureMemoryUsed;
+        int64_t rtMemoryUsed;
+        int64_t gpuMemoryUsed;
+        uint16_t numViews; // 超过 kMaxViews 的 view 不记录
+        ViewSample views[kMaxViews];
+    };
+
+    struct Stats
+    {
+        uint64_t recorded {0};
+        uint64_t written {0};
+        uint64_t dropped {0};
+    };
+
+    // capacity 为环形缓冲可以容纳的帧数
+    explicit StatsRecorder(uint32_t capacity = 1024);
+    ~StatsRecorder();
+
+    StatsRecorder(const StatsRecorder&)            = delete;
+    StatsRecorder& operator=(const StatsRecorder&) = delete;
+
+    // 打开输出文件并启动写线程，打开失败时返回 false
+    bool open(const char* filePath, Format format);
+
+    // 写完缓冲中剩余的记录后关闭文件
+    void close();
+
+    // 运行时开关，关闭时 sample() 直接返回。各个 view 的耗时需要 bgfx::setDebug(BGFX_DEBUG_PROFILER)
+    void setEnabled(bool enabled)
+    {
+        m_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    // 在 bgfx::frame() 之后调用，记录 bgfx::getStats() 返回的上一帧统计
+    void sample(uint64_t frame);
+    void sample(uint64_t frame, const bgfx::Stats& stats);
+
+    Stats getStats() const;
+
+private:
+    void writerLoop();
+    void writeHeader();
+    void writeSample(const Sample& sample, bool first);
+
+    std::vector<Sample> m_ring;
+    std::atomic<uint64_t> m_writeIndex {0};
+    std::atomic<uint64_t> m_readIndex {0};
+    std::atomic<uint64_t> m_dropped {0};
+    std::atomic<bool> m_enabled {true};
+
+    FILE* m_file {nullptr};
+    Format m_format {Format::Csv};
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stop {false};
+};
@@ -325,6 +325,27 @@ publish, and distribute this file as you see fit.
 // STBI_JPEG_OLD, but this will disable some of the SIMD decoding path
 // and hence cost some performance.
 //
+// The PNG decoder uses the same SSE2 switch to unfilter 8-bit RGB/RGBA rows,
+// and decodes pairs of short literal codes with a single table lookup in the
+// inflate loop. Both produce byte-identical output to the scalar code.
+//
+// When the compiler targets AVX2 (/arch:AVX2, -mavx2), the JPEG IDCT runs two
+// 8x8 blocks per call and YCbCr-to-RGB converts 16 pixels per iteration; the
+// results are identical to SSE2. Define STBI_NO_AVX2 to keep the SSE2 kernels.
+//
+// ===========================================================================
+//
+// Parallel JPEG decoding
+//
+// Baseline JPEGs with at least STBI_JPEG_PARALLEL_MIN_PIXELS pixels (default
+// 1 megapixel) can hand IDCT and upsampling/color conversion to the worker
+// threads of the app, see stbi_set_jpeg_parallel_for(). Huffman decoding stays
+// on the calling thread; the dequantized coefficients are buffered for
+// STBI_JPEG_PARALLEL_BAND_MCU_ROWS MCU rows at a time and transformed in
+// parallel, so the extra memory does not grow with the image height.
+// stb_image never creates threads itself, and the output is identical to the
+// single-threaded decoder.
+//
 // If for some reason you do not want to use any of SIMD code, or if
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
@@ -516,6 +537,14 @@ extern "C" {
     // flip the image vertically, so the first pixel in the output array is the bottom left
     STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+    // let large baseline JPEGs run IDCT and color conversion on the app's worker
+    // threads. func must call task(task_data, begin, end) over disjoint ranges
+    // covering [0, count) and return only after all of them have finished.
+    // pass NULL to go back to single-threaded decoding.
+    typedef void stbi_parallel_task(void *task_data, int begin, int end);
+    typedef void stbi_parallel_for_func(void *user, int count, stbi_parallel_task *task, void *task_data);
+    STBIDEF void stbi_set_jpeg_parallel_for(stbi_parallel_for_func *func, void *user);
+
     // ZLIB client - used by PNG, available for other purposes
 
     STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -739,6 +768,13 @@ static int stbi__sse2_available()
 #endif
 #endif
 
+// AVX2 kernels are only compiled when the whole build targets AVX2, so there
+// is no run-time test for them
+#if defined(STBI_SSE2) && defined(__AVX2__) && !defined(STBI_NO_AVX2)
+#define STBI_AVX2
+#include <immintrin.h>
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -909,8 +945,25 @@ static void    *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int
 static int      stbi__pnm_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
+// 纹理在多个工作线程中同时解码，失败原因按线程保存（和新版 stb_image 的 STBI_THREAD_LOCAL 相同）
+#ifndef STBI_NO_THREAD_LOCALS
+#if defined(__cplusplus) && __cplusplus >= 201103L
+#define STBI_THREAD_LOCAL thread_local
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define STBI_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define STBI_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define STBI_THREAD_LOCAL __thread
+#endif
+#endif
+
+#ifdef STBI_THREAD_LOCAL
+static STBI_THREAD_LOCAL const char *stbi__g_failure_reason;
+#else
 // this is not threadsafe
 static const char *stbi__g_failure_reason;
+#endif
 
 STBIDEF const char *stbi_failure_reason(void)
 {
@@ -1034,6 +1087,15 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
     stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+static stbi_parallel_for_func *stbi__jpeg_parallel_for = NULL;
+static void *stbi__jpeg_parallel_user = NULL;
+
+STBIDEF void stbi_set_jpeg_parallel_for(stbi_parallel_for_func *func, void *user)
+{
+    stbi__jpeg_parallel_for = func;
+    stbi__jpeg_parallel_user = user;
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
     memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1722,6 +1784,15 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
 // huffman decoding acceleration
 #define FAST_BITS   9  // larger handles more cases; smaller stomps less cache
 
+// parallel decoding of big baseline images, see stbi_set_jpeg_parallel_for
+#ifndef STBI_JPEG_PARALLEL_MIN_PIXELS
+#define STBI_JPEG_PARALLEL_MIN_PIXELS      (1 << 20)
+#endif
+#ifndef STBI_JPEG_PARALLEL_BAND_MCU_ROWS
+#define STBI_JPEG_PARALLEL_BAND_MCU_ROWS   32
+#endif
+#define STBI__JPEG_MAX_CONVERT_BANDS       64
+
 typedef struct
 {
     stbi_uc  fast[1 << FAST_BITS];
@@ -1779,6 +1850,13 @@ typedef struct
     int scan_n, order[4];
     int restart_interval, todo;
 
+    // parallel decode (NULL when single-threaded). for baseline images coeff
+    // holds the current band of blocks, band_y0 is the first unit (MCU row, or
+    // block row in single-component scans) in it
+    stbi_parallel_for_func *parallel_for;
+    void *parallel_user;
+    int band_y0, band_units;
+
     // kernels
     void(*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
     void(*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
@@ -2484,6 +2562,181 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 version of stbi__idct_simd: the same steps on two horizontally adjacent
+// blocks at once, one block per 128-bit lane, so it is bit-identical as well.
+// data points to two consecutive 64-entry blocks, out to the left block.
+static void stbi__idct_avx2x2(stbi_uc *out, int out_stride, short *data)
+{
+    __m256i row0, row1, row2, row3, row4, row5, row6, row7;
+    __m256i tmp;
+
+#define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+#define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##lo = _mm256_unpacklo_epi16((x),(y)); \
+      __m256i c0##hi = _mm256_unpackhi_epi16((x),(y)); \
+      __m256i out0##_l = _mm256_madd_epi16(c0##lo, c0); \
+      __m256i out0##_h = _mm256_madd_epi16(c0##hi, c0); \
+      __m256i out1##_l = _mm256_madd_epi16(c0##lo, c1); \
+      __m256i out1##_h = _mm256_madd_epi16(c0##hi, c1)
+
+#define dct_widen(out, in) \
+      __m256i out##_l = _mm256_srai_epi32(_mm256_unpacklo_epi16(_mm256_setzero_si256(), (in)), 4); \
+      __m256i out##_h = _mm256_srai_epi32(_mm256_unpackhi_epi16(_mm256_setzero_si256(), (in)), 4)
+
+#define dct_wadd(out, a, b) \
+      __m256i out##_l = _mm256_add_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_add_epi32(a##_h, b##_h)
+
+#define dct_wsub(out, a, b) \
+      __m256i out##_l = _mm256_sub_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_sub_epi32(a##_h, b##_h)
+
+#define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased_l = _mm256_add_epi32(a##_l, bias); \
+         __m256i abiased_h = _mm256_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm256_packs_epi32(_mm256_srai_epi32(sum_l, s), _mm256_srai_epi32(sum_h, s)); \
+         out1 = _mm256_packs_epi32(_mm256_srai_epi32(dif_l, s), _mm256_srai_epi32(dif_h, s)); \
+      }
+
+#define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi8(a, b); \
+      b = _mm256_unpackhi_epi8(tmp, b)
+
+#define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi16(a, b); \
+      b = _mm256_unpackhi_epi16(tmp, b)
+
+#define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m256i sum04 = _mm256_add_epi16(row0, row4); \
+         __m256i dif04 = _mm256_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m256i sum17 = _mm256_add_epi16(row1, row7); \
+         __m256i sum35 = _mm256_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+    // left block in the low lane, right block in the high lane
+#define dct_load(r) \
+      _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i *) (data + (r) * 8))), \
+                              _mm_load_si128((const __m128i *) (data + 64 + (r) * 8)), 1)
+
+    __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+    __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+    __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+    __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+    __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+    __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+    __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+    __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+    __m256i bias_0 = _mm256_set1_epi32(512);
+    __m256i bias_1 = _mm256_set1_epi32(65536 + (128 << 17));
+
+    row0 = dct_load(0);
+    row1 = dct_load(1);
+    row2 = dct_load(2);
+    row3 = dct_load(3);
+    row4 = dct_load(4);
+    row5 = dct_load(5);
+    row6 = dct_load(6);
+    row7 = dct_load(7);
+
+    // column pass
+    dct_pass(bias_0, 10);
+
+    {
+        // 16bit 8x8 transpose, per lane
+        dct_interleave16(row0, row4);
+        dct_interleave16(row1, row5);
+        dct_interleave16(row2, row6);
+        dct_interleave16(row3, row7);
+
+        dct_interleave16(row0, row2);
+        dct_interleave16(row1, row3);
+        dct_interleave16(row4, row6);
+        dct_interleave16(row5, row7);
+
+        dct_interleave16(row0, row1);
+        dct_interleave16(row2, row3);
+        dct_interleave16(row4, row5);
+        dct_interleave16(row6, row7);
+    }
+
+    // row pass
+    dct_pass(bias_1, 17);
+
+    {
+        __m256i p0 = _mm256_packus_epi16(row0, row1);
+        __m256i p1 = _mm256_packus_epi16(row2, row3);
+        __m256i p2 = _mm256_packus_epi16(row4, row5);
+        __m256i p3 = _mm256_packus_epi16(row6, row7);
+
+        // 8bit 8x8 transpose, per lane
+        dct_interleave8(p0, p2);
+        dct_interleave8(p1, p3);
+
+        dct_interleave8(p0, p1);
+        dct_interleave8(p2, p3);
+
+        dct_interleave8(p0, p2);
+        dct_interleave8(p1, p3);
+
+        // each register now holds rows 2k, 2k+1 of both blocks; reorder the
+        // 64-bit halves to left0 right0 left1 right1 so every row is one 16-byte store
+        p0 = _mm256_permute4x64_epi64(p0, 0xd8);
+        p1 = _mm256_permute4x64_epi64(p1, 0xd8);
+        p2 = _mm256_permute4x64_epi64(p2, 0xd8);
+        p3 = _mm256_permute4x64_epi64(p3, 0xd8);
+
+        _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(p0)); out += out_stride;
+        _mm_storeu_si128((__m128i *) out, _mm256_extracti128_si256(p0, 1)); out += out_stride;
+        _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(p2)); out += out_stride;
+        _mm_storeu_si128((__m128i *) out, _mm256_extracti128_si256(p2, 1)); out += out_stride;
+        _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(p1)); out += out_stride;
+        _mm_storeu_si128((__m128i *) out, _mm256_extracti128_si256(p1, 1)); out += out_stride;
+        _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(p3)); out += out_stride;
+        _mm_storeu_si128((__m128i *) out, _mm256_extracti128_si256(p3, 1));
+    }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+#undef dct_load
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2726,10 +2979,66 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
     // since we don't even allow 1<<30 pixels
 }
 
+// rows of 8x8 blocks that one unit of the current scan covers in component n
+static int stbi__jpeg_unit_rows(stbi__jpeg *z, int n)
+{
+    return z->scan_n == 1 ? 1 : z->img_comp[n].v;
+}
+
+// where block (bx, by) of component n is buffered in the current band
+static short *stbi__jpeg_band_block(stbi__jpeg *z, int n, int bx, int by)
+{
+    int row = by - z->band_y0 * stbi__jpeg_unit_rows(z, n);
+    return z->img_comp[n].coeff + 64 * (bx + row * z->img_comp[n].coeff_w);
+}
+
+static void stbi__jpeg_idct_band_task(void *task_data, int begin, int end)
+{
+    stbi__jpeg *z = (stbi__jpeg *)task_data;
+    int u, k, r, i;
+    for (u = begin; u < end; ++u) {
+        for (k = 0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            int rows = stbi__jpeg_unit_rows(z, n);
+            // interleaved scans decode whole MCUs, including the padding blocks
+            int w = z->scan_n == 1 ? (z->img_comp[n].x + 7) >> 3 : z->img_comp[n].coeff_w;
+            for (r = 0; r < rows; ++r) {
+                short *coeff = z->img_comp[n].coeff + 64 * z->img_comp[n].coeff_w * (u * rows + r);
+                stbi_uc *out = z->img_comp[n].data + z->img_comp[n].w2 * ((z->band_y0 + u) * rows + r) * 8;
+                i = 0;
+#ifdef STBI_AVX2
+                for (; i + 1 < w; i += 2)
+                    stbi__idct_avx2x2(out + i * 8, z->img_comp[n].w2, coeff + 64 * i);
+#endif
+                for (; i < w; ++i)
+                    z->idct_block_kernel(out + i * 8, z->img_comp[n].w2, coeff + 64 * i);
+            }
+        }
+    }
+}
+
+// transform the buffered units [band_y0, y_end) and start the next band at y_end
+static int stbi__jpeg_flush_band(stbi__jpeg *z, int y_end)
+{
+    int count = y_end - z->band_y0;
+    if (z->parallel_for && count > 0) {
+        if (count > 1)
+            z->parallel_for(z->parallel_user, count, stbi__jpeg_idct_band_task, z);
+        else
+            stbi__jpeg_idct_band_task(z, 0, count);
+        z->band_y0 = y_end;
+    }
+    return 1;
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
     stbi__jpeg_reset(z);
     if (!z->progressive) {
+        // with parallel_for set, blocks are only dequantized here and the IDCT
+        // runs one band at a time in stbi__jpeg_flush_band
+        z->band_y0 = 0;
+        z->band_units = z->scan_n == 1 ? z->img_comp[z->order[0]].coeff_h : STBI_JPEG_PARALLEL_BAND_MCU_ROWS;
         if (z->scan_n == 1) {
             int i, j;
             STBI_SIMD_ALIGN(short, data[64]);
@@ -2741,26 +3050,30 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             int w = (z->img_comp[n].x + 7) >> 3;
             int h = (z->img_comp[n].y + 7) >> 3;
             for (j = 0; j < h; ++j) {
+                if (z->parallel_for && j - z->band_y0 == z->band_units) stbi__jpeg_flush_band(z, j);
                 for (i = 0; i < w; ++i) {
                     int ha = z->img_comp[n].ha;
-                    if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
+                    short *block = z->parallel_for ? stbi__jpeg_band_block(z, n, i, j) : data;
+                    if (!stbi__jpeg_decode_block(z, block, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                    if (!z->parallel_for)
+                        z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
                     // every data block is an MCU, so countdown the restart interval
                     if (--z->todo <= 0) {
                         if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
                         // if it's NOT a restart, then just bail, so we get corrupt data
                         // rather than no data
-                        if (!STBI__RESTART(z->marker)) return 1;
+                        if (!STBI__RESTART(z->marker)) return stbi__jpeg_flush_band(z, j + 1);
                         stbi__jpeg_reset(z);
                     }
                 }
             }
-            return 1;
+            return stbi__jpeg_flush_band(z, h);
         }
         else { // interleaved
             int i, j, k, x, y;
             STBI_SIMD_ALIGN(short, data[64]);
             for (j = 0; j < z->img_mcu_y; ++j) {
+                if (z->parallel_for && j - z->band_y0 == z->band_units) stbi__jpeg_flush_band(z, j);
                 for (i = 0; i < z->img_mcu_x; ++i) {
                     // scan an interleaved mcu... process scan_n components in order
                     for (k = 0; k < z->scan_n; ++k) {
@@ -2772,8 +3085,10 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                                 int x2 = (i*z->img_comp[n].h + x) * 8;
                                 int y2 = (j*z->img_comp[n].v + y) * 8;
                                 int ha = z->img_comp[n].ha;
-                                if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                                z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*y2 + x2, z->img_comp[n].w2, data);
+                                short *block = z->parallel_for ? stbi__jpeg_band_block(z, n, x2 >> 3, y2 >> 3) : data;
+                                if (!stbi__jpeg_decode_block(z, block, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                                if (!z->parallel_for)
+                                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*y2 + x2, z->img_comp[n].w2, data);
                             }
                         }
                     }
@@ -2781,12 +3096,12 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                     // so now count down the restart interval
                     if (--z->todo <= 0) {
                         if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                        if (!STBI__RESTART(z->marker)) return 1;
+                        if (!STBI__RESTART(z->marker)) return stbi__jpeg_flush_band(z, j + 1);
                         stbi__jpeg_reset(z);
                     }
                 }
             }
-            return 1;
+            return stbi__jpeg_flush_band(z, z->img_mcu_y);
         }
     }
     else {
@@ -2861,21 +3176,52 @@ static void stbi__jpeg_dequantize(short *data, stbi_uc *dequant)
         data[i] *= dequant[i];
 }
 
+typedef struct
+{
+    stbi__jpeg *z;
+    int n;
+} stbi__jpeg_finish_task_data;
+
+// dequantize and idct block rows [begin, end) of one component
+static void stbi__jpeg_finish_task(void *task_data, int begin, int end)
+{
+    stbi__jpeg_finish_task_data *t = (stbi__jpeg_finish_task_data *)task_data;
+    stbi__jpeg *z = t->z;
+    int n = t->n;
+    int i, j;
+    int w = (z->img_comp[n].x + 7) >> 3;
+    for (j = begin; j < end; ++j) {
+        for (i = 0; i < w; ++i) {
+            short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+            stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
+        }
+        i = 0;
+#ifdef STBI_AVX2
+        for (; i + 1 < w; i += 2)
+            stbi__idct_avx2x2(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2,
+                z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w));
+#endif
+        for (; i < w; ++i) {
+            short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+            z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
+        }
+    }
+}
+
 static void stbi__jpeg_finish(stbi__jpeg *z)
 {
     if (z->progressive) {
         // dequantize and idct the data
-        int i, j, n;
+        int n;
         for (n = 0; n < z->s->img_n; ++n) {
-            int w = (z->img_comp[n].x + 7) >> 3;
+            stbi__jpeg_finish_task_data t;
             int h = (z->img_comp[n].y + 7) >> 3;
-            for (j = 0; j < h; ++j) {
-                for (i = 0; i < w; ++i) {
-                    short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
-                    stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
-                }
-            }
+            t.z = z;
+            t.n = n;
+            if (z->parallel_for)
+                z->parallel_for(z->parallel_user, h, stbi__jpeg_finish_task, &t);
+            else
+                stbi__jpeg_finish_task(&t, 0, h);
         }
     }
 }
@@ -3060,6 +3406,15 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
     z->img_mcu_x = (s->img_x + z->img_mcu_w - 1) / z->img_mcu_w;
     z->img_mcu_y = (s->img_y + z->img_mcu_h - 1) / z->img_mcu_h;
 
+    // big images hand IDCT and color conversion to the app's threads;
+    // x*y*n was checked above, so this can't overflow
+    z->parallel_for = NULL;
+    z->parallel_user = NULL;
+    if (stbi__jpeg_parallel_for && (int)(s->img_x * s->img_y) >= STBI_JPEG_PARALLEL_MIN_PIXELS) {
+        z->parallel_for = stbi__jpeg_parallel_for;
+        z->parallel_user = stbi__jpeg_parallel_user;
+    }
+
     for (i = 0; i < s->img_n; ++i) {
         // number of effective pixels (e.g. for non-interleaved MCU)
         z->img_comp[i].x = (s->img_x * z->img_comp[i].h + h_max - 1) / h_max;
@@ -3090,6 +3445,17 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
                 return stbi__free_jpeg_components(z, i + 1, stbi__err("outofmem", "Out of memory"));
             z->img_comp[i].coeff = (short*)(((size_t)z->img_comp[i].raw_coeff + 15) & ~15);
         }
+        else if (z->parallel_for) {
+            // one band of blocks, reused for every band of every scan. cleared so that
+            // blocks a truncated scan never reaches don't run the IDCT on garbage
+            z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
+            z->img_comp[i].coeff_h = STBI_JPEG_PARALLEL_BAND_MCU_ROWS * z->img_comp[i].v;
+            z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
+            if (z->img_comp[i].raw_coeff == NULL)
+                return stbi__free_jpeg_components(z, i + 1, stbi__err("outofmem", "Out of memory"));
+            z->img_comp[i].coeff = (short*)(((size_t)z->img_comp[i].raw_coeff + 15) & ~15);
+            memset(z->img_comp[i].coeff, 0, z->img_comp[i].w2 * z->img_comp[i].coeff_h * 8 * sizeof(short));
+        }
     }
 
     return 1;
@@ -3135,6 +3501,7 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
         j->img_comp[m].raw_coeff = NULL;
     }
     j->restart_interval = 0;
+    j->parallel_for = NULL;
     if (!stbi__decode_jpeg_header(j, STBI__SCAN_load)) return 0;
     m = stbi__get_marker(j);
     while (!stbi__EOI(m)) {
@@ -3437,6 +3804,59 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 {
     int i = 0;
 
+#ifdef STBI_AVX2
+    // same math as the sse2 loop below, 16 pixels per iteration. the pack and
+    // unpack steps work within 128-bit lanes, so o0 ends up with pixels 0-3
+    // and 8-11, o1 with 4-7 and 12-15.
+    if (step == 4) {
+        __m256i signflip = _mm256_set1_epi8(-0x80);
+        __m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f*4096.0f + 0.5f));
+        __m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f*4096.0f + 0.5f));
+        __m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f*4096.0f + 0.5f));
+        __m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f*4096.0f + 0.5f));
+        __m256i y_bias = _mm256_set1_epi16(8);
+        __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+        for (; i + 15 < count; i += 16) {
+            // load and widen: y*16+8 is (y<<8 | 128)>>4 of the sse2 version
+            __m256i yw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (y + i)));
+            __m256i cr_biased = _mm256_xor_si256(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcr + i))), signflip);
+            __m256i cb_biased = _mm256_xor_si256(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcb + i))), signflip);
+            __m256i yws = _mm256_add_epi16(_mm256_slli_epi16(yw, 4), y_bias);
+            __m256i crw = _mm256_slli_epi16(cr_biased, 8);
+            __m256i cbw = _mm256_slli_epi16(cb_biased, 8);
+
+            // color transform
+            __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+            __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+            __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+            __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+            __m256i rws = _mm256_add_epi16(cr0, yws);
+            __m256i gwt = _mm256_add_epi16(cb0, yws);
+            __m256i bws = _mm256_add_epi16(yws, cb1);
+            __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+            // descale
+            __m256i rw = _mm256_srai_epi16(rws, 4);
+            __m256i bw = _mm256_srai_epi16(bws, 4);
+            __m256i gw = _mm256_srai_epi16(gws, 4);
+
+            // back to byte and interleave channels
+            __m256i brb = _mm256_packus_epi16(rw, bw);
+            __m256i gxb = _mm256_packus_epi16(gw, xw);
+            __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+            __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+            __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+            __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+            // store in pixel order
+            _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+            _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+            out += 64;
+        }
+    }
+#endif
+
 #ifdef STBI_SSE2
     // step == 3 is pretty ugly on the final interleave, and i'm not convinced
     // it's useful in practice (you wouldn't use it for textures, for example).
@@ -3609,6 +4029,119 @@ typedef struct
     int ypos;    // which pre-expansion row we're on
 } stbi__resample;
 
+// resample and color-convert output rows [j0, j1). the resample state is
+// derived from j0, so bands of rows can be converted independently. with
+// 3 output channels the converters store a 4th byte past each pixel, so when
+// last_row is given the final row goes through it and can't touch the next band
+static void stbi__jpeg_convert_rows(stbi__jpeg *z, stbi_uc *output, int n, int decode_n, stbi_uc **linebuf, stbi_uc *last_row,
+    unsigned int j0, unsigned int j1)
+{
+    int k;
+    unsigned int i, j;
+    stbi_uc *coutput[4];
+
+    stbi__resample res_comp[4];
+
+    for (k = 0; k < decode_n; ++k) {
+        stbi__resample *r = &res_comp[k];
+        int line, advance;
+
+        r->hs = z->img_h_max / z->img_comp[k].h;
+        r->vs = z->img_v_max / z->img_comp[k].v;
+        r->w_lores = (z->s->img_x + r->hs - 1) / r->hs;
+
+        // same state the row loop below reaches after j0 rows from the top
+        advance = ((r->vs >> 1) + j0) / r->vs;
+        r->ystep = ((r->vs >> 1) + j0) % r->vs;
+        r->ypos = advance;
+        line = advance < z->img_comp[k].y ? advance : z->img_comp[k].y - 1;
+        r->line1 = z->img_comp[k].data + line * z->img_comp[k].w2;
+        line = advance - 1 < z->img_comp[k].y - 1 ? advance - 1 : z->img_comp[k].y - 1;
+        r->line0 = z->img_comp[k].data + (advance > 0 ? line : 0) * z->img_comp[k].w2;
+
+        if (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
+        else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
+        else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
+        else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
+        else                               r->resample = stbi__resample_row_generic;
+    }
+
+    for (j = j0; j < j1; ++j) {
+        stbi_uc *out = (last_row && j == j1 - 1) ? last_row : output + n * z->s->img_x * j;
+        for (k = 0; k < decode_n; ++k) {
+            stbi__resample *r = &res_comp[k];
+            int y_bot = r->ystep >= (r->vs >> 1);
+            coutput[k] = r->resample(linebuf[k],
+                y_bot ? r->line1 : r->line0,
+                y_bot ? r->line0 : r->line1,
+                r->w_lores, r->hs);
+            if (++r->ystep >= r->vs) {
+                r->ystep = 0;
+                r->line0 = r->line1;
+                if (++r->ypos < z->img_comp[k].y)
+                    r->line1 += z->img_comp[k].w2;
+            }
+        }
+        if (n >= 3) {
+            stbi_uc *y = coutput[0];
+            if (z->s->img_n == 3) {
+                if (z->rgb == 3) {
+                    for (i = 0; i < z->s->img_x; ++i) {
+                        out[0] = y[i];
+                        out[1] = coutput[1][i];
+                        out[2] = coutput[2][i];
+                        out[3] = 255;
+                        out += n;
+                    }
+                }
+                else {
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                }
+            }
+            else
+                for (i = 0; i < z->s->img_x; ++i) {
+                    out[0] = out[1] = out[2] = y[i];
+                    out[3] = 255; // not used if n==3
+                    out += n;
+                }
+        }
+        else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+                for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+                for (i = 0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
+        }
+    }
+    if (last_row && j0 < j1)
+        memcpy(output + n * z->s->img_x * (j1 - 1), last_row, n * z->s->img_x);
+}
+
+typedef struct
+{
+    stbi__jpeg *z;
+    stbi_uc *output;
+    stbi_uc *linebufs;   // decode_n line buffers and one output row for every band
+    int n, decode_n;
+    int band_h;
+} stbi__jpeg_convert_task_data;
+
+static void stbi__jpeg_convert_task(void *task_data, int begin, int end)
+{
+    stbi__jpeg_convert_task_data *t = (stbi__jpeg_convert_task_data *)task_data;
+    stbi__jpeg *z = t->z;
+    int b, k;
+    for (b = begin; b < end; ++b) {
+        stbi_uc *linebuf[4];
+        stbi_uc *band = t->linebufs + b * (t->decode_n + 4) * (z->s->img_x + 3);
+        unsigned int j0 = b * t->band_h;
+        unsigned int j1 = j0 + t->band_h < z->s->img_y ? j0 + t->band_h : z->s->img_y;
+        for (k = 0; k < t->decode_n; ++k)
+            linebuf[k] = band + k * (z->s->img_x + 3);
+        stbi__jpeg_convert_rows(z, t->output, t->n, t->decode_n, linebuf, band + t->decode_n * (z->s->img_x + 3), j0, j1);
+    }
+}
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
     int n, decode_n;
@@ -3631,85 +4164,46 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
     // resample and color-convert
     {
         int k;
-        unsigned int i, j;
         stbi_uc *output;
-        stbi_uc *coutput[4];
-
-        stbi__resample res_comp[4];
-
-        for (k = 0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-
-            // allocate line buffer big enough for upsampling off the edges
-            // with upsample factor of 4
-            z->img_comp[k].linebuf = (stbi_uc *)stbi__malloc(z->s->img_x + 3);
-            if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-            r->hs = z->img_h_max / z->img_comp[k].h;
-            r->vs = z->img_v_max / z->img_comp[k].v;
-            r->ystep = r->vs >> 1;
-            r->w_lores = (z->s->img_x + r->hs - 1) / r->hs;
-            r->ypos = 0;
-            r->line0 = r->line1 = z->img_comp[k].data;
-
-            if (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-            else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-            else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
-            else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
-            else                               r->resample = stbi__resample_row_generic;
+        stbi_uc *linebuf[4];
+        stbi_uc *linebufs = NULL;
+        stbi__jpeg_convert_task_data t;
+
+        t.band_h = (z->s->img_y + STBI__JPEG_MAX_CONVERT_BANDS - 1) / STBI__JPEG_MAX_CONVERT_BANDS;
+        if (t.band_h < 16) t.band_h = 16;
+
+        if (z->parallel_for) {
+            // buffers for every band, allocated up front since the tasks can't fail
+            int bands = (z->s->img_y + t.band_h - 1) / t.band_h;
+            linebufs = (stbi_uc *)stbi__malloc_mad3(bands * (decode_n + 4), z->s->img_x + 3, 1, 0);
+            if (!linebufs) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+        }
+        else {
+            for (k = 0; k < decode_n; ++k) {
+                // allocate line buffer big enough for upsampling off the edges
+                // with upsample factor of 4
+                z->img_comp[k].linebuf = (stbi_uc *)stbi__malloc(z->s->img_x + 3);
+                if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+                linebuf[k] = z->img_comp[k].linebuf;
+            }
         }
 
         // can't error after this so, this is safe
         output = (stbi_uc *)stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-        if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+        if (!output) { STBI_FREE(linebufs); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
         // now go ahead and resample
-        for (j = 0; j < z->s->img_y; ++j) {
-            stbi_uc *out = output + n * z->s->img_x * j;
-            for (k = 0; k < decode_n; ++k) {
-                stbi__resample *r = &res_comp[k];
-                int y_bot = r->ystep >= (r->vs >> 1);
-                coutput[k] = r->resample(z->img_comp[k].linebuf,
-                    y_bot ? r->line1 : r->line0,
-                    y_bot ? r->line0 : r->line1,
-                    r->w_lores, r->hs);
-                if (++r->ystep >= r->vs) {
-                    r->ystep = 0;
-                    r->line0 = r->line1;
-                    if (++r->ypos < z->img_comp[k].y)
-                        r->line1 += z->img_comp[k].w2;
-                }
-            }
-            if (n >= 3) {
-                stbi_uc *y = coutput[0];
-                if (z->s->img_n == 3) {
-                    if (z->rgb == 3) {
-                        for (i = 0; i < z->s->img_x; ++i) {
-                            out[0] = y[i];
-                            out[1] = coutput[1][i];
-                            out[2] = coutput[2][i];
-                            out[3] = 255;
-                            out += n;
-                        }
-                    }
-                    else {
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                    }
-                }
-                else
-                    for (i = 0; i < z->s->img_x; ++i) {
-                        out[0] = out[1] = out[2] = y[i];
-                        out[3] = 255; // not used if n==3
-                        out += n;
-                    }
-            }
-            else {
-                stbi_uc *y = coutput[0];
-                if (n == 1)
-                    for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
-                else
-                    for (i = 0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
-            }
+        if (linebufs) {
+            t.z = z;
+            t.output = output;
+            t.linebufs = linebufs;
+            t.n = n;
+            t.decode_n = decode_n;
+            z->parallel_for(z->parallel_user, (z->s->img_y + t.band_h - 1) / t.band_h, stbi__jpeg_convert_task, &t);
+            STBI_FREE(linebufs);
+        }
+        else {
+            stbi__jpeg_convert_rows(z, output, n, decode_n, linebuf, NULL, 0, z->s->img_y);
         }
         stbi__cleanup_jpeg(z);
         *out_x = z->s->img_x;
@@ -3777,6 +4271,13 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 
+// multi-symbol table for the literal/length alphabet: one lookup resolves
+// up to two literals whose codes fit together in STBI__ZMULTI_BITS bits.
+// entry layout: bits 0-8 first symbol, 9-16 second literal, 17-21 total
+// code length, 22-23 number of symbols (0 = not in table, use fast/slow path)
+#define STBI__ZMULTI_BITS 11
+#define STBI__ZMULTI_MASK ((1 << STBI__ZMULTI_BITS) - 1)
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -3871,6 +4372,7 @@ typedef struct
     int   z_expandable;
 
     stbi__zhuffman z_length, z_distance;
+    stbi__uint32 z_multi[1 << STBI__ZMULTI_BITS];
 } stbi__zbuf;
 
 stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
@@ -3930,6 +4432,32 @@ stbi_inline static int stbi__zhuffman_decode(stbi__zbuf *a, stbi__zhuffman *z)
     return stbi__zhuffman_decode_slowpath(a, z);
 }
 
+// build the multi-symbol table from the fast table of z_length. a second
+// literal is only paired when both codes fit in STBI__ZMULTI_BITS, so every
+// bit the entry depends on is part of the index.
+static void stbi__zbuild_multi(stbi__zbuf *a)
+{
+    stbi__zhuffman *z = &a->z_length;
+    int i;
+    for (i = 0; i < (1 << STBI__ZMULTI_BITS); ++i) {
+        int b1 = z->fast[i & STBI__ZFAST_MASK];
+        int s1, sym1;
+        if (!b1) {
+            a->z_multi[i] = 0;
+            continue;
+        }
+        s1 = b1 >> 9;
+        sym1 = b1 & 511;
+        a->z_multi[i] = (1u << 22) | ((stbi__uint32)s1 << 17) | (stbi__uint32)sym1;
+        if (sym1 < 256) {
+            int b2 = z->fast[(i >> s1) & STBI__ZFAST_MASK];
+            int s2 = b2 >> 9;
+            if (b2 && (b2 & 511) < 256 && s1 + s2 <= STBI__ZMULTI_BITS)
+                a->z_multi[i] = (2u << 22) | ((stbi__uint32)(s1 + s2) << 17) | ((stbi__uint32)(b2 & 511) << 9) | (stbi__uint32)sym1;
+        }
+    }
+}
+
 static int stbi__zexpand(stbi__zbuf *z, char *zout, int n)  // need to make room for n bytes
 {
     char *q;
@@ -3967,7 +4495,28 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
     char *zout = a->zout;
     for (;;) {
-        int z = stbi__zhuffman_decode(a, &a->z_length);
+        int z;
+        stbi__uint32 m;
+        if (a->num_bits < 16) stbi__fill_bits(a);
+        m = a->z_multi[a->code_buffer & STBI__ZMULTI_MASK];
+        if (m) {
+            int s = (m >> 17) & 31;
+            a->code_buffer >>= s;
+            a->num_bits -= s;
+            z = m & 511;
+            if ((m >> 22) == 2) {
+                if (zout + 2 > a->zout_end) {
+                    if (!stbi__zexpand(a, zout, 2)) return 0;
+                    zout = a->zout;
+                }
+                zout[0] = (char)z;
+                zout[1] = (char)((m >> 9) & 255);
+                zout += 2;
+                continue;
+            }
+        }
+        else
+            z = stbi__zhuffman_decode(a, &a->z_length);
         if (z < 256) {
             if (z < 0) return stbi__err("bad huffman code", "Corrupt PNG"); // error in huffman codes
             if (zout >= a->zout_end) {
@@ -4138,6 +4687,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
             else {
                 if (!stbi__compute_huffman_codes(a)) return 0;
             }
+            stbi__zbuild_multi(a);
             if (!stbi__parse_huffman_block(a)) return 0;
         }
     } while (!final);
@@ -4308,6 +4858,121 @@ static int stbi__paeth(int a, int b, int c)
 
 static stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+#ifdef STBI_SSE2
+// SIMD unfiltering for 8-bit PNG rows with 3 or 4 bytes per pixel.
+// sub/avg/paeth depend on the previous pixel, so these work one pixel per
+// iteration with the channels widened to 16-bit lanes (same idea as libpng's
+// filter_sse2_intrinsics.c); up has no dependency and runs 16 bytes at a time.
+// cur/raw/prior point at the second pixel of the row, count is the number of
+// pixels left. when out_n == img_n+1 the extra alpha byte is filled with 255.
+// results are bit-exact with the scalar loops.
+stbi_inline static __m128i stbi__png_load_px(stbi_uc const *p, int n)
+{
+    stbi__uint32 v;
+    // assemble 3 byte pixels in registers; a 3 byte memcpy into a 4 byte
+    // temporary goes through the stack and stalls on store forwarding
+    if (n == 4) memcpy(&v, p, 4);
+    else v = p[0] | (p[1] << 8) | ((stbi__uint32)p[2] << 16);
+    return _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)v), _mm_setzero_si128());
+}
+
+stbi_inline static void stbi__png_store_px(stbi_uc *p, __m128i v, int n, stbi__uint32 alpha)
+{
+    stbi__uint32 r = (stbi__uint32)_mm_cvtsi128_si32(_mm_packus_epi16(v, v)) | alpha;
+    if (n == 4) memcpy(p, &r, 4);
+    else {
+        p[0] = (stbi_uc)r;
+        p[1] = (stbi_uc)(r >> 8);
+        p[2] = (stbi_uc)(r >> 16);
+    }
+}
+
+stbi_inline static __m128i stbi__png_abs16(__m128i x)
+{
+    __m128i neg = _mm_cmplt_epi16(x, _mm_setzero_si128());
+    return _mm_sub_epi16(_mm_xor_si128(x, neg), neg);
+}
+
+stbi_inline static __m128i stbi__png_select16(__m128i mask, __m128i t, __m128i f)
+{
+    return _mm_or_si128(_mm_and_si128(mask, t), _mm_andnot_si128(mask, f));
+}
+
+static void stbi__png_unfilter_up_sse2(stbi_uc *cur, stbi_uc const *raw, stbi_uc const *prior, int n)
+{
+    int k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m128i r = _mm_loadu_si128((__m128i const *)(raw + k));
+        __m128i b = _mm_loadu_si128((__m128i const *)(prior + k));
+        _mm_storeu_si128((__m128i *)(cur + k), _mm_add_epi8(r, b));
+    }
+    for (; k < n; ++k)
+        cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+
+static void stbi__png_unfilter_px_sse2(int filter, stbi_uc *cur, stbi_uc const *raw, stbi_uc const *prior, int count, int img_n, int out_n)
+{
+    __m128i mask = _mm_set1_epi16(0xff);
+    stbi__uint32 alpha = (out_n != img_n) ? 0xff000000u : 0;
+    int store_n = out_n;
+    __m128i a = stbi__png_load_px(cur - out_n, img_n);
+    __m128i b, c, x;
+    int i;
+
+    switch (filter) {
+    case STBI__F_none:
+        for (i = 0; i < count; ++i, cur += out_n, raw += img_n)
+            stbi__png_store_px(cur, stbi__png_load_px(raw, img_n), store_n, alpha);
+        break;
+    case STBI__F_sub:
+    case STBI__F_paeth_first: // paeth(a,0,0) is always a
+        for (i = 0; i < count; ++i, cur += out_n, raw += img_n) {
+            a = _mm_and_si128(_mm_add_epi16(stbi__png_load_px(raw, img_n), a), mask);
+            stbi__png_store_px(cur, a, store_n, alpha);
+        }
+        break;
+    case STBI__F_up:
+        for (i = 0; i < count; ++i, cur += out_n, raw += img_n, prior += out_n) {
+            x = _mm_add_epi16(stbi__png_load_px(raw, img_n), stbi__png_load_px(prior, img_n));
+            stbi__png_store_px(cur, _mm_and_si128(x, mask), store_n, alpha);
+        }
+        break;
+    case STBI__F_avg:
+        for (i = 0; i < count; ++i, cur += out_n, raw += img_n, prior += out_n) {
+            b = stbi__png_load_px(prior, img_n);
+            x = _mm_srli_epi16(_mm_add_epi16(a, b), 1);
+            a = _mm_and_si128(_mm_add_epi16(stbi__png_load_px(raw, img_n), x), mask);
+            stbi__png_store_px(cur, a, store_n, alpha);
+        }
+        break;
+    case STBI__F_avg_first:
+        for (i = 0; i < count; ++i, cur += out_n, raw += img_n) {
+            a = _mm_and_si128(_mm_add_epi16(stbi__png_load_px(raw, img_n), _mm_srli_epi16(a, 1)), mask);
+            stbi__png_store_px(cur, a, store_n, alpha);
+        }
+        break;
+    case STBI__F_paeth:
+        c = stbi__png_load_px(prior - out_n, img_n);
+        for (i = 0; i < count; ++i, cur += out_n, raw += img_n, prior += out_n) {
+            __m128i pa, pb, pc, smallest, nearest;
+            b = stbi__png_load_px(prior, img_n);
+            // p = a + b - c, so |p-a| = |b-c|, |p-b| = |a-c|, |p-c| = |a+b-2c|
+            pa = stbi__png_abs16(_mm_sub_epi16(b, c));
+            pb = stbi__png_abs16(_mm_sub_epi16(a, c));
+            pc = stbi__png_abs16(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            // same tie-break order as stbi__paeth: a, then b, then c
+            nearest = stbi__png_select16(_mm_cmpeq_epi16(pa, smallest), a,
+                      stbi__png_select16(_mm_cmpeq_epi16(pb, smallest), b, c));
+            a = _mm_and_si128(_mm_add_epi16(stbi__png_load_px(raw, img_n), nearest), mask);
+            c = b;
+            stbi__png_store_px(cur, a, store_n, alpha);
+        }
+        break;
+    }
+}
+#endif // STBI_SSE2
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4321,6 +4986,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
     int output_bytes = out_n*bytes;
     int filter_bytes = img_n*bytes;
     int width = x;
+#ifdef STBI_SSE2
+    int use_simd = stbi__sse2_available();
+#endif
 
     STBI_ASSERT(out_n == s->img_n || out_n == s->img_n + 1);
     a->out = (stbi_uc *)stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4389,6 +5057,18 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
         }
 
         // this is a little gross, so that we don't switch per-pixel or per-component
+#ifdef STBI_SSE2
+        if (use_simd && (depth < 8 || img_n == out_n) && filter == STBI__F_up) {
+            int nk = (width - 1)*filter_bytes;
+            stbi__png_unfilter_up_sse2(cur, raw, prior, nk);
+            raw += nk;
+        }
+        else if (use_simd && depth == 8 && (img_n == 3 || img_n == 4) && filter != STBI__F_none) {
+            stbi__png_unfilter_px_sse2(filter, cur, raw, prior, (int)x - 1, img_n, out_n);
+            raw += (x - 1)*img_n;
+        }
+        else
+#endif
         if (depth < 8 || img_n == out_n) {
             int nk = (width - 1)*filter_bytes;
 #define STBI__CASE(f) \
@@ -4877,8 +5557,12 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if ((c.type & (1 << 29)) == 0) {
 #ifndef STBI_NO_FAILURE_STRINGS
+#ifdef STBI_THREAD_LOCAL
+                static STBI_THREAD_LOCAL char invalid_chunk[] = "XXXX PNG chunk not known";
+#else
                 // not threadsafe
                 static char invalid_chunk[] = "XXXX PNG chunk not known";
+#endif
                 invalid_chunk[0] = STBI__BYTECAST(c.type >> 24);
                 invalid_chunk[1] = STBI__BYTECAST(c.type >> 16);
                 invalid_chunk[2] = STBI__BYTECAST(c.type >> 8);
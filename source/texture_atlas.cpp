@@ -0,0 +1,309 @@
+﻿#include "texture_atlas.h"
+#include "image_resize.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+uint16_t alignUp(uint32_t value, uint16_t alignment)
+{
+    return static_cast<uint16_t>(std::min<uint32_t>((value + alignment - 1) / alignment * alignment, UINT16_MAX));
+}
+} // namespace
+
+TextureAtlas::TextureAtlas(uint16_t width, uint16_t height, uint16_t padding, uint8_t mipSafeLevels, uint64_t flags)
+    : m_width(width)
+    , m_height(height)
+    , m_padding(padding)
+    , m_mipSafeLevels(std::max<uint8_t>(mipSafeLevels, 1))
+    , m_flags(flags)
+{
+    // 图集尺寸不能被对齐大小整除时减少 mip 级数
+    while (m_mipSafeLevels > 1 && (m_width % (1u << (m_mipSafeLevels - 1)) != 0 || m_height % (1u << (m_mipSafeLevels - 1)) != 0))
+    {
+        --m_mipSafeLevels;
+    }
+    m_alignment = static_cast<uint16_t>(1u << (m_mipSafeLevels - 1));
+
+    const uint32_t mipCount = m_mipSafeLevels > 1 ? getMipCount(m_width, m_height) : 1;
+    m_levels.resize(mipCount);
+    for (uint32_t i = 0; i < mipCount; ++i)
+    {
+        m_levels[i].resize(size_t(std::max(m_width >> i, 1)) * std::max(m_height >> i, 1) * 4);
+    }
+
+    m_skyline.push_back({0, 0, m_width});
+}
+
+int32_t TextureAtlas::add(const uint8_t* rgba, uint16_t width, uint16_t height, uint32_t stride)
+{
+    if (!rgba || width == 0 || height == 0)
+    {
+        return kInvalidRegion;
+    }
+
+    const uint16_t cellWidth  = alignUp(uint32_t(width) + m_padding * 2u, m_alignment);
+    const uint16_t cellHeight = alignUp(uint32_t(height) + m_padding * 2u, m_alignment);
+
+    uint16_t x       = 0;
+    uint16_t y       = 0;
+    size_t nodeIndex = 0;
+    if (cellWidth > m_width || cellHeight > m_height || !findPosition(cellWidth, cellHeight, x, y, nodeIndex))
+    {
+        return kInvalidRegion;
+    }
+    insertSkyline(nodeIndex, x, y, cellWidth, cellHeight);
+
+    // 拷贝图片，边和对齐多出来的区域用最近的边缘像素填充
+    stride             = stride ? stride : uint32_t(width) * 4;
+    uint8_t* level0    = m_levels[0].data();
+    const size_t pitch = size_t(m_width) * 4;
+    for (uint16_t cy = 0; cy < cellHeight; ++cy)
+    {
+        const int sy       = std::clamp(int(cy) - int(m_padding), 0, int(height) - 1);
+        const uint8_t* src = rgba + size_t(sy) * stride;
+        uint8_t* dst       = level0 + (size_t(y) + cy) * pitch + size_t(x) * 4;
+
+        for (uint16_t cx = 0; cx < m_padding; ++cx)
+        {
+            memcpy(dst + cx * 4, src, 4);
+        }
+        memcpy(dst + m_padding * 4, src, size_t(width) * 4);
+        for (uint32_t cx = m_padding + width; cx < cellWidth; ++cx)
+        {
+            memcpy(dst + cx * 4, src + (width - 1) * 4, 4);
+        }
+    }
+
+    const Cell cell {x, y, cellWidth, cellHeight};
+    buildMips(cell);
+    m_dirty.push_back(cell);
+    m_usedArea += uint32_t(cellWidth) * cellHeight;
+
+    Region region;
+    region.x         = static_cast<uint16_t>(x + m_padding);
+    region.y         = static_cast<uint16_t>(y + m_padding);
+    region.width     = width;
+    region.height    = height;
+    region.uvRect[0] = float(region.x) / m_width;
+    region.uvRect[1] = float(region.y) / m_height;
+    region.uvRect[2] = float(region.x + width) / m_width;
+    region.uvRect[3] = float(region.y + height) / m_height;
+    m_regions.push_back(region);
+
+    return static_cast<int32_t>(m_regions.size() - 1);
+}
+
+void TextureAtlas::remapUv(int32_t region, float& u, float& v) const
+{
+    const float* rect = m_regions[region].uvRect;
+    u                 = rect[0] + u * (rect[2] - rect[0]);
+    v                 = rect[1] + v * (rect[3] - rect[1]);
+}
+
+void TextureAtlas::remapUvs(int32_t region, void* vertices, uint32_t numVertices, uint32_t stride, uint32_t offset) const
+{
+    auto data = static_cast<uint8_t*>(vertices) + offset;
+    for (uint32_t i = 0; i < numVertices; ++i, data += stride)
+    {
+        float uv[2];
+        memcpy(uv, data, sizeof(uv));
+        remapUv(region, uv[0], uv[1]);
+        memcpy(data, uv, sizeof(uv));
+    }
+}
+
+void TextureAtlas::update()
+{
+    const bool created = !bgfx::isValid(m_handle);
+    if (!created && m_dirty.empty())
+    {
+        return;
+    }
+
+    // 对齐范围以外的 mip 很小，每次整级重新生成
+    const bool srgb = (m_flags & BGFX_TEXTURE_SRGB) != 0;
+    for (size_t level = m_mipSafeLevels; level < m_levels.size(); ++level)
+    {
+        const uint16_t srcWidth  = static_cast<uint16_t>(std::max(m_width >> (level - 1), 1));
+        const uint16_t srcHeight = static_cast<uint16_t>(std::max(m_height >> (level - 1), 1));
+        const uint16_t dstWidth  = static_cast<uint16_t>(std::max(m_width >> level, 1));
+        const uint16_t dstHeight = static_cast<uint16_t>(std::max(m_height >> level, 1));
+        resizeImage(
+            nullptr,
+            m_levels[level - 1].data(),
+            srcWidth,
+            srcHeight,
+            srcWidth * 4,
+            m_levels[level].data(),
+            dstWidth,
+            dstHeight,
+            dstWidth * 4,
+            ResizeFilter::Box,
+            srgb
+        );
+    }
+
+    if (created)
+    {
+        m_handle = bgfx::createTexture2D(m_width, m_height, m_levels.size() > 1, 1, bgfx::TextureFormat::RGBA8, m_flags);
+        if (!bgfx::isValid(m_handle))
+        {
+            return;
+        }
+
+        for (size_t level = 0; level < m_levels.size(); ++level)
+        {
+            uploadLevel(static_cast<uint8_t>(level), 0, 0, std::max(m_width >> level, 1), std::max(m_height >> level, 1));
+        }
+    }
+    else
+    {
+        for (const Cell& cell : m_dirty)
+        {
+            for (uint8_t level = 0; level < m_mipSafeLevels && level < m_levels.size(); ++level)
+            {
+                uploadLevel(level, cell.x >> level, cell.y >> level, cell.width >> level, cell.height >> level);
+            }
+        }
+        for (size_t level = m_mipSafeLevels; level < m_levels.size(); ++level)
+        {
+            uploadLevel(static_cast<uint8_t>(level), 0, 0, std::max(m_width >> level, 1), std::max(m_height >> level, 1));
+        }
+    }
+
+    m_dirty.clear();
+}
+
+float TextureAtlas::getOccupancy() const
+{
+    return float(double(m_usedArea) / (double(m_width) * m_height));
+}
+
+void TextureAtlas::destroy()
+{
+    if (bgfx::isValid(m_handle))
+    {
+        bgfx::destroy(m_handle);
+        m_handle = BGFX_INVALID_HANDLE;
+    }
+}
+
+bool TextureAtlas::findPosition(uint16_t width, uint16_t height, uint16_t& x, uint16_t& y, size_t& nodeIndex) const
+{
+    // 放在顶边最低的位置，相同时选更窄的节点
+    uint32_t bestBottom = UINT32_MAX;
+    uint32_t bestWidth  = UINT32_MAX;
+    for (size_t i = 0; i < m_skyline.size(); ++i)
+    {
+        const SkylineNode& node = m_skyline[i];
+        if (uint32_t(node.x) + width > m_width)
+        {
+            break;
+        }
+
+        uint32_t top       = 0;
+        uint32_t remaining = width;
+        for (size_t j = i; remaining > 0; ++j)
+        {
+            top = std::max<uint32_t>(top, m_skyline[j].y);
+            remaining -= std::min<uint32_t>(remaining, m_skyline[j].width);
+        }
+
+        if (top + height > m_height)
+        {
+            continue;
+        }
+
+        if (top + height < bestBottom || (top + height == bestBottom && node.width < bestWidth))
+        {
+            bestBottom = top + height;
+            bestWidth  = node.width;
+            x          = node.x;
+            y          = static_cast<uint16_t>(top);
+            nodeIndex  = i;
+        }
+    }
+
+    return bestBottom != UINT32_MAX;
+}
+
+void TextureAtlas::insertSkyline(size_t nodeIndex, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    m_skyline.insert(m_skyline.begin() + nodeIndex, {x, static_cast<uint16_t>(y + height), width});
+
+    // 被新节点覆盖的部分从后面的节点中去掉
+    const uint32_t right = uint32_t(x) + width;
+    for (size_t i = nodeIndex + 1; i < m_skyline.size();)
+    {
+        SkylineNode& node = m_skyline[i];
+        if (node.x >= right)
+        {
+            break;
+        }
+
+        const uint32_t overlap = right - node.x;
+        if (node.width <= overlap)
+        {
+            m_skyline.erase(m_skyline.begin() + i);
+            continue;
+        }
+
+        node.x     = static_cast<uint16_t>(node.x + overlap);
+        node.width = static_cast<uint16_t>(node.width - overlap);
+        break;
+    }
+
+    // 合并高度相同的相邻节点
+    for (size_t i = 0; i + 1 < m_skyline.size();)
+    {
+        if (m_skyline[i].y == m_skyline[i + 1].y)
+        {
+            m_skyline[i].width = static_cast<uint16_t>(m_skyline[i].width + m_skyline[i + 1].width);
+            m_skyline.erase(m_skyline.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void TextureAtlas::buildMips(const Cell& cell)
+{
+    // 子图按 2^(mipSafeLevels-1) 对齐，每级 2x2 缩小只会读到子图自己的像素
+    const bool srgb = (m_flags & BGFX_TEXTURE_SRGB) != 0;
+    for (uint8_t level = 1; level < m_mipSafeLevels && level < m_levels.size(); ++level)
+    {
+        const uint32_t srcPitch = std::max(m_width >> (level - 1), 1) * 4;
+        const uint32_t dstPitch = std::max(m_width >> level, 1) * 4;
+        const uint8_t* src      = m_levels[level - 1].data() + size_t(cell.y >> (level - 1)) * srcPitch + size_t(cell.x >> (level - 1)) * 4;
+        uint8_t* dst            = m_levels[level].data() + size_t(cell.y >> level) * dstPitch + size_t(cell.x >> level) * 4;
+        resizeImage(
+            nullptr,
+            src,
+            cell.width >> (level - 1),
+            cell.height >> (level - 1),
+            srcPitch,
+            dst,
+            cell.width >> level,
+            cell.height >> level,
+            dstPitch,
+            ResizeFilter::Box,
+            srgb
+        );
+    }
+}
+
+void TextureAtlas::uploadLevel(uint8_t level, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    const uint32_t levelPitch = std::max(m_width >> level, 1) * 4;
+    const uint32_t rowSize    = uint32_t(width) * 4;
+    const bgfx::Memory* mem   = bgfx::alloc(rowSize * height);
+    for (uint16_t row = 0; row < height; ++row)
+    {
+        memcpy(mem->data + row * rowSize, m_levels[level].data() + (size_t(y) + row) * levelPitch + size_t(x) * 4, rowSize);
+    }
+
+    bgfx::updateTexture2D(m_handle, 0, level, x, y, width, height, mem);
+}
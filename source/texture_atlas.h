@@ -0,0 +1,102 @@
+﻿#pragma once
+
+#include "bgfx/bgfx.h"
+
+#include <cstdint>
+#include <vector>
+
+// 纹理图集：把很多小纹理放进一张 RGBA8 纹理，绘制时只需要绑定一次纹理，不同物体可以合批。
+// 使用 skyline 算法排列，每个子图四周用边缘像素填充 padding 宽的边，避免线性过滤时采样到相邻子图。
+// 子图的位置和大小按 2^(mipSafeLevels-1) 对齐，前 mipSafeLevels 级 mip 中各个子图互不影响，
+// 更小的 mip 由整张图缩小得到。
+// 可以随时添加子图（例如纹理流式加载时），update() 只上传新增的区域
+class TextureAtlas
+{
+public:
+    struct Region
+    {
+        uint16_t x {0}; // 子图内容（不含边）在图集中的位置
+        uint16_t y {0};
+        uint16_t width {0};
+        uint16_t height {0};
+        float uvRect[4] {}; // u0, v0, u1, v1
+    };
+
+    static constexpr int32_t kInvalidRegion = -1;
+
+    // width、height 不是 2^(mipSafeLevels-1) 的倍数时自动减少 mipSafeLevels，mipSafeLevels 为 1 时不生成 mip
+    TextureAtlas(
+        uint16_t width,
+        uint16_t height,
+        uint16_t padding      = 2,
+        uint8_t mipSafeLevels = 4,
+        uint64_t flags        = BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP
+    );
+
+    TextureAtlas(const TextureAtlas&)            = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    // 添加一张 RGBA8 图片，stride 为0时按紧密排列处理。图集放不下时返回 kInvalidRegion
+    int32_t add(const uint8_t* rgba, uint16_t width, uint16_t height, uint32_t stride = 0);
+
+    const Region& getRegion(int32_t region) const
+    {
+        return m_regions[region];
+    }
+
+    // 把子图自身的 UV（[0, 1]）映射到图集中。图集中的子图不支持 REPEAT 寻址
+    void remapUv(int32_t region, float& u, float& v) const;
+
+    // 导入模型时批量修改顶点中的 UV，offset 为 UV 在顶点中的字节偏移，UV 为两个 float
+    void remapUvs(int32_t region, void* vertices, uint32_t numVertices, uint32_t stride, uint32_t offset) const;
+
+    // 在调用 bgfx API 的线程中调用，第一次调用时创建纹理，之后只上传新增的子图
+    void update();
+
+    // 第一次 update() 之前返回无效句柄
+    bgfx::TextureHandle getHandle() const
+    {
+        return m_handle;
+    }
+
+    // 已经使用的面积比例
+    float getOccupancy() const;
+
+    // 销毁纹理，需要在 bgfx::shutdown 之前调用
+    void destroy();
+
+private:
+    struct SkylineNode
+    {
+        uint16_t x;
+        uint16_t y;
+        uint16_t width;
+    };
+
+    struct Cell
+    {
+        uint16_t x;
+        uint16_t y;
+        uint16_t width;
+        uint16_t height;
+    };
+
+    bool findPosition(uint16_t width, uint16_t height, uint16_t& x, uint16_t& y, size_t& nodeIndex) const;
+    void insertSkyline(size_t nodeIndex, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+    void buildMips(const Cell& cell);
+    void uploadLevel(uint8_t level, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
+    uint16_t m_width;
+    uint16_t m_height;
+    uint16_t m_padding;
+    uint16_t m_alignment;
+    uint8_t m_mipSafeLevels;
+    uint64_t m_flags;
+    bgfx::TextureHandle m_handle BGFX_INVALID_HANDLE;
+
+    std::vector<std::vector<uint8_t>> m_levels; // 完整 mip 链，每级一个 RGBA8 缓冲
+    std::vector<SkylineNode> m_skyline;
+    std::vector<Region> m_regions;
+    std::vector<Cell> m_dirty;
+    uint64_t m_usedArea {0};
+};
@@ -0,0 +1,152 @@
+﻿#include "texture_atlas.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// TextureAtlas 的回归测试：子图的排列和 UV 换算，不需要初始化 bgfx（不调用 update）
+namespace {
+int g_failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        ++g_failures;
+    }
+}
+
+bool nearlyEqual(float a, float b)
+{
+    return std::fabs(a - b) < 1e-6f;
+}
+
+std::vector<uint8_t> makeImage(uint16_t width, uint16_t height)
+{
+    std::vector<uint8_t> pixels(size_t(width) * height * 4);
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        pixels[i] = static_cast<uint8_t>(i * 13);
+    }
+    return pixels;
+}
+
+// 子图加上四周的边后互不重叠，不超出图集，边的起点按 mip 对齐
+void testPacking()
+{
+    constexpr uint16_t kSize      = 256;
+    constexpr uint16_t kPadding   = 2;
+    constexpr uint16_t kAlignment = 8; // mipSafeLevels 为4
+    constexpr uint16_t kGap       = kPadding * 2;
+    TextureAtlas atlas(kSize, kSize, kPadding, 4);
+
+    const uint16_t sizes[][2] = {{60, 30}, {17, 90}, {32, 32}, {5, 5}, {100, 12}, {40, 70}, {1, 1}, {64, 20}};
+    std::vector<int32_t> regions;
+    for (const auto& size : sizes)
+    {
+        const auto pixels = makeImage(size[0], size[1]);
+        regions.push_back(atlas.add(pixels.data(), size[0], size[1]));
+    }
+
+    printf("packing: %zu regions, occupancy %.2f\n", regions.size(), atlas.getOccupancy());
+    for (size_t i = 0; i < regions.size(); ++i)
+    {
+        check(regions[i] == int32_t(i), "regions are numbered in order");
+        const TextureAtlas::Region& region = atlas.getRegion(regions[i]);
+        check(region.width == sizes[i][0] && region.height == sizes[i][1], "region keeps the image size");
+        check(region.x >= kPadding && region.y >= kPadding, "region leaves room for the padding");
+        check(region.x + region.width + kPadding <= kSize && region.y + region.height + kPadding <= kSize, "region is inside the atlas");
+        check((region.x - kPadding) % kAlignment == 0 && (region.y - kPadding) % kAlignment == 0, "cell is aligned for mips");
+
+        check(nearlyEqual(region.uvRect[0], float(region.x) / kSize), "u0 matches the region");
+        check(nearlyEqual(region.uvRect[1], float(region.y) / kSize), "v0 matches the region");
+        check(nearlyEqual(region.uvRect[2], float(region.x + region.width) / kSize), "u1 matches the region");
+        check(nearlyEqual(region.uvRect[3], float(region.y + region.height) / kSize), "v1 matches the region");
+
+        for (size_t j = 0; j < i; ++j)
+        {
+            const TextureAtlas::Region& other = atlas.getRegion(regions[j]);
+            const bool apartX                 = region.x + region.width + kGap <= other.x || other.x + other.width + kGap <= region.x;
+            const bool apartY                 = region.y + region.height + kGap <= other.y || other.y + other.height + kGap <= region.y;
+            check(apartX || apartY, "padded regions do not overlap");
+        }
+    }
+    check(atlas.getOccupancy() > 0.0f && atlas.getOccupancy() <= 1.0f, "occupancy is in (0, 1]");
+}
+
+// 放不下的图片返回 kInvalidRegion，之后仍然可以放入更小的图片
+void testFull()
+{
+    TextureAtlas atlas(64, 64, 2, 1);
+    const auto large = makeImage(61, 10);
+    check(atlas.add(large.data(), 61, 10) == TextureAtlas::kInvalidRegion, "image wider than the atlas is rejected");
+    check(atlas.add(nullptr, 4, 4) == TextureAtlas::kInvalidRegion, "null pixels are rejected");
+
+    const auto tile = makeImage(12, 12);
+    int added       = 0;
+    while (atlas.add(tile.data(), 12, 12) != TextureAtlas::kInvalidRegion)
+    {
+        ++added;
+    }
+    printf("full: %d tiles of 12x12 in 64x64\n", added);
+    check(added == 16, "16 padded 16x16 cells fill the atlas");
+    check(nearlyEqual(atlas.getOccupancy(), 1.0f), "full atlas has occupancy 1");
+}
+
+// remapUvs 只修改顶点中 UV 所在的两个 float
+void testRemapUvs()
+{
+    struct Vertex
+    {
+        float x;
+        float y;
+        float z;
+        float u;
+        float v;
+    };
+
+    TextureAtlas atlas(128, 128, 2, 1);
+    const auto first  = makeImage(30, 10);
+    const auto second = makeImage(20, 40);
+    atlas.add(first.data(), 30, 10);
+    const int32_t region = atlas.add(second.data(), 20, 40);
+    check(region == 1, "second image gets region 1");
+
+    Vertex vertices[] = {
+        {1.0f, 2.0f, 3.0f, 0.0f, 0.0f},
+        {4.0f, 5.0f, 6.0f, 1.0f, 1.0f},
+        {7.0f, 8.0f, 9.0f, 0.5f, 0.25f},
+    };
+    atlas.remapUvs(region, vertices, 3, sizeof(Vertex), offsetof(Vertex, u));
+
+    const float* rect = atlas.getRegion(region).uvRect;
+    printf("remap: uv rect %.4f %.4f %.4f %.4f\n", rect[0], rect[1], rect[2], rect[3]);
+    check(nearlyEqual(vertices[0].u, rect[0]) && nearlyEqual(vertices[0].v, rect[1]), "(0, 0) maps to the top left");
+    check(nearlyEqual(vertices[1].u, rect[2]) && nearlyEqual(vertices[1].v, rect[3]), "(1, 1) maps to the bottom right");
+    check(nearlyEqual(vertices[2].u, (rect[0] + rect[2]) * 0.5f), "u is interpolated");
+    check(nearlyEqual(vertices[2].v, rect[1] + (rect[3] - rect[1]) * 0.25f), "v is interpolated");
+    check(vertices[1].x == 4.0f && vertices[1].y == 5.0f && vertices[1].z == 6.0f, "position is not modified");
+
+    float u = 0.5f;
+    float v = 0.25f;
+    atlas.remapUv(region, u, v);
+    check(nearlyEqual(u, vertices[2].u) && nearlyEqual(v, vertices[2].v), "remapUv matches remapUvs");
+}
+} // namespace
+
+int main()
+{
+    testPacking();
+    testFull();
+    testRemapUvs();
+
+    if (g_failures != 0)
+    {
+        fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return EXIT_FAILURE;
+    }
+    printf("all passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,371 @@
+﻿/*
+ * 离线纹理烘焙工具
+ * texture_baker [-f bc1|bc3|bc4|bc5|bc7] [-q fast|quality] [-j 线程数] [--no-mips] [--mip-filter box|triangle|lanczos3] [--srgb] input output.dds|output.ktx
+ * 用 stb_image 读取图片，生成 mipmap（--srgb 时在线性空间滤波），压缩成 BC 格式后写入 DDS 或 KTX 文件（按输出文件扩展名选择）
+ * 运行结束输出压缩吞吐量（MP/s）和第0级 mip 的 PSNR
+ */
+
+#include "block_compress.h"
+#include "image_resize.h"
+#include "stb_image.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+struct MipLevel
+{
+    uint32_t width {0};
+    uint32_t height {0};
+    std::vector<uint8_t> rgba;
+    std::vector<uint8_t> blocks;
+};
+
+struct FormatInfo
+{
+    const char* name;
+    BlockFormat format;
+    uint32_t fourCC;        // DDS 旧格式头使用，0 表示需要 DX10 扩展头
+    uint32_t dxgiFormat;
+    uint32_t dxgiFormatSrgb;
+    uint32_t glInternalFormat;
+    uint32_t glInternalFormatSrgb;
+    uint32_t glBaseInternalFormat;
+    int channels;           // 计算 PSNR 时比较的通道数
+};
+
+constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+{
+    return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+}
+
+// sRGB 版本为 0 表示该格式没有对应的 sRGB 格式
+const FormatInfo kFormats[] = {
+    {"bc1", BlockFormat::BC1, makeFourCC('D', 'X', 'T', '1'), 71, 72, 0x83F1, 0x8C4D, 0x1908, 4},
+    {"bc3", BlockFormat::BC3, makeFourCC('D', 'X', 'T', '5'), 77, 78, 0x83F3, 0x8C4F, 0x1908, 4},
+    {"bc4", BlockFormat::BC4, makeFourCC('A', 'T', 'I', '1'), 80, 0, 0x8DBB, 0, 0x1903, 1},
+    {"bc5", BlockFormat::BC5, makeFourCC('A', 'T', 'I', '2'), 83, 0, 0x8DBD, 0, 0x8227, 2},
+    {"bc7", BlockFormat::BC7, 0, 98, 99, 0x8E8C, 0x8E8D, 0x1908, 4},
+};
+
+void writeU32(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+bool endsWith(const std::string& str, const char* suffix)
+{
+    const size_t length = strlen(suffix);
+    if (str.size() < length)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (tolower(static_cast<unsigned char>(str[str.size() - length + i])) != suffix[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+double computePsnr(const MipLevel& level, BlockFormat format, int channels)
+{
+    std::vector<uint8_t> decoded(level.rgba.size());
+    decompressImage(format, level.blocks.data(), level.width, level.height, decoded.data());
+
+    double sum = 0.0;
+    for (size_t i = 0; i < decoded.size(); i += 4)
+    {
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            const double d = double(decoded[i + ch]) - double(level.rgba[i + ch]);
+            sum += d * d;
+        }
+    }
+
+    const double mse = sum / (double(level.width) * level.height * channels);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+std::vector<uint8_t> buildDds(const FormatInfo& info, bool srgb, const std::vector<MipLevel>& mips)
+{
+    constexpr uint32_t kDdsdCaps        = 0x1;
+    constexpr uint32_t kDdsdHeight      = 0x2;
+    constexpr uint32_t kDdsdWidth       = 0x4;
+    constexpr uint32_t kDdsdPixelFormat = 0x1000;
+    constexpr uint32_t kDdsdMipMapCount = 0x20000;
+    constexpr uint32_t kDdsdLinearSize  = 0x80000;
+    constexpr uint32_t kDdpfFourCC      = 0x4;
+    constexpr uint32_t kDdsCapsComplex  = 0x8;
+    constexpr uint32_t kDdsCapsTexture  = 0x1000;
+    constexpr uint32_t kDdsCapsMipMap   = 0x400000;
+
+    // BC7 和 sRGB 格式只能用 DX10 扩展头表示
+    const bool dx10 = info.fourCC == 0 || srgb;
+
+    std::vector<uint8_t> out;
+    writeU32(out, makeFourCC('D', 'D', 'S', ' '));
+    writeU32(out, 124);
+    writeU32(out, kDdsdCaps | kDdsdHeight | kDdsdWidth | kDdsdPixelFormat | kDdsdLinearSize | (mips.size() > 1 ? kDdsdMipMapCount : 0));
+    writeU32(out, mips[0].height);
+    writeU32(out, mips[0].width);
+    writeU32(out, static_cast<uint32_t>(mips[0].blocks.size()));
+    writeU32(out, 0); // depth
+    writeU32(out, static_cast<uint32_t>(mips.size()));
+    for (int i = 0; i < 11; ++i)
+    {
+        writeU32(out, 0);
+    }
+
+    // DDS_PIXELFORMAT
+    writeU32(out, 32);
+    writeU32(out, kDdpfFourCC);
+    writeU32(out, dx10 ? makeFourCC('D', 'X', '1', '0') : info.fourCC);
+    for (int i = 0; i < 5; ++i)
+    {
+        writeU32(out, 0);
+    }
+
+    writeU32(out, kDdsCapsTexture | (mips.size() > 1 ? kDdsCapsComplex | kDdsCapsMipMap : 0));
+    for (int i = 0; i < 4; ++i)
+    {
+        writeU32(out, 0);
+    }
+
+    if (dx10)
+    {
+        writeU32(out, srgb ? info.dxgiFormatSrgb : info.dxgiFormat);
+        writeU32(out, 3); // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+        writeU32(out, 0);
+        writeU32(out, 1); // arraySize
+        writeU32(out, 0);
+    }
+
+    for (const auto& mip : mips)
+    {
+        out.insert(out.end(), mip.blocks.begin(), mip.blocks.end());
+    }
+    return out;
+}
+
+std::vector<uint8_t> buildKtx(const FormatInfo& info, bool srgb, const std::vector<MipLevel>& mips)
+{
+    static const uint8_t kKtxIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    std::vector<uint8_t> out(kKtxIdentifier, kKtxIdentifier + sizeof(kKtxIdentifier));
+    writeU32(out, 0x04030201);
+    writeU32(out, 0); // glType，压缩格式为0
+    writeU32(out, 1); // glTypeSize
+    writeU32(out, 0); // glFormat
+    writeU32(out, srgb ? info.glInternalFormatSrgb : info.glInternalFormat);
+    writeU32(out, info.glBaseInternalFormat);
+    writeU32(out, mips[0].width);
+    writeU32(out, mips[0].height);
+    writeU32(out, 0); // depth
+    writeU32(out, 0); // arraySize
+    writeU32(out, 1); // faces
+    writeU32(out, static_cast<uint32_t>(mips.size()));
+    writeU32(out, 0); // bytesOfKeyValueData
+
+    // 块大小是8或16字节，每级 mip 天然4字节对齐，不需要填充
+    for (const auto& mip : mips)
+    {
+        writeU32(out, static_cast<uint32_t>(mip.blocks.size()));
+        out.insert(out.end(), mip.blocks.begin(), mip.blocks.end());
+    }
+    return out;
+}
+
+void printUsage()
+{
+    printf("usage: texture_baker [-f bc1|bc3|bc4|bc5|bc7] [-q fast|quality] [-j threads] [--no-mips] [--mip-filter box|triangle|lanczos3] [--srgb] input output.dds|output.ktx\n");
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const FormatInfo* info = &kFormats[0];
+    BlockQuality quality   = BlockQuality::Fast;
+    int threads            = 0;
+    bool generateMips      = true;
+    ResizeFilter mipFilter = ResizeFilter::Box;
+    bool srgb              = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "-f" && i + 1 < argc)
+        {
+            const std::string name = argv[++i];
+            info                   = nullptr;
+            for (const auto& format : kFormats)
+            {
+                if (name == format.name)
+                {
+                    info = &format;
+                }
+            }
+            if (!info)
+            {
+                printf("unknown format: %s\n", name.c_str());
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "-q" && i + 1 < argc)
+        {
+            const std::string preset = argv[++i];
+            quality                  = preset == "quality" ? BlockQuality::Quality : BlockQuality::Fast;
+        }
+        else if (arg == "-j" && i + 1 < argc)
+        {
+            threads = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--no-mips")
+        {
+            generateMips = false;
+        }
+        else if (arg == "--mip-filter" && i + 1 < argc)
+        {
+            const std::string name = argv[++i];
+            mipFilter              = name == "lanczos3" ? ResizeFilter::Lanczos3 : (name == "triangle" ? ResizeFilter::Triangle : ResizeFilter::Box);
+        }
+        else if (arg == "--srgb")
+        {
+            srgb = true;
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.size() != 2)
+    {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const std::string& inputPath  = files[0];
+    const std::string& outputPath = files[1];
+    const bool ktx                = endsWith(outputPath, ".ktx");
+    if (!ktx && !endsWith(outputPath, ".dds"))
+    {
+        printf("output must be .dds or .ktx: %s\n", outputPath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    if (srgb && info->dxgiFormatSrgb == 0)
+    {
+        printf("%s has no sRGB variant, ignoring --srgb\n", info->name);
+        srgb = false;
+    }
+
+    int width       = 0;
+    int height      = 0;
+    int channels    = 0;
+    stbi_uc* pixels = stbi_load(inputPath.c_str(), &width, &height, &channels, 4);
+    if (!pixels)
+    {
+        printf("failed to load %s: %s\n", inputPath.c_str(), stbi_failure_reason());
+        return EXIT_FAILURE;
+    }
+    if (width > UINT16_MAX || height > UINT16_MAX)
+    {
+        printf("image too large: %dx%d\n", width, height);
+        stbi_image_free(pixels);
+        return EXIT_FAILURE;
+    }
+
+    // 调用线程也参与计算，所以线程池只需要 threads - 1 个工作线程，-j 1 时不使用线程池
+    std::unique_ptr<ThreadPool> threadPool;
+    if (threads != 1)
+    {
+        threadPool = std::make_unique<ThreadPool>(threads > 1 ? static_cast<uint32_t>(threads - 1) : 0u);
+    }
+    const uint32_t usedThreads = threadPool ? threadPool->getThreadCount() + 1 : 1;
+
+    const uint32_t mipCount = generateMips ? getMipCount(width, height) : 1;
+    std::vector<uint8_t> chain;
+    if (mipCount > 1)
+    {
+        chain.resize(getMipChainSize(width, height, 4));
+        generateMipChain(threadPool.get(), pixels, width, height, mipFilter, srgb, chain.data());
+    }
+    else
+    {
+        chain.assign(pixels, pixels + size_t(width) * height * 4);
+    }
+    stbi_image_free(pixels);
+
+    std::vector<MipLevel> mips(mipCount);
+    size_t offset = 0;
+    for (uint32_t i = 0; i < mipCount; ++i)
+    {
+        mips[i].width  = std::max(uint32_t(width) >> i, 1u);
+        mips[i].height = std::max(uint32_t(height) >> i, 1u);
+
+        const size_t size = size_t(mips[i].width) * mips[i].height * 4;
+        mips[i].rgba.assign(chain.begin() + offset, chain.begin() + offset + size);
+        offset += size;
+    }
+
+    double pixelCount = 0.0;
+    const auto start  = std::chrono::steady_clock::now();
+    for (auto& mip : mips)
+    {
+        mip.blocks.resize(getCompressedSize(info->format, mip.width, mip.height));
+        compressImage(threadPool.get(), info->format, quality, mip.rgba.data(), mip.width, mip.height, mip.blocks.data());
+        pixelCount += double(mip.width) * mip.height;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const std::vector<uint8_t> fileData = ktx ? buildKtx(*info, srgb, mips) : buildDds(*info, srgb, mips);
+    FILE* file                          = fopen(outputPath.c_str(), "wb");
+    if (!file || fwrite(fileData.data(), 1, fileData.size(), file) != fileData.size())
+    {
+        printf("failed to write %s\n", outputPath.c_str());
+        if (file)
+        {
+            fclose(file);
+        }
+        return EXIT_FAILURE;
+    }
+    fclose(file);
+
+    printf(
+        "%s -> %s  %ux%u %s%s %s  %zu mips  %u threads\n",
+        inputPath.c_str(),
+        outputPath.c_str(),
+        mips[0].width,
+        mips[0].height,
+        info->name,
+        srgb ? " srgb" : "",
+        quality == BlockQuality::Quality ? "quality" : "fast",
+        mips.size(),
+        usedThreads
+    );
+    printf(
+        "encode %.3f ms  %.2f MP/s  psnr %.2f dB  %zu bytes\n",
+        seconds * 1000.0,
+        pixelCount / 1.0e6 / seconds,
+        computePsnr(mips[0], info->format, info->channels),
+        fileData.size()
+    );
+
+    return EXIT_SUCCESS;
+}
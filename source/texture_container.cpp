@@ -0,0 +1,508 @@
+﻿#include "texture_container.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+
+namespace {
+constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+{
+    return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+}
+
+// DDS 文件头，见 https://learn.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+constexpr uint32_t kDdsMagic          = makeFourCC('D', 'D', 'S', ' ');
+constexpr size_t kDdsHeaderSize       = 128; // magic + DDS_HEADER
+constexpr size_t kDdsDx10HeaderSize   = 20;
+constexpr uint32_t kDdpfAlphaPixels   = 0x1;
+constexpr uint32_t kDdpfFourCC        = 0x4;
+constexpr uint32_t kDdpfRgb           = 0x40;
+constexpr uint32_t kDdsCaps2Cubemap   = 0x200;
+constexpr uint32_t kDdsCaps2Volume    = 0x200000;
+constexpr uint32_t kDxgiDimension2D   = 3;
+constexpr uint32_t kDxgiMiscCubemap   = 0x4;
+
+// KTX1 文件头，见 https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html
+constexpr uint8_t kKtxIdentifier[12]  = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+constexpr size_t kKtxHeaderSize       = 64;
+constexpr uint32_t kKtxEndianness     = 0x04030201;
+
+uint32_t readU32(const uint8_t* ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+struct FormatDesc
+{
+    bgfx::TextureFormat::Enum format;
+    bool srgb;
+};
+
+FormatDesc fromDdsFourCC(uint32_t fourCC)
+{
+    switch (fourCC)
+    {
+        case makeFourCC('D', 'X', 'T', '1'):
+            return {bgfx::TextureFormat::BC1, false};
+        case makeFourCC('D', 'X', 'T', '2'):
+        case makeFourCC('D', 'X', 'T', '3'):
+            return {bgfx::TextureFormat::BC2, false};
+        case makeFourCC('D', 'X', 'T', '4'):
+        case makeFourCC('D', 'X', 'T', '5'):
+            return {bgfx::TextureFormat::BC3, false};
+        case makeFourCC('A', 'T', 'I', '1'):
+        case makeFourCC('B', 'C', '4', 'U'):
+            return {bgfx::TextureFormat::BC4, false};
+        case makeFourCC('A', 'T', 'I', '2'):
+        case makeFourCC('B', 'C', '5', 'U'):
+            return {bgfx::TextureFormat::BC5, false};
+        case makeFourCC('E', 'T', 'C', '1'):
+            return {bgfx::TextureFormat::ETC1, false};
+        default:
+            return {bgfx::TextureFormat::Unknown, false};
+    }
+}
+
+FormatDesc fromDxgiFormat(uint32_t dxgiFormat)
+{
+    switch (dxgiFormat)
+    {
+        case 28: // DXGI_FORMAT_R8G8B8A8_UNORM
+            return {bgfx::TextureFormat::RGBA8, false};
+        case 29: // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+            return {bgfx::TextureFormat::RGBA8, true};
+        case 71: // DXGI_FORMAT_BC1_UNORM
+            return {bgfx::TextureFormat::BC1, false};
+        case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+            return {bgfx::TextureFormat::BC1, true};
+        case 74: // DXGI_FORMAT_BC2_UNORM
+            return {bgfx::TextureFormat::BC2, false};
+        case 75: // DXGI_FORMAT_BC2_UNORM_SRGB
+            return {bgfx::TextureFormat::BC2, true};
+        case 77: // DXGI_FORMAT_BC3_UNORM
+            return {bgfx::TextureFormat::BC3, false};
+        case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+            return {bgfx::TextureFormat::BC3, true};
+        case 80: // DXGI_FORMAT_BC4_UNORM
+            return {bgfx::TextureFormat::BC4, false};
+        case 83: // DXGI_FORMAT_BC5_UNORM
+            return {bgfx::TextureFormat::BC5, false};
+        case 87: // DXGI_FORMAT_B8G8R8A8_UNORM
+            return {bgfx::TextureFormat::BGRA8, false};
+        case 91: // DXGI_FORMAT_B8G8R8A8_UNORM_SRGB
+            return {bgfx::TextureFormat::BGRA8, true};
+        case 95: // DXGI_FORMAT_BC6H_UF16
+            return {bgfx::TextureFormat::BC6H, false};
+        case 98: // DXGI_FORMAT_BC7_UNORM
+            return {bgfx::TextureFormat::BC7, false};
+        case 99: // DXGI_FORMAT_BC7_UNORM_SRGB
+            return {bgfx::TextureFormat::BC7, true};
+        default:
+            return {bgfx::TextureFormat::Unknown, false};
+    }
+}
+
+FormatDesc fromGlInternalFormat(uint32_t glInternalFormat)
+{
+    switch (glInternalFormat)
+    {
+        case 0x8058: // GL_RGBA8
+            return {bgfx::TextureFormat::RGBA8, false};
+        case 0x8C43: // GL_SRGB8_ALPHA8
+            return {bgfx::TextureFormat::RGBA8, true};
+        case 0x83F0: // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+        case 0x83F1: // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+            return {bgfx::TextureFormat::BC1, false};
+        case 0x8C4C: // GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+        case 0x8C4D: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+            return {bgfx::TextureFormat::BC1, true};
+        case 0x83F2: // GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+            return {bgfx::TextureFormat::BC2, false};
+        case 0x8C4E: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT
+            return {bgfx::TextureFormat::BC2, true};
+        case 0x83F3: // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+            return {bgfx::TextureFormat::BC3, false};
+        case 0x8C4F: // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+            return {bgfx::TextureFormat::BC3, true};
+        case 0x8DBB: // GL_COMPRESSED_RED_RGTC1
+            return {bgfx::TextureFormat::BC4, false};
+        case 0x8DBD: // GL_COMPRESSED_RG_RGTC2
+            return {bgfx::TextureFormat::BC5, false};
+        case 0x8E8F: // GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT
+            return {bgfx::TextureFormat::BC6H, false};
+        case 0x8E8C: // GL_COMPRESSED_RGBA_BPTC_UNORM
+            return {bgfx::TextureFormat::BC7, false};
+        case 0x8E8D: // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+            return {bgfx::TextureFormat::BC7, true};
+        case 0x8D64: // GL_ETC1_RGB8_OES
+            return {bgfx::TextureFormat::ETC1, false};
+        case 0x9274: // GL_COMPRESSED_RGB8_ETC2
+            return {bgfx::TextureFormat::ETC2, false};
+        case 0x9275: // GL_COMPRESSED_SRGB8_ETC2
+            return {bgfx::TextureFormat::ETC2, true};
+        case 0x9276: // GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2
+            return {bgfx::TextureFormat::ETC2A1, false};
+        case 0x9277: // GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2
+            return {bgfx::TextureFormat::ETC2A1, true};
+        case 0x9278: // GL_COMPRESSED_RGBA8_ETC2_EAC
+            return {bgfx::TextureFormat::ETC2A, false};
+        case 0x9279: // GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC
+            return {bgfx::TextureFormat::ETC2A, true};
+        case 0x93B0: // GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+            return {bgfx::TextureFormat::ASTC4x4, false};
+        case 0x93B2: // GL_COMPRESSED_RGBA_ASTC_5x5_KHR
+            return {bgfx::TextureFormat::ASTC5x5, false};
+        case 0x93B4: // GL_COMPRESSED_RGBA_ASTC_6x6_KHR
+            return {bgfx::TextureFormat::ASTC6x6, false};
+        case 0x93B5: // GL_COMPRESSED_RGBA_ASTC_8x5_KHR
+            return {bgfx::TextureFormat::ASTC8x5, false};
+        case 0x93B6: // GL_COMPRESSED_RGBA_ASTC_8x6_KHR
+            return {bgfx::TextureFormat::ASTC8x6, false};
+        case 0x93B7: // GL_COMPRESSED_RGBA_ASTC_8x8_KHR
+            return {bgfx::TextureFormat::ASTC8x8, false};
+        case 0x93B8: // GL_COMPRESSED_RGBA_ASTC_10x5_KHR
+            return {bgfx::TextureFormat::ASTC10x5, false};
+        case 0x93D0: // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR
+            return {bgfx::TextureFormat::ASTC4x4, true};
+        case 0x93D2: // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_5x5_KHR
+            return {bgfx::TextureFormat::ASTC5x5, true};
+        case 0x93D4: // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR
+            return {bgfx::TextureFormat::ASTC6x6, true};
+        case 0x93D5: // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x5_KHR
+            return {bgfx::TextureFormat::ASTC8x5, true};
+        case 0x93D6: // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x6_KHR
+            return {bgfx::TextureFormat::ASTC8x6, true};
+        case 0x93D7: // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR
+            return {bgfx::TextureFormat::ASTC8x8, true};
+        case 0x93D8: // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x5_KHR
+            return {bgfx::TextureFormat::ASTC10x5, true};
+        default:
+            return {bgfx::TextureFormat::Unknown, false};
+    }
+}
+
+// 一个 mip 的字节数，块压缩格式按整块计算
+uint32_t getMipSize(bgfx::TextureFormat::Enum format, uint32_t width, uint32_t height)
+{
+    uint32_t blockWidth  = 4;
+    uint32_t blockHeight = 4;
+    uint32_t blockSize   = 16;
+    switch (format)
+    {
+        case bgfx::TextureFormat::BC1:
+        case bgfx::TextureFormat::BC4:
+        case bgfx::TextureFormat::ETC1:
+        case bgfx::TextureFormat::ETC2:
+        case bgfx::TextureFormat::ETC2A1:
+            blockSize = 8;
+            break;
+        case bgfx::TextureFormat::BC2:
+        case bgfx::TextureFormat::BC3:
+        case bgfx::TextureFormat::BC5:
+        case bgfx::TextureFormat::BC6H:
+        case bgfx::TextureFormat::BC7:
+        case bgfx::TextureFormat::ETC2A:
+        case bgfx::TextureFormat::ASTC4x4:
+            break;
+        case bgfx::TextureFormat::ASTC5x5:
+            blockWidth = blockHeight = 5;
+            break;
+        case bgfx::TextureFormat::ASTC6x6:
+            blockWidth = blockHeight = 6;
+            break;
+        case bgfx::TextureFormat::ASTC8x5:
+            blockWidth  = 8;
+            blockHeight = 5;
+            break;
+        case bgfx::TextureFormat::ASTC8x6:
+            blockWidth  = 8;
+            blockHeight = 6;
+            break;
+        case bgfx::TextureFormat::ASTC8x8:
+            blockWidth = blockHeight = 8;
+            break;
+        case bgfx::TextureFormat::ASTC10x5:
+            blockWidth  = 10;
+            blockHeight = 5;
+            break;
+        default:
+            // RGBA8 / BGRA8
+            blockWidth = blockHeight = 1;
+            blockSize                = 4;
+            break;
+    }
+
+    return ((width + blockWidth - 1) / blockWidth) * ((height + blockHeight - 1) / blockHeight) * blockSize;
+}
+
+void releaseContainer(void* /*ptr*/, void* userData)
+{
+    delete static_cast<std::shared_ptr<TextureContainer>*>(userData);
+}
+} // namespace
+
+bool TextureContainer::isContainerFile(const char* filePath)
+{
+    std::string path(filePath);
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+    {
+        return false;
+    }
+
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == "dds" || ext == "ktx";
+}
+
+bool TextureContainer::open(const char* filePath)
+{
+    m_mips.clear();
+    if (!m_file.open(filePath))
+    {
+        return false;
+    }
+
+    const bool parsed = m_file.getSize() >= 4 && readU32(m_file.getData()) == kDdsMagic ? parseDds() : parseKtx();
+    if (!parsed || m_mips.empty())
+    {
+        m_mips.clear();
+        m_file.close();
+        return false;
+    }
+
+    // bgfx 的 hasMips 要求完整的 mip 链，不完整时只使用第0级
+    uint32_t fullChain = 1;
+    for (uint32_t size = std::max(m_width, m_height); size > 1; size >>= 1)
+    {
+        ++fullChain;
+    }
+    if (m_mips.size() != fullChain)
+    {
+        m_mips.resize(1);
+    }
+
+    return true;
+}
+
+bool TextureContainer::addMip(size_t offset, uint16_t width, uint16_t height)
+{
+    const uint32_t size = getMipSize(m_format, width, height);
+    if (offset > m_file.getSize() || size > m_file.getSize() - offset)
+    {
+        return false;
+    }
+
+    Mip mip;
+    mip.data   = m_file.getData() + offset;
+    mip.size   = size;
+    mip.width  = width;
+    mip.height = height;
+    m_mips.push_back(mip);
+    return true;
+}
+
+bool TextureContainer::parseDds()
+{
+    const uint8_t* data = m_file.getData();
+    const size_t size   = m_file.getSize();
+    if (size < kDdsHeaderSize || readU32(data + 4) != 124)
+    {
+        return false;
+    }
+
+    const uint32_t height   = readU32(data + 12);
+    const uint32_t width    = readU32(data + 16);
+    const uint32_t mipCount = std::max(readU32(data + 28), 1u);
+    const uint32_t pfFlags  = readU32(data + 80);
+    const uint32_t fourCC   = readU32(data + 84);
+    const uint32_t bitCount = readU32(data + 88);
+    const uint32_t redMask  = readU32(data + 92);
+    const uint32_t blueMask = readU32(data + 100);
+    const uint32_t caps2    = readU32(data + 112);
+    if (width == 0 || height == 0 || width > UINT16_MAX || height > UINT16_MAX || (caps2 & (kDdsCaps2Cubemap | kDdsCaps2Volume)))
+    {
+        return false;
+    }
+
+    size_t offset = kDdsHeaderSize;
+    FormatDesc desc {bgfx::TextureFormat::Unknown, false};
+    if ((pfFlags & kDdpfFourCC) && fourCC == makeFourCC('D', 'X', '1', '0'))
+    {
+        if (size < kDdsHeaderSize + kDdsDx10HeaderSize)
+        {
+            return false;
+        }
+
+        const uint32_t dimension = readU32(data + 132);
+        const uint32_t miscFlag  = readU32(data + 136);
+        const uint32_t arraySize = readU32(data + 140);
+        if (dimension != kDxgiDimension2D || (miscFlag & kDxgiMiscCubemap) || arraySize > 1)
+        {
+            return false;
+        }
+
+        desc = fromDxgiFormat(readU32(data + 128));
+        offset += kDdsDx10HeaderSize;
+    }
+    else if (pfFlags & kDdpfFourCC)
+    {
+        desc = fromDdsFourCC(fourCC);
+    }
+    else if ((pfFlags & kDdpfRgb) && (pfFlags & kDdpfAlphaPixels) && bitCount == 32)
+    {
+        if (redMask == 0x000000ff && blueMask == 0x00ff0000)
+        {
+            desc.format = bgfx::TextureFormat::RGBA8;
+        }
+        else if (redMask == 0x00ff0000 && blueMask == 0x000000ff)
+        {
+            desc.format = bgfx::TextureFormat::BGRA8;
+        }
+    }
+
+    if (desc.format == bgfx::TextureFormat::Unknown)
+    {
+        return false;
+    }
+
+    m_format     = desc.format;
+    m_srgb       = desc.srgb;
+    m_width      = static_cast<uint16_t>(width);
+    m_height     = static_cast<uint16_t>(height);
+    m_contiguous = true;
+
+    // DDS 中各级 mip 紧密排列，和 createTexture2D 要求的内存布局一致
+    uint16_t mipWidth  = m_width;
+    uint16_t mipHeight = m_height;
+    for (uint32_t i = 0; i < mipCount; ++i)
+    {
+        if (!addMip(offset, mipWidth, mipHeight))
+        {
+            return false;
+        }
+
+        offset += m_mips.back().size;
+        mipWidth  = std::max<uint16_t>(mipWidth >> 1, 1);
+        mipHeight = std::max<uint16_t>(mipHeight >> 1, 1);
+    }
+
+    return true;
+}
+
+bool TextureContainer::parseKtx()
+{
+    const uint8_t* data = m_file.getData();
+    const size_t size   = m_file.getSize();
+    if (size < kKtxHeaderSize || memcmp(data, kKtxIdentifier, sizeof(kKtxIdentifier)) != 0)
+    {
+        return false;
+    }
+
+    // 只支持小端存储的文件（所有常用工具的默认输出）
+    if (readU32(data + 12) != kKtxEndianness)
+    {
+        return false;
+    }
+
+    const FormatDesc desc      = fromGlInternalFormat(readU32(data + 28));
+    const uint32_t width       = readU32(data + 36);
+    const uint32_t height      = readU32(data + 40);
+    const uint32_t depth       = readU32(data + 44);
+    const uint32_t arraySize   = readU32(data + 48);
+    const uint32_t faces       = readU32(data + 52);
+    const uint32_t mipCount    = std::max(readU32(data + 56), 1u);
+    const uint32_t keyValueLen = readU32(data + 60);
+    if (desc.format == bgfx::TextureFormat::Unknown || width == 0 || height == 0 || width > UINT16_MAX || height > UINT16_MAX || depth != 0
+        || arraySize != 0 || faces != 1 || keyValueLen > size - kKtxHeaderSize)
+    {
+        return false;
+    }
+
+    m_format     = desc.format;
+    m_srgb       = desc.srgb;
+    m_width      = static_cast<uint16_t>(width);
+    m_height     = static_cast<uint16_t>(height);
+    m_contiguous = false;
+
+    // 每一级 mip 前有4字节的 imageSize，数据按4字节对齐
+    size_t offset      = kKtxHeaderSize + keyValueLen;
+    uint16_t mipWidth  = m_width;
+    uint16_t mipHeight = m_height;
+    for (uint32_t i = 0; i < mipCount; ++i)
+    {
+        if (offset + 4 > size)
+        {
+            return false;
+        }
+
+        const uint32_t imageSize = readU32(data + offset);
+        offset += 4;
+        if (!addMip(offset, mipWidth, mipHeight) || imageSize < m_mips.back().size)
+        {
+            return false;
+        }
+
+        offset += (static_cast<size_t>(imageSize) + 3) & ~size_t(3);
+        mipWidth  = std::max<uint16_t>(mipWidth >> 1, 1);
+        mipHeight = std::max<uint16_t>(mipHeight >> 1, 1);
+    }
+
+    return true;
+}
+
+bool TextureContainer::isFormatSupported() const
+{
+    if (m_mips.empty())
+    {
+        return false;
+    }
+
+    const bgfx::Caps* caps  = bgfx::getCaps();
+    const uint16_t required = m_srgb ? BGFX_CAPS_FORMAT_TEXTURE_2D_SRGB : BGFX_CAPS_FORMAT_TEXTURE_2D;
+    return (caps->formats[m_format] & required) != 0 && m_width <= caps->limits.maxTextureSize && m_height <= caps->limits.maxTextureSize;
+}
+
+bgfx::TextureHandle TextureContainer::createTexture(uint64_t flags)
+{
+    if (m_mips.empty())
+    {
+        return BGFX_INVALID_HANDLE;
+    }
+
+    if (m_srgb)
+    {
+        flags |= BGFX_TEXTURE_SRGB;
+    }
+
+    // 每个 makeRef 持有一份引用，bgfx 全部释放后才解除映射
+    auto makeRef = [this](const uint8_t* data, uint32_t size) {
+        return bgfx::makeRef(data, size, releaseContainer, new std::shared_ptr<TextureContainer>(shared_from_this()));
+    };
+
+    const bool hasMips = m_mips.size() > 1;
+    if (m_contiguous)
+    {
+        const Mip& last     = m_mips.back();
+        const uint32_t size = static_cast<uint32_t>(last.data + last.size - m_mips.front().data);
+        return bgfx::createTexture2D(m_width, m_height, hasMips, 1, m_format, flags, makeRef(m_mips.front().data, size));
+    }
+
+    // 各级 mip 不连续（KTX），先创建空纹理再逐级更新
+    bgfx::TextureHandle handle = bgfx::createTexture2D(m_width, m_height, hasMips, 1, m_format, flags, nullptr);
+    if (!bgfx::isValid(handle))
+    {
+        return handle;
+    }
+
+    for (size_t i = 0; i < m_mips.size(); ++i)
+    {
+        const Mip& mip = m_mips[i];
+        bgfx::updateTexture2D(handle, 0, static_cast<uint8_t>(i), 0, 0, mip.width, mip.height, makeRef(mip.data, mip.size));
+    }
+
+    return handle;
+}
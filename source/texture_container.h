@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include "mapped_file.h"
+
+#include "bgfx/bgfx.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// DDS / KTX1 纹理容器：文件通过内存映射读取，各级 mip 直接引用映射内存交给 bgfx，
+// BC/ETC/ASTC 等块压缩格式不需要在 CPU 上解码，显存占用也只有 RGBA8 的 1/4 ~ 1/8
+class TextureContainer : public std::enable_shared_from_this<TextureContainer>
+{
+public:
+    struct Mip
+    {
+        const uint8_t* data {nullptr};
+        uint32_t size {0};
+        uint16_t width {0};
+        uint16_t height {0};
+    };
+
+    // 根据扩展名判断是否为 .dds / .ktx 文件
+    static bool isContainerFile(const char* filePath);
+
+    // 映射文件并解析文件头，只支持单层的 2D 纹理
+    bool open(const char* filePath);
+
+    // 当前渲染后端是否支持该格式，需要在 bgfx::init 之后调用
+    bool isFormatSupported() const;
+
+    // 创建纹理。mip 数据通过 bgfx::makeRef 引用映射内存，
+    // bgfx 用完之前 TextureContainer 不会被释放，调用方不需要继续持有
+    bgfx::TextureHandle createTexture(uint64_t flags);
+
+    bgfx::TextureFormat::Enum getFormat() const
+    {
+        return m_format;
+    }
+
+    uint16_t getWidth() const
+    {
+        return m_width;
+    }
+
+    uint16_t getHeight() const
+    {
+        return m_height;
+    }
+
+    uint8_t getNumMips() const
+    {
+        return static_cast<uint8_t>(m_mips.size());
+    }
+
+    bool isSrgb() const
+    {
+        return m_srgb;
+    }
+
+private:
+    bool parseDds();
+    bool parseKtx();
+
+    // 按格式的块大小计算并校验每一级 mip，offset 为第0级在文件中的偏移
+    bool addMip(size_t offset, uint16_t width, uint16_t height);
+
+    MappedFile m_file;
+    bgfx::TextureFormat::Enum m_format {bgfx::TextureFormat::Unknown};
+    bool m_srgb {false};
+    bool m_contiguous {false}; // 各级 mip 在文件中连续存放（DDS），可以一次性交给 createTexture2D
+    uint16_t m_width {0};
+    uint16_t m_height {0};
+    std::vector<Mip> m_mips;
+};
@@ -0,0 +1,535 @@
+﻿#include "texture_manager.h"
+#include "image_resize.h"
+#include "qoi_codec.h"
+#include "texture_atlas.h"
+#include "texture_container.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+// stb_image 的内存分配走这里：16字节对齐并在头部记录大小。
+// 解码结果通过 bgfx::makeRef 直接交给 bgfx，bgfx 用完后调用 releaseImage 释放，
+// 像素数据不需要再拷贝一份到 bgfx::alloc 分配的内存中
+static void* stbiMalloc(size_t size);
+static void* stbiRealloc(void* ptr, size_t newSize);
+static void stbiFree(void* ptr);
+
+#define STBI_MALLOC(sz) stbiMalloc(sz)
+#define STBI_REALLOC(p, newsz) stbiRealloc(p, newsz)
+#define STBI_FREE(p) stbiFree(p)
+#include "stb_image.h"
+
+namespace {
+constexpr size_t kStbiHeaderSize = 16;
+
+std::atomic<size_t> g_stbiBytesInFlight {0};
+
+void releaseImage(void* ptr, void* /*userData*/)
+{
+    stbi_image_free(ptr);
+}
+
+// 大尺寸 JPEG 的 IDCT 和颜色转换交给线程池，解码任务本身也在线程池中，嵌套调用是安全的
+void stbiParallelFor(void* user, int count, stbi_parallel_task* task, void* taskData)
+{
+    static_cast<ThreadPool*>(user)->parallelFor(static_cast<uint32_t>(count), 1, [task, taskData](uint32_t begin, uint32_t end) {
+        task(taskData, static_cast<int>(begin), static_cast<int>(end));
+    });
+}
+
+// bgfx 的纹理宽高是 uint16_t，bgfx::Memory 的大小是 uint32_t，超出范围的图片不能上传
+bool getImageSize(int64_t width, int64_t height, size_t bytesPerPixel, uint32_t& size)
+{
+    if (width <= 0 || height <= 0 || width > UINT16_MAX || height > UINT16_MAX)
+    {
+        return false;
+    }
+
+    const size_t bytes = size_t(width) * size_t(height) * bytesPerPixel;
+    if (bytes > UINT32_MAX)
+    {
+        return false;
+    }
+    size = static_cast<uint32_t>(bytes);
+    return true;
+}
+
+bool readFile(const char* filePath, std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(filePath, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data.resize(fileSize > 0 ? static_cast<size_t>(fileSize) : 0);
+    const size_t readSize = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+
+    return fileSize > 0 && readSize == data.size();
+}
+
+// 压缩纹理不可用时的备选图片：同目录下同名的 PNG/JPEG 等文件
+std::string findFallbackImage(const std::string& filePath)
+{
+    static const char* const kExtensions[] = {".png", ".qoi", ".jpg", ".jpeg", ".tga", ".bmp", ".hdr"};
+
+    const size_t dot       = filePath.find_last_of('.');
+    const std::string stem = filePath.substr(0, dot);
+    for (const char* ext : kExtensions)
+    {
+        const std::string candidate = stem + ext;
+        if (FILE* file = fopen(candidate.c_str(), "rb"))
+        {
+            fclose(file);
+            return candidate;
+        }
+    }
+
+    return {};
+}
+} // namespace
+
+static void* stbiMalloc(size_t size)
+{
+    auto base = static_cast<uint8_t*>(malloc(size + kStbiHeaderSize));
+    if (!base)
+    {
+        return nullptr;
+    }
+
+    *reinterpret_cast<size_t*>(base) = size;
+    g_stbiBytesInFlight += size;
+    return base + kStbiHeaderSize;
+}
+
+static void* stbiRealloc(void* ptr, size_t newSize)
+{
+    if (!ptr)
+    {
+        return stbiMalloc(newSize);
+    }
+
+    auto base            = static_cast<uint8_t*>(ptr) - kStbiHeaderSize;
+    const size_t oldSize = *reinterpret_cast<size_t*>(base);
+    auto newBase         = static_cast<uint8_t*>(realloc(base, newSize + kStbiHeaderSize));
+    if (!newBase)
+    {
+        return nullptr;
+    }
+
+    *reinterpret_cast<size_t*>(newBase) = newSize;
+    g_stbiBytesInFlight += newSize;
+    g_stbiBytesInFlight -= oldSize;
+    return newBase + kStbiHeaderSize;
+}
+
+static void stbiFree(void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    auto base = static_cast<uint8_t*>(ptr) - kStbiHeaderSize;
+    g_stbiBytesInFlight -= *reinterpret_cast<size_t*>(base);
+    free(base);
+}
+
+TextureManager::TextureManager(ThreadPool& threadPool)
+    : m_threadPool(threadPool)
+{
+    stbi_set_jpeg_parallel_for(stbiParallelFor, &m_threadPool);
+}
+
+TextureManager::~TextureManager()
+{
+    // 等待工作线程结束，避免解码任务访问已经析构的对象
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_decodedCv.wait(lock, [this]() { return m_pending == 0; });
+
+    for (auto& entry : m_entries)
+    {
+        if (entry.state == State::Decoded)
+        {
+            stbi_image_free(entry.pixels);
+        }
+    }
+
+    stbi_set_jpeg_parallel_for(nullptr, nullptr);
+}
+
+TextureManager::TextureId TextureManager::load(const char* filePath, uint64_t flags, bool generateMips)
+{
+    Entry entry;
+    entry.filePath     = filePath;
+    entry.flags        = flags;
+    entry.generateMips = generateMips;
+    return enqueue(std::move(entry));
+}
+
+TextureManager::TextureId TextureManager::loadToAtlas(const char* filePath, TextureAtlas& atlas)
+{
+    Entry entry;
+    entry.filePath = filePath;
+    entry.atlas    = &atlas;
+    return enqueue(std::move(entry));
+}
+
+TextureManager::TextureId TextureManager::enqueue(Entry&& entry)
+{
+    TextureId id = kInvalidTexture;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        id              = static_cast<TextureId>(m_entries.size());
+        entry.loadStart = std::chrono::steady_clock::now();
+        m_entries.emplace_back(std::move(entry));
+        ++m_pending;
+    }
+
+    m_threadPool.submit([this, id]() { decode(id); });
+    return id;
+}
+
+void TextureManager::decode(TextureId id)
+{
+    std::string filePath;
+    bool generateMips = false;
+    bool srgb         = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        filePath     = m_entries[id].filePath;
+        generateMips = m_entries[id].generateMips;
+        srgb         = (m_entries[id].flags & BGFX_TEXTURE_SRGB) != 0;
+    }
+
+    void* pixels                     = nullptr;
+    uint32_t size                    = 0;
+    int width                        = 0;
+    int height                       = 0;
+    int channels                     = 0;
+    bgfx::TextureFormat::Enum format = bgfx::TextureFormat::RGBA8;
+
+    // DDS/KTX 只需要映射文件、解析文件头，mip 数据原样交给 bgfx。
+    // 后端是否支持其中的格式要在 bgfx::init 之后才能查询，在 upload() 中检查
+    std::shared_ptr<TextureContainer> container;
+    if (TextureContainer::isContainerFile(filePath.c_str()))
+    {
+        container = std::make_shared<TextureContainer>();
+        if (!container->open(filePath.c_str()))
+        {
+            const std::string fallback = findFallbackImage(filePath);
+            std::cerr << "texture container not readable: " << filePath << (fallback.empty() ? "" : ", falling back to " + fallback) << "\n";
+            container.reset();
+            filePath = fallback;
+        }
+    }
+
+    const char* failure = nullptr;
+    std::vector<uint8_t> fileData;
+    if (!container && !filePath.empty() && readFile(filePath.c_str(), fileData))
+    {
+        const auto buffer = fileData.data();
+        const int length  = static_cast<int>(fileData.size());
+
+        // RGB8 很多后端不支持，统一扩展成4通道
+        QoiHeader qoiHeader;
+        if (qoiReadHeader(buffer, fileData.size(), qoiHeader))
+        {
+            uint32_t qoiSize = 0;
+            if (!getImageSize(qoiHeader.width, qoiHeader.height, 4, qoiSize))
+            {
+                failure = "image too large";
+            }
+            pixels = failure ? nullptr : stbiMalloc(qoiSize);
+            if (pixels && qoiDecode(buffer, fileData.size(), static_cast<uint8_t*>(pixels), 4))
+            {
+                width    = static_cast<int>(qoiHeader.width);
+                height   = static_cast<int>(qoiHeader.height);
+                channels = qoiHeader.channels;
+                size     = qoiSize;
+                format   = bgfx::TextureFormat::RGBA8;
+            }
+            else
+            {
+                stbiFree(pixels);
+                pixels  = nullptr;
+                failure = failure ? failure : "qoi decode failed";
+            }
+        }
+        else
+        {
+            // 先只读文件头检查尺寸，避免解码放不进纹理的图片
+            const bool hdr             = stbi_is_hdr_from_memory(buffer, length) != 0;
+            const size_t bytesPerPixel = hdr ? 4 * sizeof(float) : 4;
+            if (stbi_info_from_memory(buffer, length, &width, &height, &channels) && !getImageSize(width, height, bytesPerPixel, size))
+            {
+                failure = "image too large";
+            }
+            else if (hdr)
+            {
+                pixels = stbi_loadf_from_memory(buffer, length, &width, &height, &channels, 4);
+                format = bgfx::TextureFormat::RGBA32F;
+            }
+            else
+            {
+                pixels = stbi_load_from_memory(buffer, length, &width, &height, &channels, 4);
+                format = bgfx::TextureFormat::RGBA8;
+            }
+
+            // 失败原因在解码的线程中立即取出，之后同一线程的其他解码会覆盖它
+            const char* reason = pixels || failure ? nullptr : stbi_failure_reason();
+            if (!pixels && !failure)
+            {
+                failure = reason && *reason ? reason : "decode failed";
+            }
+            else if (pixels && !getImageSize(width, height, bytesPerPixel, size))
+            {
+                stbi_image_free(pixels);
+                pixels  = nullptr;
+                failure = "image too large";
+            }
+        }
+    }
+
+    // mip 链和原图一样用 stbiMalloc 分配，上传后同样由 releaseImage 释放。图集自己生成 mip
+    bool hasMips = false;
+    if (pixels && generateMips && getMipCount(width, height) > 1)
+    {
+        const bool hdr         = format == bgfx::TextureFormat::RGBA32F;
+        const size_t chainSize = getMipChainSize(width, height, hdr ? 4 * sizeof(float) : 4);
+        if (void* chain = chainSize <= UINT32_MAX ? stbiMalloc(chainSize) : nullptr)
+        {
+            if (hdr)
+            {
+                generateMipChain(&m_threadPool, static_cast<const float*>(pixels), width, height, ResizeFilter::Box, static_cast<float*>(chain));
+            }
+            else
+            {
+                generateMipChain(&m_threadPool, static_cast<const uint8_t*>(pixels), width, height, ResizeFilter::Box, srgb, static_cast<uint8_t*>(chain));
+            }
+
+            stbi_image_free(pixels);
+            pixels  = chain;
+            size    = static_cast<uint32_t>(chainSize);
+            hasMips = true;
+        }
+    }
+
+    if (!pixels && !container)
+    {
+        if (!failure)
+        {
+            failure = "read error";
+        }
+        std::cerr << "failed to load texture: " << filePath << " (" << failure << ")\n";
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_entries[id];
+    if (container)
+    {
+        entry.state     = State::Decoded;
+        entry.container = std::move(container);
+    }
+    else if (pixels)
+    {
+        entry.state   = State::Decoded;
+        entry.pixels  = pixels;
+        entry.size    = size;
+        entry.width   = static_cast<uint16_t>(width);
+        entry.height  = static_cast<uint16_t>(height);
+        entry.hasMips = hasMips;
+        entry.format  = format;
+    }
+    else
+    {
+        entry.state = State::Failed;
+    }
+
+    m_decoded.push_back(id);
+    --m_pending;
+    m_decodedCv.notify_all();
+}
+
+void TextureManager::upload(TextureId id)
+{
+    Entry& entry = m_entries[id];
+    if (entry.state != State::Decoded)
+    {
+        return;
+    }
+
+    // 后端不支持压缩格式时在工作线程中重新解码同名的图片，找不到图片时 decode() 会把纹理标记为失败
+    if (entry.container && !entry.container->isFormatSupported())
+    {
+        const std::string fallback = findFallbackImage(entry.filePath);
+        std::cerr << "texture container not usable on this renderer: " << entry.filePath
+                  << (fallback.empty() ? "" : ", falling back to " + fallback) << "\n";
+        entry.container.reset();
+        entry.filePath = fallback;
+        entry.state    = State::Decoding;
+        ++m_pending;
+        m_threadPool.submit([this, id]() { decode(id); });
+        return;
+    }
+
+    // 最大纹理尺寸要在 bgfx::init 之后才能查询
+    const uint32_t maxTextureSize = bgfx::getCaps()->limits.maxTextureSize;
+    if (entry.pixels && (entry.width > maxTextureSize || entry.height > maxTextureSize))
+    {
+        std::cerr << "failed to load texture: " << entry.filePath << " (" << entry.width << "x" << entry.height << " exceeds max texture size "
+                  << maxTextureSize << ")\n";
+        stbi_image_free(entry.pixels);
+        entry.pixels = nullptr;
+        entry.state  = State::Failed;
+        return;
+    }
+
+    // 放入图集的像素已经拷贝到图集中，纹理句柄在图集 update() 之后设置
+    if (entry.atlas && entry.pixels && entry.format == bgfx::TextureFormat::RGBA8)
+    {
+        entry.atlasRegion = entry.atlas->add(static_cast<const uint8_t*>(entry.pixels), entry.width, entry.height);
+        if (entry.atlasRegion != TextureAtlas::kInvalidRegion)
+        {
+            stbi_image_free(entry.pixels);
+            entry.pixels = nullptr;
+            return;
+        }
+    }
+
+    if (entry.container)
+    {
+        // 映射内存由 bgfx 持有引用，用完后自动解除映射
+        entry.handle = entry.container->createTexture(entry.flags);
+        entry.container.reset();
+    }
+    else
+    {
+        // 像素内存的所有权转交给 bgfx，上传完成后由 releaseImage 回调释放
+        const bgfx::Memory* mem = bgfx::makeRef(entry.pixels, entry.size, releaseImage, nullptr);
+        entry.handle            = bgfx::createTexture2D(entry.width, entry.height, entry.hasMips, 1, entry.format, entry.flags, mem);
+        entry.pixels            = nullptr;
+    }
+
+    entry.state    = bgfx::isValid(entry.handle) ? State::Ready : State::Failed;
+    entry.loadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - entry.loadStart).count();
+}
+
+void TextureManager::update()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<TextureAtlas*> atlases;
+    for (TextureId id : m_decoded)
+    {
+        upload(id);
+        const Entry& entry = m_entries[id];
+        if (entry.atlasRegion != TextureAtlas::kInvalidRegion && std::find(atlases.begin(), atlases.end(), entry.atlas) == atlases.end())
+        {
+            atlases.push_back(entry.atlas);
+        }
+    }
+
+    // 同一帧加入同一个图集的纹理合并成一次上传
+    for (TextureAtlas* atlas : atlases)
+    {
+        atlas->update();
+    }
+
+    for (TextureId id : m_decoded)
+    {
+        Entry& entry = m_entries[id];
+        if (entry.atlasRegion != TextureAtlas::kInvalidRegion && entry.state == State::Decoded)
+        {
+            entry.handle   = entry.atlas->getHandle();
+            entry.state    = bgfx::isValid(entry.handle) ? State::Ready : State::Failed;
+            entry.loadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - entry.loadStart).count();
+        }
+    }
+    m_decoded.clear();
+}
+
+void TextureManager::flush()
+{
+    // update() 可能为不支持的压缩纹理重新投递解码任务，所以循环到没有未完成的任务为止
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_decodedCv.wait(lock, [this]() { return m_pending == 0; });
+        }
+
+        update();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending == 0)
+        {
+            break;
+        }
+    }
+}
+
+bgfx::TextureHandle TextureManager::getHandle(TextureId id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id >= m_entries.size())
+    {
+        return BGFX_INVALID_HANDLE;
+    }
+
+    return m_entries[id].handle;
+}
+
+bool TextureManager::isReady(TextureId id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return id < m_entries.size() && m_entries[id].state == State::Ready;
+}
+
+bool TextureManager::isFailed(TextureId id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return id >= m_entries.size() || m_entries[id].state == State::Failed;
+}
+
+int32_t TextureManager::getAtlasRegion(TextureId id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return id < m_entries.size() ? m_entries[id].atlasRegion : TextureAtlas::kInvalidRegion;
+}
+
+float TextureManager::getLoadTime(TextureId id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return id < m_entries.size() ? m_entries[id].loadTime : 0.0f;
+}
+
+void TextureManager::destroyAll()
+{
+    flush();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& entry : m_entries)
+    {
+        // 图集纹理由 TextureAtlas::destroy() 销毁
+        if (bgfx::isValid(entry.handle) && entry.atlasRegion == TextureAtlas::kInvalidRegion)
+        {
+            bgfx::destroy(entry.handle);
+        }
+        entry.handle = BGFX_INVALID_HANDLE;
+        entry.state  = State::Failed;
+    }
+}
+
+size_t TextureManager::getDecodedBytesInFlight()
+{
+    return g_stbiBytesInFlight.load();
+}
@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include "bgfx/bgfx.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+class TextureAtlas;
+class TextureContainer;
+
+// 纹理管理：在工作线程中使用 stb_image 解码 PNG/JPEG/HDR 等图片（QOI 图片用 qoiDecode 解码），
+// 主线程调用 update() 时通过 bgfx::createTexture2D 上传。
+// DDS/KTX 文件直接映射到内存交给 bgfx，渲染后端不支持其中的压缩格式时，
+// 改为加载同名的 PNG/JPEG 等图片
+class TextureManager
+{
+public:
+    using TextureId = uint32_t;
+
+    static constexpr TextureId kInvalidTexture = UINT32_MAX;
+
+    explicit TextureManager(ThreadPool& threadPool);
+    ~TextureManager();
+
+    TextureManager(const TextureManager&)            = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    // 异步加载图片文件，立即返回纹理ID，纹理在之后的 update() 中创建。
+    // 解码不依赖 bgfx，可以在 bgfx::init 之前调用，让文件读取和解码与初始化并行
+    // generateMips 为 true 时在工作线程中生成完整的 mip 链（flags 含 BGFX_TEXTURE_SRGB 时在线性空间滤波），
+    // DDS/KTX 文件使用文件中自带的 mip
+    TextureId load(const char* filePath, uint64_t flags = BGFX_TEXTURE_NONE | BGFX_SAMPLER_NONE, bool generateMips = false);
+
+    // 异步加载图片并放入图集，getHandle() 返回图集纹理，UV 用 getAtlasRegion() 对应的区域换算。
+    // 图集放不下或者不是 RGBA8 图片时创建单独的纹理，此时 getAtlasRegion() 返回 TextureAtlas::kInvalidRegion
+    TextureId loadToAtlas(const char* filePath, TextureAtlas& atlas);
+
+    // 在调用 bgfx API 的线程中每帧调用一次，上传已经解码完成的纹理
+    void update();
+
+    // 阻塞等待所有已提交的解码任务完成并上传
+    void flush();
+
+    // 纹理未上传或加载失败时返回无效句柄
+    bgfx::TextureHandle getHandle(TextureId id) const;
+
+    int32_t getAtlasRegion(TextureId id) const;
+
+    bool isReady(TextureId id) const;
+    bool isFailed(TextureId id) const;
+
+    // 从 load() 到纹理创建完成的耗时（毫秒），还没有创建时返回0
+    float getLoadTime(TextureId id) const;
+
+    // 销毁所有纹理，需要在 bgfx::shutdown 之前调用
+    void destroyAll();
+
+    // stb_image 当前持有的像素内存（已解码但 bgfx 还未释放）
+    static size_t getDecodedBytesInFlight();
+
+private:
+    enum class State
+    {
+        Decoding,
+        Decoded,
+        Ready,
+        Failed,
+    };
+
+    struct Entry
+    {
+        std::string filePath;
+        uint64_t flags {0};
+        bool generateMips {false};
+        State state {State::Decoding};
+        void* pixels {nullptr};
+        uint32_t size {0};
+        uint16_t width {0};
+        uint16_t height {0};
+        bool hasMips {false};
+        bgfx::TextureFormat::Enum format {bgfx::TextureFormat::RGBA8};
+        std::shared_ptr<TextureContainer> container; // DDS/KTX，不为空时忽略 pixels
+        TextureAtlas* atlas {nullptr};
+        int32_t atlasRegion {-1};
+        bgfx::TextureHandle handle BGFX_INVALID_HANDLE;
+        std::chrono::steady_clock::time_point loadStart;
+        float loadTime {0.0f};
+    };
+
+    TextureId enqueue(Entry&& entry);
+    void decode(TextureId id);
+    void upload(TextureId id);
+
+    ThreadPool& m_threadPool;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_decodedCv;
+    std::vector<Entry> m_entries;
+    std::vector<TextureId> m_decoded;
+    uint32_t m_pending {0};
+};
@@ -0,0 +1,73 @@
+﻿#include "texture_readback.h"
+
+#include <algorithm>
+
+TextureReadback::TextureReadback(bgfx::TextureFormat::Enum format, uint32_t bytesPerPixel)
+    : m_format(format)
+    , m_bytesPerPixel(bytesPerPixel)
+{
+}
+
+TextureReadback::~TextureReadback()
+{
+    destroy();
+}
+
+TextureReadback::Region TextureReadback::clip(const Region& region, uint16_t srcWidth, uint16_t srcHeight)
+{
+    const uint32_t mipWidth  = std::max(srcWidth >> region.mip, 1);
+    const uint32_t mipHeight = std::max(srcHeight >> region.mip, 1);
+
+    Region result = region;
+    result.x      = static_cast<uint16_t>(std::min<uint32_t>(region.x, mipWidth));
+    result.y      = static_cast<uint16_t>(std::min<uint32_t>(region.y, mipHeight));
+    result.width  = static_cast<uint16_t>(std::min<uint32_t>(region.width, mipWidth - result.x));
+    result.height = static_cast<uint16_t>(std::min<uint32_t>(region.height, mipHeight - result.y));
+    return result;
+}
+
+uint32_t TextureReadback::read(bgfx::ViewId view, bgfx::TextureHandle src, uint16_t srcWidth, uint16_t srcHeight, const Region& region, void* data)
+{
+    const Region clipped = clip(region, srcWidth, srcHeight);
+    if (clipped.width == 0 || clipped.height == 0)
+    {
+        return 0;
+    }
+
+    // 区域大小变化时重新创建，大小不变时一直复用
+    if (!bgfx::isValid(m_handle) || m_width != clipped.width || m_height != clipped.height)
+    {
+        destroy();
+        m_handle = bgfx::createTexture2D(
+            clipped.width,
+            clipped.height,
+            false,
+            1,
+            m_format,
+            0 | BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK | BGFX_SAMPLER_MIN_POINT | BGFX_SAMPLER_MAG_POINT | BGFX_SAMPLER_MIP_POINT
+                | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP
+        );
+        m_width  = clipped.width;
+        m_height = clipped.height;
+    }
+
+    // 左下角为原点的后端中纹理的第0行是画面底部，区域的 y 需要换算
+    uint16_t srcY = clipped.y;
+    if (bgfx::getCaps()->originBottomLeft)
+    {
+        const uint16_t mipHeight = static_cast<uint16_t>(std::max(srcHeight >> clipped.mip, 1));
+        srcY                     = static_cast<uint16_t>(mipHeight - clipped.y - clipped.height);
+    }
+
+    bgfx::blit(view, m_handle, 0, 0, 0, 0, src, clipped.mip, clipped.x, srcY, 0, clipped.width, clipped.height, 1);
+    return bgfx::readTexture(m_handle, data);
+}
+
+void TextureReadback::destroy()
+{
+    if (bgfx::isValid(m_handle))
+    {
+        bgfx::destroy(m_handle);
+        m_handle = BGFX_INVALID_HANDLE;
+    }
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include "bgfx/bgfx.h"
+
+#include <cstdint>
+
+// 从渲染目标回读一部分像素：子矩形或者某一级 mip（渲染目标需要带 mip，bgfx 在渲染后自动生成），
+// 回读纹理的大小和请求的区域相同，传输量和之后的 CPU 处理量只和实际需要的像素数有关。
+// 同时只能有一个未完成的读取，需要同时读取多个区域时使用多个实例
+class TextureReadback
+{
+public:
+    // 区域的坐标是对应 mip 级别中的像素坐标，原点在左上角，超出纹理的部分会被裁掉
+    struct Region
+    {
+        uint16_t x {0};
+        uint16_t y {0};
+        uint16_t width {UINT16_MAX};
+        uint16_t height {UINT16_MAX};
+        uint8_t mip {0};
+    };
+
+    TextureReadback(bgfx::TextureFormat::Enum format, uint32_t bytesPerPixel);
+    ~TextureReadback();
+
+    TextureReadback(const TextureReadback&)            = delete;
+    TextureReadback& operator=(const TextureReadback&) = delete;
+
+    // 按 src 第0级的尺寸裁剪区域，返回实际读取的区域
+    static Region clip(const Region& region, uint16_t srcWidth, uint16_t srcHeight);
+
+    uint32_t getDataSize(const Region& clipped) const
+    {
+        return uint32_t(clipped.width) * clipped.height * m_bytesPerPixel;
+    }
+
+    // 在 view 中把 src 的区域拷贝到回读纹理并调用 readTexture，data 至少 getDataSize(clip(region)) 字节。
+    // 返回数据可用时的帧号，区域为空时返回 0。
+    // 和直接回读整张纹理一样，左下角为原点的后端（OpenGL）读到的行顺序是从下到上
+    uint32_t read(bgfx::ViewId view, bgfx::TextureHandle src, uint16_t srcWidth, uint16_t srcHeight, const Region& region, void* data);
+
+    // 需要在 bgfx::shutdown 之前调用
+    void destroy();
+
+private:
+    bgfx::TextureFormat::Enum m_format;
+    uint32_t m_bytesPerPixel;
+    bgfx::TextureHandle m_handle BGFX_INVALID_HANDLE;
+    uint16_t m_width {0};
+    uint16_t m_height {0};
+};
@@ -0,0 +1,182 @@
+﻿#include "thread_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t numThreads)
+{
+    if (numThreads == 0)
+    {
+        const uint32_t hw = std::thread::hardware_concurrency();
+        numThreads        = hw > 1 ? hw - 1 : 1;
+    }
+
+    m_threads.reserve(numThreads);
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        m_threads.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_taskCv.notify_all();
+
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.emplace_back(std::move(task));
+    }
+    m_taskCv.notify_one();
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t grainSize, const ChunkFunc& func)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    grainSize                = std::max(grainSize, 1u);
+    const uint32_t numChunks = (count + grainSize - 1) / grainSize;
+    if (numChunks == 1)
+    {
+        func.invoke(func.context, 0, count);
+        return;
+    }
+
+    // 分块通过原子计数器领取，调用线程自己也会领取分块，
+    // 所以即使所有工作线程都在忙（例如嵌套调用），也能保证完成
+    Job job;
+    job.func      = func;
+    job.count     = count;
+    job.grainSize = grainSize;
+    job.numChunks = numChunks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job.nextJob = m_jobs;
+        m_jobs      = &job;
+    }
+
+    const uint32_t numHelpers = std::min(numChunks - 1, getThreadCount());
+    for (uint32_t i = 0; i < numHelpers; ++i)
+    {
+        m_taskCv.notify_one();
+    }
+
+    runChunks(job);
+
+    // 所有分块都已领取，移出列表后不会再有新的工作线程加入，等待正在执行分块的工作线程
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (Job** it = &m_jobs; *it; it = &(*it)->nextJob)
+    {
+        if (*it == &job)
+        {
+            *it = job.nextJob;
+            break;
+        }
+    }
+    m_jobCv.wait(lock, [&job]() { return job.helpers == 0; });
+}
+
+ThreadPool::Job* ThreadPool::findJob() const
+{
+    for (Job* job = m_jobs; job; job = job->nextJob)
+    {
+        if (job->next.load(std::memory_order_relaxed) < job->numChunks)
+        {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::runChunks(Job& job)
+{
+    for (;;)
+    {
+        const uint32_t chunk = job.next.fetch_add(1);
+        if (chunk >= job.numChunks)
+        {
+            break;
+        }
+
+        TRACE_ZONE("parallelFor");
+        const uint32_t begin = chunk * job.grainSize;
+        job.func.invoke(job.func.context, begin, std::min(begin + job.grainSize, job.count));
+    }
+}
+
+void ThreadPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idleCv.wait(lock, [this]() { return m_tasks.empty() && m_activeTasks == 0; });
+}
+
+void ThreadPool::workerLoop()
+{
+    TRACE_THREAD_NAME("worker");
+    for (;;)
+    {
+        std::function<void()> task;
+        Job* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskCv.wait(lock, [this]() { return m_stop || !m_tasks.empty() || findJob(); });
+
+            // parallelFor 的调用线程在等待，优先执行它的分块
+            job = findJob();
+            if (job)
+            {
+                ++job->helpers;
+            }
+            else if (m_stop && m_tasks.empty())
+            {
+                return;
+            }
+            else
+            {
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+                ++m_activeTasks;
+            }
+        }
+
+        if (job)
+        {
+            runChunks(*job);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--job->helpers == 0)
+            {
+                m_jobCv.notify_all();
+            }
+            continue;
+        }
+
+        {
+            TRACE_ZONE("task");
+            task();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_activeTasks;
+            if (m_tasks.empty() && m_activeTasks == 0)
+            {
+                m_idleCv.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 简单的工作线程池，用于图片解码、纹理压缩等CPU密集型任务
+class ThreadPool
+{
+public:
+    // numThreads 为 0 时使用 hardware_concurrency - 1（至少1个）
+    explicit ThreadPool(uint32_t numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 投递一个异步任务
+    void submit(std::function<void()> task);
+
+    // 将 [0, count) 分块并行执行，调用线程也参与计算，所有分块完成后返回
+    // 可以在工作线程内部嵌套调用，不会死锁。func 以 (begin, end) 调用，不会被拷贝，整个过程不申请内存
+    template <typename Func>
+    void parallelFor(uint32_t count, uint32_t grainSize, const Func& func)
+    {
+        const ChunkFunc chunkFunc = {&func, [](const void* context, uint32_t begin, uint32_t end) { (*static_cast<const Func*>(context))(begin, end); }};
+        parallelFor(count, grainSize, chunkFunc);
+    }
+
+    // 等待所有已投递的任务执行完毕
+    void waitIdle();
+
+    uint32_t getThreadCount() const
+    {
+        return static_cast<uint32_t>(m_threads.size());
+    }
+
+private:
+    // 不持有 parallelFor 的 func，避免构造 std::function 时申请内存
+    struct ChunkFunc
+    {
+        const void* context;
+        void (*invoke)(const void* context, uint32_t begin, uint32_t end);
+    };
+
+    // 正在执行的 parallelFor，位于调用线程的栈上。空闲的工作线程优先从 m_jobs 中领取分块，
+    // 调用线程等到没有工作线程还在执行它的分块后才返回
+    struct Job
+    {
+        ChunkFunc func;
+        uint32_t count;
+        uint32_t grainSize;
+        uint32_t numChunks;
+        std::atomic<uint32_t> next {0};
+        uint32_t helpers {0}; // 由 m_mutex 保护
+        Job* nextJob {nullptr};
+    };
+
+    void parallelFor(uint32_t count, uint32_t grainSize, const ChunkFunc& func);
+    void workerLoop();
+    Job* findJob() const;
+    static void runChunks(Job& job);
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_taskCv;
+    std::condition_variable m_idleCv;
+    std::condition_variable m_jobCv;
+    Job* m_jobs {nullptr};
+    uint32_t m_activeTasks {0};
+    bool m_stop {false};
+};
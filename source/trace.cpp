@@ -0,0 +1,197 @@
+﻿#include "trace.h"
+#include "json_writer.h"
+
+#ifdef ENABLE_TRACE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+constexpr uint32_t kMaxEventsPerThread = 1 << 16;
+constexpr uint32_t kGpuTrackId         = 1000;
+constexpr size_t kMaxNameLength        = 31;
+
+struct Event
+{
+    const char* name;
+    uint64_t begin; // 纳秒
+    uint64_t end;
+};
+
+// 只有所属线程写 events 和 count，导出时读取 count 之前的事件
+struct ThreadBuffer
+{
+    uint32_t id {0};
+    char name[kMaxNameLength + 1] {};
+    std::unique_ptr<Event[]> events {new Event[kMaxEventsPerThread]};
+    std::atomic<uint32_t> count {0};
+    std::atomic<uint32_t> dropped {0};
+};
+
+// 线程结束后缓冲仍然保留，直到程序退出，导出时可以拿到工作线程的全部事件
+std::mutex g_buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+ThreadBuffer* createBuffer(uint32_t id, const char* name)
+{
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->id  = id;
+    snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    g_buffers.emplace_back(std::move(buffer));
+    return g_buffers.back().get();
+}
+
+ThreadBuffer& getThreadBuffer()
+{
+    static std::atomic<uint32_t> nextId {1};
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+        const uint32_t id = nextId.fetch_add(1);
+        char name[kMaxNameLength + 1];
+        snprintf(name, sizeof(name), "thread %u", id);
+        buffer = createBuffer(id, name);
+    }
+    return *buffer;
+}
+
+ThreadBuffer& getGpuBuffer()
+{
+    static ThreadBuffer* buffer = createBuffer(kGpuTrackId, "GPU");
+    return *buffer;
+}
+
+// 事件只保存名字的指针，bgfx 的 view 名字在下一帧会被覆盖，GPU 轨道使用这里的固定名字
+const char* getGpuViewName(bgfx::ViewId view)
+{
+    static char names[256][16];
+    static std::once_flag once;
+    std::call_once(once, [] {
+        for (int i = 0; i < 256; ++i)
+        {
+            snprintf(names[i], sizeof(names[i]), "gpu view %d", i);
+        }
+    });
+    return names[view & 0xff];
+}
+
+void append(ThreadBuffer& buffer, const char* name, uint64_t begin, uint64_t end)
+{
+    const uint32_t index = buffer.count.load(std::memory_order_relaxed);
+    if (index >= kMaxEventsPerThread)
+    {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer.events[index] = {name, begin, end};
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+} // namespace
+
+namespace trace {
+uint64_t now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void record(const char* name, uint64_t begin, uint64_t end)
+{
+    append(getThreadBuffer(), name, begin, end);
+}
+
+void setThreadName(const char* name)
+{
+    ThreadBuffer& buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    snprintf(buffer.name, sizeof(buffer.name), "%s", name);
+}
+
+void gpuFrame(const bgfx::Stats& stats)
+{
+    if (stats.gpuTimerFreq <= 0 || stats.gpuTimeEnd <= stats.gpuTimeBegin)
+    {
+        return;
+    }
+
+    // GPU 时钟和 CPU 时钟不同步，把这一帧 GPU 的结束时间对齐到当前时间，
+    // 只有各段的长度和先后顺序有意义
+    const uint64_t end        = now();
+    const double toNs         = 1e9 / double(stats.gpuTimerFreq);
+    const uint64_t frameNs    = static_cast<uint64_t>(double(stats.gpuTimeEnd - stats.gpuTimeBegin) * toNs);
+    const uint64_t frameBegin = end > frameNs ? end - frameNs : 0;
+
+    ThreadBuffer& buffer = getGpuBuffer();
+    append(buffer, "gpu frame", frameBegin, end);
+    for (uint16_t i = 0; i < stats.numViews; ++i)
+    {
+        const bgfx::ViewStats& view = stats.viewStats[i];
+        if (view.gpuTimeEnd <= view.gpuTimeBegin)
+        {
+            continue;
+        }
+
+        const uint64_t begin = frameBegin + static_cast<uint64_t>(double(view.gpuTimeBegin - stats.gpuTimeBegin) * toNs);
+        append(buffer, getGpuViewName(view.view), begin, begin + static_cast<uint64_t>(double(view.gpuTimeEnd - view.gpuTimeBegin) * toNs));
+    }
+}
+
+bool write(const char* filePath)
+{
+    FILE* file = fopen(filePath, "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+
+    // 时间戳相对于最早的事件，单位为微秒
+    uint64_t origin = UINT64_MAX;
+    for (const auto& buffer : g_buffers)
+    {
+        const uint32_t count = buffer->count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            origin = std::min(origin, buffer->events[i].begin);
+        }
+    }
+
+    fprintf(file, "{\"traceEvents\": [\n");
+    bool first = true;
+    for (const auto& buffer : g_buffers)
+    {
+        fprintf(file, "%s  {\"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"name\": \"thread_name\", \"args\": {\"name\": ", first ? "" : ",\n", buffer->id);
+        writeJsonString(file, buffer->name);
+        fprintf(file, "}}");
+        first = false;
+
+        const uint32_t count = buffer->count.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const Event& event = buffer->events[i];
+            fprintf(file, ",\n  {\"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"name\": ", buffer->id);
+            writeJsonString(file, event.name);
+            fprintf(file, ", \"ts\": %.3f, \"dur\": %.3f}", (event.begin - origin) / 1000.0, (event.end - event.begin) / 1000.0);
+        }
+
+        const uint32_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+        if (dropped > 0)
+        {
+            fprintf(stderr, "trace: %s dropped %u events\n", buffer->name, dropped);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0;
+}
+} // namespace trace
+
+#endif // ENABLE_TRACE
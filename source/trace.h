@@ -0,0 +1,63 @@
+﻿#pragma once
+
+// CPU 时间线埋点，导出为 Chrome trace JSON（chrome://tracing 或 https://ui.perfetto.dev 打开）。
+// 只有定义了 ENABLE_TRACE（CMake 选项 ENABLE_TRACE=ON）时才记录，否则所有宏展开为空，埋点不产生任何代码。
+//
+// TRACE_ZONE("name")          记录从这里到当前作用域结束的耗时，name 必须是字符串字面量
+// TRACE_THREAD_NAME("name")   设置当前线程在时间线中显示的名字
+// TRACE_GPU_FRAME(stats)      在 bgfx::frame() 之后调用，把 bgfx::Stats 中各个 view 的 GPU 耗时放到 GPU 轨道
+// TRACE_WRITE("trace.json")   导出所有线程已经记录的事件
+//
+// 每个线程有自己的定长事件缓冲，记录时不加锁、不分配内存，缓冲写满后丢弃之后的事件
+
+#ifdef ENABLE_TRACE
+
+#include "bgfx/bgfx.h"
+
+#include <cstdint>
+
+namespace trace {
+uint64_t now();
+void record(const char* name, uint64_t begin, uint64_t end);
+void setThreadName(const char* name);
+void gpuFrame(const bgfx::Stats& stats);
+bool write(const char* filePath);
+
+class Zone
+{
+public:
+    explicit Zone(const char* name)
+        : m_name(name)
+        , m_begin(now())
+    {
+    }
+
+    ~Zone()
+    {
+        record(m_name, m_begin, now());
+    }
+
+    Zone(const Zone&)            = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_begin;
+};
+} // namespace trace
+
+#define TRACE_CONCAT_IMPL(a, b)    a##b
+#define TRACE_CONCAT(a, b)         TRACE_CONCAT_IMPL(a, b)
+#define TRACE_ZONE(name)           trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD_NAME(name)    trace::setThreadName(name)
+#define TRACE_GPU_FRAME(stats)     trace::gpuFrame(stats)
+#define TRACE_WRITE(filePath)      trace::write(filePath)
+
+#else
+
+#define TRACE_ZONE(name)
+#define TRACE_THREAD_NAME(name)
+#define TRACE_GPU_FRAME(stats)
+#define TRACE_WRITE(filePath)
+
+#endif // ENABLE_TRACE
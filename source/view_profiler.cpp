@@ -0,0 +1,101 @@
+﻿#include "view_profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+float toMs(int64_t ticks, int64_t frequency)
+{
+    return frequency > 0 ? float(double(ticks) * 1000.0 / double(frequency)) : 0.0f;
+}
+} // namespace
+
+ViewProfiler::ViewProfiler(uint32_t window)
+    : m_window(std::max(window, 1u))
+{
+    strcpy(m_frame.name, "frame");
+}
+
+void ViewProfiler::update(const bgfx::Stats& stats)
+{
+    push(m_frameHistory, toMs(stats.cpuTimeFrame, stats.cpuTimerFreq), toMs(stats.gpuTimeEnd - stats.gpuTimeBegin, stats.gpuTimerFreq));
+    store(m_frameHistory, m_frame);
+
+    for (uint16_t i = 0; i < stats.numViews; ++i)
+    {
+        const bgfx::ViewStats& viewStats = stats.viewStats[i];
+
+        // 保持按编号排序，二分查找
+        auto it = std::lower_bound(m_views.begin(), m_views.end(), viewStats.view, [](const ViewTiming& timing, bgfx::ViewId view) {
+            return timing.view < view;
+        });
+        const size_t index = size_t(it - m_views.begin());
+        if (it == m_views.end() || it->view != viewStats.view)
+        {
+            ViewTiming timing;
+            timing.view = viewStats.view;
+            m_views.insert(it, timing);
+            m_histories.insert(m_histories.begin() + index, History());
+        }
+
+        ViewTiming& timing = m_views[index];
+        if (strncmp(timing.name, viewStats.name, sizeof(timing.name) - 1) != 0)
+        {
+            strncpy(timing.name, viewStats.name, sizeof(timing.name) - 1);
+        }
+
+        History& history = m_histories[index];
+        push(
+            history,
+            toMs(viewStats.cpuTimeEnd - viewStats.cpuTimeBegin, stats.cpuTimerFreq),
+            toMs(viewStats.gpuTimeEnd - viewStats.gpuTimeBegin, stats.gpuTimerFreq)
+        );
+        store(history, timing);
+    }
+}
+
+uint16_t ViewProfiler::drawOverlay(uint16_t x, uint16_t y) const
+{
+    bgfx::dbgTextPrintf(x, y++, 0x0f, "%-24s %8s %8s %8s", "view", "cpu ms", "gpu ms", "gpu max");
+    for (const ViewTiming& timing : m_views)
+    {
+        bgfx::dbgTextPrintf(x, y++, 0x0f, "%3u %-20.20s %8.3f %8.3f %8.3f", timing.view, timing.name, timing.cpuMs, timing.gpuMs, timing.gpuMaxMs);
+    }
+    bgfx::dbgTextPrintf(x, y++, 0x0e, "%-24s %8.3f %8.3f %8.3f", m_frame.name, m_frame.cpuMs, m_frame.gpuMs, m_frame.gpuMaxMs);
+    return y;
+}
+
+void ViewProfiler::push(History& history, float cpuMs, float gpuMs)
+{
+    if (history.cpu.empty())
+    {
+        history.cpu.resize(m_window);
+        history.gpu.resize(m_window);
+    }
+
+    // 环形缓冲满了之后减去最旧的一帧
+    if (history.count == m_window)
+    {
+        history.cpuSum -= history.cpu[history.next];
+        history.gpuSum -= history.gpu[history.next];
+    }
+    else
+    {
+        ++history.count;
+    }
+
+    history.cpu[history.next] = cpuMs;
+    history.gpu[history.next] = gpuMs;
+
+    history.cpuSum += cpuMs;
+    history.gpuSum += gpuMs;
+
+    history.next = (history.next + 1) % m_window;
+}
+
+void ViewProfiler::store(const History& history, ViewTiming& timing) const
+{
+    timing.cpuMs    = float(history.cpuSum / history.count);
+    timing.gpuMs    = float(history.gpuSum / history.count);
+    timing.gpuMaxMs = *std::max_element(history.gpu.begin(), history.gpu.begin() + history.count);
+}
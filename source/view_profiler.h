@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include "bgfx/bgfx.h"
+
+#include <cstdint>
+#include <vector>
+
+// 每帧读取 bgfx::Stats 中各个 view 的 CPU/GPU 耗时，计算最近若干帧的平均值和最大值，
+// 用来区分主渲染、MSAA resolve、拷贝回读等各个阶段各自占用了多少 GPU 时间。
+// view 的名字来自 bgfx::setViewName，bgfx 只在 bgfx::setDebug(BGFX_DEBUG_PROFILER) 时统计各个 view 的耗时
+class ViewProfiler
+{
+public:
+    struct ViewTiming
+    {
+        bgfx::ViewId view {0};
+        char name[32] {};
+        float cpuMs {0.0f}; // 最近 window 帧的平均值
+        float gpuMs {0.0f};
+        float gpuMaxMs {0.0f}; // 最近 window 帧的最大值
+    };
+
+    explicit ViewProfiler(uint32_t window = 60);
+
+    // 在 bgfx::frame() 之后调用
+    void update(const bgfx::Stats& stats);
+
+    // 按 view 编号排序
+    const std::vector<ViewTiming>& getViews() const
+    {
+        return m_views;
+    }
+
+    float getFrameCpuMs() const
+    {
+        return m_frame.cpuMs;
+    }
+
+    float getFrameGpuMs() const
+    {
+        return m_frame.gpuMs;
+    }
+
+    // 用 bgfx::dbgTextPrintf 输出表格，需要 bgfx::setDebug(BGFX_DEBUG_TEXT)，x、y 为字符坐标，返回下一个空行的 y
+    uint16_t drawOverlay(uint16_t x, uint16_t y) const;
+
+private:
+    struct History
+    {
+        std::vector<float> cpu;
+        std::vector<float> gpu;
+        uint32_t count {0};
+        uint32_t next {0};
+        double cpuSum {0.0};
+        double gpuSum {0.0};
+    };
+
+    void push(History& history, float cpuMs, float gpuMs);
+    void store(const History& history, ViewTiming& timing) const;
+
+    uint32_t m_window;
+    std::vector<ViewTiming> m_views;
+    std::vector<History> m_histories; // 和 m_views 一一对应
+    ViewTiming m_frame;
+    History m_frameHistory;
+};
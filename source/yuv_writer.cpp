@@ -0,0 +1,89 @@
+﻿#include "yuv_writer.h"
+
+YuvWriter::~YuvWriter()
+{
+    close();
+}
+
+bool YuvWriter::open(const char* filePath, Format format, uint32_t width, uint32_t height, uint32_t fpsNum, uint32_t fpsDen)
+{
+    close();
+    if (width == 0 || height == 0 || (width & 1) || (height & 1) || fpsNum == 0 || fpsDen == 0)
+    {
+        return false;
+    }
+
+    m_file = fopen(filePath, "wb");
+    if (!m_file)
+    {
+        return false;
+    }
+
+    m_format     = format;
+    m_width      = width;
+    m_height     = height;
+    m_frameCount = 0;
+    m_chroma.resize(size_t(width / 2) * (height / 2) * 2);
+
+    // 渐进扫描，方形像素。GPU 上色度取 2x2 像素的平均，采样位置在4个像素中心（C420jpeg），使用 BT.709 limited range
+    if (format == Format::Y4m)
+    {
+        fprintf(m_file, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fpsNum, fpsDen);
+    }
+    return true;
+}
+
+bool YuvWriter::writeFrame(const uint8_t* y, uint32_t yStride, const uint8_t* uv, uint32_t uvStride)
+{
+    if (!m_file)
+    {
+        return false;
+    }
+
+    yStride                     = yStride ? yStride : m_width;
+    uvStride                    = uvStride ? uvStride : m_width;
+    const uint32_t chromaWidth  = m_width / 2;
+    const uint32_t chromaHeight = m_height / 2;
+
+    bool ok = m_format != Format::Y4m || fputs("FRAME\n", m_file) >= 0;
+    for (uint32_t row = 0; row < m_height && ok; ++row)
+    {
+        ok = fwrite(y + size_t(row) * yStride, 1, m_width, m_file) == m_width;
+    }
+
+    if (m_format == Format::RawNV12)
+    {
+        for (uint32_t row = 0; row < chromaHeight && ok; ++row)
+        {
+            ok = fwrite(uv + size_t(row) * uvStride, 1, m_width, m_file) == m_width;
+        }
+    }
+    else
+    {
+        // UV 交错拆分成 U、V 两个平面，色度只有亮度的 1/4，这一步的开销很小
+        uint8_t* u = m_chroma.data();
+        uint8_t* v = u + size_t(chromaWidth) * chromaHeight;
+        for (uint32_t row = 0; row < chromaHeight; ++row)
+        {
+            const uint8_t* src = uv + size_t(row) * uvStride;
+            for (uint32_t x = 0; x < chromaWidth; ++x)
+            {
+                *u++ = src[x * 2 + 0];
+                *v++ = src[x * 2 + 1];
+            }
+        }
+        ok = ok && fwrite(m_chroma.data(), 1, m_chroma.size(), m_file) == m_chroma.size();
+    }
+
+    m_frameCount += ok ? 1 : 0;
+    return ok;
+}
+
+void YuvWriter::close()
+{
+    if (m_file)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// 把 YUV420 视频帧写入文件：Y4M（ffmpeg、mpv 可以直接打开）或者不带文件头的 I420 / NV12 裸数据。
+// 输入为 GPU 转换得到的两个平面：全分辨率的 Y，半分辨率、U/V 交错的 UV（即 NV12 的内存布局）
+class YuvWriter
+{
+public:
+    enum class Format
+    {
+        Y4m,     // 文件头 + 每帧 "FRAME" + I420
+        RawI420, // Y、U、V 三个平面依次排列
+        RawNV12, // Y 平面 + UV 交错平面，和输入相同，不需要拆分
+    };
+
+    YuvWriter() = default;
+    ~YuvWriter();
+
+    YuvWriter(const YuvWriter&)            = delete;
+    YuvWriter& operator=(const YuvWriter&) = delete;
+
+    // width、height 必须是偶数，帧率为 fpsNum / fpsDen
+    bool open(const char* filePath, Format format, uint32_t width, uint32_t height, uint32_t fpsNum = 60, uint32_t fpsDen = 1);
+
+    // stride 为每行字节数，为0时按紧密排列处理（Y 为 width，UV 为 width）
+    bool writeFrame(const uint8_t* y, uint32_t yStride, const uint8_t* uv, uint32_t uvStride);
+
+    void close();
+
+    uint32_t getFrameCount() const
+    {
+        return m_frameCount;
+    }
+
+private:
+    FILE* m_file {nullptr};
+    Format m_format {Format::Y4m};
+    uint32_t m_width {0};
+    uint32_t m_height {0};
+    uint32_t m_frameCount {0};
+    std::vector<uint8_t> m_chroma; // 拆分后的 U、V 平面
+};